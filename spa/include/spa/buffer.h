@@ -101,6 +101,17 @@ static inline void *spa_buffer_find_meta(struct spa_buffer *b, uint32_t type)
 	return NULL;
 }
 
+static inline uint32_t spa_buffer_find_meta_size(struct spa_buffer *b, uint32_t type)
+{
+	uint32_t i;
+
+	for (i = 0; i < b->n_metas; i++)
+		if (b->metas[i].type == type)
+			return b->metas[i].size;
+
+	return 0;
+}
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
@@ -26,6 +26,13 @@ extern "C" {
 
 #include <spa/graph.h>
 
+#ifndef spa_graph_node_process_input
+#define spa_graph_node_process_input(d,n)	spa_node_process_input((n)->implementation)
+#endif
+#ifndef spa_graph_node_process_output
+#define spa_graph_node_process_output(d,n)	spa_node_process_output((n)->implementation)
+#endif
+
 static inline int spa_graph_impl_need_input(void *data, struct spa_graph_node *node)
 {
 	struct spa_graph_port *p;
@@ -53,7 +60,7 @@ static inline int spa_graph_impl_need_input(void *data, struct spa_graph_node *n
 	}
 
 	spa_list_for_each_safe(n, t, &ready, ready_link) {
-		n->state = spa_node_process_output(n->implementation);
+		n->state = spa_graph_node_process_output(data, n);
 		spa_debug("peer %p processed out %d", n, n->state);
 		if (n->state == SPA_RESULT_NEED_BUFFER)
 			spa_graph_need_input(n->graph, n);
@@ -70,7 +77,7 @@ static inline int spa_graph_impl_need_input(void *data, struct spa_graph_node *n
 	spa_debug("node %p ready:%d required:%d", node, node->ready[SPA_DIRECTION_INPUT], node->required[SPA_DIRECTION_INPUT]);
 
 	if (node->required[SPA_DIRECTION_INPUT] > 0 && node->ready[SPA_DIRECTION_INPUT] == node->required[SPA_DIRECTION_INPUT]) {
-		node->state = spa_node_process_input(node->implementation);
+		node->state = spa_graph_node_process_input(data, node);
 		spa_debug("node %p processed in %d", node, node->state);
 		if (node->state == SPA_RESULT_HAVE_BUFFER) {
 			spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
@@ -117,7 +124,7 @@ static inline int spa_graph_impl_have_output(void *data, struct spa_graph_node *
 	}
 
 	spa_list_for_each_safe(n, t, &ready, ready_link) {
-		n->state = spa_node_process_input(n->implementation);
+		n->state = spa_graph_node_process_input(data, n);
 		spa_debug("node %p chain processed in %d", n, n->state);
 		if (n->state == SPA_RESULT_HAVE_BUFFER)
 			spa_graph_have_output(n->graph, n);
@@ -133,7 +140,7 @@ static inline int spa_graph_impl_have_output(void *data, struct spa_graph_node *
 		n->ready_link.next = NULL;
 	}
 
-	node->state = spa_node_process_output(node->implementation);
+	node->state = spa_graph_node_process_output(data, node);
 	spa_debug("node %p processed out %d", node, node->state);
 	if (node->state == SPA_RESULT_NEED_BUFFER) {
 		node->ready[SPA_DIRECTION_INPUT] = 0;
@@ -40,6 +40,8 @@ extern "C" {
 #define SPA_TYPE_META__VideoCrop	SPA_TYPE_META_BASE "VideoCrop"
 #define SPA_TYPE_META__Ringbuffer	SPA_TYPE_META_BASE "Ringbuffer"
 #define SPA_TYPE_META__Shared		SPA_TYPE_META_BASE "Shared"
+#define SPA_TYPE_META__VideoDamage	SPA_TYPE_META_BASE "VideoDamage"
+#define SPA_TYPE_META__Dropped		SPA_TYPE_META_BASE "Dropped"
 
 struct spa_type_meta {
 	uint32_t Header;
@@ -47,6 +49,8 @@ struct spa_type_meta {
 	uint32_t VideoCrop;
 	uint32_t Ringbuffer;
 	uint32_t Shared;
+	uint32_t VideoDamage;
+	uint32_t Dropped;
 };
 
 static inline void spa_type_meta_map(struct spa_type_map *map, struct spa_type_meta *type)
@@ -57,6 +61,8 @@ static inline void spa_type_meta_map(struct spa_type_map *map, struct spa_type_m
 		type->VideoCrop = spa_type_map_get_id(map, SPA_TYPE_META__VideoCrop);
 		type->Ringbuffer = spa_type_map_get_id(map, SPA_TYPE_META__Ringbuffer);
 		type->Shared = spa_type_map_get_id(map, SPA_TYPE_META__Shared);
+		type->VideoDamage = spa_type_map_get_id(map, SPA_TYPE_META__VideoDamage);
+		type->Dropped = spa_type_map_get_id(map, SPA_TYPE_META__Dropped);
 	}
 }
 
@@ -87,11 +93,22 @@ struct spa_meta_video_crop {
 	int32_t width, height;	/**< width and height */
 };
 
-/** Ringbuffer metadata */
+/** Ringbuffer metadata
+ *
+ * The ringbuffer is in the first data of the buffer. The buffer is given to
+ * the reader once and stays there, the reader and the writer then move the
+ * indexes at their own pace. */
 struct spa_meta_ringbuffer {
 	struct spa_ringbuffer ringbuffer;	/**< the ringbuffer */
 };
 
+/** Dropped buffers metadata */
+struct spa_meta_dropped {
+	uint32_t count;		/**< number of buffers that were dropped between
+				  *  the previous buffer and this one */
+	uint32_t padding;
+};
+
 /** Describes the shared memory of a buffer is stored */
 struct spa_meta_shared {
 	int32_t flags;		/**< flags */
@@ -100,6 +117,63 @@ struct spa_meta_shared {
 	uint32_t size;		/**< size of memory */
 };
 
+/** A rectangle of a video frame */
+struct spa_meta_region {
+	int32_t x, y;		/**< x and y offsets */
+	uint32_t width, height;	/**< width and height */
+};
+
+/** Video damage metadata
+ *
+ * Lists the regions of the frame that changed since the previous frame of the
+ * stream, the other pixels are the same as in that frame. The number of regions
+ * that fit is given by the size of the metadata, see
+ * spa_meta_video_damage_max_regions(). A frame without this metadata is
+ * completely damaged.
+ */
+struct spa_meta_video_damage {
+#define SPA_META_VIDEO_DAMAGE_FLAG_ALL	(1 << 0)	/**< the complete frame changed,
+							  *  the regions are not used */
+	uint32_t flags;			/**< flags */
+	uint32_t n_regions;		/**< number of valid regions, 0 when nothing
+					  *  changed */
+	struct spa_meta_region regions[];	/**< the damaged regions */
+};
+
+/** The size of video damage metadata with room for \a n regions */
+#define SPA_META_VIDEO_DAMAGE_SIZE(n)	(sizeof(struct spa_meta_video_damage) +	\
+					 (n) * sizeof(struct spa_meta_region))
+
+/** Get the maximum number of regions in video damage metadata of \a size bytes */
+static inline uint32_t spa_meta_video_damage_max_regions(uint32_t size)
+{
+	if (size < sizeof(struct spa_meta_video_damage))
+		return 0;
+	return (size - sizeof(struct spa_meta_video_damage)) / sizeof(struct spa_meta_region);
+}
+
+/** Mark all of the frame damaged */
+static inline void spa_meta_video_damage_set_all(struct spa_meta_video_damage *damage)
+{
+	damage->flags = SPA_META_VIDEO_DAMAGE_FLAG_ALL;
+	damage->n_regions = 0;
+}
+
+/** Add a damaged region, the complete frame is marked damaged when the
+ * region does not fit in \a size bytes of metadata */
+static inline void spa_meta_video_damage_add(struct spa_meta_video_damage *damage,
+					     uint32_t size,
+					     const struct spa_meta_region *region)
+{
+	if (damage->flags & SPA_META_VIDEO_DAMAGE_FLAG_ALL)
+		return;
+	if (damage->n_regions >= spa_meta_video_damage_max_regions(size)) {
+		spa_meta_video_damage_set_all(damage);
+		return;
+	}
+	damage->regions[damage->n_regions++] = *region;
+}
+
 /** A metadata element */
 struct spa_meta {
 	uint32_t type;		/**< metadata type */
@@ -38,6 +38,7 @@ extern "C" {
 #define SPA_TYPE_PARAM_ALLOC_BUFFERS__stride	SPA_TYPE_PARAM_ALLOC_BUFFERS_BASE "stride"
 #define SPA_TYPE_PARAM_ALLOC_BUFFERS__buffers	SPA_TYPE_PARAM_ALLOC_BUFFERS_BASE "buffers"
 #define SPA_TYPE_PARAM_ALLOC_BUFFERS__align	SPA_TYPE_PARAM_ALLOC_BUFFERS_BASE "align"
+#define SPA_TYPE_PARAM_ALLOC_BUFFERS__blocks	SPA_TYPE_PARAM_ALLOC_BUFFERS_BASE "blocks"
 
 struct spa_type_param_alloc_buffers {
 	uint32_t Buffers;
@@ -45,6 +46,7 @@ struct spa_type_param_alloc_buffers {
 	uint32_t stride;
 	uint32_t buffers;
 	uint32_t align;
+	uint32_t blocks;	/**< number of data blocks in a buffer, defaults to 1 */
 };
 
 static inline void
@@ -57,6 +59,7 @@ spa_type_param_alloc_buffers_map(struct spa_type_map *map,
 		type->stride = spa_type_map_get_id(map, SPA_TYPE_PARAM_ALLOC_BUFFERS__stride);
 		type->buffers = spa_type_map_get_id(map, SPA_TYPE_PARAM_ALLOC_BUFFERS__buffers);
 		type->align = spa_type_map_get_id(map, SPA_TYPE_PARAM_ALLOC_BUFFERS__align);
+		type->blocks = spa_type_map_get_id(map, SPA_TYPE_PARAM_ALLOC_BUFFERS__blocks);
 	}
 }
 
@@ -46,9 +46,22 @@ struct spa_props {
 #define SPA_TYPE_PROPS__live		SPA_TYPE_PROPS_BASE "live"
 #define SPA_TYPE_PROPS__waveType	SPA_TYPE_PROPS_BASE "waveType"
 #define SPA_TYPE_PROPS__frequency	SPA_TYPE_PROPS_BASE "frequency"
+#define SPA_TYPE_PROPS__frequencyStep	SPA_TYPE_PROPS_BASE "frequencyStep"
 #define SPA_TYPE_PROPS__volume		SPA_TYPE_PROPS_BASE "volume"
 #define SPA_TYPE_PROPS__mute		SPA_TYPE_PROPS_BASE "mute"
 #define SPA_TYPE_PROPS__patternType	SPA_TYPE_PROPS_BASE "patternType"
+#define SPA_TYPE_PROPS__latestFrame	SPA_TYPE_PROPS_BASE "latestFrame"
+#define SPA_TYPE_PROPS__threads		SPA_TYPE_PROPS_BASE "threads"
+#define SPA_TYPE_PROPS__scaleMethod	SPA_TYPE_PROPS_BASE "scaleMethod"
+#define SPA_TYPE_PROPS__threadType	SPA_TYPE_PROPS_BASE "threadType"
+#define SPA_TYPE_PROPS__bitrate		SPA_TYPE_PROPS_BASE "bitrate"
+#define SPA_TYPE_PROPS__gopSize		SPA_TYPE_PROPS_BASE "gopSize"
+#define SPA_TYPE_PROPS__cpuLoad		SPA_TYPE_PROPS_BASE "cpuLoad"
+#define SPA_TYPE_PROPS__cpuLoadType	SPA_TYPE_PROPS_BASE "cpuLoadType"
+#define SPA_TYPE_PROPS__cpuLoadSpread	SPA_TYPE_PROPS_BASE "cpuLoadSpread"
+#define SPA_TYPE_PROPS__memoryTouch	SPA_TYPE_PROPS_BASE "memoryTouch"
+#define SPA_TYPE_PROPS__sleep		SPA_TYPE_PROPS_BASE "sleep"
+#define SPA_TYPE_PROPS__jitter		SPA_TYPE_PROPS_BASE "jitter"
 
 static inline uint32_t
 spa_pod_builder_push_props(struct spa_pod_builder *builder,
@@ -171,6 +171,149 @@ static inline void spa_ringbuffer_write_update(struct spa_ringbuffer *rbuf, int3
 	__atomic_store_n(&rbuf->writeindex, index, __ATOMIC_RELEASE);
 }
 
+/**
+ * spa_ringbuffer_get_span:
+ * @size: the size of the ringbuffer
+ * @buffer: the ringbuffer memory
+ * @offset: offset in @buffer, the index masked with the size
+ * @len: the number of bytes wanted
+ * @twice: @buffer is mapped twice after each other
+ * @data: result, a pointer to the bytes at @offset
+ *
+ * Get a pointer to the bytes at @offset so that they can be read or
+ * written in place instead of copying them with spa_ringbuffer_read_data()
+ * or spa_ringbuffer_write_data(). When the region wraps around the end of
+ * @buffer, only the first part is contiguous, get the rest with a second
+ * span at offset 0. When @buffer is mapped twice, the region never wraps.
+ *
+ * Returns: the number of contiguous bytes at @data
+ */
+static inline uint32_t
+spa_ringbuffer_get_span(uint32_t size, void *buffer, uint32_t offset, uint32_t len,
+			bool twice, void **data)
+{
+	*data = SPA_MEMBER(buffer, offset, void);
+	return twice ? len : SPA_MIN(len, size - offset);
+}
+
+#define SPA_RINGBUFFER_CACHE_LINE	64
+
+/**
+ * spa_ringbuffer_padded:
+ * @size: the size of the ringbuffer
+ * @mask: mask as @size - 1
+ * @reader: the read index and the last write index the reader has seen
+ * @writer: the write index and the last read index the writer has seen
+ *
+ * A ringbuffer for one reader and one writer in the same address space.
+ * The reader and writer indices are on separate cache lines. Each side
+ * keeps a copy of the index of the other side and only loads it again when
+ * the copy says there is not enough room. stress-ringbuffer compares it
+ * with struct spa_ringbuffer.
+ *
+ * Use struct spa_ringbuffer in shared memory, its layout is fixed.
+ */
+struct spa_ringbuffer_padded {
+	uint32_t size;
+	uint32_t mask;
+	struct {
+		uint32_t index;
+		uint32_t cached;
+	} reader __attribute__ ((aligned (SPA_RINGBUFFER_CACHE_LINE)));
+	struct {
+		uint32_t index;
+		uint32_t cached;
+	} writer __attribute__ ((aligned (SPA_RINGBUFFER_CACHE_LINE)));
+} __attribute__ ((aligned (SPA_RINGBUFFER_CACHE_LINE)));
+
+/**
+ * spa_ringbuffer_padded_init:
+ * @rbuf: a #struct spa_ringbuffer_padded
+ * @size: the number of elements in the ringbuffer, a power of 2
+ *
+ * Initialize @rbuf with @size.
+ */
+static inline void spa_ringbuffer_padded_init(struct spa_ringbuffer_padded *rbuf, uint32_t size)
+{
+	memset(rbuf, 0, sizeof(*rbuf));
+	rbuf->size = size;
+	rbuf->mask = size - 1;
+}
+
+/**
+ * spa_ringbuffer_padded_get_read_index:
+ * @rbuf: a #struct spa_ringbuffer_padded
+ * @index: the value of the read index, should be masked to get the
+ *         offset in the ringbuffer memory
+ * @min: the number of elements the reader wants
+ *
+ * Returns: the number of elements available for reading. The write index
+ *          is only loaded when less than @min elements were seen before.
+ */
+static inline int32_t
+spa_ringbuffer_padded_get_read_index(struct spa_ringbuffer_padded *rbuf, uint32_t *index,
+				     uint32_t min)
+{
+	int32_t avail;
+
+	*index = rbuf->reader.index;
+	avail = (int32_t) (rbuf->reader.cached - *index);
+	if (avail < (int32_t) min) {
+		rbuf->reader.cached = __atomic_load_n(&rbuf->writer.index, __ATOMIC_ACQUIRE);
+		avail = (int32_t) (rbuf->reader.cached - *index);
+	}
+	return avail;
+}
+
+/**
+ * spa_ringbuffer_padded_read_update:
+ * @rbuf: a #struct spa_ringbuffer_padded
+ * @index: new index
+ *
+ * Update the read index to @index
+ */
+static inline void spa_ringbuffer_padded_read_update(struct spa_ringbuffer_padded *rbuf, uint32_t index)
+{
+	__atomic_store_n(&rbuf->reader.index, index, __ATOMIC_RELEASE);
+}
+
+/**
+ * spa_ringbuffer_padded_get_write_index:
+ * @rbuf: a #struct spa_ringbuffer_padded
+ * @index: the value of the write index, should be masked to get the
+ *         offset in the ringbuffer memory
+ * @min: the number of elements the writer wants to write
+ *
+ * Returns: the fill level of @rbuf. The read index is only loaded when
+ *          there was no room for @min elements before.
+ */
+static inline int32_t
+spa_ringbuffer_padded_get_write_index(struct spa_ringbuffer_padded *rbuf, uint32_t *index,
+				      uint32_t min)
+{
+	int32_t filled;
+
+	*index = rbuf->writer.index;
+	filled = (int32_t) (*index - rbuf->writer.cached);
+	if (filled > (int32_t) (rbuf->size - min)) {
+		rbuf->writer.cached = __atomic_load_n(&rbuf->reader.index, __ATOMIC_ACQUIRE);
+		filled = (int32_t) (*index - rbuf->writer.cached);
+	}
+	return filled;
+}
+
+/**
+ * spa_ringbuffer_padded_write_update:
+ * @rbuf: a #struct spa_ringbuffer_padded
+ * @index: new index
+ *
+ * Update the write index to @index
+ */
+static inline void spa_ringbuffer_padded_write_update(struct spa_ringbuffer_padded *rbuf, uint32_t index)
+{
+	__atomic_store_n(&rbuf->writer.index, index, __ATOMIC_RELEASE);
+}
+
 
 #ifdef __cplusplus
 }  /* extern "C" */
@@ -97,6 +97,20 @@ int spa_debug_buffer(const struct spa_buffer *buffer)
 			fprintf(stderr, "      fd:     %d\n", h->fd);
 			fprintf(stderr, "      offset: %d\n", h->offset);
 			fprintf(stderr, "      size:   %d\n", h->size);
+		} else if (!strcmp(type_name, SPA_TYPE_META__Dropped)) {
+			struct spa_meta_dropped *h = m->data;
+			fprintf(stderr, "    struct spa_meta_dropped:\n");
+			fprintf(stderr, "      count:  %u\n", h->count);
+		} else if (!strcmp(type_name, SPA_TYPE_META__VideoDamage)) {
+			struct spa_meta_video_damage *h = m->data;
+			uint32_t j, n_regions;
+			fprintf(stderr, "    struct spa_meta_video_damage:\n");
+			fprintf(stderr, "      flags:     %08x\n", h->flags);
+			fprintf(stderr, "      n_regions: %u\n", h->n_regions);
+			n_regions = SPA_MIN(h->n_regions, spa_meta_video_damage_max_regions(m->size));
+			for (j = 0; j < n_regions; j++)
+				fprintf(stderr, "        %d,%d %ux%u\n", h->regions[j].x,
+					h->regions[j].y, h->regions[j].width, h->regions[j].height);
 		} else {
 			fprintf(stderr, "    Unknown:\n");
 			spa_debug_dump_mem(m->data, m->size);
@@ -0,0 +1,75 @@
+/* Spa ALSA ringbuffer
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_ALSA_RINGBUFFER_H__
+#define __SPA_ALSA_RINGBUFFER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include <spa/meta.h>
+#include <spa/ringbuffer.h>
+
+/**
+ * spa_alsa_ringbuffer_pull:
+ * @rb: the ringbuffer meta
+ * @data: the memory of the ringbuffer
+ * @dst: destination of @n_frames frames
+ * @n_frames: the number of frames to pull
+ * @frame_size: the size of one frame
+ * @silence: one frame of silence
+ *
+ * Consume exactly @n_frames from the ringbuffer. The frames that are not
+ * in the ringbuffer are filled with @silence.
+ *
+ * Returns: the number of frames read from the ringbuffer, the caller can
+ * account the remaining frames as underrun
+ */
+static inline uint32_t
+spa_alsa_ringbuffer_pull(struct spa_meta_ringbuffer *rb, void *data,
+			 void *dst, uint32_t n_frames, uint32_t frame_size,
+			 const void *silence)
+{
+	struct spa_ringbuffer *ringbuffer = &rb->ringbuffer;
+	uint32_t index, n_read, i;
+	int32_t avail;
+
+	avail = spa_ringbuffer_get_read_index(ringbuffer, &index);
+	avail = SPA_CLAMP(avail, 0, (int32_t) ringbuffer->size);
+
+	n_read = SPA_MIN(n_frames, avail / frame_size);
+
+	spa_ringbuffer_read_data(ringbuffer, data, index & ringbuffer->mask, dst,
+				 n_read * frame_size);
+	spa_ringbuffer_read_update(ringbuffer, index + n_read * frame_size);
+
+	for (i = n_read; i < n_frames; i++)
+		memcpy(SPA_MEMBER(dst, i * frame_size, void), silence, frame_size);
+
+	return n_read;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __SPA_ALSA_RINGBUFFER_H__ */
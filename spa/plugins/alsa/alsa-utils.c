@@ -13,6 +13,7 @@
 #include <lib/format.h>
 
 #include "alsa-utils.h"
+#include "alsa-ringbuffer.h"
 
 #define CHECK(s,msg) if ((err = (s)) < 0) { spa_log_error(state->log, msg ": %s", snd_strerror(err)); return err; }
 
@@ -247,6 +248,8 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 		else
 			return -EINVAL;
 	}
+	if (info->channels > MAX_CHANNELS)
+		return -EINVAL;
 
 	/* set the stream rate */
 	rrate = info->rate;
@@ -263,6 +266,8 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 	state->channels = info->channels;
 	state->rate = info->rate;
 	state->frame_size = info->channels * (snd_pcm_format_physical_width(format) / 8);
+	/* one frame of silence for the ringbuffer underruns */
+	snd_pcm_format_set_silence(format, state->silence, state->channels);
 
 	CHECK(snd_pcm_hw_params_get_buffer_size_max(params, &state->buffer_frames), "get_buffer_size_max");
 
@@ -342,19 +347,14 @@ pull_frames(struct state *state,
 		dst = SPA_MEMBER(my_areas[0].addr, offset * state->frame_size, uint8_t);
 
 		if (b->rb) {
-			struct spa_ringbuffer *ringbuffer = &b->rb->ringbuffer;
-			uint32_t index;
-			int32_t avail;
-
-			avail = spa_ringbuffer_get_read_index(ringbuffer, &index);
-
-			n_bytes = SPA_MIN(avail, to_write * state->frame_size);
-			n_frames = SPA_MIN(to_write, n_bytes / state->frame_size);
-
-			spa_ringbuffer_read_data(ringbuffer, d[0].data, index & ringbuffer->mask, dst, n_bytes);
-
-			spa_ringbuffer_read_update(ringbuffer, index + n_bytes);
-			reuse = avail == n_bytes;
+			/* the ringbuffer stays with us, we consume exactly the frames
+			 * that are needed and play silence for the missing ones */
+			n_frames = spa_alsa_ringbuffer_pull(b->rb, d[0].data, dst, to_write,
+							    state->frame_size, state->silence);
+			if (n_frames < to_write)
+				spa_log_trace(state->log, "ringbuffer underrun, %zd of %lu frames",
+					      n_frames, to_write);
+			n_frames = to_write;
 		} else {
 			offs = SPA_MIN(d[0].chunk->offset + state->ready_offset, d[0].maxsize);
 			size = SPA_MIN(d[0].chunk->size, d[0].maxsize) - offs;
@@ -47,6 +47,7 @@ struct props {
 };
 
 #define MAX_BUFFERS 64
+#define MAX_CHANNELS 64
 
 struct buffer {
 	struct spa_buffer *outbuf;
@@ -137,6 +138,7 @@ struct state {
 	int rate;
 	int channels;
 	size_t frame_size;
+	uint8_t silence[MAX_CHANNELS * 8];
 
 	struct spa_port_info info;
 	uint32_t params[3];
@@ -51,8 +51,14 @@ struct type {
 	uint32_t prop_wave;
 	uint32_t prop_freq;
 	uint32_t prop_volume;
+	uint32_t prop_freq_step;
 	uint32_t wave_sine;
 	uint32_t wave_square;
+	uint32_t wave_saw;
+	uint32_t wave_white_noise;
+	uint32_t wave_pink_noise;
+	uint32_t wave_silence;
+	uint32_t wave_impulse;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
 	struct spa_type_media_type media_type;
@@ -75,8 +81,14 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->prop_wave = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType);
 	type->prop_freq = spa_type_map_get_id(map, SPA_TYPE_PROPS__frequency);
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
+	type->prop_freq_step = spa_type_map_get_id(map, SPA_TYPE_PROPS__frequencyStep);
 	type->wave_sine = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":sine");
 	type->wave_square = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":square");
+	type->wave_saw = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":saw");
+	type->wave_white_noise = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":whiteNoise");
+	type->wave_pink_noise = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":pinkNoise");
+	type->wave_silence = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":silence");
+	type->wave_impulse = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":impulse");
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
@@ -94,10 +106,16 @@ struct props {
 	uint32_t wave;
 	double freq;
 	double volume;
+	double freq_step;	/**< added to the frequency of each next channel */
 };
 
 #define MAX_BUFFERS 16
 #define MAX_PORTS 1
+#define MAX_CHANNELS 64
+
+#define WAVE_TABLE_BITS 11
+#define WAVE_TABLE_SIZE (1 << WAVE_TABLE_BITS)
+#define MAX_PERIOD_BYTES (32 * 1024)
 
 struct buffer {
 	struct spa_buffer *outbuf;
@@ -107,9 +125,13 @@ struct buffer {
 	struct spa_list link;
 };
 
-struct impl;
+struct channel {
+	uint32_t phase;
+	uint32_t step;
+	float pink[3];
+};
 
-typedef int (*render_func_t) (struct impl *this, void *samples, size_t n_samples);
+typedef void (*convert_func_t) (void *dst, const float *src, size_t n_samples, float volume);
 
 struct impl {
 	struct spa_handle handle;
@@ -139,8 +161,14 @@ struct impl {
 	struct spa_audio_info current_format;
 	uint8_t format_buffer[1024];
 	size_t bpf;
-	render_func_t render_func;
-	double accumulator;
+	convert_func_t convert_func;
+
+	float wave_table[WAVE_TABLE_SIZE + 1];
+	struct channel channels[MAX_CHANNELS];
+	uint32_t noise_seed;
+	uint32_t period_frames;
+	size_t period_offset;
+	uint8_t period_buffer[MAX_PERIOD_BYTES];
 
 	struct buffer buffers[MAX_BUFFERS];
 	uint32_t n_buffers;
@@ -160,6 +188,7 @@ struct impl {
 #define DEFAULT_WAVE wave_sine
 #define DEFAULT_FREQ 440.0
 #define DEFAULT_VOLUME 1.0
+#define DEFAULT_FREQ_STEP 0.0
 
 static void reset_props(struct impl *this, struct props *props)
 {
@@ -167,6 +196,7 @@ static void reset_props(struct impl *this, struct props *props)
 	props->wave = this->type.DEFAULT_WAVE;
 	props->freq = DEFAULT_FREQ;
 	props->volume = DEFAULT_VOLUME;
+	props->freq_step = DEFAULT_FREQ_STEP;
 }
 
 #define PROP(f,key,type,...)							\
@@ -182,6 +212,8 @@ static void reset_props(struct impl *this, struct props *props)
 	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
 			SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
 
+#include "render.c"
+
 static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 {
 	struct impl *this;
@@ -197,42 +229,87 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 	spa_pod_builder_props(&b, &f[0], this->type.props,
 		PROP(&f[1], this->type.prop_live, SPA_POD_TYPE_BOOL,
 			this->props.live),
-		PROP_EN(&f[1], this->type.prop_wave, SPA_POD_TYPE_ID, 3,
+		PROP_EN(&f[1], this->type.prop_wave, SPA_POD_TYPE_ID, 8,
 			this->props.wave,
 			this->type.wave_sine,
-			this->type.wave_square),
+			this->type.wave_square,
+			this->type.wave_saw,
+			this->type.wave_white_noise,
+			this->type.wave_pink_noise,
+			this->type.wave_silence,
+			this->type.wave_impulse),
 		PROP_MM(&f[1], this->type.prop_freq, SPA_POD_TYPE_DOUBLE,
 			this->props.freq,
 			0.0, 50000000.0),
 		PROP_MM(&f[1], this->type.prop_volume, SPA_POD_TYPE_DOUBLE,
 			this->props.volume,
-			0.0, 10.0));
+			0.0, 10.0),
+		PROP_MM(&f[1], this->type.prop_freq_step, SPA_POD_TYPE_DOUBLE,
+			this->props.freq_step,
+			-50000000.0, 50000000.0));
 
 	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
 
 	return SPA_RESULT_OK;
 }
 
+static int do_set_props(struct spa_loop *loop,
+			bool async,
+			uint32_t seq,
+			size_t size,
+			const void *data,
+			void *user_data)
+{
+	struct impl *this = user_data;
+	const struct props *props = data;
+	bool reset, volume;
+
+	reset = props->wave != this->props.wave ||
+		props->freq != this->props.freq ||
+		props->freq_step != this->props.freq_step;
+	volume = props->volume != this->props.volume;
+
+	this->props = *props;
+
+	if (this->have_format) {
+		if (reset)
+			wave_setup(this);
+		else if (volume)
+			wave_set_volume(this);
+	}
+	return SPA_RESULT_OK;
+}
+
 static int impl_node_set_props(struct spa_node *node, const struct spa_props *props)
 {
 	struct impl *this;
+	struct props p;
 
 	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
 
 	this = SPA_CONTAINER_OF(node, struct impl, node);
 
 	if (props == NULL) {
-		reset_props(this, &this->props);
+		reset_props(this, &p);
 	} else {
+		p = this->props;
 		spa_props_query(props,
-				this->type.prop_live, SPA_POD_TYPE_BOOL, &this->props.live,
-				this->type.prop_wave, SPA_POD_TYPE_ID, &this->props.wave,
-				this->type.prop_freq, SPA_POD_TYPE_DOUBLE, &this->props.freq,
-				this->type.prop_volume, SPA_POD_TYPE_DOUBLE, &this->props.volume,
+				this->type.prop_live, SPA_POD_TYPE_BOOL, &p.live,
+				this->type.prop_wave, SPA_POD_TYPE_ID, &p.wave,
+				this->type.prop_freq, SPA_POD_TYPE_DOUBLE, &p.freq,
+				this->type.prop_volume, SPA_POD_TYPE_DOUBLE, &p.volume,
+				this->type.prop_freq_step, SPA_POD_TYPE_DOUBLE, &p.freq_step,
 				0);
 	}
 
-	if (this->props.live)
+	/* render() reads the props and the period in the data thread */
+	if (this->data_loop)
+		spa_loop_invoke(this->data_loop, do_set_props, SPA_ID_INVALID,
+				sizeof(p), &p, true, this);
+	else
+		do_set_props(NULL, false, SPA_ID_INVALID, sizeof(p), &p, this);
+
+	if (p.live)
 		this->info.flags |= SPA_PORT_INFO_FLAG_LIVE;
 	else
 		this->info.flags &= ~SPA_PORT_INFO_FLAG_LIVE;
@@ -240,8 +317,6 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 	return SPA_RESULT_OK;
 }
 
-#include "render.c"
-
 static void set_timer(struct impl *this, bool enabled)
 {
 	if (this->async || this->props.live) {
@@ -305,7 +380,11 @@ static int make_buffer(struct impl *this)
 
 		filled = spa_ringbuffer_get_write_index(&b->rb->ringbuffer, &index);
 		avail = b->rb->ringbuffer.size - filled;
-		n_bytes = SPA_MIN(avail, n_bytes);
+		if (avail < n_bytes) {
+			spa_log_trace(this->log, NAME " %p: ringbuffer overrun, %d of %d bytes",
+				      this, avail, n_bytes);
+			n_bytes = SPA_MAX(avail, 0);
+		}
 
 		n_samples = n_bytes / this->bpf;
 
@@ -313,18 +392,17 @@ static int make_buffer(struct impl *this)
 
 		if (offset + n_bytes > b->rb->ringbuffer.size) {
 			uint32_t l0 = b->rb->ringbuffer.size - offset;
-			this->render_func(this, SPA_MEMBER(b->outbuf->datas[0].data, offset, void),
-					  l0 / this->bpf);
-			this->render_func(this, b->outbuf->datas[0].data,
-					  (n_bytes - l0) / this->bpf);
+			render(this, SPA_MEMBER(b->outbuf->datas[0].data, offset, void),
+			       l0 / this->bpf);
+			render(this, b->outbuf->datas[0].data, (n_bytes - l0) / this->bpf);
 		} else {
-			this->render_func(this, SPA_MEMBER(b->outbuf->datas[0].data, offset, void),
-					  n_samples);
+			render(this, SPA_MEMBER(b->outbuf->datas[0].data, offset, void),
+			       n_samples);
 		}
 		spa_ringbuffer_write_update(&b->rb->ringbuffer, index + n_bytes);
 	} else {
 		n_samples = n_bytes / this->bpf;
-		this->render_func(this, b->outbuf->datas[0].data, n_samples);
+		render(this, b->outbuf->datas[0].data, n_samples);
 		b->outbuf->datas[0].chunk->size = n_bytes;
 		b->outbuf->datas[0].chunk->offset = 0;
 		b->outbuf->datas[0].chunk->stride = 0;
@@ -514,7 +592,7 @@ impl_node_port_enum_formats(struct spa_node *node,
 				1, INT32_MAX),
 			PROP_U_MM(&f[1], this->type.format_audio.channels, SPA_POD_TYPE_INT,
 				2,
-				1, INT32_MAX));
+				1, MAX_CHANNELS));
 		break;
 	default:
 		return SPA_RESULT_ENUM_END;
@@ -586,10 +664,15 @@ impl_node_port_set_format(struct spa_node *node,
 		else
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
+		if (info.info.raw.channels == 0 || info.info.raw.channels > MAX_CHANNELS ||
+		    info.info.raw.rate == 0)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
 		this->bpf = sizes[idx] * info.info.raw.channels;
 		this->current_format = info;
 		this->have_format = true;
-		this->render_func = sine_funcs[idx];
+		this->convert_func = convert_funcs[idx];
+		wave_setup(this);
 	}
 
 	if (this->have_format) {
@@ -1019,6 +1102,9 @@ impl_init(const struct spa_handle_factory *factory,
 	this->clock = impl_clock;
 	reset_props(this, &this->props);
 
+	wave_table_init(this->wave_table);
+	this->noise_seed = 0x9e3779b9;
+
 	spa_list_init(&this->empty);
 
 	this->timer_source.func = on_output;
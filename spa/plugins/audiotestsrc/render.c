@@ -21,36 +21,311 @@
 
 #define M_PI_M2 ( M_PI + M_PI )
 
-#define DEFINE_SINE(type,scale)								\
+/* The phase of each channel is a 32 bits fixed point number where 2^32 is
+ * one period. The upper WAVE_TABLE_BITS index the wavetable, the lower
+ * bits are used to interpolate between two entries. */
+#define PHASE_FRAC_BITS		(32 - WAVE_TABLE_BITS)
+#define PHASE_FRAC_MASK		((1u << PHASE_FRAC_BITS) - 1)
+#define PHASE_FRAC_SCALE	(1.0f / (1u << PHASE_FRAC_BITS))
+
+/* samples are generated as float in blocks of this size and then converted
+ * to the output format */
+#define BLOCK_SAMPLES		1024
+
+static void wave_table_init(float *table)
+{
+	int i;
+
+	for (i = 0; i <= WAVE_TABLE_SIZE; i++)
+		table[i] = sin(M_PI_M2 * i / WAVE_TABLE_SIZE);
+}
+
+/* xorshift32, returns a number in [-1, 1) */
+static inline float wave_noise(uint32_t *seed)
+{
+	uint32_t x = *seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*seed = x;
+
+	return (int32_t) x * (1.0f / 2147483648.0f);
+}
+
+static void
+generate_sine(struct impl *this, struct channel *ch, float *dst, int stride, size_t n_frames)
+{
+	const float *table = this->wave_table;
+	uint32_t phase = ch->phase, step = ch->step;
+	size_t i;
+
+	for (i = 0; i < n_frames; i++) {
+		uint32_t idx = phase >> PHASE_FRAC_BITS;
+		float frac = (phase & PHASE_FRAC_MASK) * PHASE_FRAC_SCALE;
+		dst[i * stride] = table[idx] + (table[idx + 1] - table[idx]) * frac;
+		phase += step;
+	}
+	ch->phase = phase;
+}
+
+static void
+generate_square(struct impl *this, struct channel *ch, float *dst, int stride, size_t n_frames)
+{
+	uint32_t phase = ch->phase, step = ch->step;
+	size_t i;
+
+	for (i = 0; i < n_frames; i++) {
+		dst[i * stride] = phase < 0x80000000u ? 1.0f : -1.0f;
+		phase += step;
+	}
+	ch->phase = phase;
+}
+
+static void
+generate_saw(struct impl *this, struct channel *ch, float *dst, int stride, size_t n_frames)
+{
+	uint32_t phase = ch->phase, step = ch->step;
+	size_t i;
+
+	for (i = 0; i < n_frames; i++) {
+		dst[i * stride] = (int32_t) phase * (1.0f / 2147483648.0f);
+		phase += step;
+	}
+	ch->phase = phase;
+}
+
+static void
+generate_impulse(struct impl *this, struct channel *ch, float *dst, int stride, size_t n_frames)
+{
+	uint32_t phase = ch->phase, step = ch->step;
+	uint32_t width = SPA_MIN(step, -step);	/* a negative frequency runs backwards */
+	size_t i;
+
+	for (i = 0; i < n_frames; i++) {
+		dst[i * stride] = phase < width ? 1.0f : 0.0f;
+		phase += step;
+	}
+	ch->phase = phase;
+}
+
+static void
+generate_white_noise(struct impl *this, struct channel *ch, float *dst, int stride, size_t n_frames)
+{
+	size_t i;
+
+	for (i = 0; i < n_frames; i++)
+		dst[i * stride] = wave_noise(&this->noise_seed);
+}
+
+/* white noise filtered by the economy pink noise filter of Paul Kellet */
+static void
+generate_pink_noise(struct impl *this, struct channel *ch, float *dst, int stride, size_t n_frames)
+{
+	float b0 = ch->pink[0], b1 = ch->pink[1], b2 = ch->pink[2];
+	size_t i;
+
+	for (i = 0; i < n_frames; i++) {
+		float white = wave_noise(&this->noise_seed);
+		b0 = 0.99765f * b0 + white * 0.0990460f;
+		b1 = 0.96300f * b1 + white * 0.2965164f;
+		b2 = 0.57000f * b2 + white * 1.0526913f;
+		dst[i * stride] = SPA_CLAMP((b0 + b1 + b2 + white * 0.1848f) * 0.25f, -1.0f, 1.0f);
+	}
+	ch->pink[0] = b0;
+	ch->pink[1] = b1;
+	ch->pink[2] = b2;
+}
+
+typedef void (*generate_func_t) (struct impl *this, struct channel *ch,
+				 float *dst, int stride, size_t n_frames);
+
+#define DEFINE_CONVERT(type,scale)							\
 static void										\
-audio_test_src_create_sine_##type (struct impl *this, type *samples, size_t n_samples)	\
+convert_##type (void *dst, const float *src, size_t n_samples, float volume)		\
 {											\
-	int i, c, channels;								\
-	double step, amp;								\
-											\
-	channels = this->current_format.info.raw.channels;				\
-	step = M_PI_M2 * this->props.freq / this->current_format.info.raw.rate;		\
-	amp = this->props.volume * scale;						\
+	type *d = dst;									\
+	float amp = volume * scale;							\
+	size_t i;									\
 											\
-	for (i = 0; i < n_samples; i++) {						\
-		type val;								\
-		this->accumulator += step;						\
-		if (this->accumulator >= M_PI_M2)					\
-			this->accumulator -= M_PI_M2;					\
-		val = (type) (sin (this->accumulator) * amp);				\
-		for (c = 0; c < channels; ++c)						\
-			*samples++ = val;						\
-	}										\
-}
-
-DEFINE_SINE(int16_t, 32767.0);
-DEFINE_SINE(int32_t, 2147483647.0);
-DEFINE_SINE(float, 1.0);
-DEFINE_SINE(double, 1.0);
-
-static const render_func_t sine_funcs[] = {
-	(render_func_t) audio_test_src_create_sine_int16_t,
-	(render_func_t) audio_test_src_create_sine_int32_t,
-	(render_func_t) audio_test_src_create_sine_float,
-	(render_func_t) audio_test_src_create_sine_double
+	for (i = 0; i < n_samples; i++)							\
+		d[i] = (type) SPA_CLAMP(src[i] * amp, -scale, scale);			\
+}
+
+DEFINE_CONVERT(int16_t, 32767.0f);
+DEFINE_CONVERT(int32_t, 2147483520.0f);
+DEFINE_CONVERT(float, 1.0f);
+DEFINE_CONVERT(double, 1.0f);
+
+static const convert_func_t convert_funcs[] = {
+	convert_int16_t,
+	convert_int32_t,
+	convert_float,
+	convert_double
 };
+
+static generate_func_t get_generate_func(struct impl *this)
+{
+	uint32_t wave = this->props.wave;
+
+	if (wave == this->type.wave_square)
+		return generate_square;
+	else if (wave == this->type.wave_saw)
+		return generate_saw;
+	else if (wave == this->type.wave_impulse)
+		return generate_impulse;
+	else if (wave == this->type.wave_white_noise)
+		return generate_white_noise;
+	else if (wave == this->type.wave_pink_noise)
+		return generate_pink_noise;
+	else
+		return generate_sine;
+}
+
+static void render_generate(struct impl *this, void *samples, size_t n_frames)
+{
+	float block[BLOCK_SAMPLES];
+	uint32_t c, channels = this->current_format.info.raw.channels;
+	size_t block_frames = BLOCK_SAMPLES / channels;
+	generate_func_t generate = get_generate_func(this);
+
+	while (n_frames > 0) {
+		size_t n = SPA_MIN(n_frames, block_frames);
+
+		for (c = 0; c < channels; c++)
+			generate(this, &this->channels[c], &block[c], channels, n);
+
+		this->convert_func(samples, block, n * channels, this->props.volume);
+
+		samples = SPA_MEMBER(samples, n * this->bpf, void);
+		n_frames -= n;
+	}
+}
+
+static void render_period(struct impl *this, void *samples, size_t n_frames)
+{
+	size_t size = n_frames * this->bpf, period = this->period_frames * this->bpf;
+
+	while (size > 0) {
+		size_t l = SPA_MIN(size, period - this->period_offset);
+
+		memcpy(samples, &this->period_buffer[this->period_offset], l);
+		samples = SPA_MEMBER(samples, l, void);
+		size -= l;
+
+		this->period_offset += l;
+		if (this->period_offset == period)
+			this->period_offset = 0;
+	}
+}
+
+static void render(struct impl *this, void *samples, size_t n_frames)
+{
+	if (this->props.wave == this->type.wave_silence)
+		memset(samples, 0, n_frames * this->bpf);
+	else if (this->period_frames > 0)
+		render_period(this, samples, n_frames);
+	else
+		render_generate(this, samples, n_frames);
+}
+
+/* The frequency of channel @c folded into [0, rate), a negative frequency
+ * step wraps around to the aliased frequency. */
+static double channel_freq(struct impl *this, uint32_t c)
+{
+	uint32_t rate = this->current_format.info.raw.rate;
+	double freq = fmod(this->props.freq + c * this->props.freq_step, rate);
+
+	return freq < 0.0 ? freq + rate : freq;
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b != 0) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* Find the number of frames after which all channels repeat, 0 when there
+ * is no such period or when it doesn't fit in the period buffer. */
+static uint32_t wave_period(struct impl *this)
+{
+	uint32_t c, channels = this->current_format.info.raw.channels;
+	uint32_t rate = this->current_format.info.raw.rate;
+	uint32_t period = 1;
+
+	if (this->props.wave == this->type.wave_white_noise ||
+	    this->props.wave == this->type.wave_pink_noise)
+		return 0;
+
+	for (c = 0; c < channels; c++) {
+		double freq = channel_freq(this, c);
+		uint32_t frames;
+
+		/* the alias of a negative frequency repeats just as often */
+		freq = SPA_MIN(freq, rate - freq);
+		if (freq == 0.0)
+			continue;
+
+		if (rate / freq != floor(rate / freq))
+			return 0;
+
+		frames = rate / freq;
+		if ((uint64_t) period / gcd(period, frames) * frames * this->bpf >
+		    sizeof(this->period_buffer))
+			return 0;
+		period = period / gcd(period, frames) * frames;
+	}
+	return period;
+}
+
+/* Called when the format or the props change. Sets up the phase step of
+ * each channel and, for periodic waves, renders one period that is then
+ * copied to the output buffers. */
+static void wave_setup(struct impl *this)
+{
+	uint32_t c, channels = this->current_format.info.raw.channels;
+	uint32_t rate = this->current_format.info.raw.rate;
+
+	for (c = 0; c < channels; c++) {
+		double freq = channel_freq(this, c);
+
+		this->channels[c].phase = 0;
+		this->channels[c].step = (uint32_t) (freq / rate * 4294967296.0);
+		memset(this->channels[c].pink, 0, sizeof(this->channels[c].pink));
+	}
+
+	this->period_frames = 0;
+	this->period_offset = 0;
+
+	if (this->props.wave != this->type.wave_silence) {
+		uint32_t period = wave_period(this);
+
+		if (period > 0) {
+			render_generate(this, this->period_buffer, period);
+			this->period_frames = period;
+			for (c = 0; c < channels; c++)
+				this->channels[c].phase = 0;
+		}
+	}
+	spa_log_debug(this->log, NAME " %p: period of %d frames", this, this->period_frames);
+}
+
+/* Called when only the volume changes. The generated samples are scaled
+ * when they are converted so only the period needs to be rendered again,
+ * the phases and the offset in the period are kept so that the wave
+ * continues without a click. */
+static void wave_set_volume(struct impl *this)
+{
+	uint32_t c, channels = this->current_format.info.raw.channels;
+
+	if (this->period_frames == 0)
+		return;
+
+	render_generate(this, this->period_buffer, this->period_frames);
+	for (c = 0; c < channels; c++)
+		this->channels[c].phase = 0;
+}
@@ -17,50 +17,107 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
 #include <stddef.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
+#include <pthread.h>
 
 #include <spa/type-map.h>
 #include <spa/log.h>
+#include <spa/list.h>
 #include <spa/node.h>
 #include <spa/video/format-utils.h>
+#include <spa/format-builder.h>
+#include <spa/param-alloc.h>
 #include <lib/props.h>
+#include <lib/format.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+
+#include "ffmpeg.h"
+
+#define NAME "ffdec"
 
 #define IS_VALID_PORT(this,d,id) ((id) == 0)
-#define MAX_BUFFERS    32
+#define MAX_BUFFERS	32
+#define MAX_PLANES	4
+
+/* the planes and strides of the output are aligned for the SIMD code of
+ * libavcodec, planes get some padding at the end like the frames that
+ * libavcodec allocates itself */
+#define PLANE_ALIGN	64
+#define PLANE_PADDING	64
+
+struct props {
+	int32_t threads;
+	uint32_t thread_type;
+};
+
+struct impl;
 
 struct buffer {
+	struct impl *impl;
 	struct spa_buffer *outbuf;
-	bool outstanding;
-	struct buffer *next;
+	struct spa_meta_header *h;
+	uint8_t *planes[MAX_PLANES];
+	bool outstanding;	/**< the buffer is with the consumer */
+	bool in_decoder;	/**< an AVFrame of the decoder uses the buffer */
+	struct spa_list link;
 };
 
 struct port {
 	bool have_format;
 	struct spa_video_info current_format;
-	bool have_buffers;
 	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct spa_list free;
 	struct spa_port_info info;
 	struct spa_port_io *io;
+	uint8_t params_buffer[1024];
 };
 
 struct type {
 	uint32_t node;
+	uint32_t format;
+	uint32_t props;
+	uint32_t prop_threads;
+	uint32_t prop_thread_type;
+	uint32_t thread_type_frame;
+	uint32_t thread_type_slice;
+	uint32_t thread_type_any;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
 	struct spa_type_media_type media_type;
 	struct spa_type_media_subtype media_subtype;
+	struct spa_type_media_subtype_video media_subtype_video;
 	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
 	struct spa_type_command_node command_node;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
+	struct spa_type_param_alloc_meta_enable param_alloc_meta_enable;
 };
 
 static inline void init_type(struct type *type, struct spa_type_map *map)
 {
 	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->prop_threads = spa_type_map_get_id(map, SPA_TYPE_PROPS__threads);
+	type->prop_thread_type = spa_type_map_get_id(map, SPA_TYPE_PROPS__threadType);
+	type->thread_type_frame = spa_type_map_get_id(map, SPA_TYPE_PROPS__threadType ":frame");
+	type->thread_type_slice = spa_type_map_get_id(map, SPA_TYPE_PROPS__threadType ":slice");
+	type->thread_type_any = spa_type_map_get_id(map, SPA_TYPE_PROPS__threadType ":any");
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
 	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_media_subtype_video_map(map, &type->media_subtype_video);
 	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
 	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
+	spa_type_param_alloc_meta_enable_map(map, &type->param_alloc_meta_enable);
 }
 
 struct impl {
@@ -71,23 +128,130 @@ struct impl {
 	struct spa_type_map *map;
 	struct spa_log *log;
 
+	uint8_t props_buffer[512];
+	struct props props;
+
 	const struct spa_node_callbacks *callbacks;
 	void *user_data;
 
+	uint8_t format_buffer[1024];
+
 	struct port in_ports[1];
 	struct port out_ports[1];
 
+	const AVCodec *codec;
+	uint32_t subtype;
+	AVCodecContext *context;
+	AVFrame *frame;
+	AVPacket *packet;
+	uint8_t *packet_data;
+	unsigned int packet_size;
+
+	/* protects the free list and the buffer state, libavcodec asks for
+	 * buffers from its frame threads */
+	pthread_mutex_t lock;
+
+	/* the layout of the output buffers */
+	enum AVPixelFormat pix_fmt;
+	int width, height;	/**< the aligned size the layout was made for */
+	uint32_t n_planes;
+	int linesize[MAX_PLANES];
+	size_t plane_size[MAX_PLANES];
+	size_t plane_offset[MAX_PLANES];
+	size_t size;
+	bool direct;		/**< decode into the output buffers */
+
+	uint32_t n_frames;
+	uint32_t n_copies;
+
 	bool started;
 };
 
+#define DEFAULT_THREADS		0
+
+static void reset_props(struct impl *this, struct props *props)
+{
+	props->threads = DEFAULT_THREADS;
+	props->thread_type = this->type.thread_type_any;
+}
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_MM(f,key,type,...)							\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
+#define PROP_U_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
+
+static void close_codec(struct impl *this)
+{
+	if (this->context == NULL)
+		return;
+
+	/* this drops the references of the decoder on the output buffers */
+	avcodec_free_context(&this->context);
+	spa_log_info(this->log, NAME " %p: closed, %u frames, %u copied", this,
+		     this->n_frames, this->n_copies);
+}
+
 static int spa_ffmpeg_dec_node_get_props(struct spa_node *node, struct spa_props **props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	if (node == NULL || props == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_pod_builder_init(&b, this->props_buffer, sizeof(this->props_buffer));
+	spa_pod_builder_props(&b, &f[0], this->type.props,
+		PROP_MM(&f[1], this->type.prop_threads, SPA_POD_TYPE_INT,
+			this->props.threads,
+			0, 64),
+		PROP_EN(&f[1], this->type.prop_thread_type, SPA_POD_TYPE_ID, 4,
+			this->props.thread_type,
+			this->type.thread_type_frame,
+			this->type.thread_type_slice,
+			this->type.thread_type_any));
+
+	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return SPA_RESULT_OK;
 }
 
 static int spa_ffmpeg_dec_node_set_props(struct spa_node *node, const struct spa_props *props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct props old;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	old = this->props;
+
+	if (props == NULL) {
+		reset_props(this, &this->props);
+	} else {
+		spa_props_query(props,
+				this->type.prop_threads, SPA_POD_TYPE_INT, &this->props.threads,
+				this->type.prop_thread_type, SPA_POD_TYPE_ID, &this->props.thread_type,
+				0);
+	}
+
+	/* the threads are configured when the codec is opened */
+	if (old.threads != this->props.threads || old.thread_type != this->props.thread_type)
+		close_codec(this);
+
+	return SPA_RESULT_OK;
 }
 
 static int spa_ffmpeg_dec_node_send_command(struct spa_node *node, const struct spa_command *command)
@@ -190,27 +354,175 @@ spa_ffmpeg_dec_node_port_enum_formats(struct spa_node *node,
 				      const struct spa_format *filter,
 				      uint32_t index)
 {
-	//struct impl *this;
+	struct impl *this;
+	struct port *in_port;
+	struct spa_format *fmt;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[3];
+	uint32_t count, match, i, n_formats;
+	struct spa_rectangle size = { 320, 240 };
+	struct spa_fraction framerate = { 25, 1 };
+	struct spa_type_video_format *vf;
+	uint32_t formats[32];
+	int res;
 
 	if (node == NULL || format == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	//this = SPA_CONTAINER_OF (node, struct impl, node);
+	this = SPA_CONTAINER_OF(node, struct impl, node);
 
 	if (!IS_VALID_PORT(this, direction, port_id))
 		return SPA_RESULT_INVALID_PORT;
 
-	switch (index) {
+	vf = &this->type.video_format;
+	in_port = &this->in_ports[0];
+
+	count = match = filter ? 0 : index;
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (count++) {
 	case 0:
+		if (direction == SPA_DIRECTION_INPUT) {
+			spa_pod_builder_format(&b, &f[0], this->type.format,
+				this->type.media_type.video,
+				this->subtype,
+				PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+					320, 240,
+					1, 1,
+					INT32_MAX, INT32_MAX),
+				PROP_U_MM(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+					25, 1,
+					0, 1,
+					INT32_MAX, 1));
+			break;
+		}
+
+		/* the output has the size of the input and the formats the decoder
+		 * can make, most decoders don't say and make I420 */
+		n_formats = 0;
+		if (this->codec->pix_fmts) {
+			for (i = 0; this->codec->pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
+				uint32_t id = spa_ffmpeg_format_from_pix_fmt(vf,
+							this->codec->pix_fmts[i]);
+				if (id != vf->UNKNOWN && n_formats < SPA_N_ELEMENTS(formats))
+					formats[n_formats++] = id;
+			}
+		}
+		if (n_formats == 0) {
+			formats[n_formats++] = vf->I420;
+			formats[n_formats++] = vf->Y42B;
+			formats[n_formats++] = vf->Y444;
+			formats[n_formats++] = vf->NV12;
+			formats[n_formats++] = vf->GRAY8;
+		}
+		if (in_port->have_format) {
+			size = in_port->current_format.info.h264.size;
+			framerate = in_port->current_format.info.h264.framerate;
+		}
+
+		spa_pod_builder_push_format(&b, &f[0], this->type.format,
+					    this->type.media_type.video,
+					    this->type.media_subtype.raw);
+
+		spa_pod_builder_push_prop(&b, &f[1], this->type.format_video.format,
+					  SPA_POD_PROP_RANGE_ENUM |
+					  (n_formats > 1 ? SPA_POD_PROP_FLAG_UNSET : 0));
+		spa_pod_builder_id(&b, formats[0]);
+		for (i = 0; i < n_formats; i++)
+			spa_pod_builder_id(&b, formats[i]);
+		spa_pod_builder_pop(&b, &f[1]);
+
+		if (in_port->have_format) {
+			spa_pod_builder_add(&b,
+				PROP(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+					size.width, size.height),
+				PROP(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+					framerate.num, framerate.denom), 0);
+		} else {
+			spa_pod_builder_add(&b,
+				PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+					size.width, size.height,
+					1, 1,
+					INT32_MAX, INT32_MAX),
+				PROP_U_MM(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+					framerate.num, framerate.denom,
+					0, 1,
+					INT32_MAX, 1), 0);
+		}
+		spa_pod_builder_pop(&b, &f[0]);
 		break;
 	default:
 		return SPA_RESULT_ENUM_END;
 	}
-	*format = NULL;
+	fmt = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+
+	if ((res = spa_format_filter(fmt, filter, &b)) != SPA_RESULT_OK || match++ != index)
+		goto next;
+
+	*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
 
 	return SPA_RESULT_OK;
 }
 
+/* make the layout of the output buffers, like libavcodec would allocate them */
+static int make_layout(struct impl *this)
+{
+	struct spa_video_info_raw *info = &this->out_ports[0].current_format.info.raw;
+	const AVPixFmtDescriptor *desc;
+	int linesize_align[AV_NUM_DATA_POINTERS];
+	int w, h, linesizes[4];
+	uint32_t i;
+
+	this->pix_fmt = spa_ffmpeg_pix_fmt_from_format(&this->type.video_format,
+						       info->format, this->codec->pix_fmts);
+	if (this->pix_fmt == AV_PIX_FMT_NONE)
+		return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+	desc = av_pix_fmt_desc_get(this->pix_fmt);
+
+	w = info->size.width;
+	h = info->size.height;
+	this->context->pix_fmt = this->pix_fmt;
+	avcodec_align_dimensions2(this->context, &w, &h, linesize_align);
+
+	if (av_image_fill_linesizes(linesizes, this->pix_fmt, w) < 0)
+		return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+	this->width = w;
+	this->height = h;
+	this->n_planes = av_pix_fmt_count_planes(this->pix_fmt);
+	this->size = 0;
+
+	for (i = 0; i < this->n_planes; i++) {
+		int ph = (i == 1 || i == 2) ? -((-h) >> desc->log2_chroma_h) : h;
+
+		this->linesize[i] = FFALIGN(linesizes[i], PLANE_ALIGN);
+		this->plane_size[i] = (size_t) this->linesize[i] * ph + PLANE_PADDING;
+		this->plane_offset[i] = this->size;
+		this->size += FFALIGN(this->plane_size[i], PLANE_ALIGN);
+	}
+	spa_log_info(this->log, NAME " %p: layout %dx%d %s, %d planes, %zd bytes", this,
+		     w, h, desc->name, this->n_planes, this->size);
+
+	return SPA_RESULT_OK;
+}
+
+static void clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers", this);
+		/* the decoder must not use the buffers anymore */
+		if (port == &this->out_ports[0])
+			close_codec(this);
+		port->n_buffers = 0;
+		spa_list_init(&port->free);
+	}
+}
+
 static int
 spa_ffmpeg_dec_node_port_set_format(struct spa_node *node,
 				    enum spa_direction direction,
@@ -221,7 +533,7 @@ spa_ffmpeg_dec_node_port_set_format(struct spa_node *node,
 	struct impl *this;
 	struct port *port;
 
-	if (node == NULL || format == NULL)
+	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
 	this = SPA_CONTAINER_OF(node, struct impl, node);
@@ -234,21 +546,50 @@ spa_ffmpeg_dec_node_port_set_format(struct spa_node *node,
 
 	if (format == NULL) {
 		port->have_format = false;
+		clear_buffers(this, port);
+		close_codec(this);
 		return SPA_RESULT_OK;
 	} else {
 		struct spa_video_info info = { SPA_FORMAT_MEDIA_TYPE(format),
 			SPA_FORMAT_MEDIA_SUBTYPE(format),
 		};
 
-		if (info.media_type != this->type.media_type.video &&
-		    info.media_subtype != this->type.media_subtype.raw)
+		if (info.media_type != this->type.media_type.video)
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
-		if (!spa_format_video_raw_parse(format, &info.info.raw, &this->type.format_video))
-			return SPA_RESULT_INVALID_MEDIA_TYPE;
+		if (direction == SPA_DIRECTION_INPUT) {
+			if (info.media_subtype != this->subtype)
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+			/* all encoded formats have the size and framerate of h264 */
+			if (!spa_format_video_h264_parse(format, &info.info.h264,
+							 &this->type.format_video))
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+		} else {
+			if (info.media_subtype != this->type.media_subtype.raw)
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+			if (!spa_format_video_raw_parse(format, &info.info.raw,
+							&this->type.format_video))
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+		}
 
 		if (!(flags & SPA_PORT_FORMAT_FLAG_TEST_ONLY)) {
+			struct spa_video_info old = port->current_format;
+			int res;
+
+			close_codec(this);
 			port->current_format = info;
+
+			if (direction == SPA_DIRECTION_OUTPUT) {
+				this->context = avcodec_alloc_context3(this->codec);
+				if (this->context == NULL)
+					return SPA_RESULT_NO_MEMORY;
+				res = make_layout(this);
+				avcodec_free_context(&this->context);
+				if (res < 0) {
+					port->current_format = old;
+					return res;
+				}
+			}
 			port->have_format = true;
 		}
 	}
@@ -263,6 +604,8 @@ spa_ffmpeg_dec_node_port_get_format(struct spa_node *node,
 {
 	struct impl *this;
 	struct port *port;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
 
 	if (node == NULL || format == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
@@ -278,7 +621,27 @@ spa_ffmpeg_dec_node_port_get_format(struct spa_node *node,
 	if (!port->have_format)
 		return SPA_RESULT_NO_FORMAT;
 
-	*format = NULL;
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+	if (direction == SPA_DIRECTION_INPUT) {
+		spa_pod_builder_format(&b, &f[0], this->type.format,
+			this->type.media_type.video,
+			this->subtype,
+			PROP(&f[1], this->type.format_video.size, -SPA_POD_TYPE_RECTANGLE,
+				&port->current_format.info.h264.size),
+			PROP(&f[1], this->type.format_video.framerate, -SPA_POD_TYPE_FRACTION,
+				&port->current_format.info.h264.framerate));
+	} else {
+		spa_pod_builder_format(&b, &f[0], this->type.format,
+			this->type.media_type.video,
+			this->type.media_subtype.raw,
+			PROP(&f[1], this->type.format_video.format, SPA_POD_TYPE_ID,
+				port->current_format.info.raw.format),
+			PROP(&f[1], this->type.format_video.size, -SPA_POD_TYPE_RECTANGLE,
+				&port->current_format.info.raw.size),
+			PROP(&f[1], this->type.format_video.framerate, -SPA_POD_TYPE_FRACTION,
+				&port->current_format.info.raw.framerate));
+	}
+	*format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
 
 	return SPA_RESULT_OK;
 }
@@ -314,7 +677,74 @@ spa_ffmpeg_dec_node_port_enum_params(struct spa_node *node,
 				     uint32_t index,
 				     struct spa_param **param)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct impl *this;
+	struct port *port;
+	uint32_t i;
+	size_t max_plane = 0;
+
+	if (node == NULL || param == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (!IS_VALID_PORT(this, direction, port_id))
+		return SPA_RESULT_INVALID_PORT;
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	spa_pod_builder_init(&b, port->params_buffer, sizeof(port->params_buffer));
+
+	switch (index) {
+	case 0:
+		if (direction == SPA_DIRECTION_INPUT) {
+			spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+				PROP_U_MM(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
+					512 * 1024, 4096, INT32_MAX),
+				PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT, 0),
+				PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+					4, 1, MAX_BUFFERS),
+				PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT, 16));
+			break;
+		}
+		/* a block for each plane so that they can be aligned */
+		for (i = 0; i < this->n_planes; i++)
+			max_plane = SPA_MAX(max_plane, FFALIGN(this->plane_size[i], PLANE_ALIGN));
+
+		/* the decoder keeps reference frames and a frame per thread */
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+			PROP(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
+				max_plane),
+			PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT,
+				this->linesize[0]),
+			PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+				16, 2, MAX_BUFFERS),
+			PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT,
+				PLANE_ALIGN),
+			PROP(&f[1], this->type.param_alloc_buffers.blocks, SPA_POD_TYPE_INT,
+				this->n_planes));
+		break;
+
+	case 1:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.Header),
+			PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				sizeof(struct spa_meta_header)));
+		break;
+
+	default:
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -326,6 +756,44 @@ spa_ffmpeg_dec_node_port_set_param(struct spa_node *node,
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
 
+static bool is_mem(struct impl *this, struct spa_data *d)
+{
+	return (d->type == this->type.data.MemPtr ||
+		d->type == this->type.data.MemFd ||
+		d->type == this->type.data.DmaBuf) && d->data != NULL;
+}
+
+/* find the planes of an output buffer, in their own data blocks or in the
+ * first one */
+static int setup_planes(struct impl *this, struct buffer *b)
+{
+	struct spa_buffer *buf = b->outbuf;
+	struct spa_data *d = buf->datas;
+	uint32_t i;
+
+	if (buf->n_datas >= this->n_planes) {
+		for (i = 0; i < this->n_planes; i++) {
+			if (!is_mem(this, &d[i]) || d[i].maxsize < this->plane_size[i])
+				return SPA_RESULT_ERROR;
+			b->planes[i] = d[i].data;
+		}
+	} else {
+		if (!is_mem(this, &d[0]) || d[0].maxsize < this->size)
+			return SPA_RESULT_ERROR;
+		for (i = 0; i < this->n_planes; i++)
+			b->planes[i] = SPA_MEMBER(d[0].data, this->plane_offset[i], uint8_t);
+	}
+
+	for (i = 0; i < this->n_planes; i++) {
+		if (((uintptr_t) b->planes[i]) & (PLANE_ALIGN - 1)) {
+			spa_log_warn(this->log, NAME " %p: buffer %p plane %d not aligned, copying",
+				     this, buf, i);
+			this->direct = false;
+		}
+	}
+	return SPA_RESULT_OK;
+}
+
 static int
 spa_ffmpeg_dec_node_port_use_buffers(struct spa_node *node,
 				     enum spa_direction direction,
@@ -333,13 +801,54 @@ spa_ffmpeg_dec_node_port_use_buffers(struct spa_node *node,
 				     struct spa_buffer **buffers,
 				     uint32_t n_buffers)
 {
+	struct impl *this;
+	struct port *port;
+	uint32_t i;
+
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	if (!IS_VALID_PORT(node, direction, port_id))
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (!IS_VALID_PORT(this, direction, port_id))
 		return SPA_RESULT_INVALID_PORT;
 
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	clear_buffers(this, port);
+
+	if (direction == SPA_DIRECTION_OUTPUT)
+		this->direct = true;
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &port->buffers[i];
+
+		b->impl = this;
+		b->outbuf = buffers[i];
+		b->outstanding = false;
+		b->in_decoder = false;
+		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
+
+		if (direction == SPA_DIRECTION_OUTPUT) {
+			if (setup_planes(this, b) < 0) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p",
+					      this, buffers[i]);
+				return SPA_RESULT_ERROR;
+			}
+			spa_list_insert(port->free.prev, &b->link);
+		} else if (!is_mem(this, &buffers[i]->datas[0])) {
+			spa_log_error(this->log, NAME " %p: invalid memory on buffer %p",
+				      this, buffers[i]);
+			return SPA_RESULT_ERROR;
+		}
+	}
+	port->n_buffers = n_buffers;
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -378,46 +887,385 @@ spa_ffmpeg_dec_node_port_set_io(struct spa_node *node,
 	return SPA_RESULT_OK;
 }
 
+static struct buffer *take_free_buffer(struct impl *this)
+{
+	struct port *port = &this->out_ports[0];
+	struct buffer *b = NULL;
+
+	pthread_mutex_lock(&this->lock);
+	if (!spa_list_is_empty(&port->free)) {
+		b = spa_list_first(&port->free, struct buffer, link);
+		spa_list_remove(&b->link);
+	}
+	pthread_mutex_unlock(&this->lock);
+
+	return b;
+}
+
+/* a buffer is free when the decoder and the consumer are both done with it */
+static void release_buffer(void *opaque, uint8_t *data)
+{
+	struct buffer *b = opaque;
+	struct impl *this = b->impl;
+
+	pthread_mutex_lock(&this->lock);
+	b->in_decoder = false;
+	if (!b->outstanding)
+		spa_list_insert(this->out_ports[0].free.prev, &b->link);
+	pthread_mutex_unlock(&this->lock);
+}
+
+static void recycle_buffer(struct impl *this, uint32_t id)
+{
+	struct port *port = &this->out_ports[0];
+	struct buffer *b = &port->buffers[id];
+
+	pthread_mutex_lock(&this->lock);
+	if (!b->outstanding) {
+		pthread_mutex_unlock(&this->lock);
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+	b->outstanding = false;
+	if (!b->in_decoder)
+		spa_list_insert(port->free.prev, &b->link);
+	pthread_mutex_unlock(&this->lock);
+
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
+
+/* the other planes hold a reference on the first one, the buffer is
+ * released when the decoder dropped all of them */
+static void release_plane(void *opaque, uint8_t *data)
+{
+	AVBufferRef *ref = opaque;
+	av_buffer_unref(&ref);
+}
+
+/* let libavcodec decode into the memory of an output buffer */
+static int get_buffer(AVCodecContext *context, AVFrame *frame, int flags)
+{
+	struct impl *this = context->opaque;
+	struct buffer *b;
+	uint32_t i;
+
+	if (!this->direct || frame->format != this->pix_fmt ||
+	    frame->width > this->width || frame->height > this->height ||
+	    (b = take_free_buffer(this)) == NULL)
+		return avcodec_default_get_buffer2(context, frame, flags);
+
+	frame->buf[0] = av_buffer_create(b->planes[0], this->plane_size[0],
+					 release_buffer, b, 0);
+	if (frame->buf[0] == NULL) {
+		pthread_mutex_lock(&this->lock);
+		spa_list_insert(this->out_ports[0].free.prev, &b->link);
+		pthread_mutex_unlock(&this->lock);
+		return AVERROR(ENOMEM);
+	}
+	b->in_decoder = true;
+
+	for (i = 1; i < this->n_planes; i++) {
+		AVBufferRef *ref;
+
+		if ((ref = av_buffer_ref(frame->buf[0])) == NULL)
+			goto no_mem;
+		frame->buf[i] = av_buffer_create(b->planes[i], this->plane_size[i],
+						 release_plane, ref, 0);
+		if (frame->buf[i] == NULL) {
+			av_buffer_unref(&ref);
+			goto no_mem;
+		}
+	}
+	for (i = 0; i < this->n_planes; i++) {
+		frame->data[i] = b->planes[i];
+		frame->linesize[i] = this->linesize[i];
+	}
+	frame->extended_data = frame->data;
+
+	return 0;
+
+      no_mem:
+	/* dropping the last reference puts the buffer back on the free list */
+	for (i = 0; i < this->n_planes; i++)
+		av_buffer_unref(&frame->buf[i]);
+	return AVERROR(ENOMEM);
+}
+
+static struct buffer *frame_buffer(struct impl *this, AVFrame *frame)
+{
+	struct port *port = &this->out_ports[0];
+	struct buffer *b;
+	uint32_t i;
+
+	if (frame->buf[0] == NULL || frame->buf[this->n_planes] != NULL)
+		return NULL;
+
+	b = av_buffer_get_opaque(frame->buf[0]);
+	if (b < port->buffers || b >= port->buffers + port->n_buffers)
+		return NULL;
+
+	for (i = 0; i < this->n_planes; i++)
+		if (frame->buf[i] == NULL || frame->data[i] != b->planes[i])
+			return NULL;
+
+	return b;
+}
+
+static int open_codec(struct impl *this)
+{
+	struct spa_video_info_h264 *info = &this->in_ports[0].current_format.info.h264;
+	int res;
+
+	if (this->context)
+		return SPA_RESULT_OK;
+
+	if ((this->context = avcodec_alloc_context3(this->codec)) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	this->context->opaque = this;
+	this->context->width = info->size.width;
+	this->context->height = info->size.height;
+	this->context->pix_fmt = this->pix_fmt;
+	this->context->get_buffer2 = get_buffer;
+	this->context->thread_count = this->props.threads;
+	if (this->props.thread_type == this->type.thread_type_frame)
+		this->context->thread_type = FF_THREAD_FRAME;
+	else if (this->props.thread_type == this->type.thread_type_slice)
+		this->context->thread_type = FF_THREAD_SLICE;
+	else
+		this->context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+#if LIBAVCODEC_VERSION_MAJOR < 59
+	/* get_buffer and release_buffer can be called from any thread */
+	this->context->thread_safe_callbacks = 1;
+#endif
+
+	if ((res = avcodec_open2(this->context, this->codec, NULL)) < 0) {
+		spa_log_error(this->log, NAME " %p: can't open codec: %s", this, av_err2str(res));
+		avcodec_free_context(&this->context);
+		return SPA_RESULT_ERROR;
+	}
+	this->n_frames = this->n_copies = 0;
+
+	spa_log_info(this->log, NAME " %p: opened %s with %d threads", this,
+		     this->codec->name, this->context->thread_count);
+
+	return SPA_RESULT_OK;
+}
+
+static void set_chunks(struct impl *this, struct buffer *b)
+{
+	struct spa_buffer *buf = b->outbuf;
+	uint32_t i;
+
+	if (buf->n_datas >= this->n_planes) {
+		for (i = 0; i < this->n_planes; i++) {
+			buf->datas[i].chunk->offset = 0;
+			buf->datas[i].chunk->size = this->plane_size[i] - PLANE_PADDING;
+			buf->datas[i].chunk->stride = this->linesize[i];
+		}
+	} else {
+		buf->datas[0].chunk->offset = 0;
+		buf->datas[0].chunk->size = this->size;
+		buf->datas[0].chunk->stride = this->linesize[0];
+	}
+}
+
+/* move a decoded frame to the output */
+static int receive_frame(struct impl *this)
+{
+	struct spa_port_io *output = this->out_ports[0].io;
+	AVFrame *frame = this->frame;
+	struct buffer *b;
+	int res;
+
+	res = avcodec_receive_frame(this->context, frame);
+	if (res == AVERROR(EAGAIN) || res == AVERROR_EOF)
+		return SPA_RESULT_NEED_BUFFER;
+	if (res < 0) {
+		spa_log_error(this->log, NAME " %p: decode error: %s", this, av_err2str(res));
+		return SPA_RESULT_ERROR;
+	}
+
+	if ((b = frame_buffer(this, frame)) == NULL) {
+		/* libavcodec decoded into its own memory */
+		if (frame->format != this->pix_fmt ||
+		    frame->width > this->width || frame->height > this->height) {
+			spa_log_error(this->log, NAME " %p: frame %dx%d %d does not match output",
+				      this, frame->width, frame->height, frame->format);
+			av_frame_unref(frame);
+			return SPA_RESULT_ERROR;
+		}
+		if ((b = take_free_buffer(this)) == NULL) {
+			av_frame_unref(frame);
+			return SPA_RESULT_OUT_OF_BUFFERS;
+		}
+		av_image_copy(b->planes, this->linesize,
+			      (const uint8_t **) frame->data, frame->linesize,
+			      this->pix_fmt, frame->width, frame->height);
+		this->n_copies++;
+	}
+
+	/* the decoder can keep a reference, the buffer is reused when both
+	 * are done with it */
+	pthread_mutex_lock(&this->lock);
+	b->outstanding = true;
+	pthread_mutex_unlock(&this->lock);
+
+	if (b->h) {
+		b->h->flags = 0;
+		b->h->seq = this->n_frames;
+		b->h->pts = frame->pts;
+		b->h->dts_offset = 0;
+	}
+	set_chunks(this, b);
+	av_frame_unref(frame);
+
+	this->n_frames++;
+
+	output->buffer_id = b->outbuf->id;
+	output->status = SPA_RESULT_HAVE_BUFFER;
+
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static int send_packet(struct impl *this, struct buffer *b)
+{
+	struct spa_data *d = &b->outbuf->datas[0];
+	uint32_t size = SPA_MIN(d->chunk->size, d->maxsize);
+	AVPacket *packet = this->packet;
+	int res;
+
+	/* libavcodec wants padding after the packet data */
+	av_fast_padded_malloc(&this->packet_data, &this->packet_size, size);
+	if (this->packet_data == NULL)
+		return SPA_RESULT_NO_MEMORY;
+	memcpy(this->packet_data, SPA_MEMBER(d->data, d->chunk->offset, void), size);
+
+	packet->data = this->packet_data;
+	packet->size = size;
+	packet->pts = b->h ? b->h->pts : AV_NOPTS_VALUE;
+
+	res = avcodec_send_packet(this->context, packet);
+	if (res == AVERROR(EAGAIN))
+		return SPA_RESULT_HAVE_BUFFER;
+	if (res < 0)
+		spa_log_warn(this->log, NAME " %p: can't decode packet: %s", this, av_err2str(res));
+
+	return SPA_RESULT_OK;
+}
+
 static int spa_ffmpeg_dec_node_process_input(struct spa_node *node)
 {
-	return SPA_RESULT_INVALID_PORT;
+	struct impl *this;
+	struct port *in_port, *out_port;
+	struct spa_port_io *input, *output;
+	int res;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = &this->out_ports[0];
+	if ((output = out_port->io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	in_port = &this->in_ports[0];
+	if ((input = in_port->io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	if (!in_port->have_format || !out_port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	if ((res = open_codec(this)) < 0)
+		return res;
+
+	if (input->status == SPA_RESULT_HAVE_BUFFER && input->buffer_id < in_port->n_buffers) {
+		/* keep the input when the decoder first wants its frames taken */
+		if ((res = send_packet(this, &in_port->buffers[input->buffer_id])) < 0)
+			return res;
+		if (res == SPA_RESULT_OK)
+			input->status = SPA_RESULT_NEED_BUFFER;
+	}
+	return receive_frame(this);
 }
 
 static int spa_ffmpeg_dec_node_process_output(struct spa_node *node)
 {
 	struct impl *this;
-	struct port *port;
-	struct spa_port_io *output;
+	struct port *in_port, *out_port;
+	struct spa_port_io *input, *output;
+	int res;
 
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
 	this = SPA_CONTAINER_OF(node, struct impl, node);
 
-	port = &this->out_ports[0];
-
-	if ((output = port->io) == NULL)
+	out_port = &this->out_ports[0];
+	if ((output = out_port->io) == NULL)
 		return SPA_RESULT_ERROR;
 
-	if (!port->have_format) {
+	if (!out_port->have_format) {
 		output->status = SPA_RESULT_NO_FORMAT;
 		return SPA_RESULT_ERROR;
 	}
-	output->status = SPA_RESULT_OK;
 
-	return SPA_RESULT_OK;
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	/* recycle */
+	if (output->buffer_id < out_port->n_buffers) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
+	/* a packet can decode to more than one frame */
+	if (this->context && (res = receive_frame(this)) != SPA_RESULT_NEED_BUFFER)
+		return res;
+
+	in_port = &this->in_ports[0];
+	if ((input = in_port->io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	/* the packet that was kept can go in now */
+	if (input->status == SPA_RESULT_HAVE_BUFFER)
+		return spa_ffmpeg_dec_node_process_input(node);
+
+	input->range = output->range;
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	return SPA_RESULT_NEED_BUFFER;
 }
 
 static int
 spa_ffmpeg_dec_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
 {
+	struct impl *this;
+	struct port *port;
+
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
 	if (port_id != 0)
 		return SPA_RESULT_INVALID_PORT;
 
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	port = &this->out_ports[port_id];
+
+	if (port->n_buffers == 0)
+		return SPA_RESULT_NO_BUFFERS;
+
+	if (buffer_id >= port->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	recycle_buffer(this, buffer_id);
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -474,8 +1322,32 @@ spa_ffmpeg_dec_get_interface(struct spa_handle *handle, uint32_t interface_id, v
 	return SPA_RESULT_OK;
 }
 
+static int spa_ffmpeg_dec_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	if (handle == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = (struct impl *) handle;
+
+	close_codec(this);
+	av_frame_free(&this->frame);
+	av_packet_free(&this->packet);
+	av_freep(&this->packet_data);
+	pthread_mutex_destroy(&this->lock);
+
+	return SPA_RESULT_OK;
+}
+
+size_t spa_ffmpeg_dec_get_size(void)
+{
+	return sizeof(struct impl);
+}
+
 int
 spa_ffmpeg_dec_init(struct spa_handle *handle,
+		    const AVCodec *codec,
 		    const struct spa_dict *info,
 		    const struct spa_support *support,
 		    uint32_t n_support)
@@ -484,6 +1356,7 @@ spa_ffmpeg_dec_init(struct spa_handle *handle,
 	uint32_t i;
 
 	handle->get_interface = spa_ffmpeg_dec_get_interface;
+	handle->clear = spa_ffmpeg_dec_clear;
 
 	this = (struct impl *) handle;
 
@@ -499,10 +1372,31 @@ spa_ffmpeg_dec_init(struct spa_handle *handle,
 	}
 	init_type(&this->type, this->map);
 
+	this->codec = codec;
+	this->subtype = spa_ffmpeg_subtype_from_codec_id(&this->type.media_subtype_video,
+							 codec->id);
+	if (codec->type != AVMEDIA_TYPE_VIDEO || this->subtype == SPA_ID_INVALID) {
+		spa_log_error(this->log, NAME " %p: codec %s is not supported", this, codec->name);
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	this->frame = av_frame_alloc();
+	this->packet = av_packet_alloc();
+	if (this->frame == NULL || this->packet == NULL) {
+		av_frame_free(&this->frame);
+		av_packet_free(&this->packet);
+		return SPA_RESULT_NO_MEMORY;
+	}
+
+	pthread_mutex_init(&this->lock, NULL);
+
 	this->node = ffmpeg_dec_node;
+	reset_props(this, &this->props);
 
-	this->in_ports[0].info.flags = 0;
-	this->out_ports[0].info.flags = 0;
+	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->in_ports[0].free);
+	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->out_ports[0].free);
 
 	return SPA_RESULT_OK;
 }
@@ -17,54 +17,107 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
 #include <stddef.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 
-#include <spa/log.h>
 #include <spa/type-map.h>
+#include <spa/log.h>
+#include <spa/list.h>
 #include <spa/node.h>
 #include <spa/video/format-utils.h>
+#include <spa/format-builder.h>
+#include <spa/param-alloc.h>
 #include <lib/props.h>
+#include <lib/format.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+
+#include "ffmpeg.h"
+
+#define NAME "ffenc"
 
 #define IS_VALID_PORT(this,d,id) ((id) == 0)
-#define MAX_BUFFERS    32
+#define MAX_BUFFERS	32
+#define MAX_PLANES	4
+
+/* libavcodec reads input planes with aligned loads */
+#define PLANE_ALIGN	32
+
+/* the pts of the frames that are in the encoder */
+#define MAX_PTS		64
+
+struct props {
+	int32_t bitrate;
+	int32_t gop_size;
+	int32_t threads;
+	uint32_t thread_type;
+};
 
 struct buffer {
-	struct spa_buffer buffer;
-	struct spa_meta metas[1];
-	struct spa_meta_header header;
-	struct spa_data datas[1];
-	struct spa_buffer *imported;
+	struct spa_buffer *outbuf;
+	struct spa_meta_header *h;
 	bool outstanding;
-	struct buffer *next;
+	struct spa_list link;
 };
 
 struct port {
 	bool have_format;
 	struct spa_video_info current_format;
-	bool have_buffers;
 	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct spa_list free;
 	struct spa_port_info info;
 	struct spa_port_io *io;
+	uint8_t params_buffer[1024];
 };
 
 struct type {
 	uint32_t node;
+	uint32_t format;
+	uint32_t props;
+	uint32_t prop_bitrate;
+	uint32_t prop_gop_size;
+	uint32_t prop_threads;
+	uint32_t prop_thread_type;
+	uint32_t thread_type_frame;
+	uint32_t thread_type_slice;
+	uint32_t thread_type_any;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
 	struct spa_type_media_type media_type;
 	struct spa_type_media_subtype media_subtype;
+	struct spa_type_media_subtype_video media_subtype_video;
 	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
 	struct spa_type_command_node command_node;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
+	struct spa_type_param_alloc_meta_enable param_alloc_meta_enable;
 };
 
 static inline void init_type(struct type *type, struct spa_type_map *map)
 {
 	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->prop_bitrate = spa_type_map_get_id(map, SPA_TYPE_PROPS__bitrate);
+	type->prop_gop_size = spa_type_map_get_id(map, SPA_TYPE_PROPS__gopSize);
+	type->prop_threads = spa_type_map_get_id(map, SPA_TYPE_PROPS__threads);
+	type->prop_thread_type = spa_type_map_get_id(map, SPA_TYPE_PROPS__threadType);
+	type->thread_type_frame = spa_type_map_get_id(map, SPA_TYPE_PROPS__threadType ":frame");
+	type->thread_type_slice = spa_type_map_get_id(map, SPA_TYPE_PROPS__threadType ":slice");
+	type->thread_type_any = spa_type_map_get_id(map, SPA_TYPE_PROPS__threadType ":any");
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
 	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_media_subtype_video_map(map, &type->media_subtype_video);
 	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
 	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
+	spa_type_param_alloc_meta_enable_map(map, &type->param_alloc_meta_enable);
 }
 
 struct impl {
@@ -75,23 +128,130 @@ struct impl {
 	struct spa_type_map *map;
 	struct spa_log *log;
 
+	uint8_t props_buffer[512];
+	struct props props;
+
 	const struct spa_node_callbacks *callbacks;
 	void *user_data;
 
+	uint8_t format_buffer[1024];
+
 	struct port in_ports[1];
 	struct port out_ports[1];
 
+	const AVCodec *codec;
+	uint32_t subtype;
+	AVCodecContext *context;
+	AVFrame *frame;		/**< the planes of the input buffer */
+	AVFrame *copy;		/**< the copy of the input that is encoded */
+	AVPacket *packet;
+
+	enum AVPixelFormat pix_fmt;
+	const AVPixFmtDescriptor *desc;
+	uint32_t n_planes;
+
+	uint64_t pts[MAX_PTS];
+	uint32_t n_frames;
+	uint32_t n_packets;
+
 	bool started;
 };
 
+#define DEFAULT_BITRATE		2000000
+#define DEFAULT_GOP_SIZE	30
+#define DEFAULT_THREADS		0
+
+static void reset_props(struct impl *this, struct props *props)
+{
+	props->bitrate = DEFAULT_BITRATE;
+	props->gop_size = DEFAULT_GOP_SIZE;
+	props->threads = DEFAULT_THREADS;
+	props->thread_type = this->type.thread_type_any;
+}
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_MM(f,key,type,...)							\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
+
+static void close_codec(struct impl *this)
+{
+	if (this->context == NULL)
+		return;
+
+	avcodec_free_context(&this->context);
+	av_frame_unref(this->frame);
+	av_frame_unref(this->copy);
+	spa_log_info(this->log, NAME " %p: closed, %u frames, %u packets", this,
+		     this->n_frames, this->n_packets);
+}
+
 static int spa_ffmpeg_enc_node_get_props(struct spa_node *node, struct spa_props **props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	if (node == NULL || props == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_pod_builder_init(&b, this->props_buffer, sizeof(this->props_buffer));
+	spa_pod_builder_props(&b, &f[0], this->type.props,
+		PROP_MM(&f[1], this->type.prop_bitrate, SPA_POD_TYPE_INT,
+			this->props.bitrate,
+			1000, INT32_MAX),
+		PROP_MM(&f[1], this->type.prop_gop_size, SPA_POD_TYPE_INT,
+			this->props.gop_size,
+			0, INT32_MAX),
+		PROP_MM(&f[1], this->type.prop_threads, SPA_POD_TYPE_INT,
+			this->props.threads,
+			0, 64),
+		PROP_EN(&f[1], this->type.prop_thread_type, SPA_POD_TYPE_ID, 4,
+			this->props.thread_type,
+			this->type.thread_type_frame,
+			this->type.thread_type_slice,
+			this->type.thread_type_any));
+
+	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return SPA_RESULT_OK;
 }
 
 static int spa_ffmpeg_enc_node_set_props(struct spa_node *node, const struct spa_props *props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct props old;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	old = this->props;
+
+	if (props == NULL) {
+		reset_props(this, &this->props);
+	} else {
+		spa_props_query(props,
+				this->type.prop_bitrate, SPA_POD_TYPE_INT, &this->props.bitrate,
+				this->type.prop_gop_size, SPA_POD_TYPE_INT, &this->props.gop_size,
+				this->type.prop_threads, SPA_POD_TYPE_INT, &this->props.threads,
+				this->type.prop_thread_type, SPA_POD_TYPE_ID, &this->props.thread_type,
+				0);
+	}
+
+	/* all props are configured when the codec is opened */
+	if (memcmp(&old, &this->props, sizeof(struct props)) != 0)
+		close_codec(this);
+
+	return SPA_RESULT_OK;
 }
 
 static int spa_ffmpeg_enc_node_send_command(struct spa_node *node, const struct spa_command *command)
@@ -180,7 +340,8 @@ spa_ffmpeg_enc_node_add_port(struct spa_node *node, enum spa_direction direction
 
 static int
 spa_ffmpeg_enc_node_remove_port(struct spa_node *node,
-				enum spa_direction direction, uint32_t port_id)
+				enum spa_direction direction,
+				uint32_t port_id)
 {
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
@@ -190,42 +351,125 @@ spa_ffmpeg_enc_node_port_enum_formats(struct spa_node *node,
 				      enum spa_direction direction,
 				      uint32_t port_id,
 				      struct spa_format **format,
-				      const struct spa_format *filter, uint32_t index)
+				      const struct spa_format *filter,
+				      uint32_t index)
 {
-	//struct impl *this;
-	//struct port *port;
+	struct impl *this;
+	struct port *in_port;
+	struct spa_format *fmt;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+	uint32_t count, match, i, n_formats;
+	struct spa_type_video_format *vf;
+	uint32_t formats[32];
+	int res;
 
 	if (node == NULL || format == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	//this = SPA_CONTAINER_OF (node, struct impl, node);
+	this = SPA_CONTAINER_OF(node, struct impl, node);
 
 	if (!IS_VALID_PORT(this, direction, port_id))
 		return SPA_RESULT_INVALID_PORT;
 
-	//port = direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+	vf = &this->type.video_format;
+	in_port = &this->in_ports[0];
 
-	switch (index) {
+	count = match = filter ? 0 : index;
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (count++) {
 	case 0:
+		if (direction == SPA_DIRECTION_OUTPUT) {
+			struct spa_video_info_raw *info = &in_port->current_format.info.raw;
+
+			if (!in_port->have_format)
+				return SPA_RESULT_NO_FORMAT;
+
+			spa_pod_builder_format(&b, &f[0], this->type.format,
+				this->type.media_type.video,
+				this->subtype,
+				PROP(&f[1], this->type.format_video.size, -SPA_POD_TYPE_RECTANGLE,
+					&info->size),
+				PROP(&f[1], this->type.format_video.framerate, -SPA_POD_TYPE_FRACTION,
+					&info->framerate));
+			break;
+		}
+
+		n_formats = 0;
+		if (this->codec->pix_fmts) {
+			for (i = 0; this->codec->pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
+				uint32_t id = spa_ffmpeg_format_from_pix_fmt(vf,
+							this->codec->pix_fmts[i]);
+				if (id != vf->UNKNOWN && n_formats < SPA_N_ELEMENTS(formats))
+					formats[n_formats++] = id;
+			}
+		} else {
+			formats[n_formats++] = vf->I420;
+		}
+		if (n_formats == 0)
+			return SPA_RESULT_ENUM_END;
+
+		spa_pod_builder_push_format(&b, &f[0], this->type.format,
+					    this->type.media_type.video,
+					    this->type.media_subtype.raw);
+
+		spa_pod_builder_push_prop(&b, &f[1], this->type.format_video.format,
+					  SPA_POD_PROP_RANGE_ENUM |
+					  (n_formats > 1 ? SPA_POD_PROP_FLAG_UNSET : 0));
+		spa_pod_builder_id(&b, formats[0]);
+		for (i = 0; i < n_formats; i++)
+			spa_pod_builder_id(&b, formats[i]);
+		spa_pod_builder_pop(&b, &f[1]);
+
+		spa_pod_builder_add(&b,
+			PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+				320, 240,
+				16, 16,
+				INT32_MAX, INT32_MAX),
+			PROP_U_MM(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+				25, 1,
+				1, 1,
+				INT32_MAX, 1), 0);
+		spa_pod_builder_pop(&b, &f[0]);
 		break;
 	default:
 		return SPA_RESULT_ENUM_END;
 	}
-	*format = NULL;
+	fmt = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+
+	if ((res = spa_format_filter(fmt, filter, &b)) != SPA_RESULT_OK || match++ != index)
+		goto next;
+
+	*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
 
 	return SPA_RESULT_OK;
 }
 
+static void clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers", this);
+		port->n_buffers = 0;
+		spa_list_init(&port->free);
+	}
+}
+
 static int
 spa_ffmpeg_enc_node_port_set_format(struct spa_node *node,
 				    enum spa_direction direction,
 				    uint32_t port_id,
-				    uint32_t flags, const struct spa_format *format)
+				    uint32_t flags,
+				    const struct spa_format *format)
 {
 	struct impl *this;
 	struct port *port;
 
-	if (node == NULL || format == NULL)
+	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
 	this = SPA_CONTAINER_OF(node, struct impl, node);
@@ -238,22 +482,48 @@ spa_ffmpeg_enc_node_port_set_format(struct spa_node *node,
 
 	if (format == NULL) {
 		port->have_format = false;
+		clear_buffers(this, port);
+		close_codec(this);
 		return SPA_RESULT_OK;
 	} else {
 		struct spa_video_info info = { SPA_FORMAT_MEDIA_TYPE(format),
 			SPA_FORMAT_MEDIA_SUBTYPE(format),
 		};
+		enum AVPixelFormat pix_fmt = AV_PIX_FMT_NONE;
 
-		if (info.media_type != this->type.media_type.video &&
-		    info.media_subtype != this->type.media_subtype.raw)
+		if (info.media_type != this->type.media_type.video)
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
-		if (!spa_format_video_raw_parse(format, &info.info.raw, &this->type.format_video))
-			return SPA_RESULT_INVALID_MEDIA_TYPE;
+		if (direction == SPA_DIRECTION_INPUT) {
+			if (info.media_subtype != this->type.media_subtype.raw)
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+			if (!spa_format_video_raw_parse(format, &info.info.raw,
+							&this->type.format_video))
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+			pix_fmt = spa_ffmpeg_pix_fmt_from_format(&this->type.video_format,
+								 info.info.raw.format,
+								 this->codec->pix_fmts);
+			if (pix_fmt == AV_PIX_FMT_NONE || info.info.raw.framerate.num == 0)
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+		} else {
+			if (info.media_subtype != this->subtype)
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+			if (!spa_format_video_h264_parse(format, &info.info.h264,
+							 &this->type.format_video))
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+		}
 
 		if (!(flags & SPA_PORT_FORMAT_FLAG_TEST_ONLY)) {
+			close_codec(this);
 			port->current_format = info;
 			port->have_format = true;
+
+			if (direction == SPA_DIRECTION_INPUT) {
+				this->pix_fmt = pix_fmt;
+				this->desc = av_pix_fmt_desc_get(pix_fmt);
+				this->n_planes = av_pix_fmt_count_planes(pix_fmt);
+			}
 		}
 	}
 	return SPA_RESULT_OK;
@@ -262,10 +532,13 @@ spa_ffmpeg_enc_node_port_set_format(struct spa_node *node,
 static int
 spa_ffmpeg_enc_node_port_get_format(struct spa_node *node,
 				    enum spa_direction direction,
-				    uint32_t port_id, const struct spa_format **format)
+				    uint32_t port_id,
+				    const struct spa_format **format)
 {
 	struct impl *this;
 	struct port *port;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
 
 	if (node == NULL || format == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
@@ -281,7 +554,27 @@ spa_ffmpeg_enc_node_port_get_format(struct spa_node *node,
 	if (!port->have_format)
 		return SPA_RESULT_NO_FORMAT;
 
-	*format = NULL;
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+	if (direction == SPA_DIRECTION_INPUT) {
+		spa_pod_builder_format(&b, &f[0], this->type.format,
+			this->type.media_type.video,
+			this->type.media_subtype.raw,
+			PROP(&f[1], this->type.format_video.format, SPA_POD_TYPE_ID,
+				port->current_format.info.raw.format),
+			PROP(&f[1], this->type.format_video.size, -SPA_POD_TYPE_RECTANGLE,
+				&port->current_format.info.raw.size),
+			PROP(&f[1], this->type.format_video.framerate, -SPA_POD_TYPE_FRACTION,
+				&port->current_format.info.raw.framerate));
+	} else {
+		spa_pod_builder_format(&b, &f[0], this->type.format,
+			this->type.media_type.video,
+			this->subtype,
+			PROP(&f[1], this->type.format_video.size, -SPA_POD_TYPE_RECTANGLE,
+				&port->current_format.info.h264.size),
+			PROP(&f[1], this->type.format_video.framerate, -SPA_POD_TYPE_FRACTION,
+				&port->current_format.info.h264.framerate));
+	}
+	*format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
 
 	return SPA_RESULT_OK;
 }
@@ -289,7 +582,8 @@ spa_ffmpeg_enc_node_port_get_format(struct spa_node *node,
 static int
 spa_ffmpeg_enc_node_port_get_info(struct spa_node *node,
 				  enum spa_direction direction,
-				  uint32_t port_id, const struct spa_port_info **info)
+				  uint32_t port_id,
+				  const struct spa_port_info **info)
 {
 	struct impl *this;
 	struct port *port;
@@ -312,32 +606,148 @@ spa_ffmpeg_enc_node_port_get_info(struct spa_node *node,
 static int
 spa_ffmpeg_enc_node_port_enum_params(struct spa_node *node,
 				     enum spa_direction direction,
-				     uint32_t port_id, uint32_t index, struct spa_param **param)
+				     uint32_t port_id,
+				     uint32_t index,
+				     struct spa_param **param)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct impl *this;
+	struct port *port;
+	struct spa_rectangle *size;
+	int linesizes[4], size0;
+
+	if (node == NULL || param == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (!IS_VALID_PORT(this, direction, port_id))
+		return SPA_RESULT_INVALID_PORT;
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	spa_pod_builder_init(&b, port->params_buffer, sizeof(port->params_buffer));
+
+	switch (index) {
+	case 0:
+		if (direction == SPA_DIRECTION_INPUT) {
+			size = &port->current_format.info.raw.size;
+			av_image_fill_linesizes(linesizes, this->pix_fmt, size->width);
+			size0 = FFALIGN(linesizes[0], PLANE_ALIGN) * size->height;
+
+			/* aligned planes let the encoder read the buffers in place */
+			spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+				PROP_U_MM(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
+					size0, size0, INT32_MAX),
+				PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT,
+					FFALIGN(linesizes[0], PLANE_ALIGN)),
+				PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+					4, 2, MAX_BUFFERS),
+				PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT,
+					PLANE_ALIGN),
+				PROP(&f[1], this->type.param_alloc_buffers.blocks, SPA_POD_TYPE_INT,
+					this->n_planes));
+			break;
+		}
+		/* an encoded frame is smaller than a raw frame */
+		size = &port->current_format.info.h264.size;
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+			PROP_U_MM(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
+				size->width * size->height * 3 + 4096,
+				4096, INT32_MAX),
+			PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT, 0),
+			PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+				8, 1, MAX_BUFFERS),
+			PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT, 16));
+		break;
+
+	case 1:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.Header),
+			PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				sizeof(struct spa_meta_header)));
+		break;
+
+	default:
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
 }
 
 static int
 spa_ffmpeg_enc_node_port_set_param(struct spa_node *node,
 				   enum spa_direction direction,
-				   uint32_t port_id, const struct spa_param *param)
+				   uint32_t port_id,
+				   const struct spa_param *param)
 {
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
 
+static bool is_mem(struct impl *this, struct spa_data *d)
+{
+	return (d->type == this->type.data.MemPtr ||
+		d->type == this->type.data.MemFd ||
+		d->type == this->type.data.DmaBuf) && d->data != NULL;
+}
+
 static int
 spa_ffmpeg_enc_node_port_use_buffers(struct spa_node *node,
 				     enum spa_direction direction,
 				     uint32_t port_id,
-				     struct spa_buffer **buffers, uint32_t n_buffers)
+				     struct spa_buffer **buffers,
+				     uint32_t n_buffers)
 {
+	struct impl *this;
+	struct port *port;
+	uint32_t i;
+
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	if (!IS_VALID_PORT(node, direction, port_id))
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (!IS_VALID_PORT(this, direction, port_id))
 		return SPA_RESULT_INVALID_PORT;
 
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	/* the encoder can still use the input */
+	if (direction == SPA_DIRECTION_INPUT)
+		close_codec(this);
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &port->buffers[i];
+
+		b->outbuf = buffers[i];
+		b->outstanding = false;
+		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
+
+		if (!is_mem(this, &buffers[i]->datas[0])) {
+			spa_log_error(this->log, NAME " %p: invalid memory on buffer %p",
+				      this, buffers[i]);
+			return SPA_RESULT_ERROR;
+		}
+		if (direction == SPA_DIRECTION_OUTPUT)
+			spa_list_insert(port->free.prev, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -355,7 +765,8 @@ spa_ffmpeg_enc_node_port_alloc_buffers(struct spa_node *node,
 static int
 spa_ffmpeg_enc_node_port_set_io(struct spa_node *node,
 				enum spa_direction direction,
-				uint32_t port_id, struct spa_port_io *io)
+				uint32_t port_id,
+				struct spa_port_io *io)
 {
 	struct impl *this;
 	struct port *port;
@@ -375,56 +786,321 @@ spa_ffmpeg_enc_node_port_set_io(struct spa_node *node,
 	return SPA_RESULT_OK;
 }
 
-static int
-spa_ffmpeg_enc_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+static void recycle_buffer(struct impl *this, uint32_t id)
 {
-	if (node == NULL)
-		return SPA_RESULT_INVALID_ARGUMENTS;
+	struct port *port = &this->out_ports[0];
+	struct buffer *b = &port->buffers[id];
 
-	if (port_id != 0)
-		return SPA_RESULT_INVALID_PORT;
+	if (!b->outstanding) {
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+	b->outstanding = false;
+	spa_list_insert(port->free.prev, &b->link);
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
 
-	return SPA_RESULT_NOT_IMPLEMENTED;
+static int open_codec(struct impl *this)
+{
+	struct spa_video_info_raw *info = &this->in_ports[0].current_format.info.raw;
+	AVCodecContext *ctx;
+	int res;
+
+	if (this->context)
+		return SPA_RESULT_OK;
+
+	if ((ctx = avcodec_alloc_context3(this->codec)) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	ctx->width = info->size.width;
+	ctx->height = info->size.height;
+	ctx->pix_fmt = this->pix_fmt;
+	ctx->time_base.num = info->framerate.denom;
+	ctx->time_base.den = info->framerate.num;
+	ctx->framerate.num = info->framerate.num;
+	ctx->framerate.den = info->framerate.denom;
+	ctx->bit_rate = this->props.bitrate;
+	ctx->gop_size = this->props.gop_size;
+	ctx->max_b_frames = 0;
+	ctx->thread_count = this->props.threads;
+	if (this->props.thread_type == this->type.thread_type_frame)
+		ctx->thread_type = FF_THREAD_FRAME;
+	else if (this->props.thread_type == this->type.thread_type_slice)
+		ctx->thread_type = FF_THREAD_SLICE;
+	else
+		ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+	if ((res = avcodec_open2(ctx, this->codec, NULL)) < 0) {
+		spa_log_error(this->log, NAME " %p: can't open codec: %s", this, av_err2str(res));
+		avcodec_free_context(&ctx);
+		return SPA_RESULT_ERROR;
+	}
+	this->context = ctx;
+
+	this->copy->format = this->pix_fmt;
+	this->copy->width = ctx->width;
+	this->copy->height = ctx->height;
+	if (av_frame_get_buffer(this->copy, PLANE_ALIGN) < 0) {
+		avcodec_free_context(&this->context);
+		return SPA_RESULT_NO_MEMORY;
+	}
+
+	this->n_frames = this->n_packets = 0;
+
+	spa_log_info(this->log, NAME " %p: opened %s with %d threads", this,
+		     this->codec->name, ctx->thread_count);
+
+	return SPA_RESULT_OK;
 }
 
-static int
-spa_ffmpeg_enc_node_port_send_command(struct spa_node *node,
-				      enum spa_direction direction,
-				      uint32_t port_id, const struct spa_command *command)
+/* point the frame to the planes of an input buffer */
+static int wrap_frame(struct impl *this, struct buffer *b, AVFrame *frame)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct spa_buffer *buf = b->outbuf;
+	struct spa_data *d = buf->datas;
+	int linesizes[4], i, h = this->context->height;
+
+	memset(frame->data, 0, sizeof(frame->data));
+	memset(frame->linesize, 0, sizeof(frame->linesize));
+
+	if (buf->n_datas >= this->n_planes) {
+		for (i = 0; i < this->n_planes; i++) {
+			if (!is_mem(this, &d[i]))
+				return SPA_RESULT_ERROR;
+			frame->data[i] = SPA_MEMBER(d[i].data, d[i].chunk->offset, uint8_t);
+			frame->linesize[i] = d[i].chunk->stride;
+		}
+	} else {
+		uint8_t *p = SPA_MEMBER(d[0].data, d[0].chunk->offset, uint8_t);
+
+		/* the planes follow each other with the default 4 byte aligned strides */
+		av_image_fill_linesizes(linesizes, this->pix_fmt, this->context->width);
+		for (i = 0; i < this->n_planes; i++) {
+			int ph = (i == 1 || i == 2) ? -((-h) >> this->desc->log2_chroma_h) : h;
+
+			frame->linesize[i] = i == 0 && d[0].chunk->stride ?
+			    d[0].chunk->stride : FFALIGN(linesizes[i], 4);
+			frame->data[i] = p;
+			p += frame->linesize[i] * ph;
+		}
+		if (p > SPA_MEMBER(d[0].data, d[0].maxsize, uint8_t))
+			return SPA_RESULT_ERROR;
+	}
+	for (i = 0; i < this->n_planes; i++) {
+		if (frame->linesize[i] <= 0)
+			return SPA_RESULT_ERROR;
+	}
+	return SPA_RESULT_OK;
+}
+
+/* the input is always copied: the encoder can keep a reference on the
+ * frames it gets and the input buffer is recycled upstream after this */
+static int send_frame(struct impl *this, struct buffer *b)
+{
+	AVFrame *frame = this->frame;
+	int res;
+
+	if (wrap_frame(this, b, frame) < 0) {
+		spa_log_error(this->log, NAME " %p: invalid input buffer %d", this, b->outbuf->id);
+		return SPA_RESULT_OK;
+	}
+
+	if (av_frame_make_writable(this->copy) < 0)
+		return SPA_RESULT_NO_MEMORY;
+	av_image_copy(this->copy->data, this->copy->linesize,
+		      (const uint8_t **) frame->data, frame->linesize,
+		      this->pix_fmt, this->context->width, this->context->height);
+	frame = this->copy;
+
+	this->pts[this->n_frames % MAX_PTS] = b->h ? b->h->pts : this->n_frames;
+	frame->pts = this->n_frames;
+
+	res = avcodec_send_frame(this->context, frame);
+	if (res == AVERROR(EAGAIN))
+		return SPA_RESULT_HAVE_BUFFER;
+	this->n_frames++;
+
+	if (res < 0)
+		spa_log_warn(this->log, NAME " %p: can't encode frame: %s", this, av_err2str(res));
+
+	return SPA_RESULT_OK;
+}
+
+static int receive_packet(struct impl *this)
+{
+	struct port *port = &this->out_ports[0];
+	struct spa_port_io *output = port->io;
+	struct buffer *b;
+	struct spa_data *d;
+	AVPacket *packet = this->packet;
+	int res;
+
+	if (spa_list_is_empty(&port->free))
+		return SPA_RESULT_OUT_OF_BUFFERS;
+
+	res = avcodec_receive_packet(this->context, packet);
+	if (res == AVERROR(EAGAIN) || res == AVERROR_EOF)
+		return SPA_RESULT_NEED_BUFFER;
+	if (res < 0) {
+		spa_log_error(this->log, NAME " %p: encode error: %s", this, av_err2str(res));
+		return SPA_RESULT_ERROR;
+	}
+
+	b = spa_list_first(&port->free, struct buffer, link);
+	d = &b->outbuf->datas[0];
+
+	if (packet->size > d->maxsize) {
+		spa_log_error(this->log, NAME " %p: packet of %d bytes does not fit buffer of %d",
+			      this, packet->size, d->maxsize);
+		av_packet_unref(packet);
+		return SPA_RESULT_ERROR;
+	}
+	spa_list_remove(&b->link);
+	b->outstanding = true;
+
+	memcpy(d->data, packet->data, packet->size);
+	d->chunk->offset = 0;
+	d->chunk->size = packet->size;
+	d->chunk->stride = 0;
+
+	if (b->h) {
+		b->h->flags = (packet->flags & AV_PKT_FLAG_KEY) ? 0 : SPA_META_HEADER_FLAG_DELTA_UNIT;
+		b->h->seq = this->n_packets;
+		b->h->pts = this->pts[packet->pts % MAX_PTS];
+		b->h->dts_offset = packet->dts - packet->pts;
+	}
+	av_packet_unref(packet);
+
+	this->n_packets++;
+
+	output->buffer_id = b->outbuf->id;
+	output->status = SPA_RESULT_HAVE_BUFFER;
+
+	return SPA_RESULT_HAVE_BUFFER;
 }
 
 static int spa_ffmpeg_enc_node_process_input(struct spa_node *node)
 {
-	return SPA_RESULT_INVALID_PORT;
+	struct impl *this;
+	struct port *in_port, *out_port;
+	struct spa_port_io *input, *output;
+	int res;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = &this->out_ports[0];
+	if ((output = out_port->io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	in_port = &this->in_ports[0];
+	if ((input = in_port->io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	if (!in_port->have_format || !out_port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	if ((res = open_codec(this)) < 0)
+		return res;
+
+	if (input->status == SPA_RESULT_HAVE_BUFFER && input->buffer_id < in_port->n_buffers) {
+		/* keep the input when the encoder first wants its packets taken */
+		if ((res = send_frame(this, &in_port->buffers[input->buffer_id])) < 0)
+			return res;
+		if (res == SPA_RESULT_OK)
+			input->status = SPA_RESULT_NEED_BUFFER;
+	}
+	return receive_packet(this);
 }
 
 static int spa_ffmpeg_enc_node_process_output(struct spa_node *node)
 {
 	struct impl *this;
-	struct port *port;
-	struct spa_port_io *output;
+	struct port *in_port, *out_port;
+	struct spa_port_io *input, *output;
+	int res;
 
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
 	this = SPA_CONTAINER_OF(node, struct impl, node);
 
-	if ((output = this->out_ports[0].io) == NULL)
-		return SPA_RESULT_OK;
-
-	port = &this->out_ports[0];
+	out_port = &this->out_ports[0];
+	if ((output = out_port->io) == NULL)
+		return SPA_RESULT_ERROR;
 
-	if (!port->have_format) {
+	if (!out_port->have_format) {
 		output->status = SPA_RESULT_NO_FORMAT;
 		return SPA_RESULT_ERROR;
 	}
-	output->status = SPA_RESULT_OK;
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	/* recycle */
+	if (output->buffer_id < out_port->n_buffers) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
+	if (this->context && (res = receive_packet(this)) != SPA_RESULT_NEED_BUFFER)
+		return res;
+
+	in_port = &this->in_ports[0];
+	if ((input = in_port->io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	/* the frame that was kept can go in now */
+	if (input->status == SPA_RESULT_HAVE_BUFFER)
+		return spa_ffmpeg_enc_node_process_input(node);
+
+	input->range = output->range;
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	return SPA_RESULT_NEED_BUFFER;
+}
+
+static int
+spa_ffmpeg_enc_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this;
+	struct port *port;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	if (port_id != 0)
+		return SPA_RESULT_INVALID_PORT;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	port = &this->out_ports[port_id];
+
+	if (port->n_buffers == 0)
+		return SPA_RESULT_NO_BUFFERS;
+
+	if (buffer_id >= port->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	recycle_buffer(this, buffer_id);
 
 	return SPA_RESULT_OK;
 }
 
+static int
+spa_ffmpeg_enc_node_port_send_command(struct spa_node *node,
+				      enum spa_direction direction,
+				      uint32_t port_id,
+				      const struct spa_command *command)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
 static const struct spa_node ffmpeg_enc_node = {
 	SPA_VERSION_NODE,
 	NULL,
@@ -469,15 +1145,40 @@ spa_ffmpeg_enc_get_interface(struct spa_handle *handle, uint32_t interface_id, v
 	return SPA_RESULT_OK;
 }
 
+static int spa_ffmpeg_enc_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	if (handle == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = (struct impl *) handle;
+
+	close_codec(this);
+	av_frame_free(&this->frame);
+	av_frame_free(&this->copy);
+	av_packet_free(&this->packet);
+
+	return SPA_RESULT_OK;
+}
+
+size_t spa_ffmpeg_enc_get_size(void)
+{
+	return sizeof(struct impl);
+}
+
 int
 spa_ffmpeg_enc_init(struct spa_handle *handle,
+		    const AVCodec *codec,
 		    const struct spa_dict *info,
-		    const struct spa_support *support, uint32_t n_support)
+		    const struct spa_support *support,
+		    uint32_t n_support)
 {
 	struct impl *this;
 	uint32_t i;
 
 	handle->get_interface = spa_ffmpeg_enc_get_interface;
+	handle->clear = spa_ffmpeg_enc_clear;
 
 	this = (struct impl *) handle;
 
@@ -491,11 +1192,34 @@ spa_ffmpeg_enc_init(struct spa_handle *handle,
 		spa_log_error(this->log, "a type-map is needed");
 		return SPA_RESULT_ERROR;
 	}
+	init_type(&this->type, this->map);
+
+	this->codec = codec;
+	this->subtype = spa_ffmpeg_subtype_from_codec_id(&this->type.media_subtype_video,
+							 codec->id);
+	if (codec->type != AVMEDIA_TYPE_VIDEO || this->subtype == SPA_ID_INVALID) {
+		spa_log_error(this->log, NAME " %p: codec %s is not supported", this, codec->name);
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	this->frame = av_frame_alloc();
+	this->copy = av_frame_alloc();
+	this->packet = av_packet_alloc();
+	if (this->frame == NULL || this->copy == NULL || this->packet == NULL) {
+		av_frame_free(&this->frame);
+		av_frame_free(&this->copy);
+		av_packet_free(&this->packet);
+		return SPA_RESULT_NO_MEMORY;
+	}
 
 	this->node = ffmpeg_enc_node;
+	reset_props(this, &this->props);
 
-	this->in_ports[0].info.flags = 0;
-	this->out_ports[0].info.flags = 0;
+	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->in_ports[0].free);
+	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
+	    SPA_PORT_INFO_FLAG_NO_REF;
+	spa_list_init(&this->out_ports[0].free);
 
 	return SPA_RESULT_OK;
 }
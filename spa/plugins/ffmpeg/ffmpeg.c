@@ -1,4 +1,4 @@
-/* Spa V4l2 support
+/* Spa FFMpeg support
  * Copyright (C) 2016 Wim Taymans <wim.taymans@gmail.com>
  *
  * This library is free software; you can redistribute it and/or
@@ -18,17 +18,24 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <spa/plugin.h>
 #include <spa/node.h>
 
-#include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 
-int spa_ffmpeg_dec_init(struct spa_handle *handle, const struct spa_dict *info,
-			const struct spa_support *support, uint32_t n_support);
-int spa_ffmpeg_enc_init(struct spa_handle *handle, const struct spa_dict *info,
-			const struct spa_support *support, uint32_t n_support);
+#include "ffmpeg.h"
+
+struct ffmpeg_factory {
+	struct spa_handle_factory factory;
+	const AVCodec *codec;
+	char name[128];
+};
+
+static struct ffmpeg_factory *factories;
+static uint32_t n_factories;
 
 static int
 ffmpeg_dec_init(const struct spa_handle_factory *factory,
@@ -37,10 +44,14 @@ ffmpeg_dec_init(const struct spa_handle_factory *factory,
 		const struct spa_support *support,
 		uint32_t n_support)
 {
+	struct ffmpeg_factory *f;
+
 	if (factory == NULL || handle == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	return spa_ffmpeg_dec_init(handle, info, support, n_support);
+	f = SPA_CONTAINER_OF(factory, struct ffmpeg_factory, factory);
+
+	return spa_ffmpeg_dec_init(handle, f->codec, info, support, n_support);
 }
 
 static int
@@ -50,10 +61,14 @@ ffmpeg_enc_init(const struct spa_handle_factory *factory,
 		const struct spa_support *support,
 		uint32_t n_support)
 {
+	struct ffmpeg_factory *f;
+
 	if (factory == NULL || handle == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	return spa_ffmpeg_enc_init(handle, info, support, n_support);
+	f = SPA_CONTAINER_OF(factory, struct ffmpeg_factory, factory);
+
+	return spa_ffmpeg_enc_init(handle, f->codec, info, support, n_support);
 }
 
 static const struct spa_interface_info ffmpeg_interfaces[] = {
@@ -76,38 +91,149 @@ ffmpeg_enum_interface_info(const struct spa_handle_factory *factory,
 	return SPA_RESULT_OK;
 }
 
-int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t index)
+/* make a factory for each codec once, the factories have their own name and
+ * the handle size of the decoder or encoder */
+static int make_factories(void)
 {
-	static const AVCodec *c = NULL;
-	static int ci = 0;
-	static struct spa_handle_factory f;
-	static char name[128];
+	const AVCodec *c;
+	uint32_t i;
 
 	av_register_all();
 
-	if (index == 0) {
-		c = av_codec_next(NULL);
-		ci = 0;
+	for (c = av_codec_next(NULL); c; c = av_codec_next(c))
+		n_factories++;
+
+	if ((factories = calloc(n_factories, sizeof(struct ffmpeg_factory))) == NULL) {
+		n_factories = 0;
+		return SPA_RESULT_NO_MEMORY;
 	}
-	while (index > ci && c) {
-		c = av_codec_next(c);
-		ci++;
+
+	for (c = av_codec_next(NULL), i = 0; c && i < n_factories; c = av_codec_next(c), i++) {
+		struct ffmpeg_factory *f = &factories[i];
+		bool encoder = av_codec_is_encoder(c);
+		const struct spa_handle_factory factory = {
+			SPA_VERSION_HANDLE_FACTORY,
+			f->name,
+			NULL,
+			encoder ? spa_ffmpeg_enc_get_size() : spa_ffmpeg_dec_get_size(),
+			encoder ? ffmpeg_enc_init : ffmpeg_dec_init,
+			ffmpeg_enum_interface_info,
+		};
+
+		snprintf(f->name, sizeof(f->name), "%s_%s", encoder ? "ffenc" : "ffdec", c->name);
+		memcpy(&f->factory, &factory, sizeof(factory));
+		f->codec = c;
 	}
-	if (c == NULL)
+	return SPA_RESULT_OK;
+}
+
+int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t index)
+{
+	int res;
+
+	if (factory == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	if (factories == NULL && (res = make_factories()) < 0)
+		return res;
+
+	if (index >= n_factories)
 		return SPA_RESULT_ENUM_END;
 
-	if (av_codec_is_encoder(c)) {
-		snprintf(name, 128, "ffenc_%s", c->name);
-		f.init = ffmpeg_enc_init;
-	} else {
-		snprintf(name, 128, "ffdec_%s", c->name);
-		f.init = ffmpeg_dec_init;
+	*factory = &factories[index].factory;
+
+	return SPA_RESULT_OK;
+}
+
+#define OFF(f)	offsetof(struct spa_type_video_format, f)
+
+static const struct {
+	enum AVPixelFormat pix_fmt;
+	size_t offset;
+} pix_fmt_map[] = {
+	{ AV_PIX_FMT_YUV420P, OFF(I420) },
+	{ AV_PIX_FMT_YUVJ420P, OFF(I420) },
+	{ AV_PIX_FMT_YUV422P, OFF(Y42B) },
+	{ AV_PIX_FMT_YUVJ422P, OFF(Y42B) },
+	{ AV_PIX_FMT_YUV444P, OFF(Y444) },
+	{ AV_PIX_FMT_YUVJ444P, OFF(Y444) },
+	{ AV_PIX_FMT_NV12, OFF(NV12) },
+	{ AV_PIX_FMT_NV21, OFF(NV21) },
+	{ AV_PIX_FMT_YUYV422, OFF(YUY2) },
+	{ AV_PIX_FMT_UYVY422, OFF(UYVY) },
+	{ AV_PIX_FMT_YVYU422, OFF(YVYU) },
+	{ AV_PIX_FMT_GRAY8, OFF(GRAY8) },
+	{ AV_PIX_FMT_RGB24, OFF(RGB) },
+	{ AV_PIX_FMT_BGR24, OFF(BGR) },
+	{ AV_PIX_FMT_RGBA, OFF(RGBA) },
+	{ AV_PIX_FMT_BGRA, OFF(BGRA) },
+	{ AV_PIX_FMT_ARGB, OFF(ARGB) },
+	{ AV_PIX_FMT_ABGR, OFF(ABGR) },
+	{ AV_PIX_FMT_RGB0, OFF(RGBx) },
+	{ AV_PIX_FMT_BGR0, OFF(BGRx) },
+	{ AV_PIX_FMT_0RGB, OFF(xRGB) },
+	{ AV_PIX_FMT_0BGR, OFF(xBGR) },
+};
+
+#undef OFF
+
+uint32_t spa_ffmpeg_format_from_pix_fmt(struct spa_type_video_format *type,
+					enum AVPixelFormat pix_fmt)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(pix_fmt_map); i++) {
+		if (pix_fmt_map[i].pix_fmt == pix_fmt)
+			return *SPA_MEMBER(type, pix_fmt_map[i].offset, uint32_t);
 	}
-	f.name = name;
-	f.info = NULL;
-	f.enum_interface_info = ffmpeg_enum_interface_info;
+	return type->UNKNOWN;
+}
 
-	*factory = &f;
+enum AVPixelFormat spa_ffmpeg_pix_fmt_from_format(struct spa_type_video_format *type,
+						  uint32_t format,
+						  const enum AVPixelFormat *pix_fmts)
+{
+	uint32_t i;
+
+	if (pix_fmts) {
+		for (i = 0; pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
+			if (spa_ffmpeg_format_from_pix_fmt(type, pix_fmts[i]) == format)
+				return pix_fmts[i];
+		}
+		return AV_PIX_FMT_NONE;
+	}
+	for (i = 0; i < SPA_N_ELEMENTS(pix_fmt_map); i++) {
+		if (*SPA_MEMBER(type, pix_fmt_map[i].offset, uint32_t) == format)
+			return pix_fmt_map[i].pix_fmt;
+	}
+	return AV_PIX_FMT_NONE;
+}
 
-	return SPA_RESULT_OK;
+uint32_t spa_ffmpeg_subtype_from_codec_id(struct spa_type_media_subtype_video *type,
+					  enum AVCodecID id)
+{
+	switch (id) {
+	case AV_CODEC_ID_H264:
+		return type->h264;
+	case AV_CODEC_ID_MJPEG:
+		return type->mjpg;
+	case AV_CODEC_ID_DVVIDEO:
+		return type->dv;
+	case AV_CODEC_ID_H263:
+		return type->h263;
+	case AV_CODEC_ID_MPEG1VIDEO:
+		return type->mpeg1;
+	case AV_CODEC_ID_MPEG2VIDEO:
+		return type->mpeg2;
+	case AV_CODEC_ID_MPEG4:
+		return type->mpeg4;
+	case AV_CODEC_ID_VC1:
+		return type->vc1;
+	case AV_CODEC_ID_VP8:
+		return type->vp8;
+	case AV_CODEC_ID_VP9:
+		return type->vp9;
+	default:
+		return SPA_ID_INVALID;
+	}
 }
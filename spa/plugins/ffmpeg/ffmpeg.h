@@ -0,0 +1,52 @@
+/* Spa FFMpeg support
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_FFMPEG_H__
+#define __SPA_FFMPEG_H__
+
+#include <spa/plugin.h>
+#include <spa/format-utils.h>
+#include <spa/video/format-utils.h>
+
+#include <libavcodec/avcodec.h>
+
+size_t spa_ffmpeg_dec_get_size(void);
+int spa_ffmpeg_dec_init(struct spa_handle *handle, const AVCodec *codec,
+			const struct spa_dict *info,
+			const struct spa_support *support, uint32_t n_support);
+
+size_t spa_ffmpeg_enc_get_size(void);
+int spa_ffmpeg_enc_init(struct spa_handle *handle, const AVCodec *codec,
+			const struct spa_dict *info,
+			const struct spa_support *support, uint32_t n_support);
+
+/** the video format of \a pix_fmt, UNKNOWN when it has no raw video format */
+uint32_t spa_ffmpeg_format_from_pix_fmt(struct spa_type_video_format *type,
+					enum AVPixelFormat pix_fmt);
+
+/** the pixel format for \a format, picked from \a pix_fmts when not NULL */
+enum AVPixelFormat spa_ffmpeg_pix_fmt_from_format(struct spa_type_video_format *type,
+						  uint32_t format,
+						  const enum AVPixelFormat *pix_fmts);
+
+/** the media subtype of a video codec or SPA_ID_INVALID */
+uint32_t spa_ffmpeg_subtype_from_codec_id(struct spa_type_media_subtype_video *type,
+					  enum AVCodecID id);
+
+#endif /* __SPA_FFMPEG_H__ */
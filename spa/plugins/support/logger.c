@@ -22,6 +22,10 @@
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/eventfd.h>
 
 #include <spa/type-map.h>
@@ -39,6 +43,8 @@
 #define DEFAULT_LOG_LEVEL SPA_LOG_LEVEL_INFO
 
 #define TRACE_BUFFER (16*1024)
+#define MAX_ENTRY 1024
+#define MAX_SPEC 32
 
 struct type {
 	uint32_t log;
@@ -49,6 +55,32 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->log = spa_type_map_get_id(map, SPA_TYPE__Log);
 }
 
+/* A trace message is stored as an entry followed by the raw arguments in
+ * 64 bit words. Strings are copied after a word with their length. The
+ * format string, file and function are kept as pointers, they are
+ * expected to be string constants. */
+struct entry {
+	uint32_t size;		/* size of the entry and arguments, multiple of 8 */
+	uint32_t level;
+	uint32_t line;
+	uint32_t padding;
+	const char *file;
+	const char *func;
+	const char *fmt;
+	uint64_t time;
+};
+
+/* one ring per thread, written by that thread and read from the main loop */
+struct trace_ring {
+	struct spa_list link;
+	struct impl *impl;
+	bool exited;		/* the thread exited, free when empty */
+	uint32_t lost;		/* messages dropped because the ring was full */
+	uint32_t reported;	/* lost messages already reported */
+	struct spa_ringbuffer rb;
+	uint8_t data[TRACE_BUFFER];
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_log log;
@@ -56,13 +88,399 @@ struct impl {
 	struct type type;
 	struct spa_type_map *map;
 
-	struct spa_ringbuffer trace_rb;
-	uint8_t trace_data[TRACE_BUFFER];
+	pthread_key_t ring_key;
+	pthread_mutex_t lock;
+	struct spa_list rings;
 
 	bool have_source;
 	struct spa_source source;
 };
 
+static const char *levels[] = { "-", "E", "W", "I", "D", "T", "*T*" };
+
+enum arg_type {
+	ARG_NONE,
+	ARG_INT,
+	ARG_LONG,
+	ARG_LONG_LONG,
+	ARG_SIZE,
+	ARG_PTRDIFF,
+	ARG_INTMAX,
+	ARG_DOUBLE,
+	ARG_POINTER,
+	ARG_STRING,
+	ARG_INVALID,
+};
+
+struct spec {
+	const char *start;	/* start of the conversion, the % */
+	int len;		/* length of the conversion */
+	int n_star;		/* number of int arguments for width and precision */
+	enum arg_type type;	/* type of the argument */
+};
+
+/* find the next conversion in the format, returns NULL at the end */
+static const char *next_spec(const char *p, struct spec *spec)
+{
+	enum { LEN_NONE, LEN_L, LEN_LL, LEN_Z, LEN_T, LEN_J, LEN_BIG_L } len = LEN_NONE;
+
+	if ((p = strchr(p, '%')) == NULL)
+		return NULL;
+
+	spec->start = p++;
+	spec->n_star = 0;
+
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+	if (*p == '*') {
+		spec->n_star++;
+		p++;
+	}
+	while (*p >= '0' && *p <= '9')
+		p++;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->n_star++;
+			p++;
+		}
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+	switch (*p) {
+	case 'h':
+		p += p[1] == 'h' ? 2 : 1;
+		break;
+	case 'l':
+		if (p[1] == 'l') {
+			len = LEN_LL;
+			p++;
+		} else
+			len = LEN_L;
+		p++;
+		break;
+	case 'q':
+		len = LEN_LL;
+		p++;
+		break;
+	case 'z':
+		len = LEN_Z;
+		p++;
+		break;
+	case 't':
+		len = LEN_T;
+		p++;
+		break;
+	case 'j':
+		len = LEN_J;
+		p++;
+		break;
+	case 'L':
+		len = LEN_BIG_L;
+		p++;
+		break;
+	}
+
+	switch (*p) {
+	case '%':
+		spec->type = ARG_NONE;
+		break;
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+		switch (len) {
+		case LEN_L: spec->type = ARG_LONG; break;
+		case LEN_LL: spec->type = ARG_LONG_LONG; break;
+		case LEN_Z: spec->type = ARG_SIZE; break;
+		case LEN_T: spec->type = ARG_PTRDIFF; break;
+		case LEN_J: spec->type = ARG_INTMAX; break;
+		case LEN_BIG_L: spec->type = ARG_INVALID; break;
+		default: spec->type = ARG_INT; break;
+		}
+		break;
+	case 'c':
+		spec->type = len == LEN_NONE ? ARG_INT : ARG_INVALID;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+		spec->type = len == LEN_BIG_L ? ARG_INVALID : ARG_DOUBLE;
+		break;
+	case 's':
+		spec->type = len == LEN_NONE ? ARG_STRING : ARG_INVALID;
+		break;
+	case 'p':
+		spec->type = ARG_POINTER;
+		break;
+	default:
+		/* %n, %m, wide characters and unknown conversions */
+		spec->type = ARG_INVALID;
+		break;
+	}
+	if (*p)
+		p++;
+	spec->len = p - spec->start;
+	if (spec->len >= MAX_SPEC)
+		spec->type = ARG_INVALID;
+
+	return p;
+}
+
+/* store the arguments after the entry, returns the total size or -1 when
+ * the format can't be deferred */
+static int encode_entry(struct entry *e, const char *fmt, va_list args)
+{
+	uint64_t *words = (uint64_t *) (e + 1);
+	uint32_t n = 0, max = (MAX_ENTRY - sizeof(struct entry)) / sizeof(uint64_t);
+	struct spec spec;
+	const char *p = fmt;
+	int i;
+
+	while ((p = next_spec(p, &spec)) != NULL) {
+		if (spec.type == ARG_INVALID || n + spec.n_star + 2 > max)
+			return -1;
+
+		for (i = 0; i < spec.n_star; i++)
+			words[n++] = va_arg(args, int);
+
+		switch (spec.type) {
+		case ARG_NONE:
+			break;
+		case ARG_INT:
+			words[n++] = va_arg(args, int);
+			break;
+		case ARG_LONG:
+			words[n++] = va_arg(args, long);
+			break;
+		case ARG_LONG_LONG:
+			words[n++] = va_arg(args, long long);
+			break;
+		case ARG_SIZE:
+			words[n++] = va_arg(args, size_t);
+			break;
+		case ARG_PTRDIFF:
+			words[n++] = va_arg(args, ptrdiff_t);
+			break;
+		case ARG_INTMAX:
+			words[n++] = va_arg(args, intmax_t);
+			break;
+		case ARG_DOUBLE:
+		{
+			double d = va_arg(args, double);
+			memcpy(&words[n++], &d, sizeof(double));
+			break;
+		}
+		case ARG_POINTER:
+			words[n++] = (uintptr_t) va_arg(args, void *);
+			break;
+		case ARG_STRING:
+		{
+			const char *str = va_arg(args, const char *);
+			uint32_t len, avail = (max - n - 1) * sizeof(uint64_t);
+
+			if (str == NULL)
+				str = "(null)";
+			len = SPA_MIN(strlen(str), avail - 1);
+			words[n++] = len;
+			memcpy(&words[n], str, len);
+			((char *) &words[n])[len] = '\0';
+			n += (len + sizeof(uint64_t)) / sizeof(uint64_t);
+			break;
+		}
+		default:
+			return -1;
+		}
+	}
+	e->size = sizeof(struct entry) + n * sizeof(uint64_t);
+	return e->size;
+}
+
+static void encode_text(struct entry *e, const char *text)
+{
+	uint64_t *words = (uint64_t *) (e + 1);
+	uint32_t len = SPA_MIN(strlen(text), MAX_ENTRY - sizeof(struct entry) - sizeof(uint64_t) - 1);
+
+	e->fmt = "%s";
+	words[0] = len;
+	memcpy(&words[1], text, len);
+	((char *) &words[1])[len] = '\0';
+	e->size = sizeof(struct entry) +
+		(1 + (len + sizeof(uint64_t)) / sizeof(uint64_t)) * sizeof(uint64_t);
+}
+
+/* format an entry made with encode_entry() */
+static void decode_entry(struct entry *e, char *text, size_t size)
+{
+	uint64_t *words = (uint64_t *) (e + 1);
+	char tmp[MAX_SPEC];
+	struct spec spec;
+	const char *p = e->fmt, *last = p;
+	size_t pos = 0;
+	int star[2], n = 0, i, res;
+
+#define APPEND(...)								\
+	res = snprintf(text + pos, size - pos, __VA_ARGS__);			\
+	pos = SPA_MIN(pos + SPA_MAX(res, 0), size - 1);
+
+	text[0] = '\0';
+	while ((p = next_spec(last, &spec)) != NULL) {
+		APPEND("%.*s", (int) (spec.start - last), last);
+		last = p;
+
+		memcpy(tmp, spec.start, spec.len);
+		tmp[spec.len] = '\0';
+
+		for (i = 0; i < spec.n_star; i++)
+			star[i] = (int) words[n++];
+
+#define APPEND_ARG(val)								\
+		switch (spec.n_star) {						\
+		case 0: APPEND(tmp, val); break;				\
+		case 1: APPEND(tmp, star[0], val); break;			\
+		default: APPEND(tmp, star[0], star[1], val); break;		\
+		}
+
+		switch (spec.type) {
+		case ARG_NONE:
+			APPEND("%%");
+			break;
+		case ARG_INT:
+			APPEND_ARG((int) words[n]);
+			n++;
+			break;
+		case ARG_LONG:
+			APPEND_ARG((long) words[n]);
+			n++;
+			break;
+		case ARG_LONG_LONG:
+			APPEND_ARG((long long) words[n]);
+			n++;
+			break;
+		case ARG_SIZE:
+			APPEND_ARG((size_t) words[n]);
+			n++;
+			break;
+		case ARG_PTRDIFF:
+			APPEND_ARG((ptrdiff_t) words[n]);
+			n++;
+			break;
+		case ARG_INTMAX:
+			APPEND_ARG((intmax_t) words[n]);
+			n++;
+			break;
+		case ARG_DOUBLE:
+		{
+			double d;
+			memcpy(&d, &words[n++], sizeof(double));
+			APPEND_ARG(d);
+			break;
+		}
+		case ARG_POINTER:
+			APPEND_ARG((void *) (uintptr_t) words[n]);
+			n++;
+			break;
+		case ARG_STRING:
+		{
+			uint32_t len = words[n++];
+			APPEND_ARG((const char *) &words[n]);
+			n += (len + sizeof(uint64_t)) / sizeof(uint64_t);
+			break;
+		}
+		default:
+			break;
+		}
+#undef APPEND_ARG
+	}
+	APPEND("%s", last);
+#undef APPEND
+}
+
+static void free_ring(struct trace_ring *ring)
+{
+	spa_list_remove(&ring->link);
+	free(ring);
+}
+
+static void ring_thread_exit(void *data)
+{
+	struct trace_ring *ring = data;
+	__atomic_store_n(&ring->exited, true, __ATOMIC_RELEASE);
+}
+
+static struct trace_ring *get_ring(struct impl *impl)
+{
+	struct trace_ring *ring;
+
+	if (SPA_LIKELY((ring = pthread_getspecific(impl->ring_key)) != NULL))
+		return ring;
+
+	/* first trace message of this thread */
+	if ((ring = calloc(1, sizeof(struct trace_ring))) == NULL)
+		return NULL;
+
+	ring->impl = impl;
+	spa_ringbuffer_init(&ring->rb, TRACE_BUFFER);
+	pthread_setspecific(impl->ring_key, ring);
+
+	pthread_mutex_lock(&impl->lock);
+	spa_list_append(&impl->rings, &ring->link);
+	pthread_mutex_unlock(&impl->lock);
+
+	return ring;
+}
+
+static void
+trace_logv(struct impl *impl,
+	   enum spa_log_level level,
+	   const char *file,
+	   int line,
+	   const char *func,
+	   const char *fmt,
+	   va_list args)
+{
+	struct trace_ring *ring;
+	uint64_t buffer[MAX_ENTRY / sizeof(uint64_t)];
+	struct entry *e = (struct entry *) buffer;
+	struct timespec ts;
+	uint32_t index;
+	int32_t filled;
+	uint64_t count = 1;
+	char text[512];
+	va_list copy;
+
+	if ((ring = get_ring(impl)) == NULL)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	e->time = SPA_TIMESPEC_TO_TIME(&ts);
+	e->level = level;
+	e->file = file;
+	e->line = line;
+	e->func = func;
+	e->fmt = fmt;
+	e->padding = 0;
+
+	va_copy(copy, args);
+	if (encode_entry(e, fmt, copy) < 0) {
+		/* can't defer this format, store the formatted text */
+		vsnprintf(text, sizeof(text), fmt, args);
+		encode_text(e, text);
+	}
+	va_end(copy);
+
+	filled = spa_ringbuffer_get_write_index(&ring->rb, &index);
+	if (filled + e->size > ring->rb.size) {
+		ring->lost++;
+		return;
+	}
+	spa_ringbuffer_write_data(&ring->rb, ring->data, index & ring->rb.mask, e, e->size);
+	spa_ringbuffer_write_update(&ring->rb, index + e->size);
+
+	/* pairs with the barrier in on_trace_event, only wake up the main
+	 * loop when it could have seen an empty ring */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->rb.readindex, __ATOMIC_RELAXED) != index)
+		return;
+
+	if (write(impl->source.fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+		fprintf(stderr, "error signaling eventfd: %s\n", strerror(errno));
+}
 static void
 impl_log_logv(struct spa_log *log,
 	      enum spa_log_level level,
@@ -74,30 +492,16 @@ impl_log_logv(struct spa_log *log,
 {
 	struct impl *impl = SPA_CONTAINER_OF(log, struct impl, log);
 	char text[512], location[1024];
-	static const char *levels[] = { "-", "E", "W", "I", "D", "T", "*T*" };
-	int size;
-	bool do_trace;
 
-	if ((do_trace = (level == SPA_LOG_LEVEL_TRACE && impl->have_source)))
-		level++;
+	if (level == SPA_LOG_LEVEL_TRACE && impl->have_source) {
+		trace_logv(impl, level + 1, file, line, func, fmt, args);
+		return;
+	}
 
 	vsnprintf(text, sizeof(text), fmt, args);
-	size = snprintf(location, sizeof(location), "[%s][%s:%i %s()] %s\n",
+	snprintf(location, sizeof(location), "[%s][%s:%i %s()] %s\n",
 		levels[level], strrchr(file, '/') + 1, line, func, text);
-
-	if (SPA_UNLIKELY(do_trace)) {
-		uint32_t index;
-		uint64_t count = 1;
-
-		spa_ringbuffer_get_write_index(&impl->trace_rb, &index);
-		spa_ringbuffer_write_data(&impl->trace_rb, impl->trace_data,
-					  index & impl->trace_rb.mask, location, size);
-		spa_ringbuffer_write_update(&impl->trace_rb, index + size);
-
-		if (write(impl->source.fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-			fprintf(stderr, "error signaling eventfd: %s\n", strerror(errno));
-	} else
-		fputs(location, stderr);
+	fputs(location, stderr);
 }
 
 
@@ -115,32 +519,68 @@ impl_log_log(struct spa_log *log,
 	va_end(args);
 }
 
+/* get the oldest message of all rings */
+static struct trace_ring *peek_rings(struct impl *impl, struct entry *e)
+{
+	struct trace_ring *ring, *t, *oldest = NULL;
+	uint64_t time = UINT64_MAX;
+	struct entry head;
+	uint32_t index;
+
+	spa_list_for_each_safe(ring, t, &impl->rings, link) {
+		/* load exited before the write index, the messages the thread
+		 * wrote before it exited are then all visible below */
+		bool exited = __atomic_load_n(&ring->exited, __ATOMIC_ACQUIRE);
+
+		if (ring->lost != ring->reported) {
+			fprintf(stderr, "[W][logger] %u trace messages lost\n",
+				ring->lost - ring->reported);
+			ring->reported = ring->lost;
+		}
+		if (spa_ringbuffer_get_read_index(&ring->rb, &index) <= 0) {
+			if (exited)
+				free_ring(ring);
+			continue;
+		}
+		spa_ringbuffer_read_data(&ring->rb, ring->data, index & ring->rb.mask,
+					 &head, sizeof(struct entry));
+		if (head.time < time) {
+			time = head.time;
+			oldest = ring;
+		}
+	}
+	if (oldest) {
+		spa_ringbuffer_get_read_index(&oldest->rb, &index);
+		spa_ringbuffer_read_data(&oldest->rb, oldest->data, index & oldest->rb.mask,
+					 e, sizeof(struct entry));
+		spa_ringbuffer_read_data(&oldest->rb, oldest->data, index & oldest->rb.mask,
+					 e, e->size);
+		spa_ringbuffer_read_update(&oldest->rb, index + e->size);
+		/* pairs with the barrier in trace_logv, the next check of
+		 * the write index sees any message that did not wake us up */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+	return oldest;
+}
+
 static void on_trace_event(struct spa_source *source)
 {
 	struct impl *impl = source->data;
-	int32_t avail;
-	uint32_t index;
+	uint64_t buffer[MAX_ENTRY / sizeof(uint64_t)];
+	struct entry *e = (struct entry *) buffer;
+	char text[512];
 	uint64_t count;
 
 	if (read(source->fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
 		fprintf(stderr, "failed to read event fd: %s", strerror(errno));
 
-	while ((avail = spa_ringbuffer_get_read_index(&impl->trace_rb, &index)) > 0) {
-		uint32_t offset, first;
-
-		if (avail > impl->trace_rb.size) {
-			index += avail - impl->trace_rb.size;
-			avail = impl->trace_rb.size;
-		}
-		offset = index & impl->trace_rb.mask;
-		first = SPA_MIN(avail, impl->trace_rb.size - offset);
-
-		fwrite(impl->trace_data + offset, first, 1, stderr);
-		if (SPA_UNLIKELY(avail > first)) {
-			fwrite(impl->trace_data, avail - first, 1, stderr);
-		}
-		spa_ringbuffer_read_update(&impl->trace_rb, index + avail);
-        }
+	pthread_mutex_lock(&impl->lock);
+	while (peek_rings(impl, e)) {
+		decode_entry(e, text, sizeof(text));
+		fprintf(stderr, "[%s][%s:%i %s()] %s\n",
+			levels[e->level], strrchr(e->file, '/') + 1, e->line, e->func, text);
+	}
+	pthread_mutex_unlock(&impl->lock);
 }
 
 static const struct spa_log impl_log = {
@@ -181,6 +621,11 @@ static int impl_clear(struct spa_handle *handle)
 		close(this->source.fd);
 		this->have_source = false;
 	}
+	pthread_key_delete(this->ring_key);
+	while (!spa_list_is_empty(&this->rings))
+		free_ring(spa_list_first(&this->rings, struct trace_ring, link));
+	pthread_mutex_destroy(&this->lock);
+
 	return SPA_RESULT_OK;
 }
 
@@ -217,6 +662,10 @@ impl_init(const struct spa_handle_factory *factory,
 	}
 	init_type(&this->type, this->map);
 
+	spa_list_init(&this->rings);
+	pthread_mutex_init(&this->lock, NULL);
+	pthread_key_create(&this->ring_key, ring_thread_exit);
+
 	if (loop) {
 		this->source.func = on_trace_event;
 		this->source.data = this;
@@ -227,8 +676,6 @@ impl_init(const struct spa_handle_factory *factory,
 		this->have_source = true;
 	}
 
-	spa_ringbuffer_init(&this->trace_rb, TRACE_BUFFER);
-
 	spa_log_debug(&this->log, NAME " %p: initialized", this);
 
 	return SPA_RESULT_OK;
@@ -33,6 +33,8 @@
 #include <spa/format-builder.h>
 #include <lib/props.h>
 
+#include "load.h"
+
 #define NAME "fakesink"
 
 struct type {
@@ -41,6 +43,7 @@ struct type {
 	uint32_t format;
 	uint32_t props;
 	uint32_t prop_live;
+	struct load_type load;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
 	struct spa_type_event_node event_node;
@@ -56,6 +59,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
 	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
 	type->prop_live = spa_type_map_get_id(map, SPA_TYPE_PROPS__live);
+	load_type_map(map, &type->load);
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
 	spa_type_event_node_map(map, &type->event_node);
@@ -66,6 +70,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 
 struct props {
 	bool live;
+	struct load_props load;
 };
 
 #define MAX_BUFFERS 16
@@ -88,8 +93,9 @@ struct impl {
 	struct spa_log *log;
 	struct spa_loop *data_loop;
 
-	uint8_t props_buffer[512];
+	uint8_t props_buffer[1024];
 	struct props props;
+	struct load load;
 
 	const struct spa_node_callbacks *callbacks;
 	void *callbacks_data;
@@ -123,6 +129,7 @@ struct impl {
 static void reset_props(struct impl *this, struct props *props)
 {
 	props->live = DEFAULT_LIVE;
+	load_props_reset(&this->type.load, &props->load);
 }
 
 #define PROP(f,key,type,...)							\
@@ -152,7 +159,26 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 	spa_pod_builder_init(&b, this->props_buffer, sizeof(this->props_buffer));
 	spa_pod_builder_props(&b, &f[0], this->type.props,
 		PROP(&f[1], this->type.prop_live, SPA_POD_TYPE_BOOL,
-			this->props.live));
+			this->props.live),
+		PROP(&f[1], this->type.load.cpu_load, SPA_POD_TYPE_INT,
+			this->props.load.cpu_load),
+		PROP_EN(&f[1], this->type.load.cpu_load_type, SPA_POD_TYPE_ID, 4,
+			this->props.load.cpu_load_type,
+			this->type.load.cpu_fixed,
+			this->type.load.cpu_uniform,
+			this->type.load.cpu_normal),
+		PROP(&f[1], this->type.load.cpu_load_spread, SPA_POD_TYPE_INT,
+			this->props.load.cpu_load_spread),
+		PROP_EN(&f[1], this->type.load.memory_touch, SPA_POD_TYPE_ID, 5,
+			this->props.load.memory_touch,
+			this->type.load.touch_none,
+			this->type.load.touch_read,
+			this->type.load.touch_write,
+			this->type.load.touch_random),
+		PROP(&f[1], this->type.load.sleep, SPA_POD_TYPE_INT,
+			this->props.load.sleep),
+		PROP(&f[1], this->type.load.jitter, SPA_POD_TYPE_INT,
+			this->props.load.jitter));
 	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
 
 	return SPA_RESULT_OK;
@@ -170,7 +196,19 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 		reset_props(this, &this->props);
 	} else {
 		spa_props_query(props,
-				this->type.prop_live, SPA_POD_TYPE_BOOL, &this->props.live, 0);
+				this->type.prop_live, SPA_POD_TYPE_BOOL, &this->props.live,
+				this->type.load.cpu_load, SPA_POD_TYPE_INT,
+					&this->props.load.cpu_load,
+				this->type.load.cpu_load_type, SPA_POD_TYPE_ID,
+					&this->props.load.cpu_load_type,
+				this->type.load.cpu_load_spread, SPA_POD_TYPE_INT,
+					&this->props.load.cpu_load_spread,
+				this->type.load.memory_touch, SPA_POD_TYPE_ID,
+					&this->props.load.memory_touch,
+				this->type.load.sleep, SPA_POD_TYPE_INT,
+					&this->props.load.sleep,
+				this->type.load.jitter, SPA_POD_TYPE_INT,
+					&this->props.load.jitter, 0);
 	}
 
 	if (this->props.live)
@@ -213,6 +251,7 @@ static inline void read_timer(struct impl *this)
 
 static void render_buffer(struct impl *this, struct buffer *b)
 {
+	load_run(&this->load, &this->type.load, &this->props.load, b->outbuf);
 }
 
 static int consume_buffer(struct impl *this)
@@ -824,6 +863,7 @@ impl_init(const struct spa_handle_factory *factory,
 	this->node = impl_node;
 	this->clock = impl_clock;
 	reset_props(this, &this->props);
+	load_init(&this->load, (uintptr_t) this);
 
 	spa_list_init(&this->ready);
 
@@ -33,6 +33,8 @@
 #include <spa/format-builder.h>
 #include <lib/props.h>
 
+#include "load.h"
+
 #define NAME "fakesrc"
 
 struct type {
@@ -42,6 +44,7 @@ struct type {
 	uint32_t props;
 	uint32_t prop_live;
 	uint32_t prop_pattern;
+	struct load_type load;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
 	struct spa_type_event_node event_node;
@@ -58,6 +61,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
 	type->prop_live = spa_type_map_get_id(map, SPA_TYPE_PROPS__live);
 	type->prop_pattern = spa_type_map_get_id(map, SPA_TYPE_PROPS__patternType);
+	load_type_map(map, &type->load);
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
 	spa_type_event_node_map(map, &type->event_node);
@@ -69,6 +73,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 struct props {
 	bool live;
 	uint32_t pattern;
+	struct load_props load;
 };
 
 #define MAX_BUFFERS 16
@@ -91,8 +96,9 @@ struct impl {
 	struct spa_log *log;
 	struct spa_loop *data_loop;
 
-	uint8_t props_buffer[512];
+	uint8_t props_buffer[1024];
 	struct props props;
+	struct load load;
 
 	const struct spa_node_callbacks *callbacks;
 	void *callbacks_data;
@@ -129,6 +135,7 @@ static void reset_props(struct impl *this, struct props *props)
 {
 	props->live = DEFAULT_LIVE;
 	props->pattern = DEFAULT_PATTERN;
+	load_props_reset(&this->type.load, &props->load);
 }
 
 #define PROP(f,key,type,...)							\
@@ -161,7 +168,26 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 			this->props.live),
 		PROP_EN(&f[1], this->type.prop_pattern, SPA_POD_TYPE_ID, 1,
 			this->props.pattern,
-			this->props.pattern));
+			this->props.pattern),
+		PROP(&f[1], this->type.load.cpu_load, SPA_POD_TYPE_INT,
+			this->props.load.cpu_load),
+		PROP_EN(&f[1], this->type.load.cpu_load_type, SPA_POD_TYPE_ID, 4,
+			this->props.load.cpu_load_type,
+			this->type.load.cpu_fixed,
+			this->type.load.cpu_uniform,
+			this->type.load.cpu_normal),
+		PROP(&f[1], this->type.load.cpu_load_spread, SPA_POD_TYPE_INT,
+			this->props.load.cpu_load_spread),
+		PROP_EN(&f[1], this->type.load.memory_touch, SPA_POD_TYPE_ID, 5,
+			this->props.load.memory_touch,
+			this->type.load.touch_none,
+			this->type.load.touch_read,
+			this->type.load.touch_write,
+			this->type.load.touch_random),
+		PROP(&f[1], this->type.load.sleep, SPA_POD_TYPE_INT,
+			this->props.load.sleep),
+		PROP(&f[1], this->type.load.jitter, SPA_POD_TYPE_INT,
+			this->props.load.jitter));
 
 	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
 
@@ -181,7 +207,19 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 	} else {
 		spa_props_query(props,
 				this->type.prop_live, SPA_POD_TYPE_BOOL, &this->props.live,
-				this->type.prop_pattern, SPA_POD_TYPE_ID, &this->props.pattern, 0);
+				this->type.prop_pattern, SPA_POD_TYPE_ID, &this->props.pattern,
+				this->type.load.cpu_load, SPA_POD_TYPE_INT,
+					&this->props.load.cpu_load,
+				this->type.load.cpu_load_type, SPA_POD_TYPE_ID,
+					&this->props.load.cpu_load_type,
+				this->type.load.cpu_load_spread, SPA_POD_TYPE_INT,
+					&this->props.load.cpu_load_spread,
+				this->type.load.memory_touch, SPA_POD_TYPE_ID,
+					&this->props.load.memory_touch,
+				this->type.load.sleep, SPA_POD_TYPE_INT,
+					&this->props.load.sleep,
+				this->type.load.jitter, SPA_POD_TYPE_INT,
+					&this->props.load.jitter, 0);
 	}
 
 	if (this->props.live)
@@ -194,6 +232,7 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 
 static int fill_buffer(struct impl *this, struct buffer *b)
 {
+	load_run(&this->load, &this->type.load, &this->props.load, b->outbuf);
 	return SPA_RESULT_OK;
 }
 
@@ -862,6 +901,7 @@ impl_init(const struct spa_handle_factory *factory,
 	this->node = impl_node;
 	this->clock = impl_clock;
 	reset_props(this, &this->props);
+	load_init(&this->load, (uintptr_t) this);
 
 	spa_list_init(&this->empty);
 
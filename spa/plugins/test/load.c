@@ -0,0 +1,135 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <time.h>
+#include <errno.h>
+
+#include "load.h"
+
+#define CACHE_LINE	64
+
+void load_init(struct load *load, uint64_t seed)
+{
+	load->seed = seed ? seed : 1;
+	load->sum = 0;
+}
+
+/* xorshift64* */
+static inline uint32_t load_random(struct load *load)
+{
+	uint64_t x = load->seed;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	load->seed = x;
+
+	return (x * 0x2545F4914F6CDD1Dull) >> 32;
+}
+
+/* a uniform random number in [0, 1) */
+static inline double load_uniform(struct load *load)
+{
+	return load_random(load) / 4294967296.0;
+}
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static int64_t busy_time(struct load *load, const struct load_type *type,
+			 const struct load_props *props)
+{
+	int64_t t = props->cpu_load;
+
+	if (props->cpu_load_type == type->cpu_uniform) {
+		t += (load_uniform(load) * 2.0 - 1.0) * props->cpu_load_spread;
+	} else if (props->cpu_load_type == type->cpu_normal) {
+		/* the sum of 4 uniform numbers has a mean of 2 and a variance
+		 * of 1/3, this is close enough to a normal distribution */
+		double n = load_uniform(load) + load_uniform(load) +
+			   load_uniform(load) + load_uniform(load);
+		t += (n - 2.0) * 1.7320508 * props->cpu_load_spread;
+	}
+	return t;
+}
+
+static void busy_loop(int64_t duration)
+{
+	int64_t end = get_time() + duration;
+
+	while (get_time() < end);
+}
+
+static void touch_memory(struct load *load, const struct load_type *type,
+			 uint32_t touch, struct spa_buffer *buffer)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < buffer->n_datas; i++) {
+		struct spa_data *d = &buffer->datas[i];
+		uint8_t *p = d->data;
+		uint32_t size = d->maxsize, n_lines = size / CACHE_LINE;
+
+		if (p == NULL || size == 0)
+			continue;
+
+		if (touch == type->touch_read) {
+			for (j = 0; j < size; j += CACHE_LINE)
+				load->sum += p[j];
+		} else if (touch == type->touch_write) {
+			for (j = 0; j < size; j += CACHE_LINE)
+				p[j] = j;
+		} else if (touch == type->touch_random && n_lines > 0) {
+			for (j = 0; j < n_lines; j++)
+				load->sum += p[(load_random(load) % n_lines) * CACHE_LINE];
+		}
+	}
+}
+
+static void sleep_time(int64_t duration)
+{
+	struct timespec ts;
+
+	ts.tv_sec = duration / SPA_NSEC_PER_SEC;
+	ts.tv_nsec = duration % SPA_NSEC_PER_SEC;
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+}
+
+void load_run(struct load *load, const struct load_type *type,
+	      const struct load_props *props, struct spa_buffer *buffer)
+{
+	int64_t t;
+
+	if (buffer && props->memory_touch != type->touch_none)
+		touch_memory(load, type, props->memory_touch, buffer);
+
+	if (props->cpu_load > 0 && (t = busy_time(load, type, props)) > 0)
+		busy_loop(t);
+
+	t = props->sleep;
+	if (props->jitter > 0)
+		t += load_random(load) % (uint32_t) props->jitter;
+	if (t > 0)
+		sleep_time(t);
+}
@@ -0,0 +1,101 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_TEST_LOAD_H__
+#define __SPA_TEST_LOAD_H__
+
+#include <spa/type-map.h>
+#include <spa/buffer.h>
+#include <spa/props.h>
+
+/* Synthetic per buffer load for the fake nodes: busy looping, touching the
+ * buffer memory and sleeping. */
+
+struct load_type {
+	uint32_t cpu_load;
+	uint32_t cpu_load_type;
+	uint32_t cpu_fixed;
+	uint32_t cpu_uniform;
+	uint32_t cpu_normal;
+	uint32_t cpu_load_spread;
+	uint32_t memory_touch;
+	uint32_t touch_none;
+	uint32_t touch_read;
+	uint32_t touch_write;
+	uint32_t touch_random;
+	uint32_t sleep;
+	uint32_t jitter;
+};
+
+static inline void load_type_map(struct spa_type_map *map, struct load_type *type)
+{
+	type->cpu_load = spa_type_map_get_id(map, SPA_TYPE_PROPS__cpuLoad);
+	type->cpu_load_type = spa_type_map_get_id(map, SPA_TYPE_PROPS__cpuLoadType);
+	type->cpu_fixed = spa_type_map_get_id(map, SPA_TYPE_PROPS__cpuLoadType ":fixed");
+	type->cpu_uniform = spa_type_map_get_id(map, SPA_TYPE_PROPS__cpuLoadType ":uniform");
+	type->cpu_normal = spa_type_map_get_id(map, SPA_TYPE_PROPS__cpuLoadType ":normal");
+	type->cpu_load_spread = spa_type_map_get_id(map, SPA_TYPE_PROPS__cpuLoadSpread);
+	type->memory_touch = spa_type_map_get_id(map, SPA_TYPE_PROPS__memoryTouch);
+	type->touch_none = spa_type_map_get_id(map, SPA_TYPE_PROPS__memoryTouch ":none");
+	type->touch_read = spa_type_map_get_id(map, SPA_TYPE_PROPS__memoryTouch ":read");
+	type->touch_write = spa_type_map_get_id(map, SPA_TYPE_PROPS__memoryTouch ":write");
+	type->touch_random = spa_type_map_get_id(map, SPA_TYPE_PROPS__memoryTouch ":random");
+	type->sleep = spa_type_map_get_id(map, SPA_TYPE_PROPS__sleep);
+	type->jitter = spa_type_map_get_id(map, SPA_TYPE_PROPS__jitter);
+}
+
+struct load_props {
+	int32_t cpu_load;		/**< busy time per buffer in nsec */
+	uint32_t cpu_load_type;		/**< how the busy time is picked */
+	int32_t cpu_load_spread;	/**< max deviation (uniform) or standard
+					  *  deviation (normal) in nsec */
+	uint32_t memory_touch;		/**< how the buffer memory is accessed */
+	int32_t sleep;			/**< sleep per buffer in nsec */
+	int32_t jitter;			/**< max random extra sleep in nsec */
+};
+
+#define LOAD_DEFAULT_CPU_LOAD		0
+#define LOAD_DEFAULT_CPU_LOAD_TYPE	cpu_fixed
+#define LOAD_DEFAULT_CPU_LOAD_SPREAD	0
+#define LOAD_DEFAULT_MEMORY_TOUCH	touch_none
+#define LOAD_DEFAULT_SLEEP		0
+#define LOAD_DEFAULT_JITTER		0
+
+static inline void load_props_reset(const struct load_type *type, struct load_props *props)
+{
+	props->cpu_load = LOAD_DEFAULT_CPU_LOAD;
+	props->cpu_load_type = type->LOAD_DEFAULT_CPU_LOAD_TYPE;
+	props->cpu_load_spread = LOAD_DEFAULT_CPU_LOAD_SPREAD;
+	props->memory_touch = type->LOAD_DEFAULT_MEMORY_TOUCH;
+	props->sleep = LOAD_DEFAULT_SLEEP;
+	props->jitter = LOAD_DEFAULT_JITTER;
+}
+
+struct load {
+	uint64_t seed;
+	uint32_t sum;			/**< keeps the memory reads alive */
+};
+
+void load_init(struct load *load, uint64_t seed);
+
+/** Apply the load of \a props for one buffer, \a buffer can be NULL */
+void load_run(struct load *load, const struct load_type *type,
+	      const struct load_props *props, struct spa_buffer *buffer);
+
+#endif /* __SPA_TEST_LOAD_H__ */
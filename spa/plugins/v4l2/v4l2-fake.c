@@ -0,0 +1,791 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Frames are produced lazily from the elapsed time and the configured
+ * frame interval. Like a real driver, the sequence number also advances
+ * when there is no queued buffer to capture into. */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+
+#include <linux/videodev2.h>
+
+#include <spa/defs.h>
+#include <spa/log.h>
+
+#include "v4l2-fake.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC	0x0001U
+#endif
+
+#define FAKE_MAX_BUFFERS	32
+#define FAKE_MAX_PLANES		2
+/* mmap offset cookie of a plane, only interpreted by fake_mmap */
+#define FAKE_MMAP_STEP		(1 << 20)
+#define FAKE_MMAP_OFFSET(index,plane)	(((index) * FAKE_MAX_PLANES + (plane)) * FAKE_MMAP_STEP)
+
+#define FAKE_API_SINGLE		(1 << 0)
+#define FAKE_API_MPLANE		(1 << 1)
+
+struct fake_format {
+	uint32_t pixelformat;
+	const char *description;
+	uint32_t n_planes;
+	uint32_t apis;		/* the APIs that enumerate the format */
+};
+
+/* like many multi-planar drivers, the mplane device only has NV12 with
+ * separate planes. The single-planar API can't describe separate planes. */
+static const struct fake_format fake_formats[] = {
+	{ V4L2_PIX_FMT_NV12M, "Y/CbCr 4:2:0 (N-C)", 2, FAKE_API_MPLANE },
+	{ V4L2_PIX_FMT_YUYV, "YUYV 4:2:2", 1, FAKE_API_SINGLE | FAKE_API_MPLANE },
+	{ V4L2_PIX_FMT_NV12, "Y/CbCr 4:2:0", 1, FAKE_API_SINGLE },
+};
+
+
+static const struct v4l2_frmsize_discrete fake_sizes[] = {
+	{ 320, 240 },
+	{ 640, 480 },
+	{ 1280, 720 },
+};
+
+static const uint32_t fake_rates[] = { 30, 60, 15 };
+
+/* the format, independent of the single or multi-planar API */
+struct fake_pix {
+	uint32_t pixelformat;
+	uint32_t width;
+	uint32_t height;
+	uint32_t n_planes;
+	struct {
+		uint32_t bytesperline;
+		uint32_t sizeimage;
+	} planes[FAKE_MAX_PLANES];
+};
+
+enum fake_buffer_state {
+	FAKE_BUFFER_DEQUEUED,
+	FAKE_BUFFER_QUEUED,
+	FAKE_BUFFER_DONE,
+};
+
+struct fake_plane {
+	int memfd;
+	void *ptr;
+	unsigned long userptr;
+	uint32_t length;
+};
+
+struct fake_buffer {
+	enum fake_buffer_state state;
+	struct fake_plane planes[FAKE_MAX_PLANES];
+	struct v4l2_buffer buf;		/* filled in when the frame is captured */
+};
+
+struct fake_queue {
+	uint32_t ids[FAKE_MAX_BUFFERS];
+	uint32_t head;
+	uint32_t count;
+};
+
+struct fake_device {
+	struct spa_log *log;
+	int timerfd;
+	enum v4l2_buf_type type;
+
+	struct fake_pix pix;
+	struct v4l2_fract timeperframe;
+
+	enum v4l2_memory memory;
+	struct fake_buffer buffers[FAKE_MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct fake_queue queued;
+	struct fake_queue done;
+
+	bool streaming;
+	uint64_t start;
+	uint64_t period;
+	uint64_t frames;
+	uint32_t sequence;
+};
+
+static inline uint64_t fake_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static inline void fake_queue_push(struct fake_queue *q, uint32_t id)
+{
+	q->ids[(q->head + q->count++) % FAKE_MAX_BUFFERS] = id;
+}
+
+static inline uint32_t fake_queue_pop(struct fake_queue *q)
+{
+	uint32_t id = q->ids[q->head];
+	q->head = (q->head + 1) % FAKE_MAX_BUFFERS;
+	q->count--;
+	return id;
+}
+
+static inline bool fake_has_format(struct fake_device *dev, const struct fake_format *f)
+{
+	return f->apis & (V4L2_TYPE_IS_MULTIPLANAR(dev->type) ? FAKE_API_MPLANE : FAKE_API_SINGLE);
+}
+
+static const struct fake_format *fake_find_format(struct fake_device *dev, uint32_t pixelformat)
+{
+	int i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(fake_formats); i++) {
+		if (!fake_has_format(dev, &fake_formats[i]))
+			continue;
+		if (fake_formats[i].pixelformat == pixelformat)
+			return &fake_formats[i];
+	}
+	return NULL;
+}
+
+static const struct fake_format *fake_enum_format(struct fake_device *dev, uint32_t index)
+{
+	int i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(fake_formats); i++) {
+		if (!fake_has_format(dev, &fake_formats[i]))
+			continue;
+		if (index-- == 0)
+			return &fake_formats[i];
+	}
+	return NULL;
+}
+
+static bool fake_has_size(uint32_t width, uint32_t height)
+{
+	int i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(fake_sizes); i++) {
+		if (fake_sizes[i].width == width && fake_sizes[i].height == height)
+			return true;
+	}
+	return false;
+}
+
+static void fake_fixate_format(struct fake_device *dev, struct fake_pix *pix)
+{
+	const struct fake_format *f;
+	uint32_t w, h;
+
+	if ((f = fake_find_format(dev, pix->pixelformat)) == NULL)
+		f = fake_enum_format(dev, 0);
+	pix->pixelformat = f->pixelformat;
+	pix->n_planes = f->n_planes;
+
+	if (!fake_has_size(pix->width, pix->height)) {
+		pix->width = fake_sizes[0].width;
+		pix->height = fake_sizes[0].height;
+	}
+	w = pix->width;
+	h = pix->height;
+
+	switch (pix->pixelformat) {
+	case V4L2_PIX_FMT_NV12M:
+		pix->planes[0].bytesperline = w;
+		pix->planes[0].sizeimage = w * h;
+		pix->planes[1].bytesperline = w;
+		pix->planes[1].sizeimage = w * h / 2;
+		break;
+	case V4L2_PIX_FMT_NV12:
+		pix->planes[0].bytesperline = w;
+		pix->planes[0].sizeimage = w * h * 3 / 2;
+		break;
+	default:
+		pix->planes[0].bytesperline = w * 2;
+		pix->planes[0].sizeimage = w * 2 * h;
+		break;
+	}
+}
+
+static void fake_pix_from_v4l2(struct fake_device *dev, const struct v4l2_format *fmt,
+			       struct fake_pix *pix)
+{
+	spa_zero(*pix);
+	if (V4L2_TYPE_IS_MULTIPLANAR(dev->type)) {
+		pix->pixelformat = fmt->fmt.pix_mp.pixelformat;
+		pix->width = fmt->fmt.pix_mp.width;
+		pix->height = fmt->fmt.pix_mp.height;
+	} else {
+		pix->pixelformat = fmt->fmt.pix.pixelformat;
+		pix->width = fmt->fmt.pix.width;
+		pix->height = fmt->fmt.pix.height;
+	}
+}
+
+static void fake_pix_to_v4l2(struct fake_device *dev, const struct fake_pix *pix,
+			     struct v4l2_format *fmt)
+{
+	int i;
+
+	spa_zero(fmt->fmt);
+	if (V4L2_TYPE_IS_MULTIPLANAR(dev->type)) {
+		struct v4l2_pix_format_mplane *mp = &fmt->fmt.pix_mp;
+
+		mp->pixelformat = pix->pixelformat;
+		mp->width = pix->width;
+		mp->height = pix->height;
+		mp->field = V4L2_FIELD_NONE;
+		mp->colorspace = V4L2_COLORSPACE_SRGB;
+		mp->num_planes = pix->n_planes;
+		for (i = 0; i < pix->n_planes; i++) {
+			mp->plane_fmt[i].bytesperline = pix->planes[i].bytesperline;
+			mp->plane_fmt[i].sizeimage = pix->planes[i].sizeimage;
+		}
+	} else {
+		fmt->fmt.pix.pixelformat = pix->pixelformat;
+		fmt->fmt.pix.width = pix->width;
+		fmt->fmt.pix.height = pix->height;
+		fmt->fmt.pix.field = V4L2_FIELD_NONE;
+		fmt->fmt.pix.colorspace = V4L2_COLORSPACE_SRGB;
+		fmt->fmt.pix.bytesperline = pix->planes[0].bytesperline;
+		fmt->fmt.pix.sizeimage = pix->planes[0].sizeimage;
+	}
+}
+
+static void fake_update_timer(struct fake_device *dev)
+{
+	struct itimerspec ts;
+	uint64_t next;
+
+	spa_zero(ts);
+	if (dev->streaming) {
+		/* stay readable while there are frames to dequeue */
+		if (dev->done.count > 0)
+			next = 1;
+		else
+			next = dev->start + (dev->frames + 1) * dev->period;
+
+		ts.it_value.tv_sec = next / SPA_NSEC_PER_SEC;
+		ts.it_value.tv_nsec = next % SPA_NSEC_PER_SEC;
+	}
+	if (timerfd_settime(dev->timerfd, TFD_TIMER_ABSTIME, &ts, NULL) < 0)
+		spa_log_warn(dev->log, "v4l2-fake: can't set timer: %s", strerror(errno));
+}
+
+static void fake_capture(struct fake_device *dev, struct fake_buffer *b, uint64_t time)
+{
+	struct fake_plane *p = &b->planes[0];
+	void *data = dev->memory == V4L2_MEMORY_MMAP ? p->ptr : (void *) p->userptr;
+
+	/* only stamp the frame, filling it would dominate the measurements */
+	if (p->length >= sizeof(uint32_t))
+		*(uint32_t *) data = dev->sequence;
+
+	b->buf.sequence = dev->sequence;
+	b->buf.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+	b->buf.field = V4L2_FIELD_NONE;
+	b->buf.timestamp.tv_sec = time / SPA_NSEC_PER_SEC;
+	b->buf.timestamp.tv_usec = (time % SPA_NSEC_PER_SEC) / 1000;
+}
+
+/* capture all frames that are due, drop them when no buffer is queued */
+static void fake_produce(struct fake_device *dev)
+{
+	uint64_t now = fake_now(), due;
+
+	if (!dev->streaming || now < dev->start)
+		return;
+
+	due = (now - dev->start) / dev->period;
+
+	while (dev->frames < due) {
+		struct fake_buffer *b;
+
+		if (dev->queued.count == 0) {
+			dev->sequence += due - dev->frames;
+			dev->frames = due;
+			break;
+		}
+		dev->frames++;
+
+		b = &dev->buffers[fake_queue_pop(&dev->queued)];
+		fake_capture(dev, b, dev->start + dev->frames * dev->period);
+		dev->sequence++;
+
+		b->state = FAKE_BUFFER_DONE;
+		fake_queue_push(&dev->done, b->buf.index);
+	}
+}
+
+static int fake_fill_buffer(struct fake_device *dev, struct fake_buffer *b, struct v4l2_buffer *buf)
+{
+	struct v4l2_plane *planes = buf->m.planes;
+	uint32_t i, n_planes = buf->length;
+	bool done = b->state == FAKE_BUFFER_DONE;
+
+	if (V4L2_TYPE_IS_MULTIPLANAR(dev->type) &&
+	    (planes == NULL || n_planes < dev->pix.n_planes))
+		return -EINVAL;
+
+	*buf = b->buf;
+	buf->type = dev->type;
+	buf->memory = dev->memory;
+	if (b->state == FAKE_BUFFER_QUEUED)
+		buf->flags |= V4L2_BUF_FLAG_QUEUED;
+	else if (done)
+		buf->flags |= V4L2_BUF_FLAG_DONE;
+
+	if (V4L2_TYPE_IS_MULTIPLANAR(dev->type)) {
+		for (i = 0; i < dev->pix.n_planes; i++) {
+			struct fake_plane *p = &b->planes[i];
+
+			spa_zero(planes[i]);
+			planes[i].length = p->length;
+			planes[i].bytesused = done ? dev->pix.planes[i].sizeimage : 0;
+			if (dev->memory == V4L2_MEMORY_MMAP)
+				planes[i].m.mem_offset = FAKE_MMAP_OFFSET(b->buf.index, i);
+			else
+				planes[i].m.userptr = p->userptr;
+		}
+		buf->m.planes = planes;
+		buf->length = dev->pix.n_planes;
+	} else {
+		buf->length = b->planes[0].length;
+		buf->bytesused = done ? dev->pix.planes[0].sizeimage : 0;
+		if (dev->memory == V4L2_MEMORY_MMAP)
+			buf->m.offset = FAKE_MMAP_OFFSET(b->buf.index, 0);
+		else
+			buf->m.userptr = b->planes[0].userptr;
+	}
+	return 0;
+}
+
+static void fake_free_buffers(struct fake_device *dev)
+{
+	int i, j;
+
+	for (i = 0; i < dev->n_buffers; i++) {
+		for (j = 0; j < FAKE_MAX_PLANES; j++) {
+			struct fake_plane *p = &dev->buffers[i].planes[j];
+
+			if (p->ptr)
+				munmap(p->ptr, p->length);
+			if (p->memfd != -1)
+				close(p->memfd);
+		}
+	}
+	dev->n_buffers = 0;
+	spa_zero(dev->queued);
+	spa_zero(dev->done);
+}
+
+static int fake_alloc_plane(struct fake_plane *p, uint32_t size)
+{
+	p->length = size;
+	if ((p->memfd = syscall(SYS_memfd_create, "spa-v4l2-fake", MFD_CLOEXEC)) == -1)
+		return -errno;
+	if (ftruncate(p->memfd, size) < 0)
+		return -errno;
+	p->ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, p->memfd, 0);
+	if (p->ptr == MAP_FAILED) {
+		p->ptr = NULL;
+		return -errno;
+	}
+	return 0;
+}
+
+static int fake_reqbufs(struct fake_device *dev, struct v4l2_requestbuffers *req)
+{
+	int i, j, res;
+
+	if (req->type != dev->type ||
+	    (req->memory != V4L2_MEMORY_MMAP && req->memory != V4L2_MEMORY_USERPTR))
+		return -EINVAL;
+	if (dev->streaming)
+		return -EBUSY;
+
+	fake_free_buffers(dev);
+
+	dev->memory = req->memory;
+	req->count = SPA_MIN(req->count, FAKE_MAX_BUFFERS);
+
+	for (i = 0; i < req->count; i++) {
+		struct fake_buffer *b = &dev->buffers[i];
+
+		spa_zero(*b);
+		for (j = 0; j < FAKE_MAX_PLANES; j++)
+			b->planes[j].memfd = -1;
+		b->buf.index = i;
+		b->state = FAKE_BUFFER_DEQUEUED;
+		dev->n_buffers++;
+
+		if (dev->memory != V4L2_MEMORY_MMAP)
+			continue;
+
+		for (j = 0; j < dev->pix.n_planes; j++) {
+			if ((res = fake_alloc_plane(&b->planes[j], dev->pix.planes[j].sizeimage)) < 0) {
+				spa_log_error(dev->log, "v4l2-fake: can't allocate buffer: %s",
+					      strerror(-res));
+				fake_free_buffers(dev);
+				return -ENOMEM;
+			}
+		}
+	}
+	return 0;
+}
+
+static int fake_set_userptr(struct fake_device *dev, struct fake_buffer *b, struct v4l2_buffer *buf)
+{
+	uint32_t i;
+
+	if (!V4L2_TYPE_IS_MULTIPLANAR(dev->type)) {
+		if (buf->m.userptr == 0 || buf->length < dev->pix.planes[0].sizeimage)
+			return -EINVAL;
+		b->planes[0].userptr = buf->m.userptr;
+		b->planes[0].length = buf->length;
+		return 0;
+	}
+
+	if (buf->m.planes == NULL || buf->length < dev->pix.n_planes)
+		return -EINVAL;
+
+	for (i = 0; i < dev->pix.n_planes; i++) {
+		struct v4l2_plane *plane = &buf->m.planes[i];
+
+		if (plane->m.userptr == 0 || plane->length < dev->pix.planes[i].sizeimage)
+			return -EINVAL;
+		b->planes[i].userptr = plane->m.userptr;
+		b->planes[i].length = plane->length;
+	}
+	return 0;
+}
+
+static int fake_qbuf(struct fake_device *dev, struct v4l2_buffer *buf)
+{
+	struct fake_buffer *b;
+	int res;
+
+	if (buf->type != dev->type || buf->index >= dev->n_buffers ||
+	    buf->memory != dev->memory)
+		return -EINVAL;
+
+	b = &dev->buffers[buf->index];
+	if (b->state != FAKE_BUFFER_DEQUEUED)
+		return -EINVAL;
+
+	if (dev->memory == V4L2_MEMORY_USERPTR &&
+	    (res = fake_set_userptr(dev, b, buf)) < 0)
+		return res;
+
+	/* frames that were due before the buffer was queued are lost */
+	fake_produce(dev);
+
+	b->state = FAKE_BUFFER_QUEUED;
+	fake_queue_push(&dev->queued, buf->index);
+	fake_fill_buffer(dev, b, buf);
+
+	if (dev->streaming)
+		fake_update_timer(dev);
+
+	return 0;
+}
+
+static int fake_dqbuf(struct fake_device *dev, struct v4l2_buffer *buf)
+{
+	struct fake_buffer *b;
+	int res;
+
+	if (buf->type != dev->type || !dev->streaming || buf->memory != dev->memory)
+		return -EINVAL;
+	if (V4L2_TYPE_IS_MULTIPLANAR(dev->type) &&
+	    (buf->m.planes == NULL || buf->length < dev->pix.n_planes))
+		return -EINVAL;
+
+	fake_produce(dev);
+
+	if (dev->done.count == 0) {
+		fake_update_timer(dev);
+		return -EAGAIN;
+	}
+	b = &dev->buffers[fake_queue_pop(&dev->done)];
+	res = fake_fill_buffer(dev, b, buf);
+	b->state = FAKE_BUFFER_DEQUEUED;
+
+	fake_update_timer(dev);
+
+	return res;
+}
+
+static int fake_streamon(struct fake_device *dev)
+{
+	if (dev->streaming)
+		return 0;
+	if (dev->n_buffers == 0)
+		return -EINVAL;
+
+	dev->period = SPA_NSEC_PER_SEC * dev->timeperframe.numerator /
+	    dev->timeperframe.denominator;
+	dev->start = fake_now();
+	dev->frames = 0;
+	dev->streaming = true;
+	fake_update_timer(dev);
+
+	return 0;
+}
+
+static int fake_streamoff(struct fake_device *dev)
+{
+	int i;
+
+	/* like a driver, return all buffers to the application */
+	for (i = 0; i < dev->n_buffers; i++)
+		dev->buffers[i].state = FAKE_BUFFER_DEQUEUED;
+	spa_zero(dev->queued);
+	spa_zero(dev->done);
+
+	dev->streaming = false;
+	fake_update_timer(dev);
+
+	return 0;
+}
+
+static int fake_expbuf(struct fake_device *dev, struct v4l2_exportbuffer *exp)
+{
+	int fd;
+
+	if (exp->type != dev->type || dev->memory != V4L2_MEMORY_MMAP ||
+	    exp->index >= dev->n_buffers || exp->plane >= dev->pix.n_planes)
+		return -EINVAL;
+
+	fd = fcntl(dev->buffers[exp->index].planes[exp->plane].memfd,
+		   exp->flags & O_CLOEXEC ? F_DUPFD_CLOEXEC : F_DUPFD, 0);
+	if (fd < 0)
+		return -errno;
+
+	exp->fd = fd;
+	return 0;
+}
+
+static int fake_do_ioctl(struct fake_device *dev, int request, void *arg)
+{
+	/* the request codes are unsigned long, don't let them sign extend */
+	uint32_t cmd = request;
+
+	switch (cmd) {
+	case VIDIOC_QUERYCAP:
+	{
+		struct v4l2_capability *cap = arg;
+
+		spa_zero(*cap);
+		snprintf((char *) cap->driver, sizeof(cap->driver), "fake");
+		snprintf((char *) cap->card, sizeof(cap->card), "Fake Camera");
+		snprintf((char *) cap->bus_info, sizeof(cap->bus_info), "virtual");
+		cap->device_caps = V4L2_CAP_STREAMING |
+		    (V4L2_TYPE_IS_MULTIPLANAR(dev->type) ?
+		     V4L2_CAP_VIDEO_CAPTURE_MPLANE : V4L2_CAP_VIDEO_CAPTURE);
+		cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+		return 0;
+	}
+	case VIDIOC_ENUM_FMT:
+	{
+		struct v4l2_fmtdesc *desc = arg;
+		const struct fake_format *f;
+
+		if (desc->type != dev->type || (f = fake_enum_format(dev, desc->index)) == NULL)
+			return -EINVAL;
+
+		desc->flags = 0;
+		desc->pixelformat = f->pixelformat;
+		snprintf((char *) desc->description, sizeof(desc->description), "%s",
+			 f->description);
+		return 0;
+	}
+	case VIDIOC_ENUM_FRAMESIZES:
+	{
+		struct v4l2_frmsizeenum *size = arg;
+
+		if (fake_find_format(dev, size->pixel_format) == NULL ||
+		    size->index >= SPA_N_ELEMENTS(fake_sizes))
+			return -EINVAL;
+
+		size->type = V4L2_FRMSIZE_TYPE_DISCRETE;
+		size->discrete = fake_sizes[size->index];
+		return 0;
+	}
+	case VIDIOC_ENUM_FRAMEINTERVALS:
+	{
+		struct v4l2_frmivalenum *ival = arg;
+
+		if (fake_find_format(dev, ival->pixel_format) == NULL ||
+		    !fake_has_size(ival->width, ival->height) ||
+		    ival->index >= SPA_N_ELEMENTS(fake_rates))
+			return -EINVAL;
+
+		ival->type = V4L2_FRMIVAL_TYPE_DISCRETE;
+		ival->discrete.numerator = 1;
+		ival->discrete.denominator = fake_rates[ival->index];
+		return 0;
+	}
+	case VIDIOC_G_FMT:
+	case VIDIOC_TRY_FMT:
+	case VIDIOC_S_FMT:
+	{
+		struct v4l2_format *fmt = arg;
+		struct fake_pix pix;
+
+		if (fmt->type != dev->type)
+			return -EINVAL;
+
+		if (cmd == VIDIOC_G_FMT) {
+			pix = dev->pix;
+		} else {
+			fake_pix_from_v4l2(dev, fmt, &pix);
+			fake_fixate_format(dev, &pix);
+		}
+		if (cmd == VIDIOC_S_FMT) {
+			if (dev->n_buffers > 0)
+				return -EBUSY;
+			dev->pix = pix;
+		}
+		fake_pix_to_v4l2(dev, &pix, fmt);
+		return 0;
+	}
+	case VIDIOC_G_PARM:
+	case VIDIOC_S_PARM:
+	{
+		struct v4l2_streamparm *parm = arg;
+
+		if (parm->type != dev->type)
+			return -EINVAL;
+
+		if (cmd == VIDIOC_S_PARM) {
+			struct v4l2_fract *t = &parm->parm.capture.timeperframe;
+
+			if (dev->streaming)
+				return -EBUSY;
+			if (t->numerator != 0 && t->denominator != 0)
+				dev->timeperframe = *t;
+		}
+		spa_zero(parm->parm);
+		parm->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+		parm->parm.capture.timeperframe = dev->timeperframe;
+		return 0;
+	}
+	case VIDIOC_REQBUFS:
+		return fake_reqbufs(dev, arg);
+
+	case VIDIOC_QUERYBUF:
+	{
+		struct v4l2_buffer *buf = arg;
+
+		if (buf->type != dev->type || buf->index >= dev->n_buffers)
+			return -EINVAL;
+
+		return fake_fill_buffer(dev, &dev->buffers[buf->index], buf);
+	}
+	case VIDIOC_QBUF:
+		return fake_qbuf(dev, arg);
+
+	case VIDIOC_DQBUF:
+		return fake_dqbuf(dev, arg);
+
+	case VIDIOC_EXPBUF:
+		return fake_expbuf(dev, arg);
+
+	case VIDIOC_STREAMON:
+	case VIDIOC_STREAMOFF:
+		if (*(enum v4l2_buf_type *) arg != dev->type)
+			return -EINVAL;
+		return cmd == VIDIOC_STREAMON ? fake_streamon(dev) : fake_streamoff(dev);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+int fake_ioctl(struct fake_device *dev, int request, void *arg)
+{
+	int res;
+
+	if ((res = fake_do_ioctl(dev, request, arg)) < 0) {
+		errno = -res;
+		return -1;
+	}
+	return 0;
+}
+
+void *fake_mmap(struct fake_device *dev, size_t length, off_t offset)
+{
+	uint32_t index = offset / FAKE_MMAP_STEP / FAKE_MAX_PLANES;
+	uint32_t plane = offset / FAKE_MMAP_STEP % FAKE_MAX_PLANES;
+
+	if (dev->memory != V4L2_MEMORY_MMAP || index >= dev->n_buffers ||
+	    plane >= dev->pix.n_planes || length > dev->buffers[index].planes[plane].length) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+	return mmap(NULL, length, PROT_READ, MAP_SHARED,
+		    dev->buffers[index].planes[plane].memfd, 0);
+}
+
+struct fake_device *fake_open(struct spa_log *log, const char *options)
+{
+	struct fake_device *dev;
+
+	if ((dev = calloc(1, sizeof(struct fake_device))) == NULL)
+		return NULL;
+
+	dev->log = log;
+	dev->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (dev->timerfd == -1) {
+		free(dev);
+		return NULL;
+	}
+
+	if (strcmp(options, "mplane") == 0)
+		dev->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	else
+		dev->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	fake_fixate_format(dev, &dev->pix);
+	dev->timeperframe.numerator = 1;
+	dev->timeperframe.denominator = fake_rates[0];
+
+	return dev;
+}
+
+void fake_close(struct fake_device *dev)
+{
+	fake_free_buffers(dev);
+	close(dev->timerfd);
+	free(dev);
+}
+
+int fake_get_fd(struct fake_device *dev)
+{
+	return dev->timerfd;
+}
@@ -0,0 +1,49 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_V4L2_FAKE_H__
+#define __SPA_V4L2_FAKE_H__
+
+/* A fake capture device, used when the device property starts with
+ * "fake:". It implements the ioctls the source uses on top of a timerfd,
+ * so that the source can be tested and benchmarked without hardware.
+ * With "fake:mplane" the device only supports the multi-planar API.
+ *
+ * The fake device is only built into the test version of the plugin,
+ * libspa-v4l2-fake, which is not installed. */
+
+#include <sys/types.h>
+
+#include <spa/log.h>
+
+#define FAKE_PREFIX		"fake:"
+
+struct fake_device;
+
+struct fake_device *fake_open(struct spa_log *log, const char *options);
+void fake_close(struct fake_device *dev);
+
+/* the fd that polls like the fd of a capture device */
+int fake_get_fd(struct fake_device *dev);
+
+/* like ioctl, returns -1 and sets errno on error */
+int fake_ioctl(struct fake_device *dev, int request, void *arg);
+void *fake_mmap(struct fake_device *dev, size_t length, off_t offset);
+
+#endif /* __SPA_V4L2_FAKE_H__ */
@@ -39,16 +39,19 @@
 #define NAME "v4l2-source"
 
 static const char default_device[] = "/dev/video0";
+#define DEFAULT_LATEST_FRAME	false
 
 struct props {
 	char device[64];
 	char device_name[128];
 	int device_fd;
+	bool latest_frame;
 };
 
 static void reset_props(struct props *props)
 {
 	strncpy(props->device, default_device, 64);
+	props->latest_frame = DEFAULT_LATEST_FRAME;
 }
 
 #define MAX_BUFFERS     64
@@ -56,9 +59,11 @@ static void reset_props(struct props *props)
 struct buffer {
 	struct spa_buffer *outbuf;
 	struct spa_meta_header *h;
+	struct spa_meta_dropped *dropped;
 	bool outstanding;
 	bool allocated;
 	struct v4l2_buffer v4l2_buffer;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
 };
 
 struct type {
@@ -69,6 +74,7 @@ struct type {
 	uint32_t prop_device;
 	uint32_t prop_device_name;
 	uint32_t prop_device_fd;
+	uint32_t prop_latest_frame;
 	struct spa_type_media_type media_type;
 	struct spa_type_media_subtype media_subtype;
 	struct spa_type_media_subtype_video media_subtype_video;
@@ -91,6 +97,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->prop_device = spa_type_map_get_id(map, SPA_TYPE_PROPS__device);
 	type->prop_device_name = spa_type_map_get_id(map, SPA_TYPE_PROPS__deviceName);
 	type->prop_device_fd = spa_type_map_get_id(map, SPA_TYPE_PROPS__deviceFd);
+	type->prop_latest_frame = spa_type_map_get_id(map, SPA_TYPE_PROPS__latestFrame);
 	spa_type_media_type_map(map, &type->media_type);
 	spa_type_media_subtype_map(map, &type->media_subtype);
 	spa_type_media_subtype_video_map(map, &type->media_subtype_video);
@@ -104,6 +111,8 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	spa_type_data_map(map, &type->data);
 }
 
+struct fake_device;
+
 struct port {
 	struct spa_log *log;
 	struct spa_loop *main_loop;
@@ -123,9 +132,11 @@ struct port {
 	uint8_t format_buffer[1024];
 
 	int fd;
+	struct fake_device *fake;
 	bool opened;
 	struct v4l2_capability cap;
 	struct v4l2_format fmt;
+	uint32_t n_planes;
 	enum v4l2_buf_type type;
 	enum v4l2_memory memtype;
 
@@ -141,6 +152,9 @@ struct port {
 
 	int64_t last_ticks;
 	int64_t last_monotonic;
+
+	bool have_sequence;
+	uint32_t last_sequence;
 };
 
 struct impl {
@@ -200,7 +214,9 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 		PROP_R(&f[1], this->type.prop_device_name, -SPA_POD_TYPE_STRING,
 			this->props.device_name, sizeof(this->props.device_name)),
 		PROP_R(&f[1], this->type.prop_device_fd, SPA_POD_TYPE_INT,
-			this->props.device_fd));
+			this->props.device_fd),
+		PROP(&f[1], this->type.prop_latest_frame, SPA_POD_TYPE_BOOL,
+			this->props.latest_frame));
 	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
 
 	return SPA_RESULT_OK;
@@ -218,8 +234,12 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 		reset_props(&this->props);
 		return SPA_RESULT_OK;
 	} else {
-		spa_props_query(props, this->type.prop_device, -SPA_POD_TYPE_STRING,
-				this->props.device, sizeof(this->props.device), 0);
+		spa_props_query(props,
+				this->type.prop_device, -SPA_POD_TYPE_STRING,
+				this->props.device, sizeof(this->props.device),
+				this->type.prop_latest_frame, SPA_POD_TYPE_BOOL,
+				&this->props.latest_frame,
+				0);
 	}
 	return SPA_RESULT_OK;
 }
@@ -633,14 +653,18 @@ static int impl_node_port_enum_params(struct spa_node *node,
 
 	switch (index) {
 	case 0:
+		/* every plane gets a block of the size of the largest plane, the
+		 * stride of each plane is set on the chunks */
 		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
 			PROP(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
-				state->fmt.fmt.pix.sizeimage),
+				spa_v4l2_max_plane_size(state)),
 			PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT,
-				state->fmt.fmt.pix.bytesperline),
+				spa_v4l2_plane_stride(state, 0)),
 			PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
 				MAX_BUFFERS, 2, MAX_BUFFERS),
-			PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT, 16));
+			PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT, 16),
+			PROP(&f[1], this->type.param_alloc_buffers.blocks, SPA_POD_TYPE_INT,
+				state->n_planes));
 		break;
 
 	case 1:
@@ -651,6 +675,14 @@ static int impl_node_port_enum_params(struct spa_node *node,
 				sizeof(struct spa_meta_header)));
 		break;
 
+	case 2:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.Dropped),
+			PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				sizeof(struct spa_meta_dropped)));
+		break;
+
 	default:
 		return SPA_RESULT_NOT_IMPLEMENTED;
 	}
@@ -23,62 +23,110 @@
 #include <errno.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <stdlib.h>
 #include <poll.h>
 
+#ifdef HAVE_V4L2_FAKE
+#include "v4l2-fake.h"
+#endif
+
 static void v4l2_on_fd_events(struct spa_source *source);
 
-static int xioctl(int fd, int request, void *arg)
+static int xioctl(struct port *state, int request, void *arg)
 {
 	int err;
 
+#ifdef HAVE_V4L2_FAKE
+	if (state->fake)
+		return fake_ioctl(state->fake, request, arg);
+#endif
+
 	do {
-		err = ioctl(fd, request, arg);
+		err = ioctl(state->fd, request, arg);
 	} while (err == -1 && errno == EINTR);
 
 	return err;
 }
 
-static int spa_v4l2_open(struct impl *this)
+static void *xmmap(struct port *state, size_t length, off_t offset)
+{
+#ifdef HAVE_V4L2_FAKE
+	if (state->fake)
+		return fake_mmap(state->fake, length, offset);
+#endif
+	return mmap(NULL, length, PROT_READ, MAP_SHARED, state->fd, offset);
+}
+
+static int open_device(struct port *state, const char *device)
 {
-	struct port *state = &this->out_ports[0];
 	struct stat st;
-	struct props *props = &this->props;
+	int fd;
 
-	if (state->opened)
-		return 0;
+	if (stat(device, &st) < 0) {
+		spa_log_error(state->log, "v4l2: Cannot identify '%s': %d, %s",
+			      device, errno, strerror(errno));
+		return -1;
+	}
 
-	if (props->device[0] == '\0') {
-		spa_log_error(state->log, "v4l2: Device property not set");
+	if (!S_ISCHR(st.st_mode)) {
+		spa_log_error(state->log, "v4l2: %s is no device", device);
 		return -1;
 	}
 
-	spa_log_info(state->log, "v4l2: Playback device is '%s'", props->device);
+	fd = open(device, O_RDWR | O_NONBLOCK, 0);
 
-	if (stat(props->device, &st) < 0) {
-		spa_log_error(state->log, "v4l2: Cannot identify '%s': %d, %s",
-			      props->device, errno, strerror(errno));
+	if (fd == -1) {
+		spa_log_error(state->log, "v4l2: Cannot open '%s': %d, %s",
+			      device, errno, strerror(errno));
 		return -1;
 	}
+	return fd;
+}
 
-	if (!S_ISCHR(st.st_mode)) {
-		spa_log_error(state->log, "v4l2: %s is no device", props->device);
+static int spa_v4l2_open(struct impl *this)
+{
+	struct port *state = &this->out_ports[0];
+	struct props *props = &this->props;
+	uint32_t caps;
+
+	if (state->opened)
+		return 0;
+
+	if (props->device[0] == '\0') {
+		spa_log_error(state->log, "v4l2: Device property not set");
 		return -1;
 	}
 
-	state->fd = open(props->device, O_RDWR | O_NONBLOCK, 0);
+	spa_log_info(state->log, "v4l2: Playback device is '%s'", props->device);
 
-	if (state->fd == -1) {
-		spa_log_error(state->log, "v4l2: Cannot open '%s': %d, %s",
-			      props->device, errno, strerror(errno));
+#ifdef HAVE_V4L2_FAKE
+	if (strncmp(props->device, FAKE_PREFIX, strlen(FAKE_PREFIX)) == 0) {
+		if ((state->fake = fake_open(state->log,
+					     props->device + strlen(FAKE_PREFIX))) == NULL) {
+			spa_log_error(state->log, "v4l2: Cannot create fake device: %s",
+				      strerror(errno));
+			return -1;
+		}
+		state->fd = fake_get_fd(state->fake);
+	} else
+#endif
+	if ((state->fd = open_device(state, props->device)) == -1)
 		return -1;
-	}
 
-	if (xioctl(state->fd, VIDIOC_QUERYCAP, &state->cap) < 0) {
+	if (xioctl(state, VIDIOC_QUERYCAP, &state->cap) < 0) {
 		perror("QUERYCAP");
 		return -1;
 	}
 
-	if ((state->cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) == 0) {
+	caps = state->cap.capabilities;
+	if (caps & V4L2_CAP_DEVICE_CAPS)
+		caps = state->cap.device_caps;
+
+	if (caps & V4L2_CAP_VIDEO_CAPTURE)
+		state->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	else if (caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE)
+		state->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	else {
 		spa_log_error(state->log, "v4l2: %s is no video capture device", props->device);
 		return -1;
 	}
@@ -105,7 +153,7 @@ static int spa_v4l2_buffer_recycle(struct impl *this, uint32_t buffer_id)
 	b->outstanding = false;
 	spa_log_trace(state->log, "v4l2 %p: recycle buffer %d", this, buffer_id);
 
-	if (xioctl(state->fd, VIDIOC_QBUF, &b->v4l2_buffer) < 0) {
+	if (xioctl(state, VIDIOC_QBUF, &b->v4l2_buffer) < 0) {
 		perror("VIDIOC_QBUF");
 	}
 	return SPA_RESULT_OK;
@@ -115,7 +163,7 @@ static int spa_v4l2_clear_buffers(struct impl *this)
 {
 	struct port *state = &this->out_ports[0];
 	struct v4l2_requestbuffers reqbuf;
-	int i;
+	int i, j;
 
 	if (state->n_buffers == 0)
 		return SPA_RESULT_OK;
@@ -129,20 +177,24 @@ static int spa_v4l2_clear_buffers(struct impl *this)
 			spa_v4l2_buffer_recycle(this, i);
 		}
 		if (b->allocated) {
-			if (b->outbuf->datas[0].data)
-				munmap(b->outbuf->datas[0].data, b->outbuf->datas[0].maxsize);
-			if (b->outbuf->datas[0].fd != -1)
-				close(b->outbuf->datas[0].fd);
-			b->outbuf->datas[0].type = SPA_ID_INVALID;
+			for (j = 0; j < state->n_planes; j++) {
+				struct spa_data *d = &b->outbuf->datas[j];
+
+				if (d->data)
+					munmap(d->data, d->maxsize);
+				if (d->fd != -1)
+					close(d->fd);
+				d->type = SPA_ID_INVALID;
+			}
 		}
 	}
 
 	spa_zero(reqbuf);
-	reqbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	reqbuf.type = state->type;
 	reqbuf.memory = state->memtype;
 	reqbuf.count = 0;
 
-	if (xioctl(state->fd, VIDIOC_REQBUFS, &reqbuf) < 0) {
+	if (xioctl(state, VIDIOC_REQBUFS, &reqbuf) < 0) {
 		perror("VIDIOC_REQBUFS");
 	}
 	state->n_buffers = 0;
@@ -178,6 +230,12 @@ static int spa_v4l2_close(struct impl *this)
 
 	spa_log_info(state->log, "v4l2: close");
 
+#ifdef HAVE_V4L2_FAKE
+	if (state->fake) {
+		fake_close(state->fake);
+		state->fake = NULL;
+	} else
+#endif
 	if (close(state->fd))
 		perror("close");
 
@@ -397,6 +455,42 @@ static const struct format_info *find_format_info_by_media_type(struct type *typ
 	return NULL;
 }
 
+static bool device_has_fourcc(struct port *state, uint32_t fourcc)
+{
+	struct v4l2_fmtdesc desc;
+
+	spa_zero(desc);
+	desc.type = state->type;
+
+	while (xioctl(state, VIDIOC_ENUM_FMT, &desc) == 0) {
+		if (desc.pixelformat == fourcc)
+			return true;
+		desc.index++;
+	}
+	return false;
+}
+
+/* prefer the fourccs that the device enumerates, multi-planar devices often
+ * only support the variants with separate planes, like NV12M for NV12 */
+static const struct format_info *find_device_format_info(struct impl *this,
+							 uint32_t type,
+							 uint32_t subtype,
+							 uint32_t format)
+{
+	struct port *state = &this->out_ports[0];
+	const struct format_info *info, *first = NULL;
+	int idx = 0;
+
+	while ((info = find_format_info_by_media_type(&this->type, type, subtype, format, idx))) {
+		if (first == NULL)
+			first = info;
+		if (device_has_fourcc(state, info->fourcc))
+			return info;
+		idx = info - format_info + 1;
+	}
+	return first;
+}
+
 static uint32_t
 enum_filter_format(struct type *type, const struct spa_format *filter, uint32_t index)
 {
@@ -542,7 +636,7 @@ spa_v4l2_enum_format(struct impl *this,
 	if (index == 0) {
 		spa_zero(state->fmtdesc);
 		state->fmtdesc.index = 0;
-		state->fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		state->fmtdesc.type = state->type;
 		state->next_fmtdesc = true;
 		spa_zero(state->frmsize);
 		state->next_frmsize = true;
@@ -562,16 +656,16 @@ spa_v4l2_enum_format(struct impl *this,
 			if (video_format == this->type.video_format.UNKNOWN)
 				return SPA_RESULT_ENUM_END;
 
-			info = find_format_info_by_media_type(&this->type,
-							      filter->body.media_type.value,
-							      filter->body.media_subtype.value,
-							      video_format, 0);
+			info = find_device_format_info(this,
+						       filter->body.media_type.value,
+						       filter->body.media_subtype.value,
+						       video_format);
 			if (info == NULL)
 				goto next_fmtdesc;
 
 			state->fmtdesc.pixelformat = info->fourcc;
 		} else {
-			if ((res = xioctl(state->fd, VIDIOC_ENUM_FMT, &state->fmtdesc)) < 0) {
+			if ((res = xioctl(state, VIDIOC_ENUM_FMT, &state->fmtdesc)) < 0) {
 				if (errno != EINVAL)
 					perror("VIDIOC_ENUM_FMT");
 				return SPA_RESULT_ENUM_END;
@@ -611,7 +705,7 @@ spa_v4l2_enum_format(struct impl *this,
 			}
 		}
 	      do_frmsize:
-		if ((res = xioctl(state->fd, VIDIOC_ENUM_FRAMESIZES, &state->frmsize)) < 0) {
+		if ((res = xioctl(state, VIDIOC_ENUM_FRAMESIZES, &state->frmsize)) < 0) {
 			if (errno == EINVAL)
 				goto next_fmtdesc;
 
@@ -696,7 +790,7 @@ spa_v4l2_enum_format(struct impl *this,
 	state->frmival.index = 0;
 
 	while (true) {
-		if ((res = xioctl(state->fd, VIDIOC_ENUM_FRAMEINTERVALS, &state->frmival)) < 0) {
+		if ((res = xioctl(state, VIDIOC_ENUM_FRAMEINTERVALS, &state->frmival)) < 0) {
 			if (errno == EINVAL) {
 				state->frmsize.index++;
 				state->next_frmsize = true;
@@ -788,21 +882,42 @@ spa_v4l2_enum_format(struct impl *this,
 	return SPA_RESULT_OK;
 }
 
+static uint32_t spa_v4l2_plane_stride(struct port *state, uint32_t plane)
+{
+	if (V4L2_TYPE_IS_MULTIPLANAR(state->type))
+		return state->fmt.fmt.pix_mp.plane_fmt[plane].bytesperline;
+	return state->fmt.fmt.pix.bytesperline;
+}
+
+static uint32_t spa_v4l2_plane_size(struct port *state, uint32_t plane)
+{
+	if (V4L2_TYPE_IS_MULTIPLANAR(state->type))
+		return state->fmt.fmt.pix_mp.plane_fmt[plane].sizeimage;
+	return state->fmt.fmt.pix.sizeimage;
+}
+
+/* the size of the largest plane, all data blocks of a buffer are allocated
+ * with the same size */
+static uint32_t spa_v4l2_max_plane_size(struct port *state)
+{
+	uint32_t i, size = 0;
+
+	for (i = 0; i < state->n_planes; i++)
+		size = SPA_MAX(size, spa_v4l2_plane_size(state, i));
+	return size;
+}
+
 static int spa_v4l2_set_format(struct impl *this, struct spa_video_info *format, bool try_only)
 {
 	struct port *state = &this->out_ports[0];
 	int cmd;
-	struct v4l2_format reqfmt, fmt;
+	struct v4l2_format fmt;
 	struct v4l2_streamparm streamparm;
 	const struct format_info *info = NULL;
-	uint32_t video_format;
+	uint32_t video_format, pixelformat, width, height, n_planes;
 	struct spa_rectangle *size = NULL;
 	struct spa_fraction *framerate = NULL;
-
-	spa_zero(fmt);
-	spa_zero(streamparm);
-	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	streamparm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	bool mplane;
 
 	if (format->media_subtype == this->type.media_subtype.raw) {
 		video_format = format->info.raw.format;
@@ -821,62 +936,89 @@ static int spa_v4l2_set_format(struct impl *this, struct spa_video_info *format,
 		video_format = this->type.video_format.ENCODED;
 	}
 
-	info = find_format_info_by_media_type(&this->type,
-					      format->media_type,
-					      format->media_subtype, video_format, 0);
+	if (spa_v4l2_open(this) < 0)
+		return -1;
+
+	info = find_device_format_info(this,
+				       format->media_type,
+				       format->media_subtype, video_format);
 	if (info == NULL || size == NULL || framerate == NULL) {
 		spa_log_error(state->log, "v4l2: unknown media type %d %d %d", format->media_type,
 			      format->media_subtype, video_format);
 		return -1;
 	}
 
+	mplane = V4L2_TYPE_IS_MULTIPLANAR(state->type);
 
-	fmt.fmt.pix.pixelformat = info->fourcc;
-	fmt.fmt.pix.field = V4L2_FIELD_ANY;
-	fmt.fmt.pix.width = size->width;
-	fmt.fmt.pix.height = size->height;
+	spa_zero(fmt);
+	spa_zero(streamparm);
+	fmt.type = state->type;
+	streamparm.type = state->type;
+
+	if (mplane) {
+		fmt.fmt.pix_mp.pixelformat = info->fourcc;
+		fmt.fmt.pix_mp.field = V4L2_FIELD_ANY;
+		fmt.fmt.pix_mp.width = size->width;
+		fmt.fmt.pix_mp.height = size->height;
+	} else {
+		fmt.fmt.pix.pixelformat = info->fourcc;
+		fmt.fmt.pix.field = V4L2_FIELD_ANY;
+		fmt.fmt.pix.width = size->width;
+		fmt.fmt.pix.height = size->height;
+	}
 	streamparm.parm.capture.timeperframe.numerator = framerate->denom;
 	streamparm.parm.capture.timeperframe.denominator = framerate->num;
 
-	spa_log_info(state->log, "v4l2: set %08x %dx%d %d/%d", fmt.fmt.pix.pixelformat,
-		     fmt.fmt.pix.width, fmt.fmt.pix.height,
+	spa_log_info(state->log, "v4l2: set %08x %dx%d %d/%d", info->fourcc,
+		     size->width, size->height,
 		     streamparm.parm.capture.timeperframe.denominator,
 		     streamparm.parm.capture.timeperframe.numerator);
 
-	reqfmt = fmt;
-
-	if (spa_v4l2_open(this) < 0)
-		return -1;
-
 	cmd = try_only ? VIDIOC_TRY_FMT : VIDIOC_S_FMT;
-	if (xioctl(state->fd, cmd, &fmt) < 0) {
+	if (xioctl(state, cmd, &fmt) < 0) {
 		perror("VIDIOC_S_FMT");
 		return -1;
 	}
 
 	/* some cheap USB cam's won't accept any change */
-	if (xioctl(state->fd, VIDIOC_S_PARM, &streamparm) < 0)
+	if (xioctl(state, VIDIOC_S_PARM, &streamparm) < 0)
 		perror("VIDIOC_S_PARM");
 
-	spa_log_info(state->log, "v4l2: got %08x %dx%d %d/%d", fmt.fmt.pix.pixelformat,
-		     fmt.fmt.pix.width, fmt.fmt.pix.height,
+	if (mplane) {
+		pixelformat = fmt.fmt.pix_mp.pixelformat;
+		width = fmt.fmt.pix_mp.width;
+		height = fmt.fmt.pix_mp.height;
+		n_planes = fmt.fmt.pix_mp.num_planes;
+	} else {
+		pixelformat = fmt.fmt.pix.pixelformat;
+		width = fmt.fmt.pix.width;
+		height = fmt.fmt.pix.height;
+		n_planes = 1;
+	}
+
+	spa_log_info(state->log, "v4l2: got %08x %dx%d %d/%d, %d planes", pixelformat,
+		     width, height,
 		     streamparm.parm.capture.timeperframe.denominator,
-		     streamparm.parm.capture.timeperframe.numerator);
+		     streamparm.parm.capture.timeperframe.numerator, n_planes);
 
-	if (reqfmt.fmt.pix.pixelformat != fmt.fmt.pix.pixelformat ||
-	    reqfmt.fmt.pix.width != fmt.fmt.pix.width ||
-	    reqfmt.fmt.pix.height != fmt.fmt.pix.height)
+	if (info->fourcc != pixelformat ||
+	    size->width != width ||
+	    size->height != height)
 		return -1;
 
+	if (n_planes < 1 || n_planes > VIDEO_MAX_PLANES) {
+		spa_log_error(state->log, "v4l2: invalid number of planes %d", n_planes);
+		return -1;
+	}
+
 	if (try_only)
 		return 0;
 
-	size->width = fmt.fmt.pix.width;
-	size->height = fmt.fmt.pix.height;
 	framerate->num = streamparm.parm.capture.timeperframe.denominator;
 	framerate->denom = streamparm.parm.capture.timeperframe.numerator;
 
 	state->fmt = fmt;
+	state->n_planes = n_planes;
 	state->info.flags = (state->export_buf ? SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS : 0) |
 	    SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS | SPA_PORT_INFO_FLAG_LIVE;
 	state->info.rate = streamparm.parm.capture.timeperframe.denominator;
@@ -887,17 +1029,23 @@ static int spa_v4l2_set_format(struct impl *this, struct spa_video_info *format,
 static int mmap_read(struct impl *this)
 {
 	struct port *state = &this->out_ports[0];
-	struct v4l2_buffer buf;
+	struct v4l2_buffer buf, next;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES], next_planes[VIDEO_MAX_PLANES];
 	struct buffer *b;
 	struct spa_data *d;
 	int64_t pts;
 	struct spa_port_io *io = state->io;
+	uint32_t i, skipped = 0, stale = 0, dropped;
 
 	spa_zero(buf);
-	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.type = state->type;
 	buf.memory = state->memtype;
+	if (V4L2_TYPE_IS_MULTIPLANAR(state->type)) {
+		buf.m.planes = planes;
+		buf.length = state->n_planes;
+	}
 
-	if (xioctl(state->fd, VIDIOC_DQBUF, &buf) < 0) {
+	if (xioctl(state, VIDIOC_DQBUF, &buf) < 0) {
 		switch (errno) {
 		case EAGAIN:
 			return SPA_RESULT_ERROR;
@@ -908,6 +1056,54 @@ static int mmap_read(struct impl *this)
 		}
 	}
 
+	/* in latest-frame mode, drain the queue and give all but the newest
+	 * buffer back to the driver right away */
+	while (this->props.latest_frame) {
+		spa_zero(next);
+		next.type = state->type;
+		next.memory = state->memtype;
+		if (V4L2_TYPE_IS_MULTIPLANAR(state->type)) {
+			next.m.planes = next_planes;
+			next.length = state->n_planes;
+		}
+
+		if (xioctl(state, VIDIOC_DQBUF, &next) < 0) {
+			if (errno != EAGAIN)
+				perror("VIDIOC_DQBUF");
+			break;
+		}
+		if (xioctl(state, VIDIOC_QBUF, &state->buffers[buf.index].v4l2_buffer) < 0)
+			perror("VIDIOC_QBUF");
+
+		skipped++;
+		buf = next;
+		if (V4L2_TYPE_IS_MULTIPLANAR(state->type)) {
+			memcpy(planes, next_planes, sizeof(planes));
+			buf.m.planes = planes;
+		}
+	}
+
+	/* in latest-frame mode, the previous buffer was not consumed and is
+	 * stale now */
+	if (this->props.latest_frame &&
+	    io->status == SPA_RESULT_HAVE_BUFFER && io->buffer_id < state->n_buffers) {
+		spa_v4l2_buffer_recycle(this, io->buffer_id);
+		stale = 1;
+	}
+
+	/* prefer the sequence numbers of the driver, they also include the
+	 * frames it had to drop itself */
+	if (state->have_sequence && buf.sequence - state->last_sequence - 1 < INT32_MAX)
+		dropped = buf.sequence - state->last_sequence - 1 + stale;
+	else
+		dropped = skipped + stale;
+
+	state->last_sequence = buf.sequence;
+	state->have_sequence = true;
+
+	if (dropped > 0)
+		spa_log_trace(state->log, "v4l2 %p: dropped %u frames", this, dropped);
+
 	state->last_ticks = (int64_t) buf.timestamp.tv_sec * SPA_USEC_PER_SEC +
 			    (uint64_t) buf.timestamp.tv_usec;
 	pts = state->last_ticks * 1000;
@@ -922,14 +1118,26 @@ static int mmap_read(struct impl *this)
 		b->h->flags = 0;
 		if (buf.flags & V4L2_BUF_FLAG_ERROR)
 			b->h->flags |= SPA_META_HEADER_FLAG_CORRUPTED;
+		if (dropped > 0)
+			b->h->flags |= SPA_META_HEADER_FLAG_DISCONT;
 		b->h->seq = buf.sequence;
 		b->h->pts = pts;
 	}
+	if (b->dropped)
+		b->dropped->count = dropped;
 
 	d = b->outbuf->datas;
-	d[0].chunk->offset = 0;
-	d[0].chunk->size = buf.bytesused;
-	d[0].chunk->stride = state->fmt.fmt.pix.bytesperline;
+	if (V4L2_TYPE_IS_MULTIPLANAR(state->type)) {
+		for (i = 0; i < state->n_planes; i++) {
+			d[i].chunk->offset = buf.m.planes[i].data_offset;
+			d[i].chunk->size = buf.m.planes[i].bytesused - buf.m.planes[i].data_offset;
+			d[i].chunk->stride = spa_v4l2_plane_stride(state, i);
+		}
+	} else {
+		d[0].chunk->offset = 0;
+		d[0].chunk->size = buf.bytesused;
+		d[0].chunk->stride = spa_v4l2_plane_stride(state, 0);
+	}
 
 	b->outstanding = true;
 	io->buffer_id = b->outbuf->id;
@@ -953,11 +1161,25 @@ static void v4l2_on_fd_events(struct spa_source *source)
 		return;
 }
 
+static void init_v4l2_buffer(struct port *state, struct buffer *b, uint32_t index)
+{
+	spa_zero(b->v4l2_buffer);
+	b->v4l2_buffer.type = state->type;
+	b->v4l2_buffer.memory = state->memtype;
+	b->v4l2_buffer.index = index;
+
+	if (V4L2_TYPE_IS_MULTIPLANAR(state->type)) {
+		memset(b->planes, 0, sizeof(b->planes));
+		b->v4l2_buffer.m.planes = b->planes;
+		b->v4l2_buffer.length = state->n_planes;
+	}
+}
+
 static int spa_v4l2_use_buffers(struct impl *this, struct spa_buffer **buffers, uint32_t n_buffers)
 {
 	struct port *state = &this->out_ports[0];
 	struct v4l2_requestbuffers reqbuf;
-	int i;
+	int i, j;
 	struct spa_data *d;
 
 	if (n_buffers > 0) {
@@ -976,11 +1198,11 @@ static int spa_v4l2_use_buffers(struct impl *this, struct spa_buffer **buffers,
 	}
 
 	spa_zero(reqbuf);
-	reqbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	reqbuf.type = state->type;
 	reqbuf.memory = state->memtype;
 	reqbuf.count = n_buffers;
 
-	if (xioctl(state->fd, VIDIOC_REQBUFS, &reqbuf) < 0) {
+	if (xioctl(state, VIDIOC_REQBUFS, &reqbuf) < 0) {
 		perror("VIDIOC_REQBUFS");
 		return SPA_RESULT_ERROR;
 	}
@@ -998,24 +1220,43 @@ static int spa_v4l2_use_buffers(struct impl *this, struct spa_buffer **buffers,
 		b->outstanding = true;
 		b->allocated = false;
 		b->h = spa_buffer_find_meta(b->outbuf, this->type.meta.Header);
+		b->dropped = spa_buffer_find_meta(b->outbuf, this->type.meta.Dropped);
 
 		spa_log_info(state->log, "v4l2: import buffer %p", buffers[i]);
 
-		if (buffers[i]->n_datas < 1) {
-			spa_log_error(state->log, "v4l2: invalid memory on buffer %p", buffers[i]);
+		if (buffers[i]->n_datas < state->n_planes) {
+			spa_log_error(state->log, "v4l2: invalid memory on buffer %p, %d planes needed",
+				      buffers[i], state->n_planes);
 			return SPA_RESULT_ERROR;
 		}
 		d = buffers[i]->datas;
 
-		spa_zero(b->v4l2_buffer);
-		b->v4l2_buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		b->v4l2_buffer.memory = state->memtype;
-		b->v4l2_buffer.index = i;
+		for (j = 0; j < state->n_planes; j++) {
+			if (state->memtype == V4L2_MEMORY_USERPTR &&
+			    d[j].maxsize < spa_v4l2_plane_size(state, j)) {
+				spa_log_error(state->log, "v4l2: plane %d of buffer %p too small %u < %u",
+					      j, buffers[i], d[j].maxsize,
+					      spa_v4l2_plane_size(state, j));
+				return SPA_RESULT_ERROR;
+			}
+			d[j].chunk->stride = spa_v4l2_plane_stride(state, j);
+		}
+
+		init_v4l2_buffer(state, b, i);
 
-		if (d[0].type == this->type.data.MemPtr || d[0].type == this->type.data.MemFd) {
+		if (V4L2_TYPE_IS_MULTIPLANAR(state->type)) {
+			for (j = 0; j < state->n_planes; j++) {
+				if (state->memtype == V4L2_MEMORY_USERPTR) {
+					b->planes[j].m.userptr = (unsigned long) d[j].data;
+					b->planes[j].length = d[j].maxsize;
+				} else {
+					b->planes[j].m.fd = d[j].fd;
+				}
+			}
+		} else if (state->memtype == V4L2_MEMORY_USERPTR) {
 			b->v4l2_buffer.m.userptr = (unsigned long) d[0].data;
 			b->v4l2_buffer.length = d[0].maxsize;
-		} else if (d[0].type == this->type.data.DmaBuf) {
+		} else {
 			b->v4l2_buffer.m.fd = d[0].fd;
 		}
 		spa_v4l2_buffer_recycle(this, buffers[i]->id);
@@ -1025,6 +1266,23 @@ static int spa_v4l2_use_buffers(struct impl *this, struct spa_buffer **buffers,
 	return SPA_RESULT_OK;
 }
 
+static void clear_planes(struct spa_buffer *buffer, int n_planes)
+{
+	int i;
+
+	for (i = 0; i < n_planes; i++) {
+		struct spa_data *d = &buffer->datas[i];
+
+		if (d->data)
+			munmap(d->data, d->maxsize);
+		if (d->fd != -1)
+			close(d->fd);
+		d->data = NULL;
+		d->fd = -1;
+		d->type = SPA_ID_INVALID;
+	}
+}
+
 static int
 mmap_init(struct impl *this,
 	  struct spa_param **params,
@@ -1034,16 +1292,16 @@ mmap_init(struct impl *this,
 {
 	struct port *state = &this->out_ports[0];
 	struct v4l2_requestbuffers reqbuf;
-	int i;
+	int i = 0, j = 0;
 
 	state->memtype = V4L2_MEMORY_MMAP;
 
 	spa_zero(reqbuf);
-	reqbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	reqbuf.type = state->type;
 	reqbuf.memory = state->memtype;
 	reqbuf.count = *n_buffers;
 
-	if (xioctl(state->fd, VIDIOC_REQBUFS, &reqbuf) < 0) {
+	if (xioctl(state, VIDIOC_REQBUFS, &reqbuf) < 0) {
 		perror("VIDIOC_REQBUFS");
 		return SPA_RESULT_ERROR;
 	}
@@ -1053,7 +1311,7 @@ mmap_init(struct impl *this,
 
 	if (reqbuf.count < 2) {
 		spa_log_error(state->log, "v4l2: can't allocate enough buffers");
-		return SPA_RESULT_ERROR;
+		goto error;
 	}
 	if (state->export_buf)
 		spa_log_info(state->log, "v4l2: using EXPBUF");
@@ -1062,9 +1320,11 @@ mmap_init(struct impl *this,
 		struct buffer *b;
 		struct spa_data *d;
 
-		if (buffers[i]->n_datas < 1) {
-			spa_log_error(state->log, "v4l2: invalid buffer data");
-			return SPA_RESULT_ERROR;
+		j = 0;
+		if (buffers[i]->n_datas < state->n_planes) {
+			spa_log_error(state->log, "v4l2: invalid buffer data, %d planes needed",
+				      state->n_planes);
+			goto error;
 		}
 
 		b = &state->buffers[i];
@@ -1072,49 +1332,57 @@ mmap_init(struct impl *this,
 		b->outstanding = true;
 		b->allocated = true;
 		b->h = spa_buffer_find_meta(b->outbuf, this->type.meta.Header);
+		b->dropped = spa_buffer_find_meta(b->outbuf, this->type.meta.Dropped);
 
-		spa_zero(b->v4l2_buffer);
-		b->v4l2_buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		b->v4l2_buffer.memory = state->memtype;
-		b->v4l2_buffer.index = i;
+		init_v4l2_buffer(state, b, i);
 
-		if (xioctl(state->fd, VIDIOC_QUERYBUF, &b->v4l2_buffer) < 0) {
+		if (xioctl(state, VIDIOC_QUERYBUF, &b->v4l2_buffer) < 0) {
 			perror("VIDIOC_QUERYBUF");
-			return SPA_RESULT_ERROR;
+			goto error;
 		}
 
 		d = buffers[i]->datas;
-		d[0].mapoffset = 0;
-		d[0].maxsize = b->v4l2_buffer.length;
-		d[0].chunk->offset = 0;
-		d[0].chunk->size = b->v4l2_buffer.length;
-		d[0].chunk->stride = state->fmt.fmt.pix.bytesperline;
-
-		if (state->export_buf) {
-			struct v4l2_exportbuffer expbuf;
-
-			spa_zero(expbuf);
-			expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-			expbuf.index = i;
-			expbuf.flags = O_CLOEXEC | O_RDONLY;
-			if (xioctl(state->fd, VIDIOC_EXPBUF, &expbuf) < 0) {
-				perror("VIDIOC_EXPBUF");
-				continue;
+		for (j = 0; j < state->n_planes; j++) {
+			uint32_t length, offset;
+
+			if (V4L2_TYPE_IS_MULTIPLANAR(state->type)) {
+				length = b->planes[j].length;
+				offset = b->planes[j].m.mem_offset;
+			} else {
+				length = b->v4l2_buffer.length;
+				offset = b->v4l2_buffer.m.offset;
 			}
-			d[0].type = this->type.data.DmaBuf;
-			d[0].fd = expbuf.fd;
-			d[0].data = NULL;
-		} else {
-			d[0].type = this->type.data.MemPtr;
-			d[0].fd = -1;
-			d[0].data = mmap(NULL,
-					 b->v4l2_buffer.length,
-					 PROT_READ, MAP_SHARED,
-					 state->fd,
-					 b->v4l2_buffer.m.offset);
-			if (d[0].data == MAP_FAILED) {
-				perror("mmap");
-				continue;
+
+			d[j].mapoffset = 0;
+			d[j].maxsize = length;
+			d[j].chunk->offset = 0;
+			d[j].chunk->size = length;
+			d[j].chunk->stride = spa_v4l2_plane_stride(state, j);
+
+			if (state->export_buf) {
+				struct v4l2_exportbuffer expbuf;
+
+				spa_zero(expbuf);
+				expbuf.type = state->type;
+				expbuf.index = i;
+				expbuf.plane = j;
+				expbuf.flags = O_CLOEXEC | O_RDONLY;
+				if (xioctl(state, VIDIOC_EXPBUF, &expbuf) < 0) {
+					perror("VIDIOC_EXPBUF");
+					goto error;
+				}
+				d[j].type = this->type.data.DmaBuf;
+				d[j].fd = expbuf.fd;
+				d[j].data = NULL;
+			} else {
+				d[j].type = this->type.data.MemPtr;
+				d[j].fd = -1;
+				d[j].data = xmmap(state, length, offset);
+				if (d[j].data == MAP_FAILED) {
+					d[j].data = NULL;
+					perror("mmap");
+					goto error;
+				}
 			}
 		}
 		spa_v4l2_buffer_recycle(this, i);
@@ -1122,6 +1390,18 @@ mmap_init(struct impl *this,
 	state->n_buffers = reqbuf.count;
 
 	return SPA_RESULT_OK;
+
+      error:
+	/* unmap the planes of this buffer and of all buffers before it */
+	clear_planes(buffers[i], j);
+	while (--i >= 0)
+		clear_planes(buffers[i], state->n_planes);
+
+	reqbuf.count = 0;
+	if (xioctl(state, VIDIOC_REQBUFS, &reqbuf) < 0)
+		perror("VIDIOC_REQBUFS");
+
+	return SPA_RESULT_ERROR;
 }
 
 static int userptr_init(struct impl *this)
@@ -1168,12 +1448,13 @@ static int spa_v4l2_stream_on(struct impl *this)
 	if (state->started)
 		return SPA_RESULT_OK;
 
-	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	if (xioctl(state->fd, VIDIOC_STREAMON, &type) < 0) {
+	type = state->type;
+	if (xioctl(state, VIDIOC_STREAMON, &type) < 0) {
 		spa_log_error(this->log, "VIDIOC_STREAMON: %s", strerror(errno));
 		return SPA_RESULT_ERROR;
 	}
 	state->started = true;
+	state->have_sequence = false;
 
 	return SPA_RESULT_OK;
 }
@@ -1189,8 +1470,8 @@ static int spa_v4l2_stream_off(struct impl *this)
 
 	spa_v4l2_port_set_enabled(this, false);
 
-	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	if (xioctl(state->fd, VIDIOC_STREAMOFF, &type) < 0) {
+	type = state->type;
+	if (xioctl(state, VIDIOC_STREAMOFF, &type) < 0) {
 		spa_log_error(this->log, "VIDIOC_STREAMOFF: %s", strerror(errno));
 		return SPA_RESULT_ERROR;
 	}
@@ -1199,7 +1480,7 @@ static int spa_v4l2_stream_off(struct impl *this)
 
 		b = &state->buffers[i];
 		if (!b->outstanding)
-			if (xioctl(state->fd, VIDIOC_QBUF, &b->v4l2_buffer) < 0)
+			if (xioctl(state, VIDIOC_QBUF, &b->v4l2_buffer) < 0)
 				spa_log_warn(this->log, "VIDIOC_QBUF: %s", strerror(errno));
 	}
 	state->started = false;
@@ -0,0 +1,154 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <arm_neon.h>
+
+#include "convert-ops.h"
+
+/* the high half of the 32 bit products, like pmulhw */
+static inline int16x8_t mulhi(int16x8_t a, int16_t c)
+{
+	int32x4_t lo = vmull_n_s16(vget_low_s16(a), c);
+	int32x4_t hi = vmull_n_s16(vget_high_s16(a), c);
+
+	return vcombine_s16(vshrn_n_s32(lo, 16), vshrn_n_s32(hi, 16));
+}
+
+#define MULHI(a,c)	mulhi(a, c)
+
+static inline int16x8_t widen(uint8x8_t v)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(v));
+}
+
+static inline void
+yuv_to_rgb_8(uint8x8_t *r, uint8x8_t *g, uint8x8_t *b, uint8x8_t y8, uint8x8_t u8, uint8x8_t v8)
+{
+	int16x8_t y = vshlq_n_s16(vsubq_s16(widen(y8), vdupq_n_s16(16)), 7);
+	int16x8_t u = vshlq_n_s16(vsubq_s16(widen(u8), vdupq_n_s16(128)), 7);
+	int16x8_t v = vshlq_n_s16(vsubq_s16(widen(v8), vdupq_n_s16(128)), 7);
+
+	y = vaddq_s16(MULHI(y, CONV_Y_TO_RGB), vdupq_n_s16(CONV_YUV_BIAS));
+	*r = vqmovun_s16(vshrq_n_s16(vaddq_s16(y, MULHI(v, CONV_V_TO_R)), CONV_YUV_SHIFT));
+	*g = vqmovun_s16(vshrq_n_s16(vaddq_s16(vaddq_s16(y, MULHI(u, CONV_U_TO_G)),
+					       MULHI(v, CONV_V_TO_G)), CONV_YUV_SHIFT));
+	*b = vqmovun_s16(vshrq_n_s16(vaddq_s16(y, MULHI(u, CONV_U_TO_B)), CONV_YUV_SHIFT));
+}
+
+static void yuv_to_rgb_neon(uint8_t *dst, const uint8_t *src, int n_pixels)
+{
+	int i;
+
+	for (i = 0; i + 16 <= n_pixels; i += 16, src += 64, dst += 64) {
+		uint8x16x4_t p = vld4q_u8(src);
+		uint8x8_t rl, gl, bl, rh, gh, bh;
+
+		yuv_to_rgb_8(&rl, &gl, &bl, vget_low_u8(p.val[1]),
+			     vget_low_u8(p.val[2]), vget_low_u8(p.val[3]));
+		yuv_to_rgb_8(&rh, &gh, &bh, vget_high_u8(p.val[1]),
+			     vget_high_u8(p.val[2]), vget_high_u8(p.val[3]));
+		p.val[1] = vcombine_u8(rl, rh);
+		p.val[2] = vcombine_u8(gl, gh);
+		p.val[3] = vcombine_u8(bl, bh);
+		vst4q_u8(dst, p);
+	}
+	video_convert_yuv_to_rgb_c(dst, src, n_pixels - i);
+}
+
+static inline void
+rgb_to_yuv_8(uint8x8_t *y, uint8x8_t *u, uint8x8_t *v, uint8x8_t r8, uint8x8_t g8, uint8x8_t b8)
+{
+	int16x8_t r = vshlq_n_s16(widen(r8), 7);
+	int16x8_t g = vshlq_n_s16(widen(g8), 7);
+	int16x8_t b = vshlq_n_s16(widen(b8), 7);
+	int16x8_t bias = vdupq_n_s16(CONV_RGB_BIAS);
+
+	*y = vqmovun_s16(vaddq_s16(vshrq_n_s16(vaddq_s16(vaddq_s16(MULHI(r, CONV_R_TO_Y),
+								   MULHI(g, CONV_G_TO_Y)),
+							 vaddq_s16(MULHI(b, CONV_B_TO_Y), bias)),
+					       CONV_RGB_SHIFT), vdupq_n_s16(16)));
+	*u = vqmovun_s16(vaddq_s16(vshrq_n_s16(vaddq_s16(vaddq_s16(MULHI(r, CONV_R_TO_U),
+								   MULHI(g, CONV_G_TO_U)),
+							 vaddq_s16(MULHI(b, CONV_B_TO_U), bias)),
+					       CONV_RGB_SHIFT), vdupq_n_s16(128)));
+	*v = vqmovun_s16(vaddq_s16(vshrq_n_s16(vaddq_s16(vaddq_s16(MULHI(r, CONV_R_TO_V),
+								   MULHI(g, CONV_G_TO_V)),
+							 vaddq_s16(MULHI(b, CONV_B_TO_V), bias)),
+					       CONV_RGB_SHIFT), vdupq_n_s16(128)));
+}
+
+static void rgb_to_yuv_neon(uint8_t *dst, const uint8_t *src, int n_pixels)
+{
+	int i;
+
+	for (i = 0; i + 16 <= n_pixels; i += 16, src += 64, dst += 64) {
+		uint8x16x4_t p = vld4q_u8(src);
+		uint8x8_t yl, ul, vl, yh, uh, vh;
+
+		rgb_to_yuv_8(&yl, &ul, &vl, vget_low_u8(p.val[1]),
+			     vget_low_u8(p.val[2]), vget_low_u8(p.val[3]));
+		rgb_to_yuv_8(&yh, &uh, &vh, vget_high_u8(p.val[1]),
+			     vget_high_u8(p.val[2]), vget_high_u8(p.val[3]));
+		p.val[1] = vcombine_u8(yl, yh);
+		p.val[2] = vcombine_u8(ul, uh);
+		p.val[3] = vcombine_u8(vl, vh);
+		vst4q_u8(dst, p);
+	}
+	video_convert_rgb_to_yuv_c(dst, src, n_pixels - i);
+}
+
+static void blend_neon(uint8_t *dst, const uint8_t *a, const uint8_t *b, int frac, int n_bytes)
+{
+	int i;
+
+	for (i = 0; i + 16 <= n_bytes; i += 16) {
+		uint8x16_t va = vld1q_u8(a + i), vb = vld1q_u8(b + i);
+		int16x8_t alo = widen(vget_low_u8(va)), ahi = widen(vget_high_u8(va));
+		int16x8_t blo = widen(vget_low_u8(vb)), bhi = widen(vget_high_u8(vb));
+
+		alo = vaddq_s16(alo, vshrq_n_s16(vmulq_n_s16(vsubq_s16(blo, alo), frac),
+						 CONV_BLEND_SHIFT));
+		ahi = vaddq_s16(ahi, vshrq_n_s16(vmulq_n_s16(vsubq_s16(bhi, ahi), frac),
+						 CONV_BLEND_SHIFT));
+		vst1q_u8(dst + i, vcombine_u8(vqmovun_s16(alo), vqmovun_s16(ahi)));
+	}
+	video_convert_blend_c(dst + i, a + i, b + i, frac, n_bytes - i);
+}
+
+static void split_neon(uint8_t *even, uint8_t *odd, const uint8_t *src, int n_pairs)
+{
+	int i;
+
+	for (i = 0; i + 16 <= n_pairs; i += 16, src += 32) {
+		uint8x16x2_t p = vld2q_u8(src);
+
+		vst1q_u8(even + i, p.val[0]);
+		vst1q_u8(odd + i, p.val[1]);
+	}
+	video_convert_split_c(even + i, odd + i, src, n_pairs - i);
+}
+
+void video_convert_ops_neon(struct video_convert_ops *ops)
+{
+	ops->name = "neon";
+	ops->yuv_to_rgb = yuv_to_rgb_neon;
+	ops->rgb_to_yuv = rgb_to_yuv_neon;
+	ops->blend = blend_neon;
+	ops->split = split_neon;
+}
@@ -0,0 +1,83 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_VIDEO_CONVERT_OPS_H__
+#define __SPA_VIDEO_CONVERT_OPS_H__
+
+#include <stdint.h>
+
+/* The kernels work on rows of 4 byte pixels, A,Y,U,V or A,R,G,B. The
+ * matrix uses BT.601 with studio swing. Every product is computed like a
+ * signed 16 bit multiply that keeps the high half, on components that are
+ * shifted up by 7 bits, so that the SIMD versions give the same result as
+ * the C version. The sum of the products has CONV_*_SHIFT fraction bits and
+ * is rounded with CONV_*_BIAS before the fraction is dropped. */
+#define CONV_MULHI(a,b)		(((int32_t)(a) * (b)) >> 16)
+
+/* coefficients in 1/8192 units, the sum has 4 fraction bits */
+#define CONV_YUV_SHIFT		4
+#define CONV_YUV_BIAS		(1 << (CONV_YUV_SHIFT - 1))
+#define CONV_Y_TO_RGB		9539	/* 1.164 */
+#define CONV_V_TO_R		13075	/* 1.596 */
+#define CONV_U_TO_G		-3209	/* -0.392 */
+#define CONV_V_TO_G		-6660	/* -0.813 */
+#define CONV_U_TO_B		16525	/* 2.017 */
+
+/* coefficients in 1/32768 units, the sum has 6 fraction bits. The chroma
+ * coefficients add up to 0 so that gray has no color. */
+#define CONV_RGB_SHIFT		6
+#define CONV_RGB_BIAS		(1 << (CONV_RGB_SHIFT - 1))
+#define CONV_R_TO_Y		8414	/* 0.257 */
+#define CONV_G_TO_Y		16519	/* 0.504 */
+#define CONV_B_TO_Y		3208	/* 0.098 */
+#define CONV_R_TO_U		-4857	/* -0.148 */
+#define CONV_G_TO_U		-9535	/* -0.291 */
+#define CONV_B_TO_U		14392	/* 0.439 */
+#define CONV_R_TO_V		14392	/* 0.439 */
+#define CONV_G_TO_V		-12051	/* -0.368 */
+#define CONV_B_TO_V		-2341	/* -0.071 */
+
+/* the fraction of the blend is in 1/128 units */
+#define CONV_BLEND_SHIFT	7
+#define CONV_BLEND_ONE		(1 << CONV_BLEND_SHIFT)
+
+typedef void (*convert_matrix_func_t) (uint8_t *dst, const uint8_t *src, int n_pixels);
+typedef void (*convert_blend_func_t) (uint8_t *dst, const uint8_t *a, const uint8_t *b,
+				      int frac, int n_bytes);
+typedef void (*convert_split_func_t) (uint8_t *even, uint8_t *odd, const uint8_t *src,
+				      int n_pairs);
+
+struct video_convert_ops {
+	const char *name;
+	convert_matrix_func_t yuv_to_rgb;	/**< AYUV to ARGB */
+	convert_matrix_func_t rgb_to_yuv;	/**< ARGB to AYUV */
+	convert_blend_func_t blend;		/**< a + (b - a) * frac */
+	convert_split_func_t split;		/**< the even and odd bytes in 2 rows */
+};
+
+void video_convert_yuv_to_rgb_c(uint8_t *dst, const uint8_t *src, int n_pixels);
+void video_convert_rgb_to_yuv_c(uint8_t *dst, const uint8_t *src, int n_pixels);
+void video_convert_blend_c(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+			   int frac, int n_bytes);
+void video_convert_split_c(uint8_t *even, uint8_t *odd, const uint8_t *src, int n_pairs);
+
+void video_convert_ops_sse2(struct video_convert_ops *ops);
+void video_convert_ops_neon(struct video_convert_ops *ops);
+
+#endif /* __SPA_VIDEO_CONVERT_OPS_H__ */
@@ -0,0 +1,154 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <emmintrin.h>
+
+#include "convert-ops.h"
+
+/* the components of 8 pixels as 16 bit values */
+static inline void
+unpack_8(const uint8_t *src, __m128i *c0, __m128i *c1, __m128i *c2, __m128i *c3)
+{
+	__m128i p0 = _mm_loadu_si128((const __m128i *) src);
+	__m128i p1 = _mm_loadu_si128((const __m128i *) (src + 16));
+	__m128i mask = _mm_set1_epi32(0xff);
+
+	*c0 = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+	*c1 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+			      _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+	*c2 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+			      _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+	*c3 = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+}
+
+/* clamp and interleave the components of 8 pixels */
+static inline void
+pack_8(uint8_t *dst, __m128i c0, __m128i c1, __m128i c2, __m128i c3)
+{
+	__m128i zero = _mm_setzero_si128(), max = _mm_set1_epi16(255);
+	__m128i lo, hi;
+
+	c1 = _mm_min_epi16(_mm_max_epi16(c1, zero), max);
+	c2 = _mm_min_epi16(_mm_max_epi16(c2, zero), max);
+	c3 = _mm_min_epi16(_mm_max_epi16(c3, zero), max);
+
+	lo = _mm_or_si128(c0, _mm_slli_epi16(c1, 8));
+	hi = _mm_or_si128(c2, _mm_slli_epi16(c3, 8));
+
+	_mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(lo, hi));
+	_mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi16(lo, hi));
+}
+
+#define MULHI(a,c)	_mm_mulhi_epi16(a, _mm_set1_epi16(c))
+
+static void yuv_to_rgb_sse2(uint8_t *dst, const uint8_t *src, int n_pixels)
+{
+	int i;
+	__m128i a, y, u, v, r, g, b;
+
+	for (i = 0; i + 8 <= n_pixels; i += 8, src += 32, dst += 32) {
+		unpack_8(src, &a, &y, &u, &v);
+		y = _mm_slli_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), 7);
+		u = _mm_slli_epi16(_mm_sub_epi16(u, _mm_set1_epi16(128)), 7);
+		v = _mm_slli_epi16(_mm_sub_epi16(v, _mm_set1_epi16(128)), 7);
+
+		y = _mm_add_epi16(MULHI(y, CONV_Y_TO_RGB), _mm_set1_epi16(CONV_YUV_BIAS));
+		r = _mm_add_epi16(y, MULHI(v, CONV_V_TO_R));
+		g = _mm_add_epi16(_mm_add_epi16(y, MULHI(u, CONV_U_TO_G)), MULHI(v, CONV_V_TO_G));
+		b = _mm_add_epi16(y, MULHI(u, CONV_U_TO_B));
+		r = _mm_srai_epi16(r, CONV_YUV_SHIFT);
+		g = _mm_srai_epi16(g, CONV_YUV_SHIFT);
+		b = _mm_srai_epi16(b, CONV_YUV_SHIFT);
+
+		pack_8(dst, a, r, g, b);
+	}
+	video_convert_yuv_to_rgb_c(dst, src, n_pixels - i);
+}
+
+static void rgb_to_yuv_sse2(uint8_t *dst, const uint8_t *src, int n_pixels)
+{
+	int i;
+	__m128i a, y, u, v, r, g, b, bias = _mm_set1_epi16(CONV_RGB_BIAS);
+
+	for (i = 0; i + 8 <= n_pixels; i += 8, src += 32, dst += 32) {
+		unpack_8(src, &a, &r, &g, &b);
+		r = _mm_slli_epi16(r, 7);
+		g = _mm_slli_epi16(g, 7);
+		b = _mm_slli_epi16(b, 7);
+
+		y = _mm_add_epi16(_mm_add_epi16(MULHI(r, CONV_R_TO_Y), MULHI(g, CONV_G_TO_Y)),
+				  _mm_add_epi16(MULHI(b, CONV_B_TO_Y), bias));
+		u = _mm_add_epi16(_mm_add_epi16(MULHI(r, CONV_R_TO_U), MULHI(g, CONV_G_TO_U)),
+				  _mm_add_epi16(MULHI(b, CONV_B_TO_U), bias));
+		v = _mm_add_epi16(_mm_add_epi16(MULHI(r, CONV_R_TO_V), MULHI(g, CONV_G_TO_V)),
+				  _mm_add_epi16(MULHI(b, CONV_B_TO_V), bias));
+		y = _mm_add_epi16(_mm_srai_epi16(y, CONV_RGB_SHIFT), _mm_set1_epi16(16));
+		u = _mm_add_epi16(_mm_srai_epi16(u, CONV_RGB_SHIFT), _mm_set1_epi16(128));
+		v = _mm_add_epi16(_mm_srai_epi16(v, CONV_RGB_SHIFT), _mm_set1_epi16(128));
+
+		pack_8(dst, a, y, u, v);
+	}
+	video_convert_rgb_to_yuv_c(dst, src, n_pixels - i);
+}
+
+static void blend_sse2(uint8_t *dst, const uint8_t *a, const uint8_t *b, int frac, int n_bytes)
+{
+	int i;
+	__m128i zero = _mm_setzero_si128(), f = _mm_set1_epi16(frac);
+
+	for (i = 0; i + 16 <= n_bytes; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *) (b + i));
+		__m128i alo = _mm_unpacklo_epi8(va, zero), ahi = _mm_unpackhi_epi8(va, zero);
+		__m128i blo = _mm_unpacklo_epi8(vb, zero), bhi = _mm_unpackhi_epi8(vb, zero);
+
+		alo = _mm_add_epi16(alo, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(blo, alo), f),
+							CONV_BLEND_SHIFT));
+		ahi = _mm_add_epi16(ahi, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(bhi, ahi), f),
+							CONV_BLEND_SHIFT));
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(alo, ahi));
+	}
+	video_convert_blend_c(dst + i, a + i, b + i, frac, n_bytes - i);
+}
+
+static void split_sse2(uint8_t *even, uint8_t *odd, const uint8_t *src, int n_pairs)
+{
+	int i;
+	__m128i mask = _mm_set1_epi16(0xff);
+
+	for (i = 0; i + 16 <= n_pairs; i += 16, src += 32) {
+		__m128i s0 = _mm_loadu_si128((const __m128i *) src);
+		__m128i s1 = _mm_loadu_si128((const __m128i *) (src + 16));
+
+		_mm_storeu_si128((__m128i *) (even + i),
+				 _mm_packus_epi16(_mm_and_si128(s0, mask), _mm_and_si128(s1, mask)));
+		_mm_storeu_si128((__m128i *) (odd + i),
+				 _mm_packus_epi16(_mm_srli_epi16(s0, 8), _mm_srli_epi16(s1, 8)));
+	}
+	video_convert_split_c(even + i, odd + i, src, n_pairs - i);
+}
+
+void video_convert_ops_sse2(struct video_convert_ops *ops)
+{
+	ops->name = "sse2";
+	ops->yuv_to_rgb = yuv_to_rgb_sse2;
+	ops->rgb_to_yuv = rgb_to_yuv_sse2;
+	ops->blend = blend_sse2;
+	ops->split = split_sse2;
+}
@@ -0,0 +1,942 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "convert.h"
+#include "convert-ops.h"
+
+#define ROUND_UP_2(n)	(((n) + 1) & ~1)
+#define ROUND_UP_4(n)	(((n) + 3) & ~3)
+#define ROUND_UP_8(n)	(((n) + 7) & ~7)
+#define ROUND_UP_16(n)	(((n) + 15) & ~15)
+
+#define CLAMP_U8(v)	((v) < 0 ? 0 : (v) > 255 ? 255 : (v))
+
+enum family {
+	FAMILY_YUV,
+	FAMILY_RGB,
+};
+
+struct format_info;
+
+typedef void (*unpack_func_t) (const struct format_info *info, uint8_t *dst,
+			       const struct video_convert_frame *src, int y, int x, int width);
+typedef void (*pack_func_t) (const struct format_info *info, struct video_convert_frame *dst,
+			     int y, int x, const uint8_t *src, int width);
+
+/* Every format is unpacked to and packed from rows of 4 byte pixels, A,Y,U,V
+ * for the YUV family and A,R,G,B for the RGB family. The rows start at pixel
+ * x, which is even for the formats with subsampled chroma. */
+struct format_info {
+	enum video_convert_format format;
+	enum family family;
+	uint32_t n_planes;
+	int bpp;		/**< bytes per pixel in the first plane */
+	int hsub;		/**< horizontal chroma subsampling, as a shift */
+	int vsub;		/**< vertical chroma subsampling, as a shift */
+	int8_t offs[4];		/**< byte offset of A and the components in a packed pixel,
+				  *  the plane of the components for planar formats, the
+				  *  offset in the chroma pair for semi-planar formats */
+	unpack_func_t unpack;
+	pack_func_t pack;
+};
+
+static void unpack_packed(const struct format_info *info, uint8_t *dst,
+			  const struct video_convert_frame *src, int y, int x, int width)
+{
+	const uint8_t *s = src->data[0] + y * src->stride[0] + x * info->bpp;
+	int i, bpp = info->bpp, a = info->offs[0], c0 = info->offs[1], c1 = info->offs[2], c2 = info->offs[3];
+
+	for (i = 0; i < width; i++, s += bpp, dst += 4) {
+		dst[0] = a < 0 ? 0xff : s[a];
+		dst[1] = s[c0];
+		dst[2] = s[c1];
+		dst[3] = s[c2];
+	}
+}
+
+static void pack_packed(const struct format_info *info, struct video_convert_frame *dst,
+			int y, int x, const uint8_t *src, int width)
+{
+	uint8_t *d = dst->data[0] + y * dst->stride[0] + x * info->bpp;
+	int i, bpp = info->bpp, a = info->offs[0], c0 = info->offs[1], c1 = info->offs[2], c2 = info->offs[3];
+
+	for (i = 0; i < width; i++, d += bpp, src += 4) {
+		if (bpp == 4)
+			d[a < 0 ? 6 - c0 - c1 - c2 : a] = a < 0 ? 0xff : src[0];
+		d[c0] = src[1];
+		d[c1] = src[2];
+		d[c2] = src[3];
+	}
+}
+
+static void unpack_422(const struct format_info *info, uint8_t *dst,
+		       const struct video_convert_frame *src, int y, int x, int width)
+{
+	const uint8_t *s = src->data[0] + y * src->stride[0] + x * 2;
+	int i, oy = info->offs[1], ou = info->offs[2], ov = info->offs[3];
+
+	for (i = 0; i < width; i += 2, s += 4, dst += 8) {
+		dst[0] = 0xff;
+		dst[1] = s[oy];
+		dst[2] = s[ou];
+		dst[3] = s[ov];
+		if (i + 1 < width) {
+			dst[4] = 0xff;
+			dst[5] = s[oy + 2];
+			dst[6] = s[ou];
+			dst[7] = s[ov];
+		}
+	}
+}
+
+static void pack_422(const struct format_info *info, struct video_convert_frame *dst,
+		     int y, int x, const uint8_t *src, int width)
+{
+	uint8_t *d = dst->data[0] + y * dst->stride[0] + x * 2;
+	int i, oy = info->offs[1], ou = info->offs[2], ov = info->offs[3];
+
+	for (i = 0; i < width; i += 2, d += 4, src += 8) {
+		if (i + 1 < width) {
+			d[oy] = src[1];
+			d[oy + 2] = src[5];
+			d[ou] = (src[2] + src[6] + 1) >> 1;
+			d[ov] = (src[3] + src[7] + 1) >> 1;
+		} else {
+			d[oy] = d[oy + 2] = src[1];
+			d[ou] = src[2];
+			d[ov] = src[3];
+		}
+	}
+}
+
+static void unpack_planar(const struct format_info *info, uint8_t *dst,
+			  const struct video_convert_frame *src, int y, int x, int width)
+{
+	int cy = y >> info->vsub, hsub = info->hsub, cx = x >> hsub, i;
+	const uint8_t *sy = src->data[0] + y * src->stride[0] + x;
+	const uint8_t *su = src->data[info->offs[2]] + cy * src->stride[info->offs[2]] + cx;
+	const uint8_t *sv = src->data[info->offs[3]] + cy * src->stride[info->offs[3]] + cx;
+
+	for (i = 0; i < width; i++, dst += 4) {
+		dst[0] = 0xff;
+		dst[1] = sy[i];
+		dst[2] = su[i >> hsub];
+		dst[3] = sv[i >> hsub];
+	}
+}
+
+static void pack_planar(const struct format_info *info, struct video_convert_frame *dst,
+			int y, int x, const uint8_t *src, int width)
+{
+	int cy = y >> info->vsub, cx = x >> info->hsub, i;
+	uint8_t *dy = dst->data[0] + y * dst->stride[0] + x;
+	uint8_t *du = dst->data[info->offs[2]] + cy * dst->stride[info->offs[2]] + cx;
+	uint8_t *dv = dst->data[info->offs[3]] + cy * dst->stride[info->offs[3]] + cx;
+
+	for (i = 0; i < width; i++)
+		dy[i] = src[i * 4 + 1];
+
+	/* 4:2:0 chroma is taken from the even rows */
+	if (y & ((1 << info->vsub) - 1))
+		return;
+
+	if (info->hsub == 0) {
+		for (i = 0; i < width; i++, src += 4) {
+			du[i] = src[2];
+			dv[i] = src[3];
+		}
+	} else {
+		for (i = 0; i < width; i += 2, src += 8) {
+			if (i + 1 < width) {
+				du[i >> 1] = (src[2] + src[6] + 1) >> 1;
+				dv[i >> 1] = (src[3] + src[7] + 1) >> 1;
+			} else {
+				du[i >> 1] = src[2];
+				dv[i >> 1] = src[3];
+			}
+		}
+	}
+}
+
+static void unpack_semi_planar(const struct format_info *info, uint8_t *dst,
+			       const struct video_convert_frame *src, int y, int x, int width)
+{
+	const uint8_t *sy = src->data[0] + y * src->stride[0] + x;
+	const uint8_t *suv = src->data[1] + (y >> 1) * src->stride[1] + x;
+	int i, ou = info->offs[2], ov = info->offs[3];
+
+	for (i = 0; i < width; i++, dst += 4) {
+		dst[0] = 0xff;
+		dst[1] = sy[i];
+		dst[2] = suv[(i & ~1) + ou];
+		dst[3] = suv[(i & ~1) + ov];
+	}
+}
+
+static void pack_semi_planar(const struct format_info *info, struct video_convert_frame *dst,
+			     int y, int x, const uint8_t *src, int width)
+{
+	uint8_t *dy = dst->data[0] + y * dst->stride[0] + x;
+	uint8_t *duv = dst->data[1] + (y >> 1) * dst->stride[1] + x;
+	int i, ou = info->offs[2], ov = info->offs[3];
+
+	for (i = 0; i < width; i++)
+		dy[i] = src[i * 4 + 1];
+
+	if (y & 1)
+		return;
+
+	for (i = 0; i < width; i += 2, src += 8, duv += 2) {
+		if (i + 1 < width) {
+			duv[ou] = (src[2] + src[6] + 1) >> 1;
+			duv[ov] = (src[3] + src[7] + 1) >> 1;
+		} else {
+			duv[ou] = src[2];
+			duv[ov] = src[3];
+		}
+	}
+}
+
+static void unpack_gray(const struct format_info *info, uint8_t *dst,
+			const struct video_convert_frame *src, int y, int x, int width)
+{
+	const uint8_t *s = src->data[0] + y * src->stride[0] + x;
+	int i;
+
+	for (i = 0; i < width; i++, dst += 4) {
+		dst[0] = 0xff;
+		dst[1] = s[i];
+		dst[2] = dst[3] = 128;
+	}
+}
+
+static void pack_gray(const struct format_info *info, struct video_convert_frame *dst,
+		      int y, int x, const uint8_t *src, int width)
+{
+	uint8_t *d = dst->data[0] + y * dst->stride[0] + x;
+	int i;
+
+	for (i = 0; i < width; i++)
+		d[i] = src[i * 4 + 1];
+}
+
+#define PACKED(f,fam,bpp,a,c0,c1,c2)	\
+	{ VIDEO_CONVERT_FORMAT_ ##f, fam, 1, bpp, 0, 0, { a, c0, c1, c2 }, unpack_packed, pack_packed }
+#define P422(f,y,u,v)			\
+	{ VIDEO_CONVERT_FORMAT_ ##f, FAMILY_YUV, 1, 2, 1, 0, { -1, y, u, v }, unpack_422, pack_422 }
+#define PLANAR(f,hs,vs,u,v)		\
+	{ VIDEO_CONVERT_FORMAT_ ##f, FAMILY_YUV, 3, 1, hs, vs, { -1, 0, u, v }, unpack_planar, pack_planar }
+#define SEMI(f,u,v)			\
+	{ VIDEO_CONVERT_FORMAT_ ##f, FAMILY_YUV, 2, 1, 1, 1, { -1, 0, u, v }, unpack_semi_planar, pack_semi_planar }
+
+static const struct format_info format_infos[] = {
+	PLANAR(I420, 1, 1, 1, 2),
+	PLANAR(YV12, 1, 1, 2, 1),
+	PLANAR(Y42B, 1, 0, 1, 2),
+	PLANAR(Y444, 0, 0, 1, 2),
+	SEMI(NV12, 0, 1),
+	SEMI(NV21, 1, 0),
+	P422(YUY2, 0, 1, 3),
+	P422(UYVY, 1, 0, 2),
+	P422(YVYU, 0, 3, 1),
+	PACKED(AYUV, FAMILY_YUV, 4, 0, 1, 2, 3),
+	{ VIDEO_CONVERT_FORMAT_GRAY8, FAMILY_YUV, 1, 1, 0, 0, { -1, 0, -1, -1 }, unpack_gray, pack_gray },
+	PACKED(RGBx, FAMILY_RGB, 4, -1, 0, 1, 2),
+	PACKED(BGRx, FAMILY_RGB, 4, -1, 2, 1, 0),
+	PACKED(xRGB, FAMILY_RGB, 4, -1, 1, 2, 3),
+	PACKED(xBGR, FAMILY_RGB, 4, -1, 3, 2, 1),
+	PACKED(RGBA, FAMILY_RGB, 4, 3, 0, 1, 2),
+	PACKED(BGRA, FAMILY_RGB, 4, 3, 2, 1, 0),
+	PACKED(ARGB, FAMILY_RGB, 4, 0, 1, 2, 3),
+	PACKED(ABGR, FAMILY_RGB, 4, 0, 3, 2, 1),
+	PACKED(RGB, FAMILY_RGB, 3, -1, 0, 1, 2),
+	PACKED(BGR, FAMILY_RGB, 3, -1, 2, 1, 0),
+};
+
+static const struct format_info *find_format_info(enum video_convert_format format)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(format_infos); i++) {
+		if (format_infos[i].format == format)
+			return &format_infos[i];
+	}
+	return NULL;
+}
+
+/* the bytes of a row of plane \a plane that hold pixels */
+static int plane_row_bytes(const struct format_info *info, uint32_t plane, int width)
+{
+	if (plane == 0)
+		return info->unpack == unpack_422 ? ROUND_UP_2(width) * 2 : width * info->bpp;
+	if (info->n_planes == 2)
+		return ROUND_UP_2(width);
+	return (width + (1 << info->hsub) - 1) >> info->hsub;
+}
+
+static int plane_height(const struct format_info *info, uint32_t plane, int height)
+{
+	if (plane == 0)
+		return height;
+	return (height + (1 << info->vsub) - 1) >> info->vsub;
+}
+
+/* the bytes of a row of plane \a plane with the pixels \a x0 to \a x1, \a x0 is even */
+static int plane_row_range(const struct format_info *info, uint32_t plane, int x0, int x1,
+			   int *offset)
+{
+	int start;
+
+	if (plane == 0)
+		start = info->unpack == unpack_422 ? x0 * 2 : x0 * info->bpp;
+	else if (info->n_planes == 2)
+		start = x0;
+	else
+		start = x0 >> info->hsub;
+
+	*offset = start;
+	return plane_row_bytes(info, plane, x1) - start;
+}
+
+uint32_t video_convert_get_layout(enum video_convert_format format, int width, int height,
+				  int strides[VIDEO_CONVERT_MAX_PLANES],
+				  size_t offsets[VIDEO_CONVERT_MAX_PLANES], size_t *size)
+{
+	const struct format_info *info = find_format_info(format);
+	int s[VIDEO_CONVERT_MAX_PLANES];
+	size_t offset = 0;
+	uint32_t i;
+
+	if (info == NULL || width <= 0 || height <= 0)
+		return 0;
+
+	s[0] = ROUND_UP_4(plane_row_bytes(info, 0, width));
+	if (info->n_planes == 2) {
+		s[1] = ROUND_UP_4(width);
+	} else if (info->n_planes == 3) {
+		if (info->hsub == 0)
+			s[1] = ROUND_UP_4(width);
+		else if (info->vsub == 0)
+			s[1] = ROUND_UP_8(width) / 2;
+		else
+			s[1] = ROUND_UP_4(ROUND_UP_2(width) / 2);
+		s[2] = s[1];
+	}
+
+	for (i = 0; i < info->n_planes; i++) {
+		if (strides)
+			strides[i] = s[i];
+		if (offsets)
+			offsets[i] = offset;
+		offset += (size_t) s[i] * plane_height(info, i, height);
+	}
+	if (size)
+		*size = offset;
+
+	return info->n_planes;
+}
+
+void video_convert_yuv_to_rgb_c(uint8_t *dst, const uint8_t *src, int n_pixels)
+{
+	int i;
+
+	for (i = 0; i < n_pixels; i++, src += 4, dst += 4) {
+		int c = (src[1] - 16) << 7;
+		int d = (src[2] - 128) << 7;
+		int e = (src[3] - 128) << 7;
+		int y = CONV_MULHI(c, CONV_Y_TO_RGB) + CONV_YUV_BIAS;
+		int r = (y + CONV_MULHI(e, CONV_V_TO_R)) >> CONV_YUV_SHIFT;
+		int g = (y + CONV_MULHI(d, CONV_U_TO_G) + CONV_MULHI(e, CONV_V_TO_G)) >> CONV_YUV_SHIFT;
+		int b = (y + CONV_MULHI(d, CONV_U_TO_B)) >> CONV_YUV_SHIFT;
+
+		dst[0] = src[0];
+		dst[1] = CLAMP_U8(r);
+		dst[2] = CLAMP_U8(g);
+		dst[3] = CLAMP_U8(b);
+	}
+}
+
+void video_convert_rgb_to_yuv_c(uint8_t *dst, const uint8_t *src, int n_pixels)
+{
+	int i;
+
+	for (i = 0; i < n_pixels; i++, src += 4, dst += 4) {
+		int r = src[1] << 7;
+		int g = src[2] << 7;
+		int b = src[3] << 7;
+		int y = ((CONV_MULHI(r, CONV_R_TO_Y) + CONV_MULHI(g, CONV_G_TO_Y) +
+			  CONV_MULHI(b, CONV_B_TO_Y) + CONV_RGB_BIAS) >> CONV_RGB_SHIFT) + 16;
+		int u = ((CONV_MULHI(r, CONV_R_TO_U) + CONV_MULHI(g, CONV_G_TO_U) +
+			  CONV_MULHI(b, CONV_B_TO_U) + CONV_RGB_BIAS) >> CONV_RGB_SHIFT) + 128;
+		int v = ((CONV_MULHI(r, CONV_R_TO_V) + CONV_MULHI(g, CONV_G_TO_V) +
+			  CONV_MULHI(b, CONV_B_TO_V) + CONV_RGB_BIAS) >> CONV_RGB_SHIFT) + 128;
+
+		dst[0] = src[0];
+		dst[1] = CLAMP_U8(y);
+		dst[2] = CLAMP_U8(u);
+		dst[3] = CLAMP_U8(v);
+	}
+}
+
+void video_convert_blend_c(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+			   int frac, int n_bytes)
+{
+	int i;
+
+	for (i = 0; i < n_bytes; i++)
+		dst[i] = a[i] + (((b[i] - a[i]) * frac) >> CONV_BLEND_SHIFT);
+}
+
+void video_convert_split_c(uint8_t *even, uint8_t *odd, const uint8_t *src, int n_pairs)
+{
+	int i;
+
+	for (i = 0; i < n_pairs; i++, src += 2) {
+		even[i] = src[0];
+		odd[i] = src[1];
+	}
+}
+
+enum mode {
+	MODE_COPY,		/**< same format and size */
+	MODE_SPLIT,		/**< packed 4:2:2 to 4:2:0 of the same size */
+	MODE_GENERIC,
+};
+
+/* the scratch memory of a band */
+struct band {
+	int x0, x1;		/**< the output columns that are converted */
+	int sx0, sx1;		/**< the source columns they need */
+	uint8_t *unpacked;	/**< in_width pixels */
+	uint8_t *rows[2];	/**< out_width pixels, horizontally scaled source rows */
+	int row_index[2];	/**< the source row in rows or -1 */
+	uint8_t *tmp;		/**< out_width pixels */
+	uint32_t *accum;	/**< out_width pixels of sums for area scaling */
+};
+
+struct video_convert {
+	const struct format_info *in;
+	const struct format_info *out;
+	int in_width, in_height;
+	int out_width, out_height;
+	enum video_convert_scale scale;
+	enum mode mode;
+	struct video_convert_ops ops;
+	convert_matrix_func_t matrix;
+
+	bool hscale;
+	int32_t *xmap;		/**< bilinear: source pixel << 8 | fraction,
+				  *  area: first source pixel */
+	int32_t *xcount;	/**< area: number of source pixels */
+
+	void *memory;
+	uint32_t max_bands;
+	struct band bands[0];
+};
+
+static void init_ops(struct video_convert_ops *ops, uint32_t flags)
+{
+	ops->name = "c";
+	ops->yuv_to_rgb = video_convert_yuv_to_rgb_c;
+	ops->rgb_to_yuv = video_convert_rgb_to_yuv_c;
+	ops->blend = video_convert_blend_c;
+	ops->split = video_convert_split_c;
+
+	if (flags & VIDEO_CONVERT_FLAG_NO_SIMD)
+		return;
+
+#if defined(HAVE_SSE2)
+	video_convert_ops_sse2(ops);
+#endif
+#if defined(HAVE_NEON)
+	video_convert_ops_neon(ops);
+#endif
+}
+
+static bool can_split(const struct format_info *in, const struct format_info *out)
+{
+	if (in->unpack != unpack_422)
+		return false;
+	if (out->unpack == unpack_planar)
+		return out->hsub == 1 && out->vsub == 1;
+	if (out->unpack == unpack_semi_planar)
+		return (in->offs[2] < in->offs[3]) == (out->offs[2] < out->offs[3]);
+	return false;
+}
+
+struct video_convert *
+video_convert_new(enum video_convert_format in_format, int in_width, int in_height,
+		  enum video_convert_format out_format, int out_width, int out_height,
+		  enum video_convert_scale scale, uint32_t max_bands, uint32_t flags)
+{
+	struct video_convert *conv;
+	const struct format_info *in, *out;
+	size_t row_size, band_size;
+	uint8_t *mem;
+	uint32_t i;
+	int x;
+
+	in = find_format_info(in_format);
+	out = find_format_info(out_format);
+	if (in == NULL || out == NULL || max_bands == 0 ||
+	    in_width <= 0 || in_height <= 0 || out_width <= 0 || out_height <= 0)
+		return NULL;
+
+	conv = calloc(1, sizeof(struct video_convert) + max_bands * sizeof(struct band));
+	if (conv == NULL)
+		return NULL;
+
+	conv->in = in;
+	conv->out = out;
+	conv->in_width = in_width;
+	conv->in_height = in_height;
+	conv->out_width = out_width;
+	conv->out_height = out_height;
+	conv->scale = scale;
+	conv->max_bands = max_bands;
+	init_ops(&conv->ops, flags);
+
+	if (in->family == FAMILY_YUV && out->family == FAMILY_RGB)
+		conv->matrix = conv->ops.yuv_to_rgb;
+	else if (in->family == FAMILY_RGB && out->family == FAMILY_YUV)
+		conv->matrix = conv->ops.rgb_to_yuv;
+
+	if (in_width == out_width && in_height == out_height) {
+		if (in == out)
+			conv->mode = MODE_COPY;
+		else if (can_split(in, out))
+			conv->mode = MODE_SPLIT;
+		else
+			conv->mode = MODE_GENERIC;
+	} else {
+		conv->mode = MODE_GENERIC;
+	}
+
+	conv->hscale = in_width != out_width;
+	if (conv->hscale) {
+		conv->xmap = malloc(out_width * sizeof(int32_t) * 2);
+		if (conv->xmap == NULL)
+			goto error;
+		conv->xcount = conv->xmap + out_width;
+
+		for (x = 0; x < out_width; x++) {
+			if (scale == VIDEO_CONVERT_SCALE_AREA) {
+				int x0 = (int64_t) x * in_width / out_width;
+				int x1 = (int64_t) (x + 1) * in_width / out_width;
+
+				conv->xmap[x] = x0;
+				conv->xcount[x] = SPA_MAX(x1 - x0, 1);
+			} else {
+				/* sample at the pixel centers, in 1/256 source pixels */
+				int64_t pos = (((int64_t) x * 2 + 1) * in_width * 256) /
+					      (out_width * 2) - 128;
+				if (pos < 0)
+					pos = 0;
+				if (pos > (int64_t) (in_width - 1) * 256)
+					pos = (int64_t) (in_width - 1) * 256;
+				conv->xmap[x] = ((pos >> 8) << 8) | ((pos & 0xff) >> 1);
+			}
+		}
+	}
+
+	row_size = ROUND_UP_16(SPA_MAX(in_width, out_width) * 4);
+	band_size = row_size * 4 + ROUND_UP_16(out_width * sizeof(uint32_t) * 4);
+	conv->memory = malloc(band_size * max_bands);
+	if (conv->memory == NULL)
+		goto error;
+
+	mem = conv->memory;
+	for (i = 0; i < max_bands; i++) {
+		struct band *b = &conv->bands[i];
+
+		b->unpacked = mem;
+		b->rows[0] = mem + row_size;
+		b->rows[1] = mem + row_size * 2;
+		b->tmp = mem + row_size * 3;
+		b->accum = (uint32_t *) (mem + row_size * 4);
+		mem += band_size;
+	}
+	return conv;
+
+      error:
+	video_convert_free(conv);
+	return NULL;
+}
+
+void video_convert_free(struct video_convert *conv)
+{
+	free(conv->xmap);
+	free(conv->memory);
+	free(conv);
+}
+
+const char *video_convert_get_kernels(struct video_convert *conv)
+{
+	return conv->ops.name;
+}
+
+/* scale the source columns sx0 to sx1 in \a src to the columns x0 to x1 in \a dst */
+static void hscale_bilinear(struct video_convert *conv, struct band *b,
+			    uint8_t *dst, const uint8_t *src)
+{
+	int x, c;
+
+	for (x = b->x0; x < b->x1; x++, dst += 4) {
+		int32_t m = conv->xmap[x];
+		const uint8_t *p = src + ((m >> 8) - b->sx0) * 4;
+		int f = m & 0xff;
+
+		if (f == 0) {
+			memcpy(dst, p, 4);
+			continue;
+		}
+		for (c = 0; c < 4; c++)
+			dst[c] = p[c] + (((p[c + 4] - p[c]) * f) >> CONV_BLEND_SHIFT);
+	}
+}
+
+static void hscale_area(struct video_convert *conv, struct band *b,
+			uint8_t *dst, const uint8_t *src)
+{
+	int x, i, c;
+
+	for (x = b->x0; x < b->x1; x++, dst += 4) {
+		const uint8_t *p = src + (conv->xmap[x] - b->sx0) * 4;
+		int n = conv->xcount[x];
+		uint32_t sum[4] = { 0, 0, 0, 0 }, recip = (1 << 16) / n;
+
+		for (i = 0; i < n; i++, p += 4) {
+			for (c = 0; c < 4; c++)
+				sum[c] += p[c];
+		}
+		for (c = 0; c < 4; c++)
+			dst[c] = (sum[c] * recip + (1 << 15)) >> 16;
+	}
+}
+
+/* unpack and horizontally scale source row \a sy into \a dst */
+static void load_row(struct video_convert *conv, struct band *b,
+		     const struct video_convert_frame *src, int sy, uint8_t *dst)
+{
+	if (!conv->hscale) {
+		conv->in->unpack(conv->in, dst, src, sy, b->x0, b->x1 - b->x0);
+		return;
+	}
+	conv->in->unpack(conv->in, b->unpacked, src, sy, b->sx0, b->sx1 - b->sx0);
+	if (conv->scale == VIDEO_CONVERT_SCALE_AREA)
+		hscale_area(conv, b, dst, b->unpacked);
+	else
+		hscale_bilinear(conv, b, dst, b->unpacked);
+}
+
+/* get the scaled source rows \a sy0 and \a sy1, neighbouring output rows share
+ * their source rows so the last 2 are kept */
+static void get_rows(struct video_convert *conv, struct band *b,
+		     const struct video_convert_frame *src, int sy0, int sy1,
+		     const uint8_t **r0, const uint8_t **r1)
+{
+	int s0, s1;
+
+	if (b->row_index[0] == sy0)
+		s0 = 0;
+	else if (b->row_index[1] == sy0)
+		s0 = 1;
+	else
+		s0 = b->row_index[0] == sy1 ? 1 : 0;
+
+	if (b->row_index[s0] != sy0) {
+		load_row(conv, b, src, sy0, b->rows[s0]);
+		b->row_index[s0] = sy0;
+	}
+	*r0 = b->rows[s0];
+
+	if (r1 == NULL)
+		return;
+
+	s1 = s0 ^ 1;
+	if (sy1 == sy0) {
+		*r1 = *r0;
+		return;
+	}
+	if (b->row_index[s1] != sy1) {
+		load_row(conv, b, src, sy1, b->rows[s1]);
+		b->row_index[s1] = sy1;
+	}
+	*r1 = b->rows[s1];
+}
+
+static const uint8_t *vscale_bilinear(struct video_convert *conv, struct band *b,
+				      const struct video_convert_frame *src, int y)
+{
+	int64_t pos;
+	int sy, f;
+	const uint8_t *r0, *r1;
+
+	if (conv->in_height == conv->out_height) {
+		get_rows(conv, b, src, y, y, &r0, NULL);
+		return r0;
+	}
+
+	pos = (((int64_t) y * 2 + 1) * conv->in_height * 256) / (conv->out_height * 2) - 128;
+	if (pos < 0)
+		pos = 0;
+	if (pos > (int64_t) (conv->in_height - 1) * 256)
+		pos = (int64_t) (conv->in_height - 1) * 256;
+	sy = pos >> 8;
+	f = (pos & 0xff) >> 1;
+
+	if (f == 0) {
+		get_rows(conv, b, src, sy, sy, &r0, NULL);
+		return r0;
+	}
+	get_rows(conv, b, src, sy, sy + 1, &r0, &r1);
+	conv->ops.blend(b->tmp, r0, r1, f, (b->x1 - b->x0) * 4);
+	return b->tmp;
+}
+
+static const uint8_t *vscale_area(struct video_convert *conv, struct band *b,
+				  const struct video_convert_frame *src, int y)
+{
+	int sy0 = (int64_t) y * conv->in_height / conv->out_height;
+	int sy1 = (int64_t) (y + 1) * conv->in_height / conv->out_height;
+	int n = SPA_MAX(sy1 - sy0, 1), i, sy;
+	int n_bytes = (b->x1 - b->x0) * 4;
+	uint32_t recip;
+	const uint8_t *r;
+
+	if (n == 1) {
+		get_rows(conv, b, src, sy0, sy0, &r, NULL);
+		return r;
+	}
+
+	memset(b->accum, 0, n_bytes * sizeof(uint32_t));
+	for (sy = sy0; sy < sy0 + n; sy++) {
+		get_rows(conv, b, src, sy, sy, &r, NULL);
+		for (i = 0; i < n_bytes; i++)
+			b->accum[i] += r[i];
+	}
+	recip = (1 << 16) / n;
+	for (i = 0; i < n_bytes; i++)
+		b->tmp[i] = (b->accum[i] * recip + (1 << 15)) >> 16;
+
+	return b->tmp;
+}
+
+static void process_copy(struct video_convert *conv, struct band *b, int y0, int y1,
+			 const struct video_convert_frame *src, struct video_convert_frame *dst)
+{
+	const struct format_info *info = conv->in;
+	uint32_t i;
+	int y;
+
+	for (i = 0; i < info->n_planes; i++) {
+		int sub = i == 0 ? 0 : info->vsub;
+		int py0 = (y0 + (1 << sub) - 1) >> sub;
+		int py1 = (y1 + (1 << sub) - 1) >> sub;
+		int offset, n_bytes = plane_row_range(info, i, b->x0, b->x1, &offset);
+		uint8_t *d = dst->data[i] + offset;
+		const uint8_t *s = src->data[i] + offset;
+
+		if (py0 >= py1)
+			continue;
+		if (src->stride[i] == dst->stride[i] &&
+		    n_bytes == plane_row_bytes(info, i, conv->in_width)) {
+			memcpy(d + py0 * dst->stride[i], s + py0 * src->stride[i],
+			       (size_t) (py1 - py0 - 1) * src->stride[i] + n_bytes);
+			continue;
+		}
+		for (y = py0; y < py1; y++)
+			memcpy(d + y * dst->stride[i], s + y * src->stride[i], n_bytes);
+	}
+}
+
+static void process_split(struct video_convert *conv, struct band *b, int y0, int y1,
+			  const struct video_convert_frame *src, struct video_convert_frame *dst)
+{
+	const struct format_info *in = conv->in, *out = conv->out;
+	int x0 = b->x0, width = b->x1 - b->x0, n_pairs = width / 2, y;
+	bool luma_even = in->offs[1] == 0;
+	/* the chroma bytes in the source are U,V or V,U */
+	bool u_first = in->offs[2] < in->offs[3];
+
+	for (y = y0; y < y1; y++) {
+		const uint8_t *s = src->data[0] + y * src->stride[0] + x0 * 2;
+		uint8_t *dy = dst->data[0] + y * dst->stride[0] + x0;
+		uint8_t *chroma = b->tmp;
+
+		if ((y & 1) == 0 && out->n_planes == 2)
+			chroma = dst->data[1] + (y >> 1) * dst->stride[1] + x0;
+
+		/* a pair of pixels is 2 pairs of luma and chroma bytes */
+		if (luma_even)
+			conv->ops.split(dy, chroma, s, n_pairs * 2);
+		else
+			conv->ops.split(chroma, dy, s, n_pairs * 2);
+
+		if (width & 1) {
+			const uint8_t *p = s + n_pairs * 4;
+
+			dy[width - 1] = p[in->offs[1]];
+			chroma[n_pairs * 2] = p[luma_even ? 1 : 0];
+			chroma[n_pairs * 2 + 1] = p[luma_even ? 3 : 2];
+		}
+
+		if ((y & 1) == 0 && out->n_planes == 3) {
+			int cy = y >> 1, cx = x0 >> 1;
+			uint8_t *du = dst->data[out->offs[2]] + cy * dst->stride[out->offs[2]] + cx;
+			uint8_t *dv = dst->data[out->offs[3]] + cy * dst->stride[out->offs[3]] + cx;
+
+			if (u_first)
+				conv->ops.split(du, dv, chroma, (width + 1) / 2);
+			else
+				conv->ops.split(dv, du, chroma, (width + 1) / 2);
+		}
+	}
+}
+
+static void process_generic(struct video_convert *conv, struct band *b, int y0, int y1,
+			    const struct video_convert_frame *src, struct video_convert_frame *dst)
+{
+	int y;
+
+	b->row_index[0] = b->row_index[1] = -1;
+
+	for (y = y0; y < y1; y++) {
+		const uint8_t *row;
+
+		if (conv->scale == VIDEO_CONVERT_SCALE_AREA)
+			row = vscale_area(conv, b, src, y);
+		else
+			row = vscale_bilinear(conv, b, src, y);
+
+		if (conv->matrix) {
+			conv->matrix(b->tmp, row, b->x1 - b->x0);
+			row = b->tmp;
+		}
+		conv->out->pack(conv->out, dst, y, b->x0, row, b->x1 - b->x0);
+	}
+}
+
+/* the output pixels from \a v0 to \a v1 that depend on the source pixels
+ * from \a s0 to \a s1 */
+static void map_range(int s0, int s1, int in_size, int out_size, int *v0, int *v1)
+{
+	/* bilinear scaling reads a neighbour on both sides and a source pixel
+	 * covers more than one output pixel when upscaling */
+	int margin = in_size == out_size ? 0 : (out_size + in_size - 1) / in_size + 1;
+
+	*v0 = SPA_MAX((int) ((int64_t) s0 * out_size / in_size) - margin, 0) & ~1;
+	*v1 = SPA_MIN(ROUND_UP_2((int) (((int64_t) s1 * out_size + in_size - 1) / in_size)
+				 + margin), out_size);
+}
+
+void video_convert_map_region(struct video_convert *conv,
+			      const struct video_convert_region *in,
+			      struct video_convert_region *out)
+{
+	int x0 = SPA_MAX(in->x, 0), y0 = SPA_MAX(in->y, 0);
+	int x1 = SPA_MIN(in->x + in->width, conv->in_width);
+	int y1 = SPA_MIN(in->y + in->height, conv->in_height);
+	int ox0, ox1, oy0, oy1;
+
+	if (x0 >= x1 || y0 >= y1) {
+		out->x = out->y = out->width = out->height = 0;
+		return;
+	}
+	map_range(x0, x1, conv->in_width, conv->out_width, &ox0, &ox1);
+	map_range(y0, y1, conv->in_height, conv->out_height, &oy0, &oy1);
+
+	out->x = ox0;
+	out->y = oy0;
+	out->width = ox1 - ox0;
+	out->height = oy1 - oy0;
+}
+
+/* set the columns of \a b, the first source column is even so that subsampled
+ * chroma can be unpacked */
+static void set_columns(struct video_convert *conv, struct band *b, int x0, int x1)
+{
+	b->x0 = x0;
+	b->x1 = x1;
+
+	if (!conv->hscale) {
+		b->sx0 = x0;
+		b->sx1 = x1;
+	} else if (conv->scale == VIDEO_CONVERT_SCALE_AREA) {
+		b->sx0 = conv->xmap[x0] & ~1;
+		b->sx1 = conv->xmap[x1 - 1] + conv->xcount[x1 - 1];
+	} else {
+		b->sx0 = (conv->xmap[x0] >> 8) & ~1;
+		b->sx1 = SPA_MIN((conv->xmap[x1 - 1] >> 8) + 2, conv->in_width);
+	}
+}
+
+void video_convert_process_region(struct video_convert *conv, uint32_t band, uint32_t n_bands,
+				  const struct video_convert_region *region,
+				  const struct video_convert_frame *src,
+				  struct video_convert_frame *dst)
+{
+	struct video_convert_region r;
+	struct band *b;
+	int rows, y0, y1;
+
+	if (band >= n_bands || n_bands > conv->max_bands)
+		return;
+
+	video_convert_map_region(conv, region, &r);
+	if (r.width == 0)
+		return;
+
+	b = &conv->bands[band];
+
+	/* bands start on even rows so that 4:2:0 chroma rows are written by
+	 * one band only */
+	rows = ROUND_UP_2((r.height + n_bands - 1) / n_bands);
+	y0 = SPA_MIN(r.y + (int) band * rows, r.y + r.height);
+	y1 = SPA_MIN(y0 + rows, r.y + r.height);
+	if (y0 >= y1)
+		return;
+
+	set_columns(conv, b, r.x, r.x + r.width);
+
+	switch (conv->mode) {
+	case MODE_COPY:
+		process_copy(conv, b, y0, y1, src, dst);
+		break;
+	case MODE_SPLIT:
+		process_split(conv, b, y0, y1, src, dst);
+		break;
+	default:
+		process_generic(conv, b, y0, y1, src, dst);
+		break;
+	}
+}
+
+void video_convert_process(struct video_convert *conv, uint32_t band, uint32_t n_bands,
+			   const struct video_convert_frame *src,
+			   struct video_convert_frame *dst)
+{
+	struct video_convert_region all = { 0, 0, conv->in_width, conv->in_height };
+
+	video_convert_process_region(conv, band, n_bands, &all, src, dst);
+}
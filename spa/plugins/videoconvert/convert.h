@@ -0,0 +1,136 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_VIDEO_CONVERT_H__
+#define __SPA_VIDEO_CONVERT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <spa/defs.h>
+
+#define VIDEO_CONVERT_MAX_PLANES	3
+
+enum video_convert_format {
+	VIDEO_CONVERT_FORMAT_UNKNOWN,
+	VIDEO_CONVERT_FORMAT_I420,
+	VIDEO_CONVERT_FORMAT_YV12,
+	VIDEO_CONVERT_FORMAT_Y42B,
+	VIDEO_CONVERT_FORMAT_Y444,
+	VIDEO_CONVERT_FORMAT_NV12,
+	VIDEO_CONVERT_FORMAT_NV21,
+	VIDEO_CONVERT_FORMAT_YUY2,
+	VIDEO_CONVERT_FORMAT_UYVY,
+	VIDEO_CONVERT_FORMAT_YVYU,
+	VIDEO_CONVERT_FORMAT_AYUV,
+	VIDEO_CONVERT_FORMAT_GRAY8,
+	VIDEO_CONVERT_FORMAT_RGBx,
+	VIDEO_CONVERT_FORMAT_BGRx,
+	VIDEO_CONVERT_FORMAT_xRGB,
+	VIDEO_CONVERT_FORMAT_xBGR,
+	VIDEO_CONVERT_FORMAT_RGBA,
+	VIDEO_CONVERT_FORMAT_BGRA,
+	VIDEO_CONVERT_FORMAT_ARGB,
+	VIDEO_CONVERT_FORMAT_ABGR,
+	VIDEO_CONVERT_FORMAT_RGB,
+	VIDEO_CONVERT_FORMAT_BGR,
+	VIDEO_CONVERT_FORMAT_MAX,
+};
+
+enum video_convert_scale {
+	VIDEO_CONVERT_SCALE_BILINEAR,	/**< interpolate between the 2 nearest pixels */
+	VIDEO_CONVERT_SCALE_AREA,	/**< average the covered pixels, for downscaling */
+};
+
+#define VIDEO_CONVERT_FLAG_NO_SIMD	(1 << 0)	/**< only use the C kernels */
+
+/** The planes of a frame */
+struct video_convert_frame {
+	uint8_t *data[VIDEO_CONVERT_MAX_PLANES];
+	int stride[VIDEO_CONVERT_MAX_PLANES];
+};
+
+/** A rectangle of a frame */
+struct video_convert_region {
+	int x, y;
+	int width, height;
+};
+
+struct video_convert;
+
+/** Get the default layout of a frame
+ * \param format a format
+ * \param width the width
+ * \param height the height
+ * \param[out] strides the stride of each plane, can be NULL
+ * \param[out] offsets the offset of each plane in one block of memory, can be NULL
+ * \param[out] size the size of the frame, can be NULL
+ * \return the number of planes or 0 when the format is not supported */
+uint32_t video_convert_get_layout(enum video_convert_format format, int width, int height,
+				  int strides[VIDEO_CONVERT_MAX_PLANES],
+				  size_t offsets[VIDEO_CONVERT_MAX_PLANES], size_t *size);
+
+/** Make a converter
+ * \param max_bands the maximum number of bands a frame is processed in, each band
+ *	has its own scratch memory
+ * \return a new converter or NULL when the conversion is not supported
+ */
+struct video_convert *
+video_convert_new(enum video_convert_format in_format, int in_width, int in_height,
+		  enum video_convert_format out_format, int out_width, int out_height,
+		  enum video_convert_scale scale, uint32_t max_bands, uint32_t flags);
+
+void video_convert_free(struct video_convert *conv);
+
+/** Get the name of the fastest kernels that are used, "c", "sse2" or "neon" */
+const char *video_convert_get_kernels(struct video_convert *conv);
+
+/** Convert band \a band of \a n_bands from \a src into \a dst
+ *
+ * A frame is split in \a n_bands bands of rows that can be converted at the same
+ * time from different threads, \a n_bands must not be larger than the max_bands
+ * of the converter.
+ */
+void video_convert_process(struct video_convert *conv, uint32_t band, uint32_t n_bands,
+			   const struct video_convert_frame *src,
+			   struct video_convert_frame *dst);
+
+/** Get the region of the output that depends on region \a in of the input
+ *
+ * This is the region that video_convert_process_region() writes, it is clipped
+ * to the output frame and starts on an even row and column. An empty input
+ * region gives an output region with a width of 0.
+ */
+void video_convert_map_region(struct video_convert *conv,
+			      const struct video_convert_region *in,
+			      struct video_convert_region *out);
+
+/** Convert band \a band of \a n_bands of the output pixels that depend on
+ * \a region of \a src
+ *
+ * The pixels of \a dst outside of the mapped region are not touched so that
+ * only the changed parts of a frame have to be converted into a frame that
+ * holds the conversion of a previous one.
+ */
+void video_convert_process_region(struct video_convert *conv, uint32_t band, uint32_t n_bands,
+				  const struct video_convert_region *region,
+				  const struct video_convert_frame *src,
+				  struct video_convert_frame *dst);
+
+#endif /* __SPA_VIDEO_CONVERT_H__ */
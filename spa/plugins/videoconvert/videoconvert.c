@@ -0,0 +1,1256 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stddef.h>
+
+#include <spa/log.h>
+#include <spa/loop.h>
+#include <spa/type-map.h>
+#include <spa/node.h>
+#include <spa/list.h>
+#include <spa/video/format-utils.h>
+#include <spa/format-builder.h>
+#include <spa/param-alloc.h>
+#include <lib/props.h>
+#include <lib/format.h>
+
+#include "convert.h"
+
+#define NAME "videoconvert"
+
+#define MAX_BUFFERS	16
+
+/* the damage regions that are kept of a frame, more regions damage the
+ * complete frame */
+#define MAX_DAMAGE	16
+/* the frames of damage history, the output buffers come back in order so
+ * this is the oldest frame they can hold */
+#define DAMAGE_HISTORY	MAX_BUFFERS
+/* the regions that are converted, more regions convert the complete frame */
+#define MAX_REGIONS	64
+
+struct props {
+	uint32_t scale;
+};
+
+struct buffer {
+	struct spa_buffer *outbuf;
+	bool outstanding;
+	struct spa_meta_header *h;
+	struct spa_meta_video_damage *damage;
+	uint32_t damage_size;
+	uint32_t frame;		/**< the input frame that was converted into the
+				  *  buffer, 0 when unknown */
+	struct spa_list link;
+};
+
+/* the regions of an input frame that changed since the previous one */
+struct damage {
+	bool all;
+	uint32_t n_regions;
+	struct video_convert_region regions[MAX_DAMAGE];
+};
+
+struct port {
+	bool have_format;
+	struct spa_video_info current_format;
+	enum video_convert_format format;
+
+	/* the default layout, used when the planes are in one data block */
+	uint32_t n_planes;
+	int strides[VIDEO_CONVERT_MAX_PLANES];
+	size_t offsets[VIDEO_CONVERT_MAX_PLANES];
+	size_t size;
+
+	struct spa_port_info info;
+	uint8_t params_buffer[1024];
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct spa_port_io *io;
+
+	struct spa_list empty;
+};
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	uint32_t props;
+	uint32_t prop_scale;
+	uint32_t scale_bilinear;
+	uint32_t scale_area;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
+	struct spa_type_event_node event_node;
+	struct spa_type_command_node command_node;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
+	struct spa_type_param_alloc_meta_enable param_alloc_meta_enable;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->prop_scale = spa_type_map_get_id(map, SPA_TYPE_PROPS__scaleMethod);
+	type->scale_bilinear = spa_type_map_get_id(map, SPA_TYPE_PROPS__scaleMethod ":bilinear");
+	type->scale_area = spa_type_map_get_id(map, SPA_TYPE_PROPS__scaleMethod ":area");
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
+	spa_type_event_node_map(map, &type->event_node);
+	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
+	spa_type_param_alloc_meta_enable_map(map, &type->param_alloc_meta_enable);
+}
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct type type;
+	struct spa_type_map *map;
+	struct spa_log *log;
+	struct spa_loop *data_loop;
+
+	uint8_t props_buffer[512];
+	struct props props;
+
+	const struct spa_node_callbacks *callbacks;
+	void *callbacks_data;
+
+	uint8_t format_buffer[1024];
+
+	struct port in_ports[1];
+	struct port out_ports[1];
+
+	/* only changed on the data loop */
+	struct video_convert *conv;
+
+	/* the frames are counted so that an output buffer that holds an older
+	 * frame only needs the damage of the frames after it to be converted */
+	uint32_t frame;
+	struct damage history[DAMAGE_HISTORY];
+	bool full;
+	uint32_t n_regions;
+	struct video_convert_region regions[MAX_REGIONS];
+};
+
+#define CHECK_IN_PORT(this,d,p)  ((d) == SPA_DIRECTION_INPUT && (p) == 0)
+#define CHECK_OUT_PORT(this,d,p) ((d) == SPA_DIRECTION_OUTPUT && (p) == 0)
+#define CHECK_PORT(this,d,p)     ((p) == 0)
+
+#define DEFAULT_SCALE scale_bilinear
+
+static void reset_props(struct impl *this, struct props *props)
+{
+	props->scale = this->type.DEFAULT_SCALE;
+}
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_MM(f,key,type,...)							\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
+#define PROP_U_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
+
+/* convert the regions of the frame or the complete frame */
+static void do_convert(struct impl *this, const struct video_convert_frame *src,
+		       struct video_convert_frame *dst)
+{
+	uint32_t i;
+
+	if (this->full) {
+		video_convert_process(this->conv, 0, 1, src, dst);
+		return;
+	}
+	for (i = 0; i < this->n_regions; i++)
+		video_convert_process_region(this->conv, 0, 1, &this->regions[i], src, dst);
+}
+
+static int do_set_convert(struct spa_loop *loop,
+			  bool async,
+			  uint32_t seq,
+			  size_t size,
+			  const void *data,
+			  void *user_data)
+{
+	struct impl *this = user_data;
+	struct port *out = &this->out_ports[0];
+	uint32_t i;
+
+	/* the output buffers don't hold a conversion of the new setup */
+	for (i = 0; i < out->n_buffers; i++)
+		out->buffers[i].frame = 0;
+
+	this->conv = *(struct video_convert **) data;
+
+	return SPA_RESULT_OK;
+}
+
+/* install \a conv on the data loop and free the old conversion */
+static void set_convert(struct impl *this, struct video_convert *conv)
+{
+	struct video_convert *old = this->conv;
+
+	if (this->data_loop)
+		spa_loop_invoke(this->data_loop, do_set_convert, SPA_ID_INVALID,
+				sizeof(conv), &conv, true, this);
+	else
+		do_set_convert(NULL, false, SPA_ID_INVALID, sizeof(conv), &conv, this);
+
+	if (old)
+		video_convert_free(old);
+}
+
+static int setup_convert(struct impl *this)
+{
+	struct port *in = &this->in_ports[0], *out = &this->out_ports[0];
+	struct spa_rectangle *is, *os;
+	struct video_convert *conv;
+
+	if (!in->have_format || !out->have_format) {
+		set_convert(this, NULL);
+		return SPA_RESULT_OK;
+	}
+
+	is = &in->current_format.info.raw.size;
+	os = &out->current_format.info.raw.size;
+
+	conv = video_convert_new(in->format, is->width, is->height,
+				 out->format, os->width, os->height,
+				 this->props.scale == this->type.scale_area ?
+				 VIDEO_CONVERT_SCALE_AREA : VIDEO_CONVERT_SCALE_BILINEAR,
+				 1, 0);
+	set_convert(this, conv);
+	if (conv == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	spa_log_info(this->log, NAME " %p: convert %dx%d to %dx%d with %s kernels", this,
+		     is->width, is->height, os->width, os->height,
+		     video_convert_get_kernels(conv));
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
+{
+	struct impl *this;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(props != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_pod_builder_init(&b, this->props_buffer, sizeof(this->props_buffer));
+	spa_pod_builder_props(&b, &f[0], this->type.props,
+		PROP_EN(&f[1], this->type.prop_scale, SPA_POD_TYPE_ID, 3,
+			this->props.scale,
+			this->type.scale_bilinear,
+			this->type.scale_area));
+
+	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_node_set_props(struct spa_node *node, const struct spa_props *props)
+{
+	struct impl *this;
+	uint32_t scale;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	scale = this->props.scale;
+
+	if (props == NULL) {
+		reset_props(this, &this->props);
+	} else {
+		spa_props_query(props,
+				this->type.prop_scale, SPA_POD_TYPE_ID, &this->props.scale,
+				0);
+	}
+
+	if (scale != this->props.scale)
+		return setup_convert(this);
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_node_send_command(struct spa_node *node, const struct spa_command *command)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(command != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (SPA_COMMAND_TYPE(command) == this->type.command_node.Start ||
+	    SPA_COMMAND_TYPE(command) == this->type.command_node.Pause)
+		return SPA_RESULT_OK;
+	else
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_set_callbacks(struct spa_node *node,
+			const struct spa_node_callbacks *callbacks,
+			void *data)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	this->callbacks = callbacks;
+	this->callbacks_data = data;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_get_n_ports(struct spa_node *node,
+		      uint32_t *n_input_ports,
+		      uint32_t *max_input_ports,
+		      uint32_t *n_output_ports,
+		      uint32_t *max_output_ports)
+{
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	if (n_input_ports)
+		*n_input_ports = 1;
+	if (max_input_ports)
+		*max_input_ports = 1;
+	if (n_output_ports)
+		*n_output_ports = 1;
+	if (max_output_ports)
+		*max_output_ports = 1;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_get_port_ids(struct spa_node *node,
+		       uint32_t n_input_ports,
+		       uint32_t *input_ids,
+		       uint32_t n_output_ports,
+		       uint32_t *output_ids)
+{
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	if (n_input_ports > 0 && input_ids)
+		input_ids[0] = 0;
+	if (n_output_ports > 0 && output_ids)
+		output_ids[0] = 0;
+
+	return SPA_RESULT_OK;
+}
+
+
+static int impl_node_add_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_remove_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static enum video_convert_format convert_format(struct impl *this, uint32_t format)
+{
+	struct spa_type_video_format *f = &this->type.video_format;
+
+	if (format == f->I420)
+		return VIDEO_CONVERT_FORMAT_I420;
+	else if (format == f->YV12)
+		return VIDEO_CONVERT_FORMAT_YV12;
+	else if (format == f->Y42B)
+		return VIDEO_CONVERT_FORMAT_Y42B;
+	else if (format == f->Y444)
+		return VIDEO_CONVERT_FORMAT_Y444;
+	else if (format == f->NV12)
+		return VIDEO_CONVERT_FORMAT_NV12;
+	else if (format == f->NV21)
+		return VIDEO_CONVERT_FORMAT_NV21;
+	else if (format == f->YUY2)
+		return VIDEO_CONVERT_FORMAT_YUY2;
+	else if (format == f->UYVY)
+		return VIDEO_CONVERT_FORMAT_UYVY;
+	else if (format == f->YVYU)
+		return VIDEO_CONVERT_FORMAT_YVYU;
+	else if (format == f->AYUV)
+		return VIDEO_CONVERT_FORMAT_AYUV;
+	else if (format == f->GRAY8)
+		return VIDEO_CONVERT_FORMAT_GRAY8;
+	else if (format == f->RGBx)
+		return VIDEO_CONVERT_FORMAT_RGBx;
+	else if (format == f->BGRx)
+		return VIDEO_CONVERT_FORMAT_BGRx;
+	else if (format == f->xRGB)
+		return VIDEO_CONVERT_FORMAT_xRGB;
+	else if (format == f->xBGR)
+		return VIDEO_CONVERT_FORMAT_xBGR;
+	else if (format == f->RGBA)
+		return VIDEO_CONVERT_FORMAT_RGBA;
+	else if (format == f->BGRA)
+		return VIDEO_CONVERT_FORMAT_BGRA;
+	else if (format == f->ARGB)
+		return VIDEO_CONVERT_FORMAT_ARGB;
+	else if (format == f->ABGR)
+		return VIDEO_CONVERT_FORMAT_ABGR;
+	else if (format == f->RGB)
+		return VIDEO_CONVERT_FORMAT_RGB;
+	else if (format == f->BGR)
+		return VIDEO_CONVERT_FORMAT_BGR;
+
+	return VIDEO_CONVERT_FORMAT_UNKNOWN;
+}
+
+static int
+impl_node_port_enum_formats(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    struct spa_format **format,
+			    const struct spa_format *filter,
+			    uint32_t index)
+{
+	struct impl *this;
+	int res;
+	struct spa_format *fmt;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+	uint32_t count, match;
+	struct spa_type_video_format *vf;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(format != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	vf = &this->type.video_format;
+	count = match = filter ? 0 : index;
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (count++) {
+	case 0:
+		spa_pod_builder_format(&b, &f[0], this->type.format,
+			this->type.media_type.video,
+			this->type.media_subtype.raw,
+			PROP_U_EN(&f[1], this->type.format_video.format, SPA_POD_TYPE_ID, 22,
+				vf->I420,
+				vf->I420, vf->YV12, vf->Y42B, vf->Y444, vf->NV12, vf->NV21,
+				vf->YUY2, vf->UYVY, vf->YVYU, vf->AYUV, vf->GRAY8,
+				vf->RGBx, vf->BGRx, vf->xRGB, vf->xBGR,
+				vf->RGBA, vf->BGRA, vf->ARGB, vf->ABGR,
+				vf->RGB, vf->BGR),
+			PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+				320, 240,
+				1, 1,
+				INT32_MAX, INT32_MAX),
+			PROP_U_MM(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+				25, 1,
+				0, 1,
+				INT32_MAX, 1));
+		break;
+	default:
+		return SPA_RESULT_ENUM_END;
+	}
+	fmt = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+
+	if ((res = spa_format_filter(fmt, filter, &b)) != SPA_RESULT_OK || match++ != index)
+		goto next;
+
+	*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
+
+	return SPA_RESULT_OK;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers", this);
+		port->n_buffers = 0;
+		spa_list_init(&port->empty);
+	}
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_set_format(struct spa_node *node,
+			  enum spa_direction direction,
+			  uint32_t port_id,
+			  uint32_t flags,
+			  const struct spa_format *format)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (format == NULL) {
+		port->have_format = false;
+		clear_buffers(this, port);
+	} else {
+		struct spa_video_info info = { SPA_FORMAT_MEDIA_TYPE(format),
+			SPA_FORMAT_MEDIA_SUBTYPE(format),
+		};
+		enum video_convert_format fmt;
+		uint32_t n_planes;
+
+		if (info.media_type != this->type.media_type.video ||
+		    info.media_subtype != this->type.media_subtype.raw)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (!spa_format_video_raw_parse(format, &info.info.raw, &this->type.format_video))
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		fmt = convert_format(this, info.info.raw.format);
+		n_planes = video_convert_get_layout(fmt,
+						    info.info.raw.size.width,
+						    info.info.raw.size.height,
+						    port->strides, port->offsets, &port->size);
+		if (n_planes == 0)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		port->current_format = info;
+		port->format = fmt;
+		port->n_planes = n_planes;
+		port->have_format = true;
+	}
+
+	return setup_convert(this);
+}
+
+static int
+impl_node_port_get_format(struct spa_node *node,
+			  enum spa_direction direction,
+			  uint32_t port_id,
+			  const struct spa_format **format)
+{
+	struct impl *this;
+	struct port *port;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(format != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+	spa_pod_builder_format(&b, &f[0], this->type.format,
+		this->type.media_type.video,
+		this->type.media_subtype.raw,
+		PROP(&f[1], this->type.format_video.format, SPA_POD_TYPE_ID,
+			port->current_format.info.raw.format),
+		PROP(&f[1], this->type.format_video.size, -SPA_POD_TYPE_RECTANGLE,
+			&port->current_format.info.raw.size),
+		PROP(&f[1], this->type.format_video.framerate, -SPA_POD_TYPE_FRACTION,
+			&port->current_format.info.raw.framerate));
+
+	*format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_get_info(struct spa_node *node,
+			enum spa_direction direction,
+			uint32_t port_id,
+			const struct spa_port_info **info)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(info != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+	*info = &port->info;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_enum_params(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   uint32_t index,
+			   struct spa_param **param)
+{
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(param != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	spa_pod_builder_init(&b, port->params_buffer, sizeof(port->params_buffer));
+
+	switch (index) {
+	case 0:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+			PROP     (&f[1], this->type.param_alloc_buffers.size,    SPA_POD_TYPE_INT,
+										  port->size),
+			PROP     (&f[1], this->type.param_alloc_buffers.stride,  SPA_POD_TYPE_INT,
+										  port->strides[0]),
+			PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+										  2, 1, MAX_BUFFERS),
+			PROP     (&f[1], this->type.param_alloc_buffers.align,   SPA_POD_TYPE_INT, 16));
+		break;
+
+	case 1:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.Header),
+			PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				sizeof(struct spa_meta_header)));
+		break;
+
+	case 2:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.VideoDamage),
+			PROP_MM(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				SPA_META_VIDEO_DAMAGE_SIZE(MAX_DAMAGE),
+				SPA_META_VIDEO_DAMAGE_SIZE(1),
+				SPA_META_VIDEO_DAMAGE_SIZE(MAX_DAMAGE)));
+		break;
+
+	default:
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_set_param(struct spa_node *node,
+			 enum spa_direction direction,
+			 uint32_t port_id,
+			 const struct spa_param *param)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_port_use_buffers(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   struct spa_buffer **buffers,
+			   uint32_t n_buffers)
+{
+	struct impl *this;
+	struct port *port;
+	uint32_t i, j;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b;
+		struct spa_data *d = buffers[i]->datas;
+		uint32_t n_datas = buffers[i]->n_datas;
+
+		b = &port->buffers[i];
+		b->outbuf = buffers[i];
+		b->outstanding = true;
+		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
+		b->damage = spa_buffer_find_meta(buffers[i], this->type.meta.VideoDamage);
+		b->damage_size = spa_buffer_find_meta_size(buffers[i], this->type.meta.VideoDamage);
+		b->frame = 0;
+
+		/* the planes are in their own data blocks or all in the first one */
+		if (n_datas < port->n_planes)
+			n_datas = 1;
+
+		for (j = 0; j < n_datas && j < port->n_planes; j++) {
+			if ((d[j].type != this->type.data.MemPtr &&
+			     d[j].type != this->type.data.MemFd &&
+			     d[j].type != this->type.data.DmaBuf) || d[j].data == NULL) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p",
+					      this, buffers[i]);
+				return SPA_RESULT_ERROR;
+			}
+		}
+		if (n_datas == 1 && d[0].maxsize < port->size) {
+			spa_log_error(this->log, NAME " %p: buffer %p too small %u < %zd",
+				      this, buffers[i], d[0].maxsize, port->size);
+			return SPA_RESULT_ERROR;
+		}
+		spa_list_insert(port->empty.prev, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_alloc_buffers(struct spa_node *node,
+			     enum spa_direction direction,
+			     uint32_t port_id,
+			     struct spa_param **params,
+			     uint32_t n_params,
+			     struct spa_buffer **buffers,
+			     uint32_t *n_buffers)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_port_set_io(struct spa_node *node,
+		      enum spa_direction direction,
+		      uint32_t port_id,
+		      struct spa_port_io *io)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+	port->io = io;
+
+	return SPA_RESULT_OK;
+}
+
+static void recycle_buffer(struct impl *this, uint32_t id)
+{
+	struct port *port = &this->out_ports[0];
+	struct buffer *b = &port->buffers[id];
+
+	if (!b->outstanding) {
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+
+	spa_list_insert(port->empty.prev, &b->link);
+	b->outstanding = false;
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
+
+static int impl_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, SPA_DIRECTION_OUTPUT, port_id),
+			       SPA_RESULT_INVALID_PORT);
+
+	port = &this->out_ports[port_id];
+
+	if (port->n_buffers == 0)
+		return SPA_RESULT_NO_BUFFERS;
+
+	if (buffer_id >= port->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	recycle_buffer(this, buffer_id);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_send_command(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    const struct spa_command *command)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static struct buffer *find_free_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->empty))
+		return NULL;
+
+	b = spa_list_first(&port->empty, struct buffer, link);
+	spa_list_remove(&b->link);
+	b->outstanding = true;
+
+	return b;
+}
+
+/* get the planes of a buffer, the chunks of the output buffer are updated */
+static void
+get_frame(struct impl *this, struct port *port, struct spa_buffer *buf, bool output,
+	  struct video_convert_frame *frame)
+{
+	struct spa_data *d = buf->datas;
+	uint32_t i;
+
+	if (buf->n_datas >= port->n_planes) {
+		for (i = 0; i < port->n_planes; i++) {
+			if (output) {
+				size_t end = i + 1 < port->n_planes ?
+				    port->offsets[i + 1] : port->size;
+
+				d[i].chunk->offset = 0;
+				d[i].chunk->size = end - port->offsets[i];
+				d[i].chunk->stride = port->strides[i];
+			}
+			frame->data[i] = SPA_MEMBER(d[i].data, d[i].chunk->offset, uint8_t);
+			frame->stride[i] = d[i].chunk->stride ? d[i].chunk->stride : port->strides[i];
+		}
+	} else {
+		if (output) {
+			d[0].chunk->offset = 0;
+			d[0].chunk->size = port->size;
+			d[0].chunk->stride = port->strides[0];
+		}
+		for (i = 0; i < port->n_planes; i++) {
+			frame->data[i] = SPA_MEMBER(d[0].data,
+						    d[0].chunk->offset + port->offsets[i], uint8_t);
+			frame->stride[i] = port->strides[i];
+		}
+	}
+}
+
+static bool clip_region(const struct spa_meta_region *r, const struct spa_rectangle *size,
+			struct video_convert_region *region)
+{
+	int64_t x0 = SPA_MAX(r->x, 0), y0 = SPA_MAX(r->y, 0);
+	int64_t x1 = SPA_MIN((int64_t) r->x + r->width, size->width);
+	int64_t y1 = SPA_MIN((int64_t) r->y + r->height, size->height);
+
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	region->x = x0;
+	region->y = y0;
+	region->width = x1 - x0;
+	region->height = y1 - y0;
+	return true;
+}
+
+/* keep the damage of the new input frame in the history */
+static void record_damage(struct impl *this, struct buffer *sbuf)
+{
+	struct damage *d = &this->history[this->frame % DAMAGE_HISTORY];
+	struct spa_meta_video_damage *damage = sbuf->damage;
+	struct spa_rectangle *size = &this->in_ports[0].current_format.info.raw.size;
+	uint32_t i;
+
+	d->all = damage == NULL ||
+	    (damage->flags & SPA_META_VIDEO_DAMAGE_FLAG_ALL) ||
+	    damage->n_regions > SPA_MIN(MAX_DAMAGE,
+					spa_meta_video_damage_max_regions(sbuf->damage_size)) ||
+	    (sbuf->h && (sbuf->h->flags & SPA_META_HEADER_FLAG_DISCONT));
+	d->n_regions = 0;
+
+	if (d->all)
+		return;
+
+	for (i = 0; i < damage->n_regions; i++) {
+		if (clip_region(&damage->regions[i], size, &d->regions[d->n_regions]))
+			d->n_regions++;
+	}
+}
+
+/* collect the regions that changed since the frame in \a dbuf, returns false
+ * when the complete frame needs to be converted */
+static bool collect_damage(struct impl *this, struct buffer *dbuf)
+{
+	struct spa_rectangle *size = &this->in_ports[0].current_format.info.raw.size;
+	uint64_t area = 0;
+	uint32_t f, i;
+
+	this->n_regions = 0;
+
+	if (dbuf->frame == 0 || this->frame - dbuf->frame > DAMAGE_HISTORY)
+		return false;
+
+	for (f = dbuf->frame + 1; f != this->frame + 1; f++) {
+		struct damage *d = &this->history[f % DAMAGE_HISTORY];
+
+		if (d->all || this->n_regions + d->n_regions > MAX_REGIONS)
+			return false;
+
+		for (i = 0; i < d->n_regions; i++) {
+			struct video_convert_region *r = &d->regions[i];
+
+			this->regions[this->n_regions++] = *r;
+			area += (uint64_t) r->width * r->height;
+		}
+	}
+	/* converting more than half of the frame in regions is not faster */
+	return area * 2 < (uint64_t) size->width * size->height;
+}
+
+/* the damage of the output frame is the scaled damage of the input frame */
+static void set_output_damage(struct impl *this, struct buffer *dbuf)
+{
+	struct damage *d = &this->history[this->frame % DAMAGE_HISTORY];
+	struct spa_meta_video_damage *damage = dbuf->damage;
+	uint32_t i;
+
+	damage->flags = 0;
+	damage->n_regions = 0;
+
+	if (d->all) {
+		spa_meta_video_damage_set_all(damage);
+		return;
+	}
+	for (i = 0; i < d->n_regions; i++) {
+		struct video_convert_region r;
+		struct spa_meta_region region;
+
+		video_convert_map_region(this->conv, &d->regions[i], &r);
+		region.x = r.x;
+		region.y = r.y;
+		region.width = r.width;
+		region.height = r.height;
+		spa_meta_video_damage_add(damage, dbuf->damage_size, &region);
+	}
+}
+
+static int impl_node_process_input(struct spa_node *node)
+{
+	struct impl *this;
+	struct spa_port_io *input;
+	struct spa_port_io *output;
+	struct port *in_port, *out_port;
+	struct buffer *sbuf, *dbuf;
+	struct video_convert_frame src, dst;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = &this->out_ports[0];
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, SPA_RESULT_ERROR);
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	in_port = &this->in_ports[0];
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, SPA_RESULT_ERROR);
+
+	if (input->buffer_id >= in_port->n_buffers)
+		return SPA_RESULT_NEED_BUFFER;
+
+	if (this->conv == NULL)
+		return SPA_RESULT_NO_FORMAT;
+
+	if ((dbuf = find_free_buffer(this, out_port)) == NULL)
+		return SPA_RESULT_OUT_OF_BUFFERS;
+
+	sbuf = &in_port->buffers[input->buffer_id];
+
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	/* frame 0 is used for buffers that hold no frame */
+	if (++this->frame == 0)
+		this->frame = 1;
+	record_damage(this, sbuf);
+	this->full = !collect_damage(this, dbuf);
+
+	get_frame(this, in_port, sbuf->outbuf, false, &src);
+	get_frame(this, out_port, dbuf->outbuf, true, &dst);
+
+	spa_log_trace(this->log, NAME " %p: convert frame %u into buffer with frame %u, %u regions",
+		      this, this->frame, dbuf->frame, this->full ? 0 : this->n_regions);
+
+	if (this->full || this->n_regions > 0)
+		do_convert(this, &src, &dst);
+	dbuf->frame = this->frame;
+
+	if (sbuf->h && dbuf->h)
+		*dbuf->h = *sbuf->h;
+	if (dbuf->damage)
+		set_output_damage(this, dbuf);
+
+	output->buffer_id = dbuf->outbuf->id;
+	output->status = SPA_RESULT_HAVE_BUFFER;
+
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static int impl_node_process_output(struct spa_node *node)
+{
+	struct impl *this;
+	struct port *in_port, *out_port;
+	struct spa_port_io *input, *output;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = &this->out_ports[0];
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, SPA_RESULT_ERROR);
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	/* recycle */
+	if (output->buffer_id < out_port->n_buffers) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
+	in_port = &this->in_ports[0];
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, SPA_RESULT_ERROR);
+
+	input->range = output->range;
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	return SPA_RESULT_NEED_BUFFER;
+}
+
+static const struct spa_dict_item node_info_items[] = {
+	{ "media.class", "Video/Filter" },
+};
+
+static const struct spa_dict node_info = {
+	SPA_N_ELEMENTS(node_info_items),
+	node_info_items
+};
+
+static const struct spa_node impl_node = {
+	SPA_VERSION_NODE,
+	&node_info,
+	impl_node_get_props,
+	impl_node_set_props,
+	impl_node_send_command,
+	impl_node_set_callbacks,
+	impl_node_get_n_ports,
+	impl_node_get_port_ids,
+	impl_node_add_port,
+	impl_node_remove_port,
+	impl_node_port_enum_formats,
+	impl_node_port_set_format,
+	impl_node_port_get_format,
+	impl_node_port_get_info,
+	impl_node_port_enum_params,
+	impl_node_port_set_param,
+	impl_node_port_use_buffers,
+	impl_node_port_alloc_buffers,
+	impl_node_port_set_io,
+	impl_node_port_reuse_buffer,
+	impl_node_port_send_command,
+	impl_node_process_input,
+	impl_node_process_output,
+};
+
+static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id, void **interface)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(interface != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = (struct impl *) handle;
+
+	if (interface_id == this->type.node)
+		*interface = &this->node;
+	else
+		return SPA_RESULT_UNKNOWN_INTERFACE;
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = (struct impl *) handle;
+
+	if (this->conv)
+		video_convert_free(this->conv);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *this;
+	uint32_t i;
+
+	spa_return_val_if_fail(factory != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this = (struct impl *) handle;
+
+	for (i = 0; i < n_support; i++) {
+		if (strcmp(support[i].type, SPA_TYPE__TypeMap) == 0)
+			this->map = support[i].data;
+		else if (strcmp(support[i].type, SPA_TYPE__Log) == 0)
+			this->log = support[i].data;
+		else if (strcmp(support[i].type, SPA_TYPE_LOOP__DataLoop) == 0)
+			this->data_loop = support[i].data;
+	}
+	if (this->map == NULL) {
+		spa_log_error(this->log, "a type-map is needed");
+		return SPA_RESULT_ERROR;
+	}
+	init_type(&this->type, this->map);
+
+	this->node = impl_node;
+	reset_props(this, &this->props);
+
+	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->in_ports[0].empty);
+
+	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
+	    SPA_PORT_INFO_FLAG_NO_REF;
+	spa_list_init(&this->out_ports[0].empty);
+
+	return SPA_RESULT_OK;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE__Node,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t index)
+{
+	spa_return_val_if_fail(factory != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(info != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	switch (index) {
+	case 0:
+		*info = &impl_interfaces[index];
+		break;
+	default:
+		return SPA_RESULT_ENUM_END;
+	}
+	return SPA_RESULT_OK;
+}
+
+static const struct spa_dict_item info_items[] = {
+	{ "factory.author", "Wim Taymans <wim.taymans@gmail.com>" },
+	{ "factory.description", "Convert and scale raw video" },
+};
+
+static const struct spa_dict info = {
+	SPA_N_ELEMENTS(info_items),
+	info_items
+};
+
+const struct spa_handle_factory spa_videoconvert_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	NAME,
+	&info,
+	sizeof(struct impl),
+	impl_init,
+	impl_enum_interface_info,
+};
@@ -17,6 +17,8 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <endian.h>
+
 typedef enum {
 	GRAY = 0,
 	YELLOW,
@@ -31,6 +33,7 @@ typedef enum {
 	POS_Q,
 	DARK_BLACK,
 	LIGHT_BLACK,
+	SNOW,
 	N_COLORS
 } Color;
 
@@ -59,20 +62,44 @@ static Pixel colors[N_COLORS] = {
 	{49, 0, 107, 0, 0, 0},		/* POSITIVE Q */
 	{9, 9, 9, 0, 0, 0},		/* DARK BLACK */
 	{29, 29, 29, 0, 0, 0},		/* LIGHT BLACK */
+	{128, 128, 128, 0, 0, 0},	/* SNOW, the chroma of the snow area */
 };
 
 /* YUV values are computed in init_colors() */
 
-typedef struct _DrawingData DrawingData;
-
-typedef void (*DrawPixelFunc) (DrawingData * dd, int x, Pixel * pixel);
+#define MAX_PLANES	3
+#define N_BANDS		3
+/* the snow generator runs this many xorshift generators side by side so
+ * that the compiler can keep them in vector registers */
+#define NOISE_LANES	8
+
+typedef void (*DrawPixelFunc) (uint8_t *lines[], int x, const Pixel *pixel);
+typedef void (*DrawNoiseFunc) (uint8_t *line, const uint8_t *noise, int width);
+
+struct draw_format {
+	uint32_t n_planes;
+	int bpp;			/**< bytes per pixel in the first plane */
+	DrawPixelFunc draw_pixel;	/**< only used to render the templates */
+	DrawNoiseFunc draw_noise;	/**< expands gray noise into a packed line,
+					  *  NULL when the first plane is luma */
+};
 
-struct _DrawingData {
-	char *line;
+/* The SMPTE pattern has 3 bands of identical lines. A line of each band is
+ * rendered once per format and every frame only copies the lines, the snow
+ * is the only part that is generated for each frame. */
+struct draw_cache {
+	const struct draw_format *format;
 	int width;
 	int height;
-	int stride;
-	DrawPixelFunc draw_pixel;
+	int strides[MAX_PLANES];
+	size_t offsets[MAX_PLANES];
+	int band_end[N_BANDS];		/**< last line + 1 of each band */
+	int snow_x;			/**< start of the snow in the last band */
+
+	uint8_t *lines[N_BANDS][MAX_PLANES];	/**< line templates */
+
+	uint32_t noise_state[NOISE_LANES];
+	uint8_t *noise;			/**< a line of noise */
 };
 
 static inline void update_yuv(Pixel * pixel)
@@ -108,171 +135,330 @@ static void init_colors(void)
 	}
 }
 
-static void draw_pixel_rgb(DrawingData * dd, int x, Pixel * color)
+static void draw_pixel_rgb(uint8_t *lines[], int x, const Pixel * color)
+{
+	lines[0][3 * x + 0] = color->R;
+	lines[0][3 * x + 1] = color->G;
+	lines[0][3 * x + 2] = color->B;
+}
+
+static void draw_pixel_rgbx(uint8_t *lines[], int x, const Pixel * color)
+{
+	lines[0][4 * x + 0] = color->R;
+	lines[0][4 * x + 1] = color->G;
+	lines[0][4 * x + 2] = color->B;
+	lines[0][4 * x + 3] = 0xff;
+}
+
+static void draw_pixel_bgrx(uint8_t *lines[], int x, const Pixel * color)
 {
-	dd->line[3 * x + 0] = color->R;
-	dd->line[3 * x + 1] = color->G;
-	dd->line[3 * x + 2] = color->B;
+	lines[0][4 * x + 0] = color->B;
+	lines[0][4 * x + 1] = color->G;
+	lines[0][4 * x + 2] = color->R;
+	lines[0][4 * x + 3] = 0xff;
 }
 
-static void draw_pixel_uyvy(DrawingData * dd, int x, Pixel * color)
+static void draw_pixel_uyvy(uint8_t *lines[], int x, const Pixel * color)
 {
 	if (x & 1) {
 		/* odd pixel */
-		dd->line[2 * (x - 1) + 3] = color->Y;
+		lines[0][2 * (x - 1) + 3] = color->Y;
 	} else {
 		/* even pixel */
-		dd->line[2 * x + 0] = color->U;
-		dd->line[2 * x + 1] = color->Y;
-		dd->line[2 * x + 2] = color->V;
+		lines[0][2 * x + 0] = color->U;
+		lines[0][2 * x + 1] = color->Y;
+		lines[0][2 * x + 2] = color->V;
 	}
 }
 
-static int drawing_data_init(DrawingData * dd, struct impl *this, char *data)
+/* the chroma of the even pixel is used for the pair */
+static void draw_pixel_nv12(uint8_t *lines[], int x, const Pixel * color)
 {
-	struct spa_video_info *format = &this->current_format;
-	struct spa_rectangle *size = &format->info.raw.size;
-
-	if ((format->media_type != this->type.media_type.video) ||
-	    (format->media_subtype != this->type.media_subtype.raw))
-		return SPA_RESULT_NOT_IMPLEMENTED;
+	lines[0][x] = color->Y;
+	if (!(x & 1)) {
+		lines[1][x + 0] = color->U;
+		lines[1][x + 1] = color->V;
+	}
+}
 
-	if (format->info.raw.format == this->type.video_format.RGB) {
-		dd->draw_pixel = draw_pixel_rgb;
-	} else if (format->info.raw.format == this->type.video_format.UYVY) {
-		dd->draw_pixel = draw_pixel_uyvy;
-	} else
-		return SPA_RESULT_NOT_IMPLEMENTED;
+static void draw_pixel_i420(uint8_t *lines[], int x, const Pixel * color)
+{
+	lines[0][x] = color->Y;
+	if (!(x & 1)) {
+		lines[1][x / 2] = color->U;
+		lines[2][x / 2] = color->V;
+	}
+}
 
-	dd->line = data;
-	dd->width = size->width;
-	dd->height = size->height;
-	dd->stride = this->stride;
+static void draw_noise_rgb(uint8_t *line, const uint8_t *noise, int width)
+{
+	int x;
 
-	return SPA_RESULT_OK;
+	for (x = 0; x < width; x++) {
+		line[3 * x + 0] = noise[x];
+		line[3 * x + 1] = noise[x];
+		line[3 * x + 2] = noise[x];
+	}
 }
 
-static inline void draw_pixels(DrawingData * dd, int offset, Color color, int length)
+/* the gray pixels of RGBx and BGRx are the same */
+static void draw_noise_rgbx(uint8_t *line, const uint8_t *noise, int width)
 {
+	uint32_t *d = (uint32_t *) line;
 	int x;
 
-	for (x = offset; x < offset + length; x++) {
-		dd->draw_pixel(dd, x, &colors[color]);
+	for (x = 0; x < width; x++) {
+#if __BYTE_ORDER == __BIG_ENDIAN
+		d[x] = (noise[x] * 0x01010100u) | 0xff;
+#else
+		d[x] = (noise[x] * 0x00010101u) | 0xff000000u;
+#endif
 	}
 }
 
-static inline void next_line(DrawingData * dd)
+/* starts on an even pixel, the luma of gray noise is the noise itself */
+static void draw_noise_uyvy(uint8_t *line, const uint8_t *noise, int width)
 {
-	dd->line += dd->stride;
+	int x;
+
+	for (x = 0; x + 1 < width; x += 2) {
+		line[2 * x + 0] = 128;
+		line[2 * x + 1] = noise[x];
+		line[2 * x + 2] = 128;
+		line[2 * x + 3] = noise[x + 1];
+	}
+	if (x < width) {
+		line[2 * x + 0] = 128;
+		line[2 * x + 1] = noise[x];
+		line[2 * x + 2] = 128;
+	}
 }
 
-static void draw_smpte_snow(DrawingData * dd)
+static const struct draw_format format_rgb = { 1, 3, draw_pixel_rgb, draw_noise_rgb };
+static const struct draw_format format_rgbx = { 1, 4, draw_pixel_rgbx, draw_noise_rgbx };
+static const struct draw_format format_bgrx = { 1, 4, draw_pixel_bgrx, draw_noise_rgbx };
+static const struct draw_format format_uyvy = { 1, 2, draw_pixel_uyvy, draw_noise_uyvy };
+static const struct draw_format format_nv12 = { 2, 1, draw_pixel_nv12, NULL };
+static const struct draw_format format_i420 = { 3, 1, draw_pixel_i420, NULL };
+
+/* fill \a n bytes with noise, a xorshift32 generator per lane */
+static void noise_fill(struct draw_cache *c, uint8_t *dst, int n)
 {
-	int h, w;
-	int y1, y2;
-	int i, j;
-
-	w = dd->width;
-	h = dd->height;
-	y1 = 2 * h / 3;
-	y2 = 3 * h / 4;
-
-	for (i = 0; i < y1; i++) {
-		for (j = 0; j < 7; j++) {
-			int x1 = j * w / 7;
-			int x2 = (j + 1) * w / 7;
-			draw_pixels(dd, x1, j, x2 - x1);
+	uint32_t *s = c->noise_state;
+	int i, chunk;
+
+	while (n > 0) {
+		for (i = 0; i < NOISE_LANES; i++) {
+			uint32_t x = s[i];
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			s[i] = x;
 		}
-		next_line(dd);
+		chunk = SPA_MIN(n, (int) sizeof(c->noise_state));
+		memcpy(dst, s, chunk);
+		dst += chunk;
+		n -= chunk;
 	}
+}
 
-	for (i = y1; i < y2; i++) {
-		for (j = 0; j < 7; j++) {
-			int x1 = j * w / 7;
-			int x2 = (j + 1) * w / 7;
-			Color c = (j & 1) ? BLACK : BLUE - j;
-
-			draw_pixels(dd, x1, c, x2 - x1);
-		}
-		next_line(dd);
+static inline void draw_noise(struct draw_cache *c, uint8_t *line, int x, int width)
+{
+	if (c->format->draw_noise == NULL) {
+		noise_fill(c, line + x, width);
+	} else {
+		noise_fill(c, c->noise, width);
+		c->format->draw_noise(line + x * c->format->bpp, c->noise, width);
 	}
+}
 
-	for (i = y2; i < h; i++) {
-		int x = 0;
-
-		/* negative I */
-		draw_pixels(dd, x, NEG_I, w / 6);
-		x += w / 6;
-
-		/* white */
-		draw_pixels(dd, x, WHITE, w / 6);
-		x += w / 6;
-
-		/* positive Q */
-		draw_pixels(dd, x, POS_Q, w / 6);
-		x += w / 6;
-
-		/* pluge */
-		draw_pixels(dd, x, DARK_BLACK, w / 12);
-		x += w / 12;
-		draw_pixels(dd, x, BLACK, w / 12);
-		x += w / 12;
-		draw_pixels(dd, x, LIGHT_BLACK, w / 12);
-		x += w / 12;
-
-		/* war of the ants (a.k.a. snow) */
-		for (j = x; j < w; j++) {
-			Pixel p;
-			unsigned char r = rand();
-
-			p.R = r;
-			p.G = r;
-			p.B = r;
-			update_yuv(&p);
-			dd->draw_pixel(dd, j, &p);
-		}
+static void template_pixels(struct draw_cache *c, int band, int offset, Color color, int length)
+{
+	int x;
+
+	for (x = offset; x < offset + length; x++)
+		c->format->draw_pixel(c->lines[band], x, &colors[color]);
+}
+
+static void render_templates(struct draw_cache *c)
+{
+	int w = c->width, x, j;
+
+	for (j = 0; j < 7; j++) {
+		int x1 = j * w / 7;
+		int x2 = (j + 1) * w / 7;
 
-		next_line(dd);
+		template_pixels(c, 0, x1, j, x2 - x1);
+		template_pixels(c, 1, x1, (j & 1) ? BLACK : BLUE - j, x2 - x1);
 	}
+
+	x = 0;
+	/* negative I */
+	template_pixels(c, 2, x, NEG_I, w / 6);
+	x += w / 6;
+	/* white */
+	template_pixels(c, 2, x, WHITE, w / 6);
+	x += w / 6;
+	/* positive Q */
+	template_pixels(c, 2, x, POS_Q, w / 6);
+	x += w / 6;
+	/* pluge */
+	template_pixels(c, 2, x, DARK_BLACK, w / 12);
+	x += w / 12;
+	template_pixels(c, 2, x, BLACK, w / 12);
+	x += w / 12;
+	template_pixels(c, 2, x, LIGHT_BLACK, w / 12);
+	x += w / 12;
+
+	/* war of the ants (a.k.a. snow), starts on a chroma pair */
+	c->snow_x = x & ~1;
+	template_pixels(c, 2, c->snow_x, SNOW, w - c->snow_x);
+}
+
+static void drawing_clear(struct impl *this)
+{
+	free(this->cache);
+	this->cache = NULL;
 }
 
-static void draw_snow(DrawingData * dd)
+/* compute the plane layout of the current format and render the line
+ * templates of the pattern */
+static int drawing_set_format(struct impl *this)
 {
-	int x, y;
-
-	for (y = 0; y < dd->height; y++) {
-		for (x = 0; x < dd->width; x++) {
-			Pixel p;
-			unsigned char r = rand();
-
-			p.R = r;
-			p.G = r;
-			p.B = r;
-			update_yuv(&p);
-			dd->draw_pixel(dd, x, &p);
+	struct spa_video_info *format = &this->current_format;
+	const struct draw_format *df;
+	struct draw_cache *c;
+	int w, h, i, j, strides[MAX_PLANES] = { 0, }, heights[MAX_PLANES] = { 0, };
+	size_t size, lines_size;
+	uint8_t *p;
+
+	if ((format->media_type != this->type.media_type.video) ||
+	    (format->media_subtype != this->type.media_subtype.raw))
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	w = format->info.raw.size.width;
+	h = format->info.raw.size.height;
+	heights[0] = h;
+
+	if (format->info.raw.format == this->type.video_format.RGB) {
+		df = &format_rgb;
+		strides[0] = SPA_ROUND_UP_N(w * 3, 4);
+	} else if (format->info.raw.format == this->type.video_format.RGBx) {
+		df = &format_rgbx;
+		strides[0] = w * 4;
+	} else if (format->info.raw.format == this->type.video_format.BGRx) {
+		df = &format_bgrx;
+		strides[0] = w * 4;
+	} else if (format->info.raw.format == this->type.video_format.UYVY) {
+		df = &format_uyvy;
+		strides[0] = SPA_ROUND_UP_N(w * 2, 4);
+	} else if (format->info.raw.format == this->type.video_format.NV12) {
+		df = &format_nv12;
+		strides[0] = strides[1] = SPA_ROUND_UP_N(w, 4);
+		heights[1] = (h + 1) / 2;
+	} else if (format->info.raw.format == this->type.video_format.I420) {
+		df = &format_i420;
+		strides[0] = SPA_ROUND_UP_N(w, 4);
+		strides[1] = strides[2] = SPA_ROUND_UP_N((w + 1) / 2, 4);
+		heights[1] = heights[2] = (h + 1) / 2;
+	} else
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	init_colors();
+
+	for (i = 0, size = 0, lines_size = 0; i < df->n_planes; i++) {
+		size += (size_t) strides[i] * heights[i];
+		lines_size += N_BANDS * strides[i];
+	}
+
+	drawing_clear(this);
+
+	c = calloc(1, sizeof(struct draw_cache) + lines_size + SPA_ROUND_UP_N(w, 32));
+	if (c == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	c->format = df;
+	c->width = w;
+	c->height = h;
+	c->band_end[0] = 2 * h / 3;
+	c->band_end[1] = 3 * h / 4;
+	c->band_end[2] = h;
+
+	p = SPA_MEMBER(c, sizeof(struct draw_cache), uint8_t);
+	for (i = 0, size = 0; i < df->n_planes; i++) {
+		c->strides[i] = strides[i];
+		c->offsets[i] = size;
+		size += (size_t) strides[i] * heights[i];
+
+		for (j = 0; j < N_BANDS; j++) {
+			c->lines[j][i] = p;
+			p += strides[i];
 		}
+	}
+	c->noise = p;
+
+	for (i = 0; i < NOISE_LANES; i++)
+		c->noise_state[i] = 0x9e3779b9u * (i + 1);
+
+	render_templates(c);
+
+	this->cache = c;
+	this->stride = strides[0];
+	this->size = size;
+
+	return SPA_RESULT_OK;
+}
+
+static void draw_smpte_snow(struct draw_cache *c, uint8_t *data)
+{
+	uint32_t i;
+	int b, y, end;
+	uint8_t *line;
 
-		next_line(dd);
+	for (i = 0; i < c->format->n_planes; i++) {
+		line = data + c->offsets[i];
+
+		for (b = 0, y = 0; b < N_BANDS; b++) {
+			/* the subsampled lines take the chroma of the even luma line */
+			end = i == 0 ? c->band_end[b] : (c->band_end[b] + 1) / 2;
+
+			for (; y < end; y++, line += c->strides[i])
+				memcpy(line, c->lines[b][i], c->strides[i]);
+		}
 	}
+
+	line = data + c->band_end[1] * c->strides[0];
+	for (y = c->band_end[1]; y < c->height; y++, line += c->strides[0])
+		draw_noise(c, line, c->snow_x, c->width - c->snow_x);
 }
 
-static int draw(struct impl *this, char *data)
+static void draw_snow(struct draw_cache *c, uint8_t *data)
 {
-	DrawingData dd;
-	int res;
-	uint32_t pattern;
+	uint32_t i;
+	int y;
+	uint8_t *line;
 
-	init_colors();
+	line = data;
+	for (y = 0; y < c->height; y++, line += c->strides[0])
+		draw_noise(c, line, 0, c->width);
+
+	/* the chroma of gray */
+	for (i = 1; i < c->format->n_planes; i++)
+		memset(data + c->offsets[i], 128, (size_t) c->strides[i] * ((c->height + 1) / 2));
+}
+
+static int draw(struct impl *this, uint8_t *data)
+{
+	uint32_t pattern;
 
-	res = drawing_data_init(&dd, this, data);
-	if (res != SPA_RESULT_OK)
-		return res;
+	if (this->cache == NULL)
+		return SPA_RESULT_NO_FORMAT;
 
 	pattern = this->props.pattern;
 	if (pattern == this->type.pattern_smpte_snow)
-		draw_smpte_snow(&dd);
+		draw_smpte_snow(this->cache, data);
 	else if (pattern == this->type.pattern_snow)
-		draw_snow(&dd);
+		draw_snow(this->cache, data);
 	else
 		return SPA_RESULT_NOT_IMPLEMENTED;
 
@@ -19,6 +19,7 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
@@ -93,6 +94,8 @@ struct props {
 #define MAX_BUFFERS 16
 #define MAX_PORTS 1
 
+struct draw_cache;
+
 struct buffer {
 	struct spa_buffer *outbuf;
 	bool outstanding;
@@ -127,8 +130,9 @@ struct impl {
 	bool have_format;
 	struct spa_video_info current_format;
 	uint8_t format_buffer[1024];
-	size_t bpp;
 	int stride;
+	size_t size;
+	struct draw_cache *cache;
 
 	struct buffer buffers[MAX_BUFFERS];
 	uint32_t n_buffers;
@@ -257,7 +261,6 @@ static int make_buffer(struct impl *this)
 {
 	struct buffer *b;
 	struct spa_port_io *io = this->io;
-	int n_bytes;
 
 	read_timer(this);
 
@@ -270,14 +273,12 @@ static int make_buffer(struct impl *this)
 	spa_list_remove(&b->link);
 	b->outstanding = true;
 
-	n_bytes = b->outbuf->datas[0].maxsize;
-
 	spa_log_trace(this->log, NAME " %p: dequeue buffer %d", this, b->outbuf->id);
 
 	fill_buffer(this, b);
 
 	b->outbuf->datas[0].chunk->offset = 0;
-	b->outbuf->datas[0].chunk->size = n_bytes;
+	b->outbuf->datas[0].chunk->size = this->size;
 	b->outbuf->datas[0].chunk->stride = this->stride;
 
 	if (b->h) {
@@ -453,10 +454,14 @@ impl_node_port_enum_formats(struct spa_node *node,
 		spa_pod_builder_format(&b, &f[0], this->type.format,
 			this->type.media_type.video,
 			this->type.media_subtype.raw,
-			PROP_U_EN(&f[1], this->type.format_video.format, SPA_POD_TYPE_ID, 3,
+			PROP_U_EN(&f[1], this->type.format_video.format, SPA_POD_TYPE_ID, 7,
 				this->type.video_format.RGB,
 				this->type.video_format.RGB,
-				this->type.video_format.UYVY),
+				this->type.video_format.UYVY,
+				this->type.video_format.RGBx,
+				this->type.video_format.BGRx,
+				this->type.video_format.NV12,
+				this->type.video_format.I420),
 			PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
 				320, 240,
 				1, 1,
@@ -511,7 +516,11 @@ impl_node_port_set_format(struct spa_node *node,
 	if (format == NULL) {
 		this->have_format = false;
 		clear_buffers(this);
+		drawing_clear(this);
 	} else {
+		struct spa_video_info old = this->current_format;
+		int res;
+
 		struct spa_video_info info = { SPA_FORMAT_MEDIA_TYPE(format),
 			SPA_FORMAT_MEDIA_SUBTYPE(format),
 		};
@@ -523,22 +532,15 @@ impl_node_port_set_format(struct spa_node *node,
 		if (!spa_format_video_raw_parse(format, &info.info.raw, &this->type.format_video))
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
-		if (info.info.raw.format == this->type.video_format.RGB)
-			this->bpp = 3;
-		else if (info.info.raw.format == this->type.video_format.UYVY)
-			this->bpp = 2;
-		else
-			return SPA_RESULT_INVALID_MEDIA_TYPE;
-
 		this->current_format = info;
+		if ((res = drawing_set_format(this)) < 0) {
+			this->current_format = old;
+			return res == SPA_RESULT_NOT_IMPLEMENTED ?
+				SPA_RESULT_INVALID_MEDIA_TYPE : res;
+		}
 		this->have_format = true;
 	}
 
-	if (this->have_format) {
-		struct spa_video_info_raw *raw_info = &this->current_format.info.raw;
-		this->stride = SPA_ROUND_UP_N(this->bpp * raw_info->size.width, 4);
-	}
-
 	return SPA_RESULT_OK;
 }
 
@@ -619,20 +621,17 @@ impl_node_port_enum_params(struct spa_node *node,
 	spa_pod_builder_init(&b, this->params_buffer, sizeof(this->params_buffer));
 
 	switch (index) {
-	case 0: {
-		struct spa_video_info_raw *raw_info = &this->current_format.info.raw;
-
+	case 0:
 		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
 			PROP(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
-				this->stride * raw_info->size.height),
+				this->size),
 			PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT,
 				this->stride),
 			PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
 				2, 1, 32),
 			PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT,
 				16));
-			break;
-	}
+		break;
 	case 1:
 		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
 			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
@@ -696,6 +695,11 @@ impl_node_port_use_buffers(struct spa_node *node,
 				      buffers[i]);
 			return SPA_RESULT_ERROR;
 		}
+		if (d[0].maxsize < this->size) {
+			spa_log_error(this->log, NAME " %p: buffer %p too small, %u < %zd", this,
+				      buffers[i], d[0].maxsize, this->size);
+			return SPA_RESULT_ERROR;
+		}
 		spa_list_append(&this->empty, &b->link);
 	}
 	this->n_buffers = n_buffers;
@@ -924,6 +928,7 @@ static int impl_clear(struct spa_handle *handle)
 	if (this->data_loop)
 		spa_loop_remove_source(this->data_loop, &this->timer_source);
 	close(this->timer_source.fd);
+	drawing_clear(this);
 
 	return SPA_RESULT_OK;
 }
@@ -714,6 +714,7 @@ static int impl_node_process_input(struct spa_node *node)
 	struct spa_port_io *output;
 	struct port *in_port, *out_port;
 	struct spa_buffer *dbuf, *sbuf;
+	struct buffer *sb, *db;
 
 	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
 
@@ -737,12 +738,18 @@ static int impl_node_process_input(struct spa_node *node)
 	if ((dbuf = find_free_buffer(this, out_port)) == NULL)
 		return SPA_RESULT_OUT_OF_BUFFERS;
 
-	sbuf = in_port->buffers[input->buffer_id].outbuf;
+	sb = &in_port->buffers[input->buffer_id];
+	sbuf = sb->outbuf;
 
 	input->status = SPA_RESULT_NEED_BUFFER;
 
 	do_volume(this, sbuf, dbuf);
 
+	/* keep the timestamps of the input */
+	db = &out_port->buffers[dbuf->id];
+	if (sb->h && db->h)
+		*db->h = *sb->h;
+
 	output->buffer_id = dbuf->id;
 	output->status = SPA_RESULT_HAVE_BUFFER;
 
@@ -0,0 +1,48 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+
+#include <spa/graph-scheduler1.h>
+
+#include "benchmark-graph.h"
+
+static void *init(struct spa_graph *graph)
+{
+	struct spa_graph_data *data;
+
+	if ((data = calloc(1, sizeof(struct spa_graph_data))) == NULL)
+		return NULL;
+
+	spa_graph_data_init(data, graph);
+	spa_graph_set_callbacks(graph, &spa_graph_impl_default, data);
+
+	return data;
+}
+
+static void clear(void *data)
+{
+	free(data);
+}
+
+const struct scheduler benchmark_scheduler1 = {
+	"graph-scheduler1",
+	init,
+	clear,
+};
@@ -0,0 +1,848 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <spa/node.h>
+#include <spa/log-impl.h>
+#include <spa/type-map-impl.h>
+#include <spa/audio/format-utils.h>
+#include <spa/format-utils.h>
+#include <spa/format-builder.h>
+
+#include "benchmark-graph.h"
+
+/* Builds graphs of fakesrc, fakesink, volume and audiomixer nodes and runs
+ * them synchronously under each of the graph schedulers. The time of every
+ * cycle is measured, a cycle pulls all sinks (or pushes all sources) once.
+ * None of the plugins has more than one output, so there are no graphs where
+ * a node feeds several peers. */
+
+#define DEFAULT_CYCLES		10000
+#define DEFAULT_SIZE		4
+#define DEFAULT_BUFFER_SIZE	1024
+#define DEFAULT_PLUGIN_DIR	"build/spa/plugins"
+#define WARMUP_CYCLES		100
+#define RUN_TIMEOUT		60	/* seconds */
+
+#define MAX_SIZE		64
+#define MAX_NODES		(3 * MAX_SIZE + 2)
+#define MAX_LINKS		(2 * MAX_SIZE + 2)
+#define MAX_NODE_PORTS		MAX_SIZE
+#define N_BUFFERS		2
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+static const struct scheduler *schedulers[] = {
+	&benchmark_scheduler1,
+	&benchmark_scheduler3,
+};
+#define N_SCHEDULERS	SPA_N_ELEMENTS(schedulers)
+
+enum topology {
+	TOPOLOGY_CHAIN,		/* fakesrc, size volumes, fakesink */
+	TOPOLOGY_FAN_IN,	/* size fakesrcs into an audiomixer, fakesink */
+	TOPOLOGY_PARALLEL,	/* size chains of fakesrc, volume, fakesink */
+	N_TOPOLOGIES,
+};
+
+static const char *topology_names[] = {
+	"chain",
+	"fan-in",
+	"parallel",
+};
+
+enum node_kind {
+	NODE_SOURCE,
+	NODE_SINK,
+	NODE_VOLUME,
+	NODE_MIXER,
+};
+
+struct plugin {
+	const char *file;
+	void *hnd;
+};
+
+enum {
+	PLUGIN_TEST,
+	PLUGIN_VOLUME,
+	PLUGIN_AUDIOMIXER,
+	N_PLUGINS,
+};
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+	struct spa_type_command_node command_node;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+	spa_type_command_node_map(map, &type->command_node);
+}
+
+struct buffer {
+	struct spa_buffer buffer;
+	struct spa_meta metas[1];
+	struct spa_meta_header header;
+	struct spa_data datas[1];
+	struct spa_chunk chunks[1];
+};
+
+/* the io area and the buffers shared by the two ports of a link */
+struct link {
+	struct spa_port_io io;
+	struct spa_buffer *buffers[N_BUFFERS];
+	struct buffer buffer[N_BUFFERS];
+};
+
+struct node {
+	enum node_kind kind;
+	struct spa_handle *handle;
+	struct spa_node *node;
+
+	struct spa_graph_node gnode;
+	struct spa_graph_port ports[2][MAX_NODE_PORTS];
+	uint32_t n_ports[2];
+
+	/* sinks are scheduled through the probe that counts the buffers */
+	struct spa_node probe;
+	struct spa_port_io *io;
+	uint64_t n_consumed;
+};
+
+struct result {
+	const char *scheduler;
+	const char *topology;
+	const char *status;		/**< ok, stalled, timeout, crashed or error */
+	uint32_t n_nodes;
+	uint64_t n_buffers;
+	int64_t elapsed;
+	int64_t min, p50, p90, p99, max;
+};
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_log *log;
+	struct type type;
+
+	struct spa_support support[2];
+	uint32_t n_support;
+
+	const char *plugin_dir;
+	struct plugin plugins[N_PLUGINS];
+
+	uint32_t cycles;
+	uint32_t size;
+	uint32_t buffer_size;
+	bool push;
+
+	struct spa_graph graph;
+
+	struct node *nodes[MAX_NODES];
+	uint32_t n_nodes;
+	struct node *sources[MAX_NODES];
+	uint32_t n_sources;
+	struct node *sinks[MAX_NODES];
+	uint32_t n_sinks;
+	struct link links[MAX_LINKS];
+	uint32_t n_links;
+	bool error;
+
+	int64_t *times;
+	struct result results[N_SCHEDULERS * N_TOPOLOGIES];
+	uint32_t n_results;
+};
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static int probe_process_input(struct spa_node *node)
+{
+	struct node *n = SPA_CONTAINER_OF(node, struct node, probe);
+
+	if (n->io->status == SPA_RESULT_HAVE_BUFFER)
+		n->n_consumed++;
+
+	return spa_node_process_input(n->node);
+}
+
+static int probe_process_output(struct spa_node *node)
+{
+	struct node *n = SPA_CONTAINER_OF(node, struct node, probe);
+
+	return spa_node_process_output(n->node);
+}
+
+static const struct spa_node probe_node = {
+	SPA_VERSION_NODE,
+	.process_input = probe_process_input,
+	.process_output = probe_process_output,
+};
+
+static int
+make_handle(struct data *data, struct node *n, struct plugin *plugin, const char *name)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	char path[PATH_MAX];
+	uint32_t i;
+	int res;
+
+	if (plugin->hnd == NULL) {
+		snprintf(path, sizeof(path), "%s/%s", data->plugin_dir, plugin->file);
+		if ((plugin->hnd = dlopen(path, RTLD_NOW)) == NULL) {
+			printf("can't load %s: %s\n", path, dlerror());
+			return SPA_RESULT_ERROR;
+		}
+	}
+	if ((enum_func = dlsym(plugin->hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return SPA_RESULT_ERROR;
+	}
+
+	for (i = 0;; i++) {
+		const struct spa_handle_factory *factory;
+		void *iface;
+
+		if ((res = enum_func(&factory, i)) < 0) {
+			if (res != SPA_RESULT_ENUM_END)
+				printf("can't enumerate factories: %d\n", res);
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		n->handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, n->handle, NULL, data->support,
+						   data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			free(n->handle);
+			n->handle = NULL;
+			return res;
+		}
+		if ((res = spa_handle_get_interface(n->handle, data->type.node, &iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return res;
+		}
+		n->node = iface;
+		return SPA_RESULT_OK;
+	}
+	return SPA_RESULT_ERROR;
+}
+
+static struct node *add_node(struct data *data, enum node_kind kind)
+{
+	struct node *n;
+	int res = SPA_RESULT_OK;
+
+	if (data->error)
+		return NULL;
+
+	if (data->n_nodes == MAX_NODES || (n = calloc(1, sizeof(struct node))) == NULL) {
+		data->error = true;
+		return NULL;
+	}
+	data->nodes[data->n_nodes++] = n;
+	n->kind = kind;
+
+	switch (kind) {
+	case NODE_SOURCE:
+		res = make_handle(data, n, &data->plugins[PLUGIN_TEST], "fakesrc");
+		data->sources[data->n_sources++] = n;
+		break;
+	case NODE_SINK:
+		res = make_handle(data, n, &data->plugins[PLUGIN_TEST], "fakesink");
+		data->sinks[data->n_sinks++] = n;
+		break;
+	case NODE_VOLUME:
+		res = make_handle(data, n, &data->plugins[PLUGIN_VOLUME], "volume");
+		break;
+	case NODE_MIXER:
+		res = make_handle(data, n, &data->plugins[PLUGIN_AUDIOMIXER], "audiomixer");
+		break;
+	}
+	if (res < 0) {
+		data->error = true;
+		return NULL;
+	}
+
+	spa_graph_node_init(&n->gnode);
+	if (kind == NODE_SINK) {
+		n->probe = probe_node;
+		spa_graph_node_set_implementation(&n->gnode, &n->probe);
+	} else
+		spa_graph_node_set_implementation(&n->gnode, n->node);
+	spa_graph_node_add(&data->graph, &n->gnode);
+
+	return n;
+}
+
+static void free_node(struct node *n)
+{
+	if (n->handle) {
+		spa_handle_clear(n->handle);
+		free(n->handle);
+	}
+	free(n);
+}
+
+static void init_link(struct data *data, struct link *l)
+{
+	int i;
+
+	l->io = SPA_PORT_IO_INIT;
+
+	for (i = 0; i < N_BUFFERS; i++) {
+		struct buffer *b = &l->buffer[i];
+
+		l->buffers[i] = &b->buffer;
+
+		b->buffer.id = i;
+		b->buffer.n_metas = 1;
+		b->buffer.metas = b->metas;
+		b->buffer.n_datas = 1;
+		b->buffer.datas = b->datas;
+
+		b->header.flags = 0;
+		b->header.seq = 0;
+		b->header.pts = 0;
+		b->header.dts_offset = 0;
+		b->metas[0].type = data->type.meta.Header;
+		b->metas[0].data = &b->header;
+		b->metas[0].size = sizeof(b->header);
+
+		b->datas[0].type = data->type.data.MemPtr;
+		b->datas[0].flags = 0;
+		b->datas[0].fd = -1;
+		b->datas[0].mapoffset = 0;
+		b->datas[0].maxsize = data->buffer_size;
+		b->datas[0].data = calloc(1, data->buffer_size);
+		b->datas[0].chunk = &b->chunks[0];
+		b->datas[0].chunk->offset = 0;
+		b->datas[0].chunk->size = data->buffer_size;
+		b->datas[0].chunk->stride = 0;
+	}
+}
+
+static void clear_link(struct link *l)
+{
+	int i;
+
+	for (i = 0; i < N_BUFFERS; i++)
+		free(l->buffer[i].datas[0].data);
+}
+
+static int set_port(struct data *data, struct node *n, enum spa_direction direction,
+		    const struct spa_format *format, struct link *l)
+{
+	uint32_t port_id = n->n_ports[direction];
+	struct spa_graph_port *p;
+	int res;
+
+	if (port_id == MAX_NODE_PORTS)
+		return SPA_RESULT_INVALID_PORT;
+
+	/* the audiomixer inputs are added on demand */
+	if (n->kind == NODE_MIXER && direction == SPA_DIRECTION_INPUT) {
+		if ((res = spa_node_add_port(n->node, direction, port_id)) < 0)
+			return res;
+	} else if (port_id > 0)
+		return SPA_RESULT_INVALID_PORT;
+
+	if ((res = spa_node_port_set_io(n->node, direction, port_id, &l->io)) < 0)
+		return res;
+	if ((res = spa_node_port_set_format(n->node, direction, port_id, 0, format)) < 0)
+		return res;
+	if ((res = spa_node_port_use_buffers(n->node, direction, port_id,
+					     l->buffers, N_BUFFERS)) < 0)
+		return res;
+
+	p = &n->ports[direction][port_id];
+	spa_graph_port_init(p, direction, port_id, 0, &l->io);
+	spa_graph_port_add(&n->gnode, p);
+	n->n_ports[direction]++;
+
+	if (n->kind == NODE_SINK)
+		n->io = &l->io;
+
+	return SPA_RESULT_OK;
+}
+
+static void link_nodes(struct data *data, struct node *out, struct node *in)
+{
+	struct spa_format *format;
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod_frame f[2];
+	uint8_t buffer[256];
+	struct link *l;
+	int res;
+
+	if (out == NULL || in == NULL || data->error)
+		goto error;
+	if (data->n_links == MAX_LINKS)
+		goto error;
+
+	l = &data->links[data->n_links++];
+	init_link(data, l);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_pod_builder_format(&b, &f[0], data->type.format,
+		data->type.media_type.audio,
+		data->type.media_subtype.raw,
+		SPA_POD_PROP(&f[1], data->type.format_audio.format, 0, SPA_POD_TYPE_ID, 1,
+			data->type.audio_format.S16),
+		SPA_POD_PROP(&f[1], data->type.format_audio.layout, 0, SPA_POD_TYPE_INT, 1,
+			SPA_AUDIO_LAYOUT_INTERLEAVED),
+		SPA_POD_PROP(&f[1], data->type.format_audio.rate, 0, SPA_POD_TYPE_INT, 1,
+			44100),
+		SPA_POD_PROP(&f[1], data->type.format_audio.channels, 0, SPA_POD_TYPE_INT, 1,
+			2));
+	format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	if ((res = set_port(data, out, SPA_DIRECTION_OUTPUT, format, l)) < 0 ||
+	    (res = set_port(data, in, SPA_DIRECTION_INPUT, format, l)) < 0) {
+		printf("can't link nodes: %d\n", res);
+		goto error;
+	}
+	spa_graph_port_link(&out->ports[SPA_DIRECTION_OUTPUT][out->n_ports[SPA_DIRECTION_OUTPUT] - 1],
+			    &in->ports[SPA_DIRECTION_INPUT][in->n_ports[SPA_DIRECTION_INPUT] - 1]);
+	return;
+
+      error:
+	data->error = true;
+}
+
+/* make a node and link \a prev to it */
+static struct node *add_linked(struct data *data, struct node *prev, enum node_kind kind)
+{
+	struct node *n;
+
+	if (prev == NULL)
+		return NULL;
+
+	n = add_node(data, kind);
+	link_nodes(data, prev, n);
+
+	return n;
+}
+
+static int build_graph(struct data *data, enum topology topology)
+{
+	struct node *n, *mix;
+	uint32_t i;
+
+	switch (topology) {
+	case TOPOLOGY_CHAIN:
+		n = add_node(data, NODE_SOURCE);
+		for (i = 0; i < data->size; i++)
+			n = add_linked(data, n, NODE_VOLUME);
+		add_linked(data, n, NODE_SINK);
+		break;
+
+	case TOPOLOGY_FAN_IN:
+		mix = add_node(data, NODE_MIXER);
+		for (i = 0; i < data->size; i++)
+			link_nodes(data, add_node(data, NODE_SOURCE), mix);
+		add_linked(data, mix, NODE_SINK);
+		break;
+
+	case TOPOLOGY_PARALLEL:
+		for (i = 0; i < data->size; i++)
+			add_linked(data, add_linked(data, add_node(data, NODE_SOURCE),
+						    NODE_VOLUME), NODE_SINK);
+		break;
+
+	default:
+		return SPA_RESULT_INVALID_ARGUMENTS;
+	}
+	return data->error ? SPA_RESULT_ERROR : SPA_RESULT_OK;
+}
+
+static void clear_graph(struct data *data)
+{
+	uint32_t i;
+
+	for (i = 0; i < data->n_nodes; i++)
+		free_node(data->nodes[i]);
+	for (i = 0; i < data->n_links; i++)
+		clear_link(&data->links[i]);
+
+	data->n_nodes = data->n_sources = data->n_sinks = data->n_links = 0;
+	data->error = false;
+}
+
+static void send_command(struct data *data, uint32_t type)
+{
+	struct spa_command cmd = SPA_COMMAND_INIT(type);
+	uint32_t i;
+	int res;
+
+	for (i = 0; i < data->n_nodes; i++) {
+		struct node *n = data->nodes[i];
+
+		if (n->handle && (res = spa_node_send_command(n->node, &cmd)) < 0)
+			printf("got command error %d\n", res);
+	}
+}
+
+static inline void run_cycle(struct data *data)
+{
+	uint32_t i;
+
+	if (data->push) {
+		for (i = 0; i < data->n_sources; i++)
+			spa_graph_have_output(&data->graph, &data->sources[i]->gnode);
+	} else {
+		for (i = 0; i < data->n_sinks; i++)
+			spa_graph_need_input(&data->graph, &data->sinks[i]->gnode);
+	}
+}
+
+static int compare_time(const void *a, const void *b)
+{
+	const int64_t *t1 = a, *t2 = b;
+
+	return *t1 < *t2 ? -1 : *t1 > *t2 ? 1 : 0;
+}
+
+static int measure(struct data *data, const struct scheduler *scheduler,
+		   enum topology topology, struct result *r)
+{
+	void *sched_data;
+	int64_t t1, t2;
+	uint32_t i, n = data->cycles;
+	int res;
+
+	spa_graph_init(&data->graph);
+	if ((sched_data = scheduler->init(&data->graph)) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	if ((res = build_graph(data, topology)) < 0) {
+		printf("can't build %s graph: %d\n", topology_names[topology], res);
+		goto done;
+	}
+
+	send_command(data, data->type.command_node.Start);
+
+	for (i = 0; i < WARMUP_CYCLES; i++)
+		run_cycle(data);
+	for (i = 0; i < data->n_sinks; i++)
+		data->sinks[i]->n_consumed = 0;
+
+	for (i = 0; i < n; i++) {
+		t1 = get_time();
+		run_cycle(data);
+		t2 = get_time();
+		data->times[i] = t2 - t1;
+	}
+
+	send_command(data, data->type.command_node.Pause);
+
+	r->n_nodes = data->n_nodes;
+	r->n_buffers = 0;
+	for (i = 0; i < data->n_sinks; i++)
+		r->n_buffers += data->sinks[i]->n_consumed;
+
+	r->elapsed = 0;
+	for (i = 0; i < n; i++)
+		r->elapsed += data->times[i];
+
+	qsort(data->times, n, sizeof(int64_t), compare_time);
+	r->min = data->times[0];
+	r->p50 = data->times[(n - 1) * 50 / 100];
+	r->p90 = data->times[(n - 1) * 90 / 100];
+	r->p99 = data->times[(n - 1) * 99 / 100];
+	r->max = data->times[n - 1];
+
+      done:
+	clear_graph(data);
+	scheduler->clear(sched_data);
+
+	return res;
+}
+
+/* measure in a child process so that a scheduler that crashes or hangs on
+ * a graph only fails that run */
+static int run_benchmark(struct data *data, const struct scheduler *scheduler,
+			 enum topology topology)
+{
+	struct result *r = &data->results[data->n_results++];
+	int fds[2], status;
+	ssize_t len;
+	pid_t pid;
+
+	r->scheduler = scheduler->name;
+	r->topology = topology_names[topology];
+
+	if (pipe(fds) < 0) {
+		printf("can't create pipe: %m\n");
+		return SPA_RESULT_ERRNO;
+	}
+	fflush(stdout);
+
+	if ((pid = fork()) < 0) {
+		printf("can't fork: %m\n");
+		close(fds[0]);
+		close(fds[1]);
+		return SPA_RESULT_ERRNO;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		alarm(RUN_TIMEOUT);
+		if (measure(data, scheduler, topology, r) < 0)
+			_exit(1);
+		if (write(fds[1], r, sizeof(struct result)) != sizeof(struct result))
+			_exit(1);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	len = read(fds[0], r, sizeof(struct result));
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+
+	if (WIFSIGNALED(status))
+		r->status = WTERMSIG(status) == SIGALRM ? "timeout" : "crashed";
+	else if (WEXITSTATUS(status) != 0 || len != sizeof(struct result))
+		r->status = "error";
+	else if (r->n_buffers == 0)
+		r->status = "stalled";
+	else
+		r->status = "ok";
+
+	if (r->elapsed > 0)
+		printf("%-18s %-9s %4u nodes %10.0f cycles/s %10.0f buffers/s  "
+		       "p50 %6" PRIi64 " p90 %6" PRIi64 " p99 %6" PRIi64 " max %8" PRIi64 " ns %s\n",
+		       r->scheduler, r->topology, r->n_nodes,
+		       data->cycles * (double) SPA_NSEC_PER_SEC / r->elapsed,
+		       r->n_buffers * (double) SPA_NSEC_PER_SEC / r->elapsed,
+		       r->p50, r->p90, r->p99, r->max, r->status);
+	else
+		printf("%-18s %-9s %s\n", r->scheduler, r->topology, r->status);
+
+	return strcmp(r->status, "ok") == 0 ? SPA_RESULT_OK : SPA_RESULT_ERROR;
+}
+
+static int write_json(struct data *data, const char *filename)
+{
+	FILE *f;
+	uint32_t i;
+
+	if ((f = fopen(filename, "w")) == NULL) {
+		printf("can't open %s: %m\n", filename);
+		return SPA_RESULT_ERROR;
+	}
+
+	fprintf(f, "{\n");
+	fprintf(f, "  \"cycles\": %u,\n", data->cycles);
+	fprintf(f, "  \"size\": %u,\n", data->size);
+	fprintf(f, "  \"buffer-size\": %u,\n", data->buffer_size);
+	fprintf(f, "  \"mode\": \"%s\",\n", data->push ? "push" : "pull");
+	fprintf(f, "  \"results\": [\n");
+	for (i = 0; i < data->n_results; i++) {
+		struct result *r = &data->results[i];
+		double elapsed = r->elapsed > 0 ? r->elapsed : 1;
+
+		fprintf(f, "    { \"scheduler\": \"%s\", \"topology\": \"%s\", \"status\": \"%s\",\n",
+			r->scheduler, r->topology, r->status);
+		fprintf(f, "      \"nodes\": %u, \"elapsed-ns\": %" PRIi64 ", \"buffers\": %" PRIu64 ",\n",
+			r->n_nodes, r->elapsed, r->n_buffers);
+		fprintf(f, "      \"cycles-per-sec\": %.1f, \"buffers-per-sec\": %.1f,\n",
+			r->elapsed > 0 ? data->cycles * SPA_NSEC_PER_SEC / elapsed : 0.0,
+			r->n_buffers * SPA_NSEC_PER_SEC / elapsed);
+		fprintf(f, "      \"cycle-ns\": { \"min\": %" PRIi64 ", \"p50\": %" PRIi64
+			", \"p90\": %" PRIi64 ", \"p99\": %" PRIi64 ", \"max\": %" PRIi64 " } }%s\n",
+			r->min, r->p50, r->p90, r->p99, r->max,
+			i + 1 < data->n_results ? "," : "");
+	}
+	fprintf(f, "  ]\n");
+	fprintf(f, "}\n");
+	fclose(f);
+
+	return SPA_RESULT_OK;
+}
+
+static void show_help(const char *name)
+{
+	uint32_t i;
+
+	printf("usage: %s [options]\n"
+	       "  -s scheduler  run only this scheduler, can be repeated\n"
+	       "  -t topology   run only this topology, can be repeated\n"
+	       "  -n size       nodes in a chain or branches of a graph (default %d)\n"
+	       "  -c cycles     measured cycles (default %d)\n"
+	       "  -b bytes      buffer size (default %d)\n"
+	       "  -m pull|push  pull the sinks or push the sources (default pull)\n"
+	       "  -p dir        plugin directory (default %s)\n"
+	       "  -o file       write the results as JSON to file\n",
+	       name, DEFAULT_SIZE, DEFAULT_CYCLES, DEFAULT_BUFFER_SIZE, DEFAULT_PLUGIN_DIR);
+
+	printf("schedulers:");
+	for (i = 0; i < N_SCHEDULERS; i++)
+		printf(" %s", schedulers[i]->name);
+	printf("\ntopologies:");
+	for (i = 0; i < N_TOPOLOGIES; i++)
+		printf(" %s", topology_names[i]);
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL };
+	bool run_scheduler[N_SCHEDULERS] = { false, }, all_schedulers = true;
+	bool run_topology[N_TOPOLOGIES] = { false, }, all_topologies = true;
+	const char *str, *output = NULL;
+	uint32_t i, j;
+	int c, res = 0;
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+	data.log->level = SPA_LOG_LEVEL_ERROR;
+	if ((str = getenv("SPA_DEBUG")))
+		data.log->level = atoi(str);
+
+	data.plugin_dir = DEFAULT_PLUGIN_DIR;
+	data.plugins[PLUGIN_TEST].file = "test/libspa-test.so";
+	data.plugins[PLUGIN_VOLUME].file = "volume/libspa-volume.so";
+	data.plugins[PLUGIN_AUDIOMIXER].file = "audiomixer/libspa-audiomixer.so";
+	data.cycles = DEFAULT_CYCLES;
+	data.size = DEFAULT_SIZE;
+	data.buffer_size = DEFAULT_BUFFER_SIZE;
+
+	while ((c = getopt(argc, argv, "s:t:n:c:b:m:p:o:h")) != -1) {
+		switch (c) {
+		case 's':
+			for (i = 0; i < N_SCHEDULERS; i++)
+				if (strcmp(optarg, schedulers[i]->name) == 0)
+					break;
+			if (i == N_SCHEDULERS) {
+				printf("unknown scheduler %s\n", optarg);
+				return -1;
+			}
+			run_scheduler[i] = true;
+			all_schedulers = false;
+			break;
+		case 't':
+			for (i = 0; i < N_TOPOLOGIES; i++)
+				if (strcmp(optarg, topology_names[i]) == 0)
+					break;
+			if (i == N_TOPOLOGIES) {
+				printf("unknown topology %s\n", optarg);
+				return -1;
+			}
+			run_topology[i] = true;
+			all_topologies = false;
+			break;
+		case 'n':
+			data.size = atoi(optarg);
+			break;
+		case 'c':
+			data.cycles = atoi(optarg);
+			break;
+		case 'b':
+			data.buffer_size = atoi(optarg);
+			break;
+		case 'm':
+			data.push = strcmp(optarg, "push") == 0;
+			break;
+		case 'p':
+			data.plugin_dir = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			show_help(argv[0]);
+			return c == 'h' ? 0 : -1;
+		}
+	}
+	if (data.size == 0 || data.size > MAX_SIZE || data.cycles == 0 ||
+	    data.buffer_size < 4) {
+		show_help(argv[0]);
+		return -1;
+	}
+	/* whole stereo S16 frames */
+	data.buffer_size &= ~3;
+
+	data.support[0].type = SPA_TYPE__TypeMap;
+	data.support[0].data = data.map;
+	data.support[1].type = SPA_TYPE__Log;
+	data.support[1].data = data.log;
+	data.n_support = 2;
+
+	init_type(&data.type, data.map);
+
+	if ((data.times = calloc(data.cycles, sizeof(int64_t))) == NULL) {
+		printf("can't allocate\n");
+		return -1;
+	}
+
+	printf("%u cycles, size %u, %u bytes buffers, %s mode\n",
+	       data.cycles, data.size, data.buffer_size, data.push ? "push" : "pull");
+
+	for (i = 0; i < N_SCHEDULERS; i++) {
+		if (!all_schedulers && !run_scheduler[i])
+			continue;
+		for (j = 0; j < N_TOPOLOGIES; j++) {
+			if (!all_topologies && !run_topology[j])
+				continue;
+			if (run_benchmark(&data, schedulers[i], j) < 0)
+				res = -1;
+		}
+	}
+
+	if (output && write_json(&data, output) < 0)
+		res = -1;
+
+	free(data.times);
+	for (i = 0; i < N_PLUGINS; i++)
+		if (data.plugins[i].hnd)
+			dlclose(data.plugins[i].hnd);
+
+	return res;
+}
@@ -0,0 +1,38 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __BENCHMARK_GRAPH_H__
+#define __BENCHMARK_GRAPH_H__
+
+#include <spa/graph.h>
+
+/* The graph schedulers are header only and all use the same names, each
+ * of them is compiled in its own file that exports one of these. */
+struct scheduler {
+	const char *name;
+	/** install the scheduler on \a graph, returns the scheduler data */
+	void *(*init) (struct spa_graph *graph);
+	/** free the scheduler data */
+	void (*clear) (void *data);
+};
+
+extern const struct scheduler benchmark_scheduler1;
+extern const struct scheduler benchmark_scheduler3;
+
+#endif /* __BENCHMARK_GRAPH_H__ */
@@ -2,113 +2,384 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 #include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 #include <spa/ringbuffer.h>
 
-#define ARRAY_SIZE 64
-#define MAX_VALUE 0x10000
+#define DEFAULT_SIZE	(64 * 1024)
+#define DEFAULT_CHUNK	256
+#define DEFAULT_SECONDS	2
+#define MAX_SPINS	1000
 
-struct spa_ringbuffer rb;
-uint8_t *data;
+enum layout {
+	LAYOUT_PLAIN,		/* struct spa_ringbuffer, the indices share a cache line */
+	LAYOUT_PADDED,		/* struct spa_ringbuffer_padded */
+};
 
-static int fill_int_array(int *array, int start, int count)
+static const char *layout_names[] = { "plain", "padded" };
+
+struct test {
+	enum layout layout;
+	bool span;		/* access the data in place instead of copying */
+	bool twice;		/* the data is mapped twice */
+	uint32_t size;
+	uint32_t chunk;
+	int reader_cpu;
+	int writer_cpu;
+
+	struct spa_ringbuffer rb;
+	struct spa_ringbuffer_padded prb;
+	uint8_t *data;
+
+	bool running;
+	uint64_t bytes;
+	uint64_t failures;
+};
+
+static inline int32_t get_read_index(struct test *t, uint32_t *index)
 {
-	int i, j = start;
-	for (i = 0; i < count; i++) {
-		array[i] = j;
-		j = (j + 1) % MAX_VALUE;
-	}
-	return j;
+	if (t->layout == LAYOUT_PADDED)
+		return spa_ringbuffer_padded_get_read_index(&t->prb, index, t->chunk);
+	return spa_ringbuffer_get_read_index(&t->rb, index);
 }
 
-static int cmp_array(int *array1, int *array2, int count)
+static inline void read_update(struct test *t, uint32_t index)
 {
-	int i;
-	for (i = 0; i < count; i++)
-		if (array1[i] != array2[i]) {
-			printf("%d != %d at offset %d\n", array1[i], array2[i], i);
-			return 0;
-		}
+	if (t->layout == LAYOUT_PADDED)
+		spa_ringbuffer_padded_read_update(&t->prb, index);
+	else
+		spa_ringbuffer_read_update(&t->rb, index);
+}
 
-	return 1;
+static inline int32_t get_write_index(struct test *t, uint32_t *index)
+{
+	if (t->layout == LAYOUT_PADDED)
+		return spa_ringbuffer_padded_get_write_index(&t->prb, index, t->chunk);
+	return spa_ringbuffer_get_write_index(&t->rb, index);
 }
 
-static void *reader_start(void *arg)
+static inline void write_update(struct test *t, uint32_t index)
 {
-	int i = 0, a[ARRAY_SIZE], b[ARRAY_SIZE];
-	unsigned long j = 0, nfailures = 0;
+	if (t->layout == LAYOUT_PADDED)
+		spa_ringbuffer_padded_write_update(&t->prb, index);
+	else
+		spa_ringbuffer_write_update(&t->rb, index);
+}
 
-	printf("reader started on cpu: %d\n", sched_getcpu());
+static inline uint32_t fill(uint32_t *p, uint32_t n, uint32_t seq)
+{
+	uint32_t i;
 
-	i = fill_int_array(a, i, ARRAY_SIZE);
+	for (i = 0; i < n; i++)
+		p[i] = seq++;
+	return seq;
+}
 
-	while (1) {
-		uint32_t index;
+static inline uint32_t check(struct test *t, const uint32_t *p, uint32_t n, uint32_t seq)
+{
+	uint32_t i;
 
-		if (spa_ringbuffer_get_read_index(&rb, &index) >= ARRAY_SIZE * sizeof(int)) {
-			spa_ringbuffer_read_data(&rb, data, index & rb.mask, b,
-						 ARRAY_SIZE * sizeof(int));
+	for (i = 0; i < n; i++) {
+		if (SPA_UNLIKELY(p[i] != seq)) {
+			t->failures++;
+			seq = p[i];
+		}
+		seq++;
+	}
+	return seq;
+}
+
+static void *reader_start(void *arg)
+{
+	struct test *t = arg;
+	uint32_t a[t->chunk / sizeof(uint32_t)], seq = 0, index, offset, n;
+	uint64_t bytes = 0;
+	void *p;
+	int spins = 0;
 
-			if (!cmp_array(a, b, ARRAY_SIZE)) {
-				nfailures++;
-				printf
-				    ("failure in chunk %lu - probability: %lu/%lu = %.3f per million\n",
-				     j, nfailures, j, (float) nfailures / (j + 1) * 1000000);
-				i = (b[0] + ARRAY_SIZE) % MAX_VALUE;
+	while (__atomic_load_n(&t->running, __ATOMIC_RELAXED)) {
+		if (get_read_index(t, &index) < (int32_t) t->chunk) {
+			if (++spins == MAX_SPINS) {
+				sched_yield();
+				spins = 0;
 			}
-			i = fill_int_array(a, i, ARRAY_SIZE);
-			j++;
+			continue;
+		}
+		offset = index & (t->size - 1);
 
-			spa_ringbuffer_read_update(&rb, index + ARRAY_SIZE * sizeof(int));
+		if (t->span) {
+			n = spa_ringbuffer_get_span(t->size, t->data, offset, t->chunk, t->twice, &p);
+			seq = check(t, p, n / sizeof(uint32_t), seq);
+			if (n < t->chunk) {
+				spa_ringbuffer_get_span(t->size, t->data, 0, t->chunk - n, false, &p);
+				seq = check(t, p, (t->chunk - n) / sizeof(uint32_t), seq);
+			}
+		} else {
+			n = spa_ringbuffer_get_span(t->size, t->data, offset, t->chunk, t->twice, &p);
+			memcpy(a, p, n);
+			if (n < t->chunk)
+				memcpy(SPA_MEMBER(a, n, void), t->data, t->chunk - n);
+			seq = check(t, a, t->chunk / sizeof(uint32_t), seq);
 		}
+		read_update(t, index + t->chunk);
+		bytes += t->chunk;
 	}
+	t->bytes = bytes;
 
 	return NULL;
 }
 
 static void *writer_start(void *arg)
 {
-	int i = 0, a[ARRAY_SIZE];
-	printf("writer started on cpu: %d\n", sched_getcpu());
-
-	i = fill_int_array(a, i, ARRAY_SIZE);
-
-	while (1) {
-		uint32_t index;
+	struct test *t = arg;
+	uint32_t a[t->chunk / sizeof(uint32_t)], seq = 0, index, offset, n;
+	void *p;
+	int spins = 0;
 
-		if (spa_ringbuffer_get_write_index(&rb, &index) >= ARRAY_SIZE * sizeof(int)) {
-			spa_ringbuffer_write_data(&rb, data, index & rb.mask, a,
-						  ARRAY_SIZE * sizeof(int));
-			spa_ringbuffer_write_update(&rb, index + ARRAY_SIZE * sizeof(int));
+	while (__atomic_load_n(&t->running, __ATOMIC_RELAXED)) {
+		if (get_write_index(t, &index) > (int32_t) (t->size - t->chunk)) {
+			if (++spins == MAX_SPINS) {
+				sched_yield();
+				spins = 0;
+			}
+			continue;
+		}
+		offset = index & (t->size - 1);
 
-			i = fill_int_array(a, i, ARRAY_SIZE);
+		if (t->span) {
+			n = spa_ringbuffer_get_span(t->size, t->data, offset, t->chunk, t->twice, &p);
+			seq = fill(p, n / sizeof(uint32_t), seq);
+			if (n < t->chunk) {
+				spa_ringbuffer_get_span(t->size, t->data, 0, t->chunk - n, false, &p);
+				seq = fill(p, (t->chunk - n) / sizeof(uint32_t), seq);
+			}
+		} else {
+			seq = fill(a, t->chunk / sizeof(uint32_t), seq);
+			n = spa_ringbuffer_get_span(t->size, t->data, offset, t->chunk, t->twice, &p);
+			memcpy(p, a, n);
+			if (n < t->chunk)
+				memcpy(t->data, SPA_MEMBER(a, n, void), t->chunk - n);
 		}
+		write_update(t, index + t->chunk);
 	}
 
 	return NULL;
 }
 
-int main(int argc, char *argv[])
+/* map the memory twice after each other, like PW_MEMBLOCK_FLAG_MAP_TWICE */
+static uint8_t *alloc_data(uint32_t size, bool twice)
 {
-	int size;
+	uint8_t *ptr;
+	int fd;
 
-	printf("starting ringbuffer stress test\n");
+	if (!twice)
+		return malloc(size);
 
-	sscanf(argv[1], "%d", &size);
+	if ((fd = syscall(SYS_memfd_create, "stress-ringbuffer", 0)) < 0)
+		return NULL;
 
-	printf("buffer size (bytes): %d\n", size);
-	printf("array size (bytes): %ld\n", sizeof(int) * ARRAY_SIZE);
+	if (ftruncate(fd, size) < 0)
+		goto error;
 
-	spa_ringbuffer_init(&rb, size);
-	data = malloc(size);
+	ptr = mmap(NULL, size << 1, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (ptr == MAP_FAILED)
+		goto error;
 
+	if (mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0) != ptr ||
+	    mmap(ptr + size, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, 0) != ptr + size) {
+		munmap(ptr, size << 1);
+		goto error;
+	}
+	close(fd);
+	return ptr;
+
+      error:
+	close(fd);
+	return NULL;
+}
+
+static void free_data(uint8_t *data, uint32_t size, bool twice)
+{
+	if (twice)
+		munmap(data, size << 1);
+	else
+		free(data);
+}
+
+static int start_thread(pthread_t *thread, int cpu, void *(*func) (void *), void *data)
+{
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+	int res;
+
+	pthread_attr_init(&attr);
+	if (cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+	res = pthread_create(thread, &attr, func, data);
+	pthread_attr_destroy(&attr);
+
+	return res;
+}
+
+static int run_test(struct test *t, double seconds)
+{
 	pthread_t reader_thread, writer_thread;
-	pthread_create(&reader_thread, NULL, reader_start, NULL);
-	pthread_create(&writer_thread, NULL, writer_start, NULL);
+	struct timespec ts, start, end;
+	double elapsed;
+
+	if ((t->data = alloc_data(t->size, t->twice)) == NULL) {
+		printf("can't allocate %u bytes\n", t->size);
+		return -1;
+	}
+	spa_ringbuffer_init(&t->rb, t->size);
+	spa_ringbuffer_padded_init(&t->prb, t->size);
+	t->bytes = 0;
+	t->failures = 0;
+	t->running = true;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (start_thread(&reader_thread, t->reader_cpu, reader_start, t) != 0 ||
+	    start_thread(&writer_thread, t->writer_cpu, writer_start, t) != 0) {
+		printf("can't start threads\n");
+		exit(-1);
+	}
+
+	ts.tv_sec = seconds;
+	ts.tv_nsec = (seconds - ts.tv_sec) * SPA_NSEC_PER_SEC;
+	nanosleep(&ts, NULL);
+	__atomic_store_n(&t->running, false, __ATOMIC_RELAXED);
+
+	pthread_join(writer_thread, NULL);
+	pthread_join(reader_thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (SPA_TIMESPEC_TO_TIME(&end) - SPA_TIMESPEC_TO_TIME(&start)) / (double) SPA_NSEC_PER_SEC;
+
+	printf("%-7s %-5s %-6s cpus %2d -> %-2d %10.1f MB/s %10.2f Mchunks/s  failures %" PRIu64 "\n",
+	       layout_names[t->layout], t->span ? "span" : "copy", t->twice ? "twice" : "once",
+	       t->writer_cpu, t->reader_cpu,
+	       t->bytes / elapsed / (1024 * 1024), t->bytes / t->chunk / elapsed / 1000000,
+	       t->failures);
 
-	while (1)
-		sleep(1);
+	free_data(t->data, t->size, t->twice);
 
-	return 0;
+	return t->failures > 0 ? -1 : 0;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [options] [size]\n"
+	       "  -c <bytes>    bytes per read and write, a multiple of 4 (default %d)\n"
+	       "  -d <seconds>  duration of each run (default %d)\n"
+	       "  -l <layout>   plain, padded or all (default all)\n"
+	       "  -m <mode>     copy, span or all (default all)\n"
+	       "  -t            map the memory twice\n"
+	       "  -w <cpu>      cpu of the writer\n"
+	       "  -r <cpu>      cpu of the reader\n"
+	       "size is the ringbuffer size in bytes, a power of 2 (default %d)\n"
+	       "Without -w and -r the threads run on different cpus and then on the same cpu.\n",
+	       name, DEFAULT_CHUNK, DEFAULT_SECONDS, DEFAULT_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	struct test t = { 0, };
+	double seconds = DEFAULT_SECONDS;
+	int c, l, m, i, res = 0, n_cpus;
+	int first_layout = LAYOUT_PLAIN, last_layout = LAYOUT_PADDED;
+	int first_mode = 0, last_mode = 1;
+	int cpus[2][2], n_pairs = 0, reader_cpu = -1, writer_cpu = -1;
+
+	t.size = DEFAULT_SIZE;
+	t.chunk = DEFAULT_CHUNK;
+
+	while ((c = getopt(argc, argv, "c:d:l:m:tw:r:h")) != -1) {
+		switch (c) {
+		case 'c':
+			t.chunk = atoi(optarg);
+			break;
+		case 'd':
+			seconds = atof(optarg);
+			break;
+		case 'l':
+			if (strcmp(optarg, "plain") == 0)
+				last_layout = LAYOUT_PLAIN;
+			else if (strcmp(optarg, "padded") == 0)
+				first_layout = LAYOUT_PADDED;
+			break;
+		case 'm':
+			if (strcmp(optarg, "copy") == 0)
+				last_mode = 0;
+			else if (strcmp(optarg, "span") == 0)
+				first_mode = 1;
+			break;
+		case 't':
+			t.twice = true;
+			break;
+		case 'w':
+			writer_cpu = atoi(optarg);
+			break;
+		case 'r':
+			reader_cpu = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if (optind < argc)
+		t.size = atoi(argv[optind]);
+
+	if (t.size == 0 || (t.size & (t.size - 1)) != 0 ||
+	    t.chunk == 0 || t.chunk % sizeof(uint32_t) != 0 || t.chunk > t.size) {
+		usage(argv[0]);
+		return -1;
+	}
+	if (t.twice && t.size % sysconf(_SC_PAGESIZE) != 0) {
+		printf("the size must be a multiple of the page size with -t\n");
+		return -1;
+	}
+
+	if (reader_cpu >= 0 || writer_cpu >= 0) {
+		cpus[n_pairs][0] = writer_cpu;
+		cpus[n_pairs][1] = reader_cpu;
+		n_pairs++;
+	} else {
+		n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		if (n_cpus > 1) {
+			cpus[n_pairs][0] = 0;
+			cpus[n_pairs][1] = 1;
+			n_pairs++;
+		} else
+			printf("only one cpu, the threads can only run on the same cpu\n");
+		cpus[n_pairs][0] = 0;
+		cpus[n_pairs][1] = 0;
+		n_pairs++;
+	}
+
+	printf("ringbuffer %u bytes, %u bytes per chunk, %.1f seconds per run\n",
+	       t.size, t.chunk, seconds);
+
+	for (i = 0; i < n_pairs; i++) {
+		for (l = first_layout; l <= last_layout; l++) {
+			for (m = first_mode; m <= last_mode; m++) {
+				t.layout = l;
+				t.span = m == 1;
+				t.writer_cpu = cpus[i][0];
+				t.reader_cpu = cpus[i][1];
+				if (run_test(&t, seconds) < 0)
+					res = -1;
+			}
+		}
+	}
+	return res;
 }
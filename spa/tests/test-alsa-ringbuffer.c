@@ -0,0 +1,136 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Checks how the ALSA sink pulls a period from a ringbuffer: it consumes
+ * exactly the frames that are there and fills the rest with silence, also
+ * when the data wraps. */
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "alsa-ringbuffer.h"
+
+#define RB_SIZE		64
+#define FRAME_SIZE	4	/* U16 stereo */
+#define MAX_FRAMES	32
+
+/* silence of U16 is the middle of the range */
+static const uint8_t silence[FRAME_SIZE] = { 0x00, 0x80, 0x00, 0x80 };
+
+struct test {
+	struct spa_meta_ringbuffer rb;
+	uint8_t data[RB_SIZE];
+	uint32_t seq;		/* next frame to write */
+	uint32_t expected;	/* next frame to read */
+	uint64_t underrun;	/* bytes of silence played */
+	uint32_t n_errors;
+};
+
+static void make_frame(uint8_t *frame, uint32_t seq)
+{
+	uint32_t i;
+
+	for (i = 0; i < FRAME_SIZE; i++)
+		frame[i] = (seq * FRAME_SIZE + i) & 0x7f;
+}
+
+static void write_frames(struct test *t, uint32_t n_frames)
+{
+	uint8_t frames[MAX_FRAMES * FRAME_SIZE];
+	uint32_t i, index;
+
+	for (i = 0; i < n_frames; i++)
+		make_frame(&frames[i * FRAME_SIZE], t->seq++);
+
+	spa_ringbuffer_get_write_index(&t->rb.ringbuffer, &index);
+	spa_ringbuffer_write_data(&t->rb.ringbuffer, t->data, index & t->rb.ringbuffer.mask,
+				  frames, n_frames * FRAME_SIZE);
+	spa_ringbuffer_write_update(&t->rb.ringbuffer, index + n_frames * FRAME_SIZE);
+}
+
+static void pull(struct test *t, const char *name, uint32_t n_frames, uint32_t expected)
+{
+	uint8_t dst[MAX_FRAMES * FRAME_SIZE], frame[FRAME_SIZE];
+	uint32_t i, n_read;
+
+	memset(dst, 0xff, sizeof(dst));
+
+	n_read = spa_alsa_ringbuffer_pull(&t->rb, t->data, dst, n_frames, FRAME_SIZE, silence);
+	if (n_read != expected) {
+		printf("%s: read %u frames, expected %u\n", name, n_read, expected);
+		t->n_errors++;
+	}
+
+	for (i = 0; i < n_read; i++) {
+		make_frame(frame, t->expected++);
+		if (memcmp(&dst[i * FRAME_SIZE], frame, FRAME_SIZE) != 0) {
+			printf("%s: frame %u has wrong data\n", name, i);
+			t->n_errors++;
+		}
+	}
+	for (; i < n_frames; i++) {
+		if (memcmp(&dst[i * FRAME_SIZE], silence, FRAME_SIZE) != 0) {
+			printf("%s: frame %u is not silent\n", name, i);
+			t->n_errors++;
+		}
+	}
+	if (dst[n_frames * FRAME_SIZE] != 0xff) {
+		printf("%s: wrote past %u frames\n", name, n_frames);
+		t->n_errors++;
+	}
+	t->underrun += (n_frames - n_read) * FRAME_SIZE;
+	printf("%s: %u of %u frames, underrun %" PRIu64 "\n", name, n_read, n_frames,
+	       t->underrun);
+}
+
+int main(int argc, char *argv[])
+{
+	struct test t = { { { 0, }, }, };
+	uint32_t index;
+
+	spa_ringbuffer_init(&t.rb.ringbuffer, RB_SIZE);
+
+	/* a short ringbuffer is padded with silence */
+	write_frames(&t, 5);
+	pull(&t, "short", 8, 5);
+
+	/* nothing in the ringbuffer, a whole period of silence */
+	pull(&t, "empty", 4, 0);
+
+	/* the data wraps around the end of the ringbuffer */
+	write_frames(&t, RB_SIZE / FRAME_SIZE);
+	pull(&t, "wrap", 10, 10);
+	pull(&t, "wrap short", 8, 6);
+
+	/* a partial frame stays in the ringbuffer */
+	write_frames(&t, 1);
+	spa_ringbuffer_get_write_index(&t.rb.ringbuffer, &index);
+	spa_ringbuffer_write_update(&t.rb.ringbuffer, index + FRAME_SIZE / 2);
+	pull(&t, "partial", 2, 1);
+	if (spa_ringbuffer_get_read_index(&t.rb.ringbuffer, &index) != FRAME_SIZE / 2) {
+		printf("partial: the partial frame was consumed\n");
+		t.n_errors++;
+	}
+
+	if (t.n_errors > 0)
+		printf("error: %u errors\n", t.n_errors);
+
+	return t.n_errors > 0 ? -1 : 0;
+}
@@ -0,0 +1,364 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Checks the samples of the periodic waves of the audiotestsrc. The second
+ * channel has minus half the frequency of the first one so that it runs
+ * backwards and all channels repeat after PERIOD frames, which does not
+ * divide the BUFFER_FRAMES that are rendered in each cycle. After a volume
+ * change the waves must continue where they were. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+
+#include <spa/type-map-impl.h>
+#include <spa/log-impl.h>
+#include <spa/node.h>
+#include <spa/audio/format-utils.h>
+#include <spa/format-builder.h>
+#include <lib/props.h>
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+struct type {
+	uint32_t node;
+	uint32_t props;
+	uint32_t format;
+	uint32_t prop_wave;
+	uint32_t prop_freq;
+	uint32_t prop_freq_step;
+	uint32_t prop_volume;
+	uint32_t wave_square;
+	uint32_t wave_saw;
+	uint32_t wave_impulse;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->prop_wave = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType);
+	type->prop_freq = spa_type_map_get_id(map, SPA_TYPE_PROPS__frequency);
+	type->prop_freq_step = spa_type_map_get_id(map, SPA_TYPE_PROPS__frequencyStep);
+	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
+	type->wave_square = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":square");
+	type->wave_saw = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":saw");
+	type->wave_impulse = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":impulse");
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+}
+
+#define RATE		48000
+#define CHANNELS	2
+#define FREQ		3000.0		/* 16 frames */
+#define FREQ_STEP	-4500.0		/* -1500 Hz, 32 frames */
+#define PERIOD		32
+#define BUFFER_FRAMES	100
+#define N_BUFFERS	2
+
+enum wave {
+	WAVE_SQUARE,
+	WAVE_SAW,
+	WAVE_IMPULSE,
+};
+
+struct buffer {
+	struct spa_buffer buffer;
+	struct spa_data datas[1];
+	struct spa_chunk chunks[1];
+	float samples[BUFFER_FRAMES * CHANNELS];
+};
+
+struct data {
+	struct type type;
+
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	struct spa_support support[2];
+	uint32_t n_support;
+
+	struct spa_handle *handle;
+	struct spa_node *source;
+	struct spa_port_io io;
+
+	struct spa_buffer *bp[N_BUFFERS];
+	struct buffer buffers[N_BUFFERS];
+
+	uint32_t n_errors;
+};
+
+static int make_node(struct data *data, struct spa_node **node, const char *lib, const char *name)
+{
+	int res;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return SPA_RESULT_ERROR;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return SPA_RESULT_ERROR;
+	}
+
+	for (i = 0;; i++) {
+		const struct spa_handle_factory *factory;
+		void *iface;
+
+		if ((res = enum_func(&factory, i)) < 0) {
+			if (res != SPA_RESULT_ENUM_END)
+				printf("can't enumerate factories: %d\n", res);
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		data->handle = calloc(1, factory->size);
+		if ((res =
+		     spa_handle_factory_init(factory, data->handle, NULL, data->support,
+					     data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		if ((res = spa_handle_get_interface(data->handle, data->type.node, &iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return res;
+		}
+		*node = iface;
+		return SPA_RESULT_OK;
+	}
+	return SPA_RESULT_ERROR;
+}
+
+static int set_props(struct data *data, uint32_t wave, double volume)
+{
+	struct spa_props *props;
+	struct spa_pod_frame f[2];
+	uint8_t buffer[256];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+
+	spa_pod_builder_props(&b, &f[0], data->type.props,
+		SPA_POD_PROP(&f[1], data->type.prop_wave, 0, SPA_POD_TYPE_ID, 1, wave),
+		SPA_POD_PROP(&f[1], data->type.prop_freq, 0, SPA_POD_TYPE_DOUBLE, 1, FREQ),
+		SPA_POD_PROP(&f[1], data->type.prop_freq_step, 0, SPA_POD_TYPE_DOUBLE, 1,
+			FREQ_STEP),
+		SPA_POD_PROP(&f[1], data->type.prop_volume, 0, SPA_POD_TYPE_DOUBLE, 1, volume));
+	props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return spa_node_set_props(data->source, props);
+}
+
+static int set_format(struct data *data)
+{
+	struct spa_format *fmt;
+	struct spa_pod_frame f[2];
+	uint8_t buffer[256];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+
+	spa_pod_builder_format(&b, &f[0], data->type.format,
+		data->type.media_type.audio,
+		data->type.media_subtype.raw,
+		SPA_POD_PROP(&f[1], data->type.format_audio.format, 0, SPA_POD_TYPE_ID, 1,
+			data->type.audio_format.F32),
+		SPA_POD_PROP(&f[1], data->type.format_audio.layout, 0, SPA_POD_TYPE_INT, 1,
+			SPA_AUDIO_LAYOUT_INTERLEAVED),
+		SPA_POD_PROP(&f[1], data->type.format_audio.rate, 0, SPA_POD_TYPE_INT, 1,
+			RATE),
+		SPA_POD_PROP(&f[1], data->type.format_audio.channels, 0, SPA_POD_TYPE_INT, 1,
+			CHANNELS));
+	fmt = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	return spa_node_port_set_format(data->source, SPA_DIRECTION_OUTPUT, 0, 0, fmt);
+}
+
+static int use_buffers(struct data *data)
+{
+	int i;
+
+	for (i = 0; i < N_BUFFERS; i++) {
+		struct buffer *b = &data->buffers[i];
+
+		data->bp[i] = &b->buffer;
+		b->buffer.id = i;
+		b->buffer.n_metas = 0;
+		b->buffer.n_datas = 1;
+		b->buffer.datas = b->datas;
+
+		b->datas[0].type = data->type.data.MemPtr;
+		b->datas[0].flags = 0;
+		b->datas[0].fd = -1;
+		b->datas[0].mapoffset = 0;
+		b->datas[0].maxsize = sizeof(b->samples);
+		b->datas[0].data = b->samples;
+		b->datas[0].chunk = &b->chunks[0];
+		b->datas[0].chunk->offset = 0;
+		b->datas[0].chunk->size = 0;
+		b->datas[0].chunk->stride = 0;
+	}
+	return spa_node_port_use_buffers(data->source, SPA_DIRECTION_OUTPUT, 0,
+					 data->bp, N_BUFFERS);
+}
+
+/* the sample of @wave at @frame of a wave that repeats every @period frames,
+ * all of them are exact in float for a period that is a power of 2 */
+static float expected_sample(enum wave wave, uint32_t frame, uint32_t period)
+{
+	float pos = (float) (frame % period) / period;
+
+	switch (wave) {
+	case WAVE_SQUARE:
+		return pos < 0.5f ? 1.0f : -1.0f;
+	case WAVE_SAW:
+		return pos < 0.5f ? 2.0f * pos : 2.0f * pos - 2.0f;
+	case WAVE_IMPULSE:
+		return pos == 0.0f ? 1.0f : 0.0f;
+	}
+	return 0.0f;
+}
+
+/* renders one buffer and checks it against the wave starting at @frame */
+static int check_buffer(struct data *data, const char *name, enum wave wave,
+			uint32_t frame, float volume)
+{
+	struct buffer *b;
+	uint32_t i, c;
+	int res;
+
+	data->io.status = SPA_RESULT_NEED_BUFFER;
+	if ((res = spa_node_process_output(data->source)) != SPA_RESULT_HAVE_BUFFER) {
+		printf("%s: got process_output error %d\n", name, res);
+		return res;
+	}
+	b = &data->buffers[data->io.buffer_id];
+
+	if (b->chunks[0].size != sizeof(b->samples)) {
+		printf("%s: got %u bytes, expected %zd\n", name, b->chunks[0].size,
+		       sizeof(b->samples));
+		data->n_errors++;
+	}
+
+	for (i = 0; i < BUFFER_FRAMES; i++) {
+		for (c = 0; c < CHANNELS; c++) {
+			float s = b->samples[i * CHANNELS + c];
+			uint32_t period = c == 0 ? PERIOD / 2 : PERIOD;
+			uint32_t pos = c == 0 ? frame + i : period - (frame + i) % period;
+			float e = volume * expected_sample(wave, pos, period);
+
+			if (s != e) {
+				printf("%s: frame %u channel %u is %f, expected %f\n", name,
+				       frame + i, c, s, e);
+				data->n_errors++;
+				return SPA_RESULT_OK;
+			}
+		}
+	}
+	return SPA_RESULT_OK;
+}
+
+static int run(struct data *data, const char *name, uint32_t wave_id, enum wave wave)
+{
+	uint32_t i, frame = 0;
+	int res;
+
+	if ((res = set_props(data, wave_id, 1.0)) < 0) {
+		printf("%s: can't set props: %d\n", name, res);
+		return res;
+	}
+
+	for (i = 0; i < 3; i++, frame += BUFFER_FRAMES)
+		if ((res = check_buffer(data, name, wave, frame, 1.0f)) < 0)
+			return res;
+
+	/* a volume change doesn't restart the wave */
+	if ((res = set_props(data, wave_id, 0.5)) < 0) {
+		printf("%s: can't set props: %d\n", name, res);
+		return res;
+	}
+	for (i = 0; i < 2; i++, frame += BUFFER_FRAMES)
+		if ((res = check_buffer(data, name, wave, frame, 0.5f)) < 0)
+			return res;
+
+	printf("%s: %u frames\n", name, frame);
+
+	return SPA_RESULT_OK;
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	const char *str;
+	int res;
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+
+	if ((str = getenv("SPA_DEBUG")))
+		data.log->level = atoi(str);
+
+	data.support[0].type = SPA_TYPE__TypeMap;
+	data.support[0].data = data.map;
+	data.support[1].type = SPA_TYPE__Log;
+	data.support[1].data = data.log;
+	data.n_support = 2;
+
+	init_type(&data.type, data.map);
+
+	if ((res = make_node(&data, &data.source,
+			     "build/spa/plugins/audiotestsrc/libspa-audiotestsrc.so",
+			     "audiotestsrc")) < 0) {
+		printf("can't create audiotestsrc: %d\n", res);
+		return -1;
+	}
+	data.io = SPA_PORT_IO_INIT;
+
+	if ((res = spa_node_port_set_io(data.source, SPA_DIRECTION_OUTPUT, 0, &data.io)) < 0 ||
+	    (res = set_format(&data)) < 0 ||
+	    (res = use_buffers(&data)) < 0) {
+		printf("can't configure audiotestsrc: %d\n", res);
+		return -1;
+	}
+
+	if (run(&data, "square", data.type.wave_square, WAVE_SQUARE) < 0 ||
+	    run(&data, "saw", data.type.wave_saw, WAVE_SAW) < 0 ||
+	    run(&data, "impulse", data.type.wave_impulse, WAVE_IMPULSE) < 0)
+		return -1;
+
+	spa_node_port_set_format(data.source, SPA_DIRECTION_OUTPUT, 0, 0, NULL);
+	spa_handle_clear(data.handle);
+	free(data.handle);
+
+	if (data.n_errors > 0)
+		printf("error: %u errors\n", data.n_errors);
+
+	return data.n_errors > 0 ? -1 : 0;
+}
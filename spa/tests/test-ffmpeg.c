@@ -0,0 +1,571 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Encodes a generated clip with an ffenc node and decodes it again with the
+ * matching ffdec node, reports the frames per second of both and checks
+ * that the decoded frames look like the generated ones.
+ *
+ *   test-ffmpeg [-c <codec>] [-n <frames>] [-s <width>x<height>] [-t <threads>]
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include <spa/type-map-impl.h>
+#include <spa/log-impl.h>
+#include <spa/node.h>
+#include <spa/param-alloc.h>
+#include <spa/video/format-utils.h>
+#include <spa/format-builder.h>
+#include <lib/props.h>
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+#define PLUGIN	"build/spa/plugins/ffmpeg/libspa-ffmpeg.so"
+
+struct type {
+	uint32_t node;
+	uint32_t props;
+	uint32_t format;
+	uint32_t prop_threads;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->prop_threads = spa_type_map_get_id(map, SPA_TYPE_PROPS__threads);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
+}
+
+#define MAX_BUFFERS	16
+#define MAX_BLOCKS	4
+
+struct buffer {
+	struct spa_buffer buffer;
+	struct spa_meta metas[1];
+	struct spa_meta_header header;
+	struct spa_data datas[MAX_BLOCKS];
+	struct spa_chunk chunks[MAX_BLOCKS];
+	void *mem[MAX_BLOCKS];
+};
+
+struct port {
+	struct spa_port_io io;
+	struct spa_buffer *bp[MAX_BUFFERS];
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+};
+
+struct packet {
+	void *data;
+	uint32_t size;
+	int64_t pts;
+};
+
+struct node {
+	struct spa_handle *handle;
+	struct spa_node *node;
+	struct port in, out;
+};
+
+struct data {
+	struct type type;
+
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	struct spa_support support[2];
+	uint32_t n_support;
+
+	struct node enc;
+	struct node dec;
+
+	const char *codec;
+	uint32_t n_frames;
+	uint32_t width, height;
+	int32_t threads;
+
+	struct packet *packets;
+	uint32_t n_packets;
+
+	uint32_t n_decoded;
+	uint32_t n_bad;
+};
+
+static inline uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static int make_node(struct data *data, struct node *node, const char *lib, const char *name)
+{
+	int res;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return SPA_RESULT_ERROR;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return SPA_RESULT_ERROR;
+	}
+
+	for (i = 0;; i++) {
+		const struct spa_handle_factory *factory;
+		void *iface;
+
+		if ((res = enum_func(&factory, i)) < 0) {
+			if (res != SPA_RESULT_ENUM_END)
+				printf("can't enumerate factories: %d\n", res);
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		node->handle = calloc(1, factory->size);
+		if ((res =
+		     spa_handle_factory_init(factory, node->handle, NULL, data->support,
+					     data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		if ((res = spa_handle_get_interface(node->handle, data->type.node, &iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return res;
+		}
+		node->node = iface;
+		return SPA_RESULT_OK;
+	}
+	printf("can't find factory %s\n", name);
+	return SPA_RESULT_ERROR;
+}
+
+static int set_threads(struct data *data, struct node *node)
+{
+	struct spa_props *props;
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod_frame f[2];
+	uint8_t buffer[128];
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_pod_builder_props(&b, &f[0], data->type.props,
+		SPA_POD_PROP(&f[1], data->type.prop_threads, 0, SPA_POD_TYPE_INT, 1,
+			data->threads));
+	props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return spa_node_set_props(node->node, props);
+}
+
+static struct spa_format *make_raw_format(struct data *data, uint8_t *buffer, size_t size)
+{
+	struct spa_pod_frame f[2];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, size);
+
+	spa_pod_builder_format(&b, &f[0], data->type.format,
+			       data->type.media_type.video, data->type.media_subtype.raw,
+			       SPA_POD_PROP(&f[1], data->type.format_video.format, 0,
+					    SPA_POD_TYPE_ID, 1, data->type.video_format.I420),
+			       SPA_POD_PROP(&f[1], data->type.format_video.size, 0,
+					    SPA_POD_TYPE_RECTANGLE, 1, data->width, data->height),
+			       SPA_POD_PROP(&f[1], data->type.format_video.framerate, 0,
+					    SPA_POD_TYPE_FRACTION, 1, 30, 1));
+	return SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+}
+
+/* make buffers from the Buffers param of the port, a block of memory for
+ * each block the port asks for */
+static int use_buffers(struct data *data, struct node *node, enum spa_direction direction)
+{
+	struct port *port = direction == SPA_DIRECTION_INPUT ? &node->in : &node->out;
+	struct spa_param *param;
+	uint32_t i, j, size = 0, stride = 0, n_buffers = 4, blocks = 1;
+	int res;
+
+	if ((res = spa_node_port_enum_params(node->node, direction, 0, 0, &param)) < 0)
+		return res;
+
+	spa_param_query(param,
+			data->type.param_alloc_buffers.size, SPA_POD_TYPE_INT, &size,
+			data->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT, &stride,
+			data->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT, &n_buffers,
+			data->type.param_alloc_buffers.blocks, SPA_POD_TYPE_INT, &blocks, 0);
+
+	n_buffers = SPA_CLAMP(n_buffers, 1, MAX_BUFFERS);
+	blocks = SPA_CLAMP(blocks, 1, MAX_BLOCKS);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &port->buffers[i];
+
+		port->bp[i] = &b->buffer;
+		b->buffer.id = i;
+		b->buffer.n_metas = 1;
+		b->buffer.metas = b->metas;
+		b->buffer.n_datas = blocks;
+		b->buffer.datas = b->datas;
+
+		b->metas[0].type = data->type.meta.Header;
+		b->metas[0].data = &b->header;
+		b->metas[0].size = sizeof(b->header);
+
+		for (j = 0; j < blocks; j++) {
+			free(b->mem[j]);
+			if (posix_memalign(&b->mem[j], 64, size) != 0)
+				return SPA_RESULT_NO_MEMORY;
+
+			b->datas[j].type = data->type.data.MemPtr;
+			b->datas[j].flags = 0;
+			b->datas[j].fd = -1;
+			b->datas[j].mapoffset = 0;
+			b->datas[j].maxsize = size;
+			b->datas[j].data = b->mem[j];
+			b->datas[j].chunk = &b->chunks[j];
+			b->datas[j].chunk->offset = 0;
+			b->datas[j].chunk->size = 0;
+			b->datas[j].chunk->stride = j == 0 ? stride : stride / 2;
+		}
+	}
+	port->n_buffers = n_buffers;
+
+	return spa_node_port_use_buffers(node->node, direction, 0, port->bp, n_buffers);
+}
+
+static void free_buffers(struct port *port)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < MAX_BUFFERS; i++)
+		for (j = 0; j < MAX_BLOCKS; j++)
+			free(port->buffers[i].mem[j]);
+}
+
+static inline uint8_t pattern(uint32_t frame, uint32_t x, uint32_t y)
+{
+	return 16 + ((x + y + frame * 4) & 0x7f) + ((x >> 5) & 0x3f);
+}
+
+/* a moving gradient on the luma and flat chroma */
+static void fill_frame(struct data *data, struct buffer *b, uint32_t frame)
+{
+	uint32_t x, y, j;
+	uint8_t *p;
+
+	for (y = 0; y < data->height; y++) {
+		p = SPA_MEMBER(b->mem[0], y * b->chunks[0].stride, uint8_t);
+		for (x = 0; x < data->width; x++)
+			p[x] = pattern(frame, x, y);
+	}
+	for (j = 1; j < 3; j++)
+		memset(b->mem[j], 128, b->chunks[j].stride * (data->height / 2));
+
+	b->header.pts = frame;
+	for (j = 0; j < 3; j++)
+		b->chunks[j].size = b->chunks[j].stride * (j == 0 ? data->height : data->height / 2);
+}
+
+static void check_frame(struct data *data, struct buffer *b)
+{
+	uint32_t x, y, frame = b->header.pts;
+	uint64_t diff = 0;
+	uint8_t *p;
+
+	for (y = 0; y < data->height; y++) {
+		p = SPA_MEMBER(b->mem[0], y * b->chunks[0].stride, uint8_t);
+		for (x = 0; x < data->width; x++)
+			diff += abs(p[x] - pattern(frame, x, y));
+	}
+	if (diff > 8 * data->width * data->height) {
+		printf("frame %u: average difference %f\n", frame,
+		       diff / (double) (data->width * data->height));
+		data->n_bad++;
+	}
+	data->n_decoded++;
+}
+
+static int setup_encoder(struct data *data)
+{
+	struct node *enc = &data->enc;
+	struct spa_format *format;
+	uint8_t buffer[256];
+	int res;
+
+	format = make_raw_format(data, buffer, sizeof(buffer));
+	if ((res = spa_node_port_set_format(enc->node, SPA_DIRECTION_INPUT, 0, 0, format)) < 0)
+		return res;
+	if ((res = spa_node_port_enum_formats(enc->node, SPA_DIRECTION_OUTPUT, 0,
+					      &format, NULL, 0)) < 0)
+		return res;
+	if ((res = spa_node_port_set_format(enc->node, SPA_DIRECTION_OUTPUT, 0, 0, format)) < 0)
+		return res;
+
+	if ((res = use_buffers(data, enc, SPA_DIRECTION_INPUT)) < 0 ||
+	    (res = use_buffers(data, enc, SPA_DIRECTION_OUTPUT)) < 0)
+		return res;
+
+	if (enc->in.bp[0]->n_datas < 3) {
+		printf("encoder input has %d blocks, need planes\n", enc->in.bp[0]->n_datas);
+		return SPA_RESULT_ERROR;
+	}
+
+	enc->in.io = SPA_PORT_IO_INIT;
+	enc->out.io = SPA_PORT_IO_INIT;
+	spa_node_port_set_io(enc->node, SPA_DIRECTION_INPUT, 0, &enc->in.io);
+	spa_node_port_set_io(enc->node, SPA_DIRECTION_OUTPUT, 0, &enc->out.io);
+
+	return SPA_RESULT_OK;
+}
+
+static int setup_decoder(struct data *data)
+{
+	struct node *dec = &data->dec;
+	const struct spa_format *in_format;
+	struct spa_format *format;
+	uint8_t buffer[256];
+	int res;
+
+	if ((res = spa_node_port_get_format(data->enc.node, SPA_DIRECTION_OUTPUT, 0,
+					    &in_format)) < 0)
+		return res;
+	if ((res = spa_node_port_set_format(dec->node, SPA_DIRECTION_INPUT, 0, 0, in_format)) < 0)
+		return res;
+
+	format = make_raw_format(data, buffer, sizeof(buffer));
+	if ((res = spa_node_port_set_format(dec->node, SPA_DIRECTION_OUTPUT, 0, 0, format)) < 0)
+		return res;
+
+	if ((res = use_buffers(data, dec, SPA_DIRECTION_INPUT)) < 0 ||
+	    (res = use_buffers(data, dec, SPA_DIRECTION_OUTPUT)) < 0)
+		return res;
+
+	dec->in.io = SPA_PORT_IO_INIT;
+	dec->out.io = SPA_PORT_IO_INIT;
+	spa_node_port_set_io(dec->node, SPA_DIRECTION_INPUT, 0, &dec->in.io);
+	spa_node_port_set_io(dec->node, SPA_DIRECTION_OUTPUT, 0, &dec->out.io);
+
+	return SPA_RESULT_OK;
+}
+
+static void keep_packet(struct data *data, struct buffer *b)
+{
+	struct packet *p = &data->packets[data->n_packets++];
+
+	p->size = b->chunks[0].size;
+	p->data = malloc(p->size);
+	memcpy(p->data, b->mem[0], p->size);
+	p->pts = b->header.pts;
+}
+
+static int encode(struct data *data)
+{
+	struct node *enc = &data->enc;
+	uint32_t i;
+	int res;
+
+	for (i = 0; i < data->n_frames; i++) {
+		struct buffer *b = &enc->in.buffers[i % enc->in.n_buffers];
+
+		fill_frame(data, b, i);
+
+		enc->in.io.buffer_id = b->buffer.id;
+		enc->in.io.status = SPA_RESULT_HAVE_BUFFER;
+
+		res = spa_node_process_input(enc->node);
+		while (res == SPA_RESULT_HAVE_BUFFER) {
+			if (data->n_packets < data->n_frames)
+				keep_packet(data, &enc->out.buffers[enc->out.io.buffer_id]);
+			enc->out.io.status = SPA_RESULT_NEED_BUFFER;
+			res = spa_node_process_output(enc->node);
+		}
+		if (res != SPA_RESULT_NEED_BUFFER) {
+			printf("encode error %d\n", res);
+			return res;
+		}
+	}
+	return SPA_RESULT_OK;
+}
+
+static int decode(struct data *data)
+{
+	struct node *dec = &data->dec;
+	uint32_t i;
+	int res;
+
+	for (i = 0; i < data->n_packets; i++) {
+		struct packet *p = &data->packets[i];
+		struct buffer *b = &dec->in.buffers[i % dec->in.n_buffers];
+
+		if (p->size > b->datas[0].maxsize) {
+			printf("packet %d too large\n", i);
+			return SPA_RESULT_ERROR;
+		}
+		memcpy(b->mem[0], p->data, p->size);
+		b->chunks[0].offset = 0;
+		b->chunks[0].size = p->size;
+		b->header.pts = p->pts;
+
+		dec->in.io.buffer_id = b->buffer.id;
+		dec->in.io.status = SPA_RESULT_HAVE_BUFFER;
+
+		res = spa_node_process_input(dec->node);
+		while (res == SPA_RESULT_HAVE_BUFFER) {
+			check_frame(data, &dec->out.buffers[dec->out.io.buffer_id]);
+			dec->out.io.status = SPA_RESULT_NEED_BUFFER;
+			res = spa_node_process_output(dec->node);
+		}
+		if (res != SPA_RESULT_NEED_BUFFER) {
+			printf("decode error %d\n", res);
+			return res;
+		}
+	}
+	return SPA_RESULT_OK;
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	const char *str;
+	char name[128];
+	uint64_t start, enc_time, dec_time;
+	uint32_t i;
+	int c, res;
+
+	data.codec = "mpeg4";
+	data.n_frames = 300;
+	data.width = 1280;
+	data.height = 720;
+	data.threads = 0;
+
+	while ((c = getopt(argc, argv, "c:n:s:t:")) != -1) {
+		switch (c) {
+		case 'c':
+			data.codec = optarg;
+			break;
+		case 'n':
+			data.n_frames = atoi(optarg);
+			break;
+		case 's':
+			sscanf(optarg, "%ux%u", &data.width, &data.height);
+			break;
+		case 't':
+			data.threads = atoi(optarg);
+			break;
+		default:
+			printf("usage: %s [-c <codec>] [-n <frames>] [-s <width>x<height>] "
+			       "[-t <threads>]\n", argv[0]);
+			return -1;
+		}
+	}
+	data.width &= ~15;
+	data.height &= ~15;
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+
+	if ((str = getenv("SPA_DEBUG")))
+		data.log->level = atoi(str);
+
+	data.support[0].type = SPA_TYPE__TypeMap;
+	data.support[0].data = data.map;
+	data.support[1].type = SPA_TYPE__Log;
+	data.support[1].data = data.log;
+	data.n_support = 2;
+
+	init_type(&data.type, data.map);
+
+	snprintf(name, sizeof(name), "ffenc_%s", data.codec);
+	if ((res = make_node(&data, &data.enc, PLUGIN, name)) < 0)
+		return -1;
+	snprintf(name, sizeof(name), "ffdec_%s", data.codec);
+	if ((res = make_node(&data, &data.dec, PLUGIN, name)) < 0)
+		return -1;
+
+	if ((res = set_threads(&data, &data.enc)) < 0 ||
+	    (res = set_threads(&data, &data.dec)) < 0 ||
+	    (res = setup_encoder(&data)) < 0 ||
+	    (res = setup_decoder(&data)) < 0) {
+		printf("can't configure %s: %d\n", data.codec, res);
+		return -1;
+	}
+
+	data.packets = calloc(data.n_frames, sizeof(struct packet));
+
+	start = get_time();
+	if (encode(&data) < 0)
+		return -1;
+	enc_time = get_time() - start;
+
+	start = get_time();
+	if (decode(&data) < 0)
+		return -1;
+	dec_time = get_time() - start;
+
+	printf("%s %ux%u, %u threads\n", data.codec, data.width, data.height, data.threads);
+	printf("encode: %u frames, %u packets %8.1f frames/s\n", data.n_frames, data.n_packets,
+	       data.n_frames * (double) SPA_NSEC_PER_SEC / enc_time);
+	printf("decode: %u packets, %u frames %8.1f frames/s\n", data.n_packets, data.n_decoded,
+	       data.n_decoded * (double) SPA_NSEC_PER_SEC / dec_time);
+
+	/* the encoder and the frame threads of the decoder delay some frames */
+	if (data.n_decoded + 2 * MAX_BUFFERS < data.n_frames || data.n_bad > 0) {
+		printf("failed: %u frames decoded, %u bad\n", data.n_decoded, data.n_bad);
+		res = -1;
+	} else {
+		printf("ok\n");
+		res = 0;
+	}
+
+	spa_handle_clear(data.dec.handle);
+	spa_handle_clear(data.enc.handle);
+	free(data.dec.handle);
+	free(data.enc.handle);
+
+	free_buffers(&data.enc.in);
+	free_buffers(&data.enc.out);
+	free_buffers(&data.dec.in);
+	free_buffers(&data.dec.out);
+	for (i = 0; i < data.n_packets; i++)
+		free(data.packets[i].data);
+	free(data.packets);
+
+	return res;
+}
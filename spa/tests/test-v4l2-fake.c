@@ -0,0 +1,600 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Runs the v4l2 source on the fake device with a consumer that is slower
+ * than the camera and compares the latency and the dropped frames of the
+ * default mode with the latest-frame mode.
+ *
+ *   test-v4l2-fake [-m] [-p] [-d <consumer-delay-ms>] [-t <seconds>]
+ *
+ * -m lets the source allocate and export its buffers, by default the
+ * buffers are provided as user pointers. -p makes the fake device
+ * multi-planar and captures NV12 with one data block per plane, the
+ * chunks of both planes are checked for every frame. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <poll.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/type-map-impl.h>
+#include <spa/log-impl.h>
+#include <spa/node.h>
+#include <spa/loop.h>
+#include <spa/video/format-utils.h>
+#include <spa/format-builder.h>
+#include <lib/debug.h>
+#include <lib/props.h>
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+struct type {
+	uint32_t node;
+	uint32_t props;
+	uint32_t format;
+	uint32_t props_device;
+	uint32_t props_latest_frame;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
+	struct spa_type_command_node command_node;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props_device = spa_type_map_get_id(map, SPA_TYPE_PROPS__device);
+	type->props_latest_frame = spa_type_map_get_id(map, SPA_TYPE_PROPS__latestFrame);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
+	spa_type_command_node_map(map, &type->command_node);
+}
+
+#define MAX_BUFFERS	8
+#define WIDTH		640
+#define HEIGHT		480
+#define FRAMERATE	30
+#define MAX_PLANES	2
+
+struct buffer {
+	struct spa_buffer buffer;
+	struct spa_meta metas[2];
+	struct spa_meta_header header;
+	struct spa_meta_dropped dropped;
+	struct spa_data datas[MAX_PLANES];
+	struct spa_chunk chunks[MAX_PLANES];
+	uint8_t *mem[MAX_PLANES];
+};
+
+struct plane {
+	uint32_t size;
+	uint32_t stride;
+};
+
+struct stats {
+	uint32_t frames;
+	uint32_t dropped;
+	uint32_t discont;
+	uint32_t bad_chunks;
+	uint64_t latency_sum;
+	uint64_t latency_max;
+};
+
+struct data {
+	struct type type;
+
+	struct spa_type_map *map;
+	struct spa_log *log;
+	struct spa_loop data_loop;
+
+	struct spa_support support[4];
+	uint32_t n_support;
+
+	struct spa_handle *handle;
+	struct spa_node *source;
+	struct spa_port_io source_output[1];
+
+	bool use_mmap;
+	bool mplane;
+	uint32_t n_planes;
+	struct plane planes[MAX_PLANES];
+	uint32_t delay_ms;
+	uint32_t seconds;
+
+	bool running;
+	pthread_t thread;
+
+	struct spa_source sources[16];
+	unsigned int n_sources;
+
+	bool rebuild_fds;
+	struct pollfd fds[16];
+	unsigned int n_fds;
+
+	struct spa_buffer *bp[MAX_BUFFERS];
+	struct buffer buffers[MAX_BUFFERS];
+	unsigned int n_buffers;
+
+	struct stats stats;
+};
+
+static inline uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static int make_node(struct data *data, struct spa_node **node, const char *lib, const char *name)
+{
+	int res;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return SPA_RESULT_ERROR;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return SPA_RESULT_ERROR;
+	}
+
+	for (i = 0;; i++) {
+		const struct spa_handle_factory *factory;
+		void *iface;
+
+		if ((res = enum_func(&factory, i)) < 0) {
+			if (res != SPA_RESULT_ENUM_END)
+				printf("can't enumerate factories: %d\n", res);
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		data->handle = calloc(1, factory->size);
+		if ((res =
+		     spa_handle_factory_init(factory, data->handle, NULL, data->support,
+					     data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		if ((res = spa_handle_get_interface(data->handle, data->type.node, &iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return res;
+		}
+		*node = iface;
+		return SPA_RESULT_OK;
+	}
+	return SPA_RESULT_ERROR;
+}
+
+static void on_source_done(void *data, int seq, int res)
+{
+}
+
+static void on_source_event(void *_data, struct spa_event *event)
+{
+	printf("got event %d\n", SPA_EVENT_TYPE(event));
+}
+
+static void on_source_have_output(void *_data)
+{
+	struct data *data = _data;
+	struct spa_port_io *io = &data->source_output[0];
+	struct spa_buffer *b;
+	struct spa_meta_header *h;
+	struct spa_meta_dropped *dropped;
+	uint64_t latency;
+	int i, res;
+
+	b = data->bp[io->buffer_id];
+
+	if ((h = spa_buffer_find_meta(b, data->type.meta.Header))) {
+		latency = get_time() - h->pts;
+
+		data->stats.frames++;
+		if (h->flags & SPA_META_HEADER_FLAG_DISCONT)
+			data->stats.discont++;
+		data->stats.latency_sum += latency;
+		if (latency > data->stats.latency_max)
+			data->stats.latency_max = latency;
+	}
+	if ((dropped = spa_buffer_find_meta(b, data->type.meta.Dropped)))
+		data->stats.dropped += dropped->count;
+
+	for (i = 0; i < data->n_planes; i++) {
+		struct spa_chunk *c = b->datas[i].chunk;
+
+		if (i >= b->n_datas || c->size != data->planes[i].size ||
+		    c->stride != data->planes[i].stride) {
+			data->stats.bad_chunks++;
+			break;
+		}
+	}
+
+	/* a consumer that is slower than the camera */
+	usleep(data->delay_ms * 1000);
+
+	io->status = SPA_RESULT_NEED_BUFFER;
+
+	if ((res = spa_node_process_output(data->source)) < 0)
+		printf("got pull error %d\n", res);
+}
+
+static const struct spa_node_callbacks source_callbacks = {
+	SPA_VERSION_NODE_CALLBACKS,
+	.done = on_source_done,
+	.event = on_source_event,
+	.have_output = on_source_have_output
+};
+
+static int do_add_source(struct spa_loop *loop, struct spa_source *source)
+{
+	struct data *data = SPA_CONTAINER_OF(loop, struct data, data_loop);
+
+	data->sources[data->n_sources] = *source;
+	data->n_sources++;
+	data->rebuild_fds = true;
+
+	return SPA_RESULT_OK;
+}
+
+static int do_update_source(struct spa_source *source)
+{
+	return SPA_RESULT_OK;
+}
+
+static void do_remove_source(struct spa_source *source)
+{
+}
+
+static int
+do_invoke(struct spa_loop *loop,
+	  spa_invoke_func_t func, uint32_t seq, size_t size, const void *data, bool block, void *user_data)
+{
+	return func(loop, false, seq, size, data, user_data);
+}
+
+static int make_nodes(struct data *data, bool latest_frame)
+{
+	int res;
+	struct spa_props *props;
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod_frame f[2];
+	uint8_t buffer[256];
+
+	if ((res =
+	     make_node(data, &data->source, "build/spa/plugins/v4l2/libspa-v4l2-fake.so",
+		       "v4l2-source")) < 0) {
+		printf("can't create v4l2-source: %d\n", res);
+		return res;
+	}
+
+	spa_node_set_callbacks(data->source, &source_callbacks, data);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_pod_builder_props(&b, &f[0], data->type.props,
+		SPA_POD_PROP(&f[1], data->type.props_device, 0, SPA_POD_TYPE_STRING, 1,
+			data->mplane ? "fake:mplane" : "fake:"),
+		SPA_POD_PROP(&f[1], data->type.props_latest_frame, 0, SPA_POD_TYPE_BOOL, 1,
+			latest_frame));
+	props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	if ((res = spa_node_set_props(data->source, props)) < 0)
+		printf("got set_props error %d\n", res);
+
+	return res;
+}
+
+static void init_buffer(struct data *data, struct buffer *b, uint32_t id)
+{
+	int i;
+
+	data->bp[id] = &b->buffer;
+
+	b->buffer.id = id;
+	b->buffer.n_metas = 2;
+	b->buffer.metas = b->metas;
+	b->buffer.n_datas = data->n_planes;
+	b->buffer.datas = b->datas;
+
+	spa_zero(b->header);
+	b->metas[0].type = data->type.meta.Header;
+	b->metas[0].data = &b->header;
+	b->metas[0].size = sizeof(b->header);
+
+	spa_zero(b->dropped);
+	b->metas[1].type = data->type.meta.Dropped;
+	b->metas[1].data = &b->dropped;
+	b->metas[1].size = sizeof(b->dropped);
+
+	for (i = 0; i < data->n_planes; i++) {
+		b->datas[i].type = data->type.data.MemPtr;
+		b->datas[i].flags = 0;
+		b->datas[i].fd = -1;
+		b->datas[i].mapoffset = 0;
+		b->datas[i].maxsize = data->planes[i].size;
+		b->datas[i].data = b->mem[i];
+		b->datas[i].chunk = &b->chunks[i];
+		b->datas[i].chunk->offset = 0;
+		b->datas[i].chunk->size = 0;
+		b->datas[i].chunk->stride = 0;
+	}
+}
+
+static int alloc_buffers(struct data *data)
+{
+	int i, j, res;
+	uint32_t n_buffers = MAX_BUFFERS;
+
+	for (i = 0; i < MAX_BUFFERS; i++) {
+		struct buffer *b = &data->buffers[i];
+
+		for (j = 0; j < data->n_planes; j++) {
+			if (!data->use_mmap && b->mem[j] == NULL)
+				b->mem[j] = malloc(data->planes[j].size);
+		}
+		init_buffer(data, b, i);
+	}
+
+	if (data->use_mmap) {
+		if ((res = spa_node_port_alloc_buffers(data->source, SPA_DIRECTION_OUTPUT, 0,
+						       NULL, 0, data->bp, &n_buffers)) < 0)
+			return res;
+	} else {
+		if ((res = spa_node_port_use_buffers(data->source, SPA_DIRECTION_OUTPUT, 0,
+						     data->bp, n_buffers)) < 0)
+			return res;
+	}
+	data->n_buffers = n_buffers;
+
+	return SPA_RESULT_OK;
+}
+
+static int negotiate_formats(struct data *data)
+{
+	int res;
+	struct spa_format *format;
+	struct spa_pod_frame f[2];
+	uint8_t buffer[256];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+
+	data->source_output[0] = SPA_PORT_IO_INIT;
+
+	if ((res =
+	     spa_node_port_set_io(data->source, SPA_DIRECTION_OUTPUT, 0,
+				  &data->source_output[0])) < 0)
+		return res;
+
+	spa_pod_builder_format(&b, &f[0], data->type.format,
+			       data->type.media_type.video, data->type.media_subtype.raw,
+			       SPA_POD_PROP(&f[1], data->type.format_video.format, 0,
+					    SPA_POD_TYPE_ID, 1,
+					    data->mplane ? data->type.video_format.NV12 :
+							   data->type.video_format.YUY2),
+			       SPA_POD_PROP(&f[1], data->type.format_video.size, 0,
+					    SPA_POD_TYPE_RECTANGLE, 1,
+					    WIDTH, HEIGHT),
+			       SPA_POD_PROP(&f[1], data->type.format_video.framerate, 0,
+					    SPA_POD_TYPE_FRACTION, 1, FRAMERATE, 1));
+	format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	if ((res = spa_node_port_set_format(data->source, SPA_DIRECTION_OUTPUT, 0, 0, format)) < 0)
+		return res;
+
+	return alloc_buffers(data);
+}
+
+static void *loop(void *user_data)
+{
+	struct data *data = user_data;
+
+	while (data->running) {
+		int i, r;
+
+		if (data->rebuild_fds) {
+			for (i = 0; i < data->n_sources; i++) {
+				struct spa_source *p = &data->sources[i];
+				data->fds[i].fd = p->fd;
+				data->fds[i].events = p->mask;
+			}
+			data->n_fds = data->n_sources;
+			data->rebuild_fds = false;
+		}
+
+		r = poll((struct pollfd *) data->fds, data->n_fds, 100);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (r == 0)
+			continue;
+
+		for (i = 0; i < data->n_sources; i++) {
+			struct spa_source *p = &data->sources[i];
+			p->rmask = 0;
+			if (data->fds[i].revents & POLLIN)
+				p->rmask |= SPA_IO_IN;
+			if (data->fds[i].revents & POLLERR)
+				p->rmask |= SPA_IO_ERR;
+		}
+		for (i = 0; i < data->n_sources; i++) {
+			struct spa_source *p = &data->sources[i];
+			if (p->rmask)
+				p->func(p);
+		}
+	}
+	return NULL;
+}
+
+static int run(struct data *data, bool latest_frame)
+{
+	struct stats *s = &data->stats;
+	int res, err;
+
+	spa_zero(*s);
+	data->n_sources = 0;
+
+	if ((res = make_nodes(data, latest_frame)) < 0)
+		return res;
+
+	if ((res = negotiate_formats(data)) < 0) {
+		printf("can't negotiate nodes: %d\n", res);
+		return res;
+	}
+
+	{
+		struct spa_command cmd = SPA_COMMAND_INIT(data->type.command_node.Start);
+		if ((res = spa_node_send_command(data->source, &cmd)) < 0) {
+			printf("got error %d\n", res);
+			return res;
+		}
+	}
+
+	data->running = true;
+	if ((err = pthread_create(&data->thread, NULL, loop, data)) != 0) {
+		printf("can't create thread: %d %s", err, strerror(err));
+		return SPA_RESULT_ERROR;
+	}
+
+	sleep(data->seconds);
+
+	data->running = false;
+	pthread_join(data->thread, NULL);
+
+	{
+		struct spa_command cmd = SPA_COMMAND_INIT(data->type.command_node.Pause);
+		if ((res = spa_node_send_command(data->source, &cmd)) < 0)
+			printf("got error %d\n", res);
+	}
+	spa_node_port_set_format(data->source, SPA_DIRECTION_OUTPUT, 0, 0, NULL);
+	spa_handle_clear(data->handle);
+	free(data->handle);
+
+	printf("%-8s: %5u frames, %5u dropped (%u discont), latency avg %6.2f ms max %6.2f ms\n",
+	       latest_frame ? "latest" : "default", s->frames, s->dropped, s->discont,
+	       s->frames ? s->latency_sum / (double) s->frames / 1000000.0 : 0.0,
+	       s->latency_max / 1000000.0);
+
+	if (s->bad_chunks > 0) {
+		printf("%u frames with unexpected plane chunks\n", s->bad_chunks);
+		return SPA_RESULT_ERROR;
+	}
+	return SPA_RESULT_OK;
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	const char *str;
+	int c, i, j;
+
+	data.delay_ms = 50;
+	data.seconds = 3;
+
+	while ((c = getopt(argc, argv, "mpd:t:")) != -1) {
+		switch (c) {
+		case 'm':
+			data.use_mmap = true;
+			break;
+		case 'p':
+			data.mplane = true;
+			break;
+		case 'd':
+			data.delay_ms = atoi(optarg);
+			break;
+		case 't':
+			data.seconds = atoi(optarg);
+			break;
+		default:
+			printf("usage: %s [-m] [-p] [-d <consumer-delay-ms>] [-t <seconds>]\n",
+			       argv[0]);
+			return -1;
+		}
+	}
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+
+	if ((str = getenv("SPA_DEBUG")))
+		data.log->level = atoi(str);
+
+	data.data_loop.version = SPA_VERSION_LOOP;
+	data.data_loop.add_source = do_add_source;
+	data.data_loop.update_source = do_update_source;
+	data.data_loop.remove_source = do_remove_source;
+	data.data_loop.invoke = do_invoke;
+
+	data.support[0].type = SPA_TYPE__TypeMap;
+	data.support[0].data = data.map;
+	data.support[1].type = SPA_TYPE__Log;
+	data.support[1].data = data.log;
+	data.support[2].type = SPA_TYPE_LOOP__DataLoop;
+	data.support[2].data = &data.data_loop;
+	data.support[3].type = SPA_TYPE_LOOP__MainLoop;
+	data.support[3].data = &data.data_loop;
+	data.n_support = 4;
+
+	init_type(&data.type, data.map);
+
+	if (data.mplane) {
+		/* NV12, the Y plane and the interleaved UV plane at half height */
+		data.n_planes = 2;
+		data.planes[0].size = WIDTH * HEIGHT;
+		data.planes[0].stride = WIDTH;
+		data.planes[1].size = WIDTH * HEIGHT / 2;
+		data.planes[1].stride = WIDTH;
+	} else {
+		/* YUY2 */
+		data.n_planes = 1;
+		data.planes[0].size = WIDTH * 2 * HEIGHT;
+		data.planes[0].stride = WIDTH * 2;
+	}
+
+	printf("fake camera %dx%d@%d %s, consumer takes %u ms per frame, %s buffers\n",
+	       WIDTH, HEIGHT, FRAMERATE, data.mplane ? "NV12 2 planes" : "YUY2",
+	       data.delay_ms, data.use_mmap ? "mmap" : "userptr");
+
+	if (run(&data, false) < 0 || run(&data, true) < 0)
+		return -1;
+
+	for (i = 0; i < MAX_BUFFERS; i++)
+		for (j = 0; j < MAX_PLANES; j++)
+			free(data.buffers[i].mem[j]);
+
+	return 0;
+}
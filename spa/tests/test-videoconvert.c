@@ -0,0 +1,390 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the throughput of the video converter for some common
+ * conversions, with the C kernels and with the SIMD kernels of this
+ * machine, and checks that both give the same result and that converting
+ * only a changed region gives the same result as converting the frame.
+ * The color matrix is checked on the limits of the studio swing range.
+ *
+ *   test-videoconvert [-n <frames>] [-t <threads>]
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "convert.h"
+
+#define MAX_THREADS	8
+
+struct test {
+	const char *name;
+	enum video_convert_format in_format;
+	int in_width, in_height;
+	enum video_convert_format out_format;
+	int out_width, out_height;
+	enum video_convert_scale scale;
+};
+
+#define FMT(f)	VIDEO_CONVERT_FORMAT_ ##f
+#define BILINEAR VIDEO_CONVERT_SCALE_BILINEAR
+#define AREA	VIDEO_CONVERT_SCALE_AREA
+
+static const struct test tests[] = {
+	{ "I420 copy",        FMT(I420), 1920, 1080, FMT(I420), 1920, 1080, BILINEAR },
+	{ "YUY2 to I420",     FMT(YUY2), 1920, 1080, FMT(I420), 1920, 1080, BILINEAR },
+	{ "UYVY to NV12",     FMT(UYVY), 1920, 1080, FMT(NV12), 1920, 1080, BILINEAR },
+	{ "I420 to BGRx",     FMT(I420), 1920, 1080, FMT(BGRx), 1920, 1080, BILINEAR },
+	{ "NV12 to RGBA",     FMT(NV12), 1920, 1080, FMT(RGBA), 1920, 1080, BILINEAR },
+	{ "YUY2 to RGB",      FMT(YUY2), 1920, 1080, FMT(RGB),  1920, 1080, BILINEAR },
+	{ "BGRx to I420",     FMT(BGRx), 1920, 1080, FMT(I420), 1920, 1080, BILINEAR },
+	{ "RGB to YUY2",      FMT(RGB),  1920, 1080, FMT(YUY2), 1920, 1080, BILINEAR },
+	{ "I420 1080p->720p", FMT(I420), 1920, 1080, FMT(I420), 1280,  720, BILINEAR },
+	{ "I420 720p->1080p", FMT(I420), 1280,  720, FMT(BGRx), 1920, 1080, BILINEAR },
+	{ "BGRx 4K->1080p",   FMT(BGRx), 3840, 2160, FMT(BGRx), 1920, 1080, AREA },
+	{ "NV12 4K->720p",    FMT(NV12), 3840, 2160, FMT(I420), 1280,  720, AREA },
+};
+
+struct frame {
+	struct video_convert_frame f;
+	uint8_t *mem;
+	size_t size;
+};
+
+static int alloc_frame(struct frame *frame, enum video_convert_format format,
+		       int width, int height)
+{
+	size_t offsets[VIDEO_CONVERT_MAX_PLANES];
+	uint32_t i, n_planes;
+
+	n_planes = video_convert_get_layout(format, width, height,
+					    frame->f.stride, offsets, &frame->size);
+	if (n_planes == 0)
+		return -1;
+
+	if (posix_memalign((void **) &frame->mem, 64, frame->size) != 0)
+		return -1;
+
+	for (i = 0; i < n_planes; i++)
+		frame->f.data[i] = frame->mem + offsets[i];
+
+	return 0;
+}
+
+struct data {
+	struct video_convert *conv;
+	const struct video_convert_frame *src;
+	struct video_convert_frame *dst;
+
+	uint32_t n_threads;
+	pthread_t threads[MAX_THREADS];
+	pthread_barrier_t start;
+	pthread_barrier_t done;
+	bool quit;
+};
+
+struct worker {
+	struct data *data;
+	uint32_t band;
+};
+
+static struct worker workers[MAX_THREADS];
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct data *data = w->data;
+
+	while (true) {
+		pthread_barrier_wait(&data->start);
+		if (data->quit)
+			break;
+		video_convert_process(data->conv, w->band, data->n_threads, data->src, data->dst);
+		pthread_barrier_wait(&data->done);
+	}
+	return NULL;
+}
+
+static void convert_frame(struct data *data)
+{
+	if (data->n_threads == 1) {
+		video_convert_process(data->conv, 0, 1, data->src, data->dst);
+		return;
+	}
+	pthread_barrier_wait(&data->start);
+	video_convert_process(data->conv, 0, data->n_threads, data->src, data->dst);
+	pthread_barrier_wait(&data->done);
+}
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* returns the output megapixels per second */
+static double run(struct data *data, struct video_convert *conv, int n_frames,
+		  const struct frame *src, struct frame *dst, int out_pixels)
+{
+	uint64_t t1, t2;
+	int i;
+
+	data->conv = conv;
+	data->src = &src->f;
+	data->dst = &dst->f;
+
+	convert_frame(data);
+
+	t1 = get_time();
+	for (i = 0; i < n_frames; i++)
+		convert_frame(data);
+	t2 = get_time();
+
+	return (double) out_pixels * n_frames * 1000.0 / (t2 - t1);
+}
+
+/* convert a frame with a changed region into \a dst, which holds the conversion
+ * of \a src, by converting only that region and compare with a conversion of the
+ * whole frame. The frames are made from AYUV frames so that the change is easy
+ * to keep inside the region. */
+static bool check_region(struct video_convert *conv, const struct test *t,
+			 struct frame *src, struct frame *dst)
+{
+	struct video_convert_region region = { (t->in_width / 3) & ~1, (t->in_height / 5) & ~1,
+					       (t->in_width / 7) & ~1, (t->in_height / 9) & ~1 };
+	struct video_convert *make;
+	struct frame ayuv, changed, ref;
+	int y;
+	size_t i;
+	bool same;
+
+	make = video_convert_new(FMT(AYUV), t->in_width, t->in_height,
+				 t->in_format, t->in_width, t->in_height, BILINEAR, 1, 0);
+	if (make == NULL ||
+	    alloc_frame(&ayuv, FMT(AYUV), t->in_width, t->in_height) < 0 ||
+	    alloc_frame(&changed, t->in_format, t->in_width, t->in_height) < 0 ||
+	    alloc_frame(&ref, t->out_format, t->out_width, t->out_height) < 0)
+		return false;
+
+	for (i = 0; i < ayuv.size; i++)
+		ayuv.mem[i] = rand();
+	video_convert_process(make, 0, 1, &ayuv.f, &src->f);
+	video_convert_process(conv, 0, 1, &src->f, &dst->f);
+
+	for (y = region.y; y < region.y + region.height; y++)
+		memset(ayuv.f.data[0] + y * ayuv.f.stride[0] + region.x * 4, 0x80, region.width * 4);
+	video_convert_process(make, 0, 1, &ayuv.f, &changed.f);
+
+	video_convert_process_region(conv, 0, 1, &region, &changed.f, &dst->f);
+	memset(ref.mem, 0, ref.size);
+	video_convert_process(conv, 0, 1, &changed.f, &ref.f);
+
+	same = memcmp(dst->mem, ref.mem, ref.size) == 0;
+
+	free(ayuv.mem);
+	free(changed.mem);
+	free(ref.mem);
+	video_convert_free(make);
+
+	return same;
+}
+
+struct color {
+	uint8_t yuv[3];
+	uint8_t rgb[3];
+};
+
+/* BT.601 studio swing, the black and white points and the primaries */
+static const struct color colors[] = {
+	{ {  16, 128, 128 }, {   0,   0,   0 } },
+	{ { 235, 128, 128 }, { 255, 255, 255 } },
+	{ { 126, 128, 128 }, { 128, 128, 128 } },
+	{ {  81,  90, 240 }, { 255,   0,   0 } },
+	{ { 145,  54,  34 }, {   0, 255,   0 } },
+	{ {  41, 240, 110 }, {   0,   0, 255 } },
+};
+
+/* convert a frame filled with one pixel and check all pixels of the result */
+static bool check_pixel(enum video_convert_format in_format, const uint8_t *in,
+			enum video_convert_format out_format, const uint8_t *out,
+			uint32_t flags, int tolerance)
+{
+	struct video_convert *conv;
+	struct frame src, dst;
+	int i, c, width = 64, height = 2;
+	bool ok = true;
+
+	conv = video_convert_new(in_format, width, height, out_format, width, height,
+				 BILINEAR, 1, flags);
+	if (conv == NULL ||
+	    alloc_frame(&src, in_format, width, height) < 0 ||
+	    alloc_frame(&dst, out_format, width, height) < 0)
+		return false;
+
+	for (i = 0; i < width * height; i++) {
+		src.mem[i * 4] = 0xff;
+		memcpy(&src.mem[i * 4 + 1], in, 3);
+	}
+	video_convert_process(conv, 0, 1, &src.f, &dst.f);
+
+	for (i = 0; i < width * height && ok; i++) {
+		for (c = 0; c < 3; c++) {
+			if (abs(dst.mem[i * 4 + 1 + c] - out[c]) > tolerance) {
+				printf("%s %3d %3d %3d -> %3d %3d %3d, expected %3d %3d %3d\n",
+				       video_convert_get_kernels(conv), in[0], in[1], in[2],
+				       dst.mem[i * 4 + 1], dst.mem[i * 4 + 2], dst.mem[i * 4 + 3],
+				       out[0], out[1], out[2]);
+				ok = false;
+				break;
+			}
+		}
+	}
+	free(src.mem);
+	free(dst.mem);
+	video_convert_free(conv);
+
+	return ok;
+}
+
+static bool check_colors(void)
+{
+	uint32_t i, j, flags[] = { VIDEO_CONVERT_FLAG_NO_SIMD, 0 };
+	bool ok = true;
+
+	for (i = 0; i < SPA_N_ELEMENTS(flags); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(colors); j++) {
+			/* black and white must be exact, the other colors can be off
+			 * by one because their studio swing values are rounded */
+			int tolerance = j < 2 ? 0 : 1;
+
+			ok &= check_pixel(FMT(AYUV), colors[j].yuv, FMT(ARGB), colors[j].rgb,
+					  flags[i], tolerance);
+			ok &= check_pixel(FMT(ARGB), colors[j].rgb, FMT(AYUV), colors[j].yuv,
+					  flags[i], tolerance);
+		}
+	}
+	return ok;
+}
+
+static void run_test(struct data *data, const struct test *t, int n_frames)
+{
+	struct video_convert *c_conv, *simd_conv;
+	struct frame src, c_dst, simd_dst;
+	double c_mps, simd_mps;
+	size_t i;
+	bool same, region_same;
+
+	c_conv = video_convert_new(t->in_format, t->in_width, t->in_height,
+				   t->out_format, t->out_width, t->out_height,
+				   t->scale, MAX_THREADS, VIDEO_CONVERT_FLAG_NO_SIMD);
+	simd_conv = video_convert_new(t->in_format, t->in_width, t->in_height,
+				      t->out_format, t->out_width, t->out_height,
+				      t->scale, MAX_THREADS, 0);
+	if (c_conv == NULL || simd_conv == NULL) {
+		printf("%-18s: not supported\n", t->name);
+		return;
+	}
+
+	if (alloc_frame(&src, t->in_format, t->in_width, t->in_height) < 0 ||
+	    alloc_frame(&c_dst, t->out_format, t->out_width, t->out_height) < 0 ||
+	    alloc_frame(&simd_dst, t->out_format, t->out_width, t->out_height) < 0) {
+		printf("%-18s: can't allocate frames\n", t->name);
+		exit(-1);
+	}
+
+	srand(0);
+	for (i = 0; i < src.size; i++)
+		src.mem[i] = rand();
+	memset(c_dst.mem, 0, c_dst.size);
+	memset(simd_dst.mem, 0, simd_dst.size);
+
+	c_mps = run(data, c_conv, n_frames, &src, &c_dst, t->out_width * t->out_height);
+	simd_mps = run(data, simd_conv, n_frames, &src, &simd_dst, t->out_width * t->out_height);
+
+	same = memcmp(c_dst.mem, simd_dst.mem, c_dst.size) == 0;
+	region_same = check_region(c_conv, t, &src, &c_dst);
+
+	printf("%-18s: c %8.1f MPix/s, %-4s %8.1f MPix/s (%5.2fx) %s%s\n", t->name,
+	       c_mps, video_convert_get_kernels(simd_conv), simd_mps, simd_mps / c_mps,
+	       same ? "ok" : "MISMATCH", region_same ? "" : " REGION MISMATCH");
+
+	free(src.mem);
+	free(c_dst.mem);
+	free(simd_dst.mem);
+	video_convert_free(c_conv);
+	video_convert_free(simd_conv);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL, };
+	int c, n_frames = 50, res = 0;
+	uint32_t i;
+
+	data.n_threads = 1;
+
+	while ((c = getopt(argc, argv, "n:t:")) != -1) {
+		switch (c) {
+		case 'n':
+			n_frames = atoi(optarg);
+			break;
+		case 't':
+			data.n_threads = SPA_CLAMP(atoi(optarg), 1, MAX_THREADS);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n <frames>] [-t <threads>]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	pthread_barrier_init(&data.start, NULL, data.n_threads);
+	pthread_barrier_init(&data.done, NULL, data.n_threads);
+	for (i = 1; i < data.n_threads; i++) {
+		workers[i].data = &data;
+		workers[i].band = i;
+		pthread_create(&data.threads[i], NULL, worker_thread, &workers[i]);
+	}
+
+	if (!check_colors()) {
+		printf("color matrix: MISMATCH\n");
+		res = -1;
+	} else
+		printf("color matrix: ok\n");
+
+	printf("%d frames, %d threads\n", n_frames, data.n_threads);
+	for (i = 0; i < SPA_N_ELEMENTS(tests); i++)
+		run_test(&data, &tests[i], n_frames);
+
+	if (data.n_threads > 1) {
+		data.quit = true;
+		pthread_barrier_wait(&data.start);
+		for (i = 1; i < data.n_threads; i++)
+			pthread_join(data.threads[i], NULL);
+	}
+	pthread_barrier_destroy(&data.start);
+	pthread_barrier_destroy(&data.done);
+
+	return res;
+}
@@ -0,0 +1,603 @@
+/* Spa
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures how many frames per second the videotestsrc can render for
+ * all its formats at 1080p and 4K. The last frame of every run is compared
+ * with a reference rendering of the pattern, pixel by pixel.
+ *
+ *   test-videotestsrc [-n <frames>] [-p smpte-snow|snow]
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include <spa/type-map-impl.h>
+#include <spa/log-impl.h>
+#include <spa/node.h>
+#include <spa/param-alloc.h>
+#include <spa/video/format-utils.h>
+#include <spa/format-builder.h>
+#include <lib/props.h>
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+struct type {
+	uint32_t node;
+	uint32_t props;
+	uint32_t format;
+	uint32_t prop_pattern;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->prop_pattern = spa_type_map_get_id(map, SPA_TYPE_PROPS__patternType);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
+}
+
+#define N_BUFFERS	2
+
+enum format_kind {
+	FORMAT_RGB,
+	FORMAT_UYVY,
+	FORMAT_RGBX,
+	FORMAT_BGRX,
+	FORMAT_NV12,
+	FORMAT_I420,
+};
+
+struct rgb {
+	uint8_t r, g, b;
+};
+
+struct yuv {
+	uint8_t y, u, v;
+};
+
+enum {
+	GRAY, YELLOW, CYAN, GREEN, MAGENTA, RED, BLUE, BLACK,
+	NEG_I, WHITE, POS_Q, DARK_BLACK, LIGHT_BLACK,
+};
+
+/* the colors of the SMPTE pattern, in the order of the bars */
+static const struct rgb colors[] = {
+	{ 191, 191, 191 },	/* GRAY */
+	{ 191, 191, 0 },	/* YELLOW */
+	{ 0, 191, 191 },	/* CYAN */
+	{ 0, 191, 0 },		/* GREEN */
+	{ 191, 0, 191 },	/* MAGENTA */
+	{ 191, 0, 0 },		/* RED */
+	{ 0, 0, 191 },		/* BLUE */
+	{ 19, 19, 19 },		/* BLACK */
+	{ 0, 33, 76 },		/* NEGATIVE I */
+	{ 255, 255, 255 },	/* WHITE */
+	{ 49, 0, 107 },		/* POSITIVE Q */
+	{ 9, 9, 9 },		/* DARK BLACK */
+	{ 29, 29, 29 },		/* LIGHT BLACK */
+};
+
+struct buffer {
+	struct spa_buffer buffer;
+	struct spa_data datas[1];
+	struct spa_chunk chunks[1];
+	void *mem;
+};
+
+struct data {
+	struct type type;
+
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	struct spa_support support[2];
+	uint32_t n_support;
+
+	struct spa_handle *handle;
+	struct spa_node *source;
+	struct spa_port_io io;
+
+	struct spa_buffer *bp[N_BUFFERS];
+	struct buffer buffers[N_BUFFERS];
+
+	uint32_t n_frames;
+	const char *pattern;
+	bool smpte;
+};
+
+static inline uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static int make_node(struct data *data, struct spa_node **node, const char *lib, const char *name)
+{
+	int res;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return SPA_RESULT_ERROR;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return SPA_RESULT_ERROR;
+	}
+
+	for (i = 0;; i++) {
+		const struct spa_handle_factory *factory;
+		void *iface;
+
+		if ((res = enum_func(&factory, i)) < 0) {
+			if (res != SPA_RESULT_ENUM_END)
+				printf("can't enumerate factories: %d\n", res);
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		data->handle = calloc(1, factory->size);
+		if ((res =
+		     spa_handle_factory_init(factory, data->handle, NULL, data->support,
+					     data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		if ((res = spa_handle_get_interface(data->handle, data->type.node, &iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return res;
+		}
+		*node = iface;
+		return SPA_RESULT_OK;
+	}
+	return SPA_RESULT_ERROR;
+}
+
+static int set_pattern(struct data *data)
+{
+	struct spa_props *props;
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod_frame f[2];
+	uint8_t buffer[128];
+	char name[128];
+
+	snprintf(name, sizeof(name), SPA_TYPE_PROPS__patternType ":%s", data->pattern);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_pod_builder_props(&b, &f[0], data->type.props,
+		SPA_POD_PROP(&f[1], data->type.prop_pattern, 0, SPA_POD_TYPE_ID, 1,
+			spa_type_map_get_id(data->map, name)));
+	props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return spa_node_set_props(data->source, props);
+}
+
+static int set_format(struct data *data, uint32_t format, uint32_t width, uint32_t height)
+{
+	struct spa_format *fmt;
+	struct spa_pod_frame f[2];
+	uint8_t buffer[256];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+
+	spa_pod_builder_format(&b, &f[0], data->type.format,
+			       data->type.media_type.video, data->type.media_subtype.raw,
+			       SPA_POD_PROP(&f[1], data->type.format_video.format, 0,
+					    SPA_POD_TYPE_ID, 1, format),
+			       SPA_POD_PROP(&f[1], data->type.format_video.size, 0,
+					    SPA_POD_TYPE_RECTANGLE, 1, width, height),
+			       SPA_POD_PROP(&f[1], data->type.format_video.framerate, 0,
+					    SPA_POD_TYPE_FRACTION, 1, 30, 1));
+	fmt = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	return spa_node_port_set_format(data->source, SPA_DIRECTION_OUTPUT, 0, 0, fmt);
+}
+
+static int use_buffers(struct data *data)
+{
+	struct spa_param *param;
+	int res, i;
+	uint32_t size = 0, stride = 0;
+
+	if ((res = spa_node_port_enum_params(data->source, SPA_DIRECTION_OUTPUT, 0, 0,
+					     &param)) < 0)
+		return res;
+
+	spa_param_query(param,
+			data->type.param_alloc_buffers.size, SPA_POD_TYPE_INT, &size,
+			data->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT, &stride, 0);
+
+	for (i = 0; i < N_BUFFERS; i++) {
+		struct buffer *b = &data->buffers[i];
+
+		free(b->mem);
+		if (posix_memalign(&b->mem, 64, size) != 0)
+			return SPA_RESULT_NO_MEMORY;
+
+		data->bp[i] = &b->buffer;
+		b->buffer.id = i;
+		b->buffer.n_metas = 0;
+		b->buffer.n_datas = 1;
+		b->buffer.datas = b->datas;
+
+		b->datas[0].type = data->type.data.MemPtr;
+		b->datas[0].flags = 0;
+		b->datas[0].fd = -1;
+		b->datas[0].mapoffset = 0;
+		b->datas[0].maxsize = size;
+		b->datas[0].data = b->mem;
+		b->datas[0].chunk = &b->chunks[0];
+		b->datas[0].chunk->offset = 0;
+		b->datas[0].chunk->size = 0;
+		b->datas[0].chunk->stride = stride;
+	}
+	return spa_node_port_use_buffers(data->source, SPA_DIRECTION_OUTPUT, 0,
+					 data->bp, N_BUFFERS);
+}
+
+/* BT.601 studio swing, the same integer math as the videotestsrc */
+static struct yuv to_yuv(const struct rgb *c)
+{
+	uint16_t y, u, v;
+	struct yuv res;
+
+	y = 76 * c->r + 150 * c->g + 29 * c->b;
+	u = -43 * c->r - 84 * c->g + 127 * c->b;
+	v = 127 * c->r - 106 * c->g - 21 * c->b;
+
+	res.y = (y + 128) >> 8;
+	res.u = ((u + 128) >> 8) + 128;
+	res.v = ((v + 128) >> 8) + 128;
+
+	return res;
+}
+
+/* The color of pixel \a x, \a y of the SMPTE pattern, -1 for snow. The snow
+ * starts on an even pixel so that a chroma pair is never half snow. */
+static int smpte_color(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+	uint32_t j, x1;
+
+	if (y < 3 * h / 4) {
+		for (j = 0; x >= (j + 1) * w / 7; j++);
+		if (y < 2 * h / 3)
+			return j;
+		return (j & 1) ? BLACK : BLUE - j;
+	}
+
+	x1 = 3 * (w / 6);
+	if (x < w / 6)
+		return NEG_I;
+	if (x < 2 * (w / 6))
+		return WHITE;
+	if (x < x1)
+		return POS_Q;
+	if (x >= ((x1 + 3 * (w / 12)) & ~1))
+		return -1;
+	if (x < x1 + w / 12)
+		return DARK_BLACK;
+	if (x < x1 + 2 * (w / 12))
+		return BLACK;
+	return LIGHT_BLACK;
+}
+
+/* the expected color of a pixel, gray for snow */
+static bool ref_pixel(struct data *data, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+		      struct rgb *rgb, struct yuv *yuv)
+{
+	int c = data->smpte ? smpte_color(x, y, w, h) : -1;
+
+	if (c < 0) {
+		rgb->r = rgb->g = rgb->b = 128;
+		yuv->y = yuv->u = yuv->v = 128;
+		return false;
+	}
+	*rgb = colors[c];
+	*yuv = to_yuv(rgb);
+	return true;
+}
+
+static int check_pixel(const char *name, uint32_t x, uint32_t y, const char *what,
+		       uint8_t got, uint8_t expected)
+{
+	if (got == expected)
+		return 0;
+
+	printf("%s: pixel %u,%u has %s %u, expected %u\n", name, x, y, what, got, expected);
+	return 1;
+}
+
+/* compare \a frame with the reference pattern, the planes are contiguous and
+ * the chroma of a pair of pixels is that of the even pixel, on the even line
+ * for NV12 and I420 */
+static int check_frame(struct data *data, const char *name, enum format_kind kind,
+		       uint32_t w, uint32_t h, const uint8_t *frame, uint32_t size)
+{
+	uint32_t x, y, strides[3], offsets[3], expected_size;
+	struct rgb rgb, crgb;
+	struct yuv yuv, cyuv;
+	const uint8_t *p;
+	bool solid;
+	int errors = 0;
+
+	switch (kind) {
+	case FORMAT_RGB:
+		strides[0] = SPA_ROUND_UP_N(w * 3, 4);
+		expected_size = strides[0] * h;
+		break;
+	case FORMAT_UYVY:
+		strides[0] = SPA_ROUND_UP_N(w * 2, 4);
+		expected_size = strides[0] * h;
+		break;
+	case FORMAT_RGBX:
+	case FORMAT_BGRX:
+		strides[0] = w * 4;
+		expected_size = strides[0] * h;
+		break;
+	case FORMAT_NV12:
+		strides[0] = strides[1] = SPA_ROUND_UP_N(w, 4);
+		offsets[1] = strides[0] * h;
+		expected_size = offsets[1] + strides[1] * ((h + 1) / 2);
+		break;
+	case FORMAT_I420:
+		strides[0] = SPA_ROUND_UP_N(w, 4);
+		strides[1] = strides[2] = SPA_ROUND_UP_N((w + 1) / 2, 4);
+		offsets[1] = strides[0] * h;
+		offsets[2] = offsets[1] + strides[1] * ((h + 1) / 2);
+		expected_size = offsets[2] + strides[2] * ((h + 1) / 2);
+		break;
+	default:
+		return SPA_RESULT_ERROR;
+	}
+	if (size != expected_size) {
+		printf("%s: frame of %u bytes, expected %u\n", name, size, expected_size);
+		return SPA_RESULT_ERROR;
+	}
+
+	for (y = 0; y < h && errors < 10; y++) {
+		for (x = 0; x < w && errors < 10; x++) {
+			solid = ref_pixel(data, x, y, w, h, &rgb, &yuv);
+			ref_pixel(data, x & ~1, kind == FORMAT_UYVY ? y : y & ~1, w, h,
+				  &crgb, &cyuv);
+
+			switch (kind) {
+			case FORMAT_RGB:
+				p = frame + y * strides[0] + 3 * x;
+				if (solid) {
+					errors += check_pixel(name, x, y, "R", p[0], rgb.r);
+					errors += check_pixel(name, x, y, "G", p[1], rgb.g);
+					errors += check_pixel(name, x, y, "B", p[2], rgb.b);
+				} else {
+					errors += check_pixel(name, x, y, "G", p[1], p[0]);
+					errors += check_pixel(name, x, y, "B", p[2], p[0]);
+				}
+				break;
+			case FORMAT_RGBX:
+			case FORMAT_BGRX:
+				p = frame + y * strides[0] + 4 * x;
+				if (solid) {
+					bool bgr = kind == FORMAT_BGRX;
+
+					errors += check_pixel(name, x, y, "byte 0", p[0],
+							      bgr ? rgb.b : rgb.r);
+					errors += check_pixel(name, x, y, "byte 1", p[1], rgb.g);
+					errors += check_pixel(name, x, y, "byte 2", p[2],
+							      bgr ? rgb.r : rgb.b);
+				} else {
+					errors += check_pixel(name, x, y, "byte 1", p[1], p[0]);
+					errors += check_pixel(name, x, y, "byte 2", p[2], p[0]);
+				}
+				errors += check_pixel(name, x, y, "x", p[3], 0xff);
+				break;
+			case FORMAT_UYVY:
+				p = frame + y * strides[0] + 2 * (x & ~1);
+				if (solid)
+					errors += check_pixel(name, x, y, "Y", p[(x & 1) ? 3 : 1], yuv.y);
+				if (!(x & 1)) {
+					errors += check_pixel(name, x, y, "U", p[0], cyuv.u);
+					errors += check_pixel(name, x, y, "V", p[2], cyuv.v);
+				}
+				break;
+			case FORMAT_NV12:
+				if (solid)
+					errors += check_pixel(name, x, y, "Y",
+							      frame[y * strides[0] + x], yuv.y);
+				if (!(x & 1) && !(y & 1)) {
+					p = frame + offsets[1] + (y / 2) * strides[1] + x;
+					errors += check_pixel(name, x, y, "U", p[0], cyuv.u);
+					errors += check_pixel(name, x, y, "V", p[1], cyuv.v);
+				}
+				break;
+			case FORMAT_I420:
+				if (solid)
+					errors += check_pixel(name, x, y, "Y",
+							      frame[y * strides[0] + x], yuv.y);
+				if (!(x & 1) && !(y & 1)) {
+					p = frame + (y / 2) * strides[1] + x / 2;
+					errors += check_pixel(name, x, y, "U", p[offsets[1]], cyuv.u);
+					errors += check_pixel(name, x, y, "V", p[offsets[2]], cyuv.v);
+				}
+				break;
+			}
+		}
+	}
+	return errors > 0 ? SPA_RESULT_ERROR : SPA_RESULT_OK;
+}
+
+static int run(struct data *data, const char *name, uint32_t format, enum format_kind kind,
+	       uint32_t width, uint32_t height)
+{
+	struct spa_data *d;
+	uint64_t start, elapsed;
+	uint32_t i;
+	int res;
+
+	if ((res = set_format(data, format, width, height)) < 0) {
+		printf("can't set format %s: %d\n", name, res);
+		return res;
+	}
+	if ((res = use_buffers(data)) < 0) {
+		printf("can't use buffers: %d\n", res);
+		return res;
+	}
+
+	data->io = SPA_PORT_IO_INIT;
+
+	start = get_time();
+	for (i = 0; i < data->n_frames; i++) {
+		data->io.status = SPA_RESULT_NEED_BUFFER;
+		if ((res = spa_node_process_output(data->source)) != SPA_RESULT_HAVE_BUFFER) {
+			printf("got process_output error %d\n", res);
+			return res;
+		}
+	}
+	elapsed = get_time() - start;
+
+	d = &data->bp[data->io.buffer_id]->datas[0];
+
+	printf("%-5s %4ux%-4u %8.1f frames/s %8.1f MB/s\n", name, width, height,
+	       data->n_frames * (double) SPA_NSEC_PER_SEC / elapsed,
+	       data->n_frames * (double) d->chunk->size *
+	       SPA_NSEC_PER_SEC / elapsed / (1024 * 1024));
+
+	return check_frame(data, name, kind, width, height,
+			   SPA_MEMBER(d->data, d->chunk->offset, uint8_t), d->chunk->size);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	const char *str;
+	int c, i, j, res;
+	struct {
+		const char *name;
+		uint32_t format;
+		enum format_kind kind;
+	} formats[6];
+	static const struct spa_rectangle sizes[] = {
+		{ 321, 241 },
+		{ 1920, 1080 },
+		{ 3840, 2160 },
+	};
+
+	data.n_frames = 200;
+	data.pattern = "smpte-snow";
+
+	while ((c = getopt(argc, argv, "n:p:")) != -1) {
+		switch (c) {
+		case 'n':
+			data.n_frames = atoi(optarg);
+			break;
+		case 'p':
+			data.pattern = optarg;
+			break;
+		default:
+			printf("usage: %s [-n <frames>] [-p smpte-snow|snow]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+
+	if ((str = getenv("SPA_DEBUG")))
+		data.log->level = atoi(str);
+
+	data.support[0].type = SPA_TYPE__TypeMap;
+	data.support[0].data = data.map;
+	data.support[1].type = SPA_TYPE__Log;
+	data.support[1].data = data.log;
+	data.n_support = 2;
+
+	init_type(&data.type, data.map);
+
+	formats[0].name = "RGB";
+	formats[0].format = data.type.video_format.RGB;
+	formats[0].kind = FORMAT_RGB;
+	formats[1].name = "UYVY";
+	formats[1].format = data.type.video_format.UYVY;
+	formats[1].kind = FORMAT_UYVY;
+	formats[2].name = "RGBx";
+	formats[2].format = data.type.video_format.RGBx;
+	formats[2].kind = FORMAT_RGBX;
+	formats[3].name = "BGRx";
+	formats[3].format = data.type.video_format.BGRx;
+	formats[3].kind = FORMAT_BGRX;
+	formats[4].name = "NV12";
+	formats[4].format = data.type.video_format.NV12;
+	formats[4].kind = FORMAT_NV12;
+	formats[5].name = "I420";
+	formats[5].format = data.type.video_format.I420;
+	formats[5].kind = FORMAT_I420;
+
+	if ((res = make_node(&data, &data.source,
+			     "build/spa/plugins/videotestsrc/libspa-videotestsrc.so",
+			     "videotestsrc")) < 0) {
+		printf("can't create videotestsrc: %d\n", res);
+		return -1;
+	}
+	if ((res = spa_node_port_set_io(data.source, SPA_DIRECTION_OUTPUT, 0, &data.io)) < 0 ||
+	    (res = set_pattern(&data)) < 0) {
+		printf("can't configure videotestsrc: %d\n", res);
+		return -1;
+	}
+
+	data.smpte = strcmp(data.pattern, "smpte-snow") == 0;
+
+	printf("pattern %s, %u frames\n", data.pattern, data.n_frames);
+
+	for (i = 0; i < SPA_N_ELEMENTS(sizes); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(formats); j++) {
+			if (run(&data, formats[j].name, formats[j].format, formats[j].kind,
+				sizes[i].width, sizes[i].height) < 0)
+				return -1;
+		}
+	}
+
+	spa_node_port_set_format(data.source, SPA_DIRECTION_OUTPUT, 0, 0, NULL);
+	spa_handle_clear(data.handle);
+	free(data.handle);
+
+	for (i = 0; i < N_BUFFERS; i++)
+		free(data.buffers[i].mem);
+
+	return 0;
+}
@@ -36,18 +36,74 @@ struct pw_client_node_proxy;
 
 #define PW_TYPE_INTERFACE__ClientNode		PW_TYPE_INTERFACE_BASE "ClientNode"
 
-#define PW_VERSION_CLIENT_NODE			0
+#define PW_VERSION_CLIENT_NODE			1
 
 struct pw_client_node_message;
 
+/** The position of the graph, written by the server in each cycle
+ *
+ * \a seq is odd while the server updates the position, readers retry when
+ * it is odd or when it changed while they read the position.
+ * \memberof pw_client_node
+ */
+struct pw_client_node_position {
+	uint32_t seq;		/**< update sequence number, 0 when never written */
+	int32_t rate;		/**< rate of \a ticks */
+	int64_t ticks;		/**< the ticks of the graph clock at \a monotonic */
+	int64_t monotonic;	/**< the CLOCK_MONOTONIC time in nanoseconds */
+};
+
 /** Shared structure between client and server \memberof pw_client_node */
 struct pw_client_node_area {
 	uint32_t max_input_ports;	/**< max input ports of the node */
 	uint32_t n_input_ports;		/**< number of input ports of the node */
 	uint32_t max_output_ports;	/**< max output ports of the node */
 	uint32_t n_output_ports;	/**< number of output ports of the node */
+	struct pw_client_node_position position;	/**< the position of the graph */
 };
 
+/** Update the position, only one thread can write the position */
+static inline void
+pw_client_node_position_write(struct pw_client_node_position *pos,
+			      int32_t rate, int64_t ticks, int64_t monotonic)
+{
+	uint32_t seq = pos->seq;
+
+	__atomic_store_n(&pos->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	pos->rate = rate;
+	pos->ticks = ticks;
+	pos->monotonic = monotonic;
+	__atomic_store_n(&pos->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/** Read a consistent copy of the position
+ * \return false when the position was never written or was updated
+ * too often while reading */
+static inline bool
+pw_client_node_position_read(const struct pw_client_node_position *pos,
+			     struct pw_client_node_position *res)
+{
+	uint32_t seq1, seq2;
+	int retry;
+
+	for (retry = 0; retry < 16; retry++) {
+		seq1 = __atomic_load_n(&pos->seq, __ATOMIC_ACQUIRE);
+		if (seq1 & 1)
+			continue;
+		res->rate = pos->rate;
+		res->ticks = pos->ticks;
+		res->monotonic = pos->monotonic;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		seq2 = __atomic_load_n(&pos->seq, __ATOMIC_RELAXED);
+		if (seq1 == seq2) {
+			res->seq = seq1;
+			return seq1 != 0;
+		}
+	}
+	return false;
+}
+
 /** \class pw_client_node_transport
  *
  * \brief Transport object
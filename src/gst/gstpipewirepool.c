@@ -21,7 +21,11 @@
 #include "config.h"
 #endif
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <gst/gst.h>
+#include <gst/allocators/gstfdmemory.h>
 
 #include "gstpipewirepool.h"
 
@@ -40,6 +44,33 @@ enum
 
 static guint pool_signals[LAST_SIGNAL] = { 0 };
 
+/* A memfd of the stream. It is dup'd once and the memory of the buffers in it
+ * is kept mapped so that it can be reused when the buffers are renegotiated. */
+typedef struct {
+  dev_t dev;
+  ino_t ino;
+  int fd;
+  GArray *mems;
+} PoolFd;
+
+typedef struct {
+  gsize offset;
+  gsize size;
+  GstMemory *mem;
+} PoolMem;
+
+static void
+pool_fd_free (PoolFd *pfd)
+{
+  guint i;
+
+  for (i = 0; i < pfd->mems->len; i++)
+    gst_memory_unref (g_array_index (pfd->mems, PoolMem, i).mem);
+  g_array_free (pfd->mems, TRUE);
+  close (pfd->fd);
+  g_slice_free (PoolFd, pfd);
+}
+
 GstPipeWirePool *
 gst_pipewire_pool_new (void)
 {
@@ -79,6 +110,137 @@ gst_pipewire_pool_remove_buffer (GstPipeWirePool *pool, GstBuffer *buffer)
   return res;
 }
 
+/**
+ * gst_pipewire_pool_get_fd_memory:
+ * @pool: a #GstPipeWirePool
+ * @fd: a memfd or dmabuf of the stream
+ * @offset: the offset of the buffer in @fd
+ * @size: the size of the buffer
+ * @dmabuf: if @fd is a dmabuf
+ *
+ * Get a memory for the buffer at @offset in @fd. The memory maps @fd from the
+ * start and has @offset as its offset, the same memory is returned for the
+ * same buffer when the buffers are renegotiated and it is not used anymore.
+ *
+ * Memfds are identified by their inode. Before Linux 5.3 all dmabufs share
+ * one inode so a dmabuf always gets a new memory that is not cached.
+ *
+ * Returns: (transfer full): a #GstMemory or %NULL on error
+ */
+GstMemory *
+gst_pipewire_pool_get_fd_memory (GstPipeWirePool *pool, int fd, gsize offset, gsize size,
+    gboolean dmabuf)
+{
+  struct stat st;
+  PoolFd *pfd = NULL;
+  PoolMem pm;
+  GList *walk;
+  guint i;
+
+  g_return_val_if_fail (GST_IS_PIPEWIRE_POOL (pool), NULL);
+
+  if (dmabuf) {
+    GstMemory *mem;
+    int dfd;
+
+    if ((dfd = dup (fd)) < 0)
+      return NULL;
+    mem = gst_fd_allocator_alloc (pool->fd_allocator, dfd, offset + size,
+        GST_FD_MEMORY_FLAG_NONE);
+    gst_memory_resize (mem, offset, size);
+    return mem;
+  }
+
+  if (fstat (fd, &st) < 0)
+    return NULL;
+
+  GST_OBJECT_LOCK (pool);
+  for (walk = pool->fds; walk; walk = walk->next) {
+    PoolFd *p = walk->data;
+
+    if (p->dev == st.st_dev && p->ino == st.st_ino) {
+      pfd = p;
+      break;
+    }
+  }
+  if (pfd == NULL) {
+    int dfd;
+
+    if ((dfd = dup (fd)) < 0) {
+      GST_OBJECT_UNLOCK (pool);
+      return NULL;
+    }
+    pfd = g_slice_new (PoolFd);
+    pfd->dev = st.st_dev;
+    pfd->ino = st.st_ino;
+    pfd->fd = dfd;
+    pfd->mems = g_array_new (FALSE, FALSE, sizeof (PoolMem));
+    pool->fds = g_list_prepend (pool->fds, pfd);
+    GST_DEBUG_OBJECT (pool, "new fd %d for %d", dfd, fd);
+  }
+
+  /* a memory is free when only the cache has a ref */
+  for (i = 0; i < pfd->mems->len; i++) {
+    PoolMem *p = &g_array_index (pfd->mems, PoolMem, i);
+
+    if (p->offset == offset && p->size == size &&
+        GST_MINI_OBJECT_REFCOUNT_VALUE (p->mem) == 1) {
+      gst_memory_resize (p->mem, offset - p->mem->offset, size);
+      GST_OBJECT_UNLOCK (pool);
+      return gst_memory_ref (p->mem);
+    }
+  }
+
+  pm.offset = offset;
+  pm.size = size;
+  pm.mem = gst_fd_allocator_alloc (pool->fd_allocator, pfd->fd, offset + size,
+      GST_FD_MEMORY_FLAG_KEEP_MAPPED | GST_FD_MEMORY_FLAG_DONT_CLOSE);
+  gst_memory_resize (pm.mem, offset, size);
+  g_array_append_val (pfd->mems, pm);
+  GST_OBJECT_UNLOCK (pool);
+
+  return gst_memory_ref (pm.mem);
+}
+
+/**
+ * gst_pipewire_pool_trim:
+ * @pool: a #GstPipeWirePool
+ *
+ * Release the cached memory that is not used by any buffer, call this when
+ * the buffers are negotiated.
+ */
+void
+gst_pipewire_pool_trim (GstPipeWirePool *pool)
+{
+  GList *walk, *next;
+  guint i;
+
+  g_return_if_fail (GST_IS_PIPEWIRE_POOL (pool));
+
+  GST_OBJECT_LOCK (pool);
+  for (walk = pool->fds; walk; walk = next) {
+    PoolFd *pfd = walk->data;
+
+    next = walk->next;
+
+    for (i = 0; i < pfd->mems->len;) {
+      PoolMem *p = &g_array_index (pfd->mems, PoolMem, i);
+
+      if (GST_MINI_OBJECT_REFCOUNT_VALUE (p->mem) == 1) {
+        gst_memory_unref (p->mem);
+        g_array_remove_index_fast (pfd->mems, i);
+      } else
+        i++;
+    }
+    if (pfd->mems->len == 0) {
+      GST_DEBUG_OBJECT (pool, "release fd %d", pfd->fd);
+      pool_fd_free (pfd);
+      pool->fds = g_list_delete_link (pool->fds, walk);
+    }
+  }
+  GST_OBJECT_UNLOCK (pool);
+}
+
 static GstFlowReturn
 acquire_buffer (GstBufferPool * pool, GstBuffer ** buffer,
         GstBufferPoolAcquireParams * params)
@@ -146,6 +308,9 @@ gst_pipewire_pool_finalize (GObject * object)
 
   GST_DEBUG_OBJECT (pool, "finalize");
 
+  g_list_free_full (pool->fds, (GDestroyNotify) pool_fd_free);
+  g_object_unref (pool->fd_allocator);
+
   G_OBJECT_CLASS (gst_pipewire_pool_parent_class)->finalize (object);
 }
 
@@ -175,4 +340,5 @@ gst_pipewire_pool_init (GstPipeWirePool * pool)
 {
   g_cond_init (&pool->cond);
   g_queue_init (&pool->available);
+  pool->fd_allocator = gst_fd_allocator_new ();
 }
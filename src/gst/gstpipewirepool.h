@@ -48,6 +48,9 @@ struct _GstPipeWirePool {
   struct pw_stream *stream;
   GQueue available;
   GCond cond;
+
+  GstAllocator *fd_allocator;
+  GList *fds;
 };
 
 struct _GstPipeWirePoolClass {
@@ -61,6 +64,11 @@ GstPipeWirePool *  gst_pipewire_pool_new           (void);
 gboolean        gst_pipewire_pool_add_buffer    (GstPipeWirePool *pool, GstBuffer *buffer);
 gboolean        gst_pipewire_pool_remove_buffer (GstPipeWirePool *pool, GstBuffer *buffer);
 
+GstMemory *     gst_pipewire_pool_get_fd_memory (GstPipeWirePool *pool, int fd,
+                                                 gsize offset, gsize size,
+                                                 gboolean dmabuf);
+void            gst_pipewire_pool_trim          (GstPipeWirePool *pool);
+
 G_END_DECLS
 
 #endif /* __GST_PIPEWIRE_POOL_H__ */
@@ -40,7 +40,6 @@
 #include <unistd.h>
 
 #include <gio/gunixfdmessage.h>
-#include <gst/allocators/gstfdmemory.h>
 #include <gst/video/video.h>
 
 #include <spa/buffer.h>
@@ -54,6 +53,11 @@ GST_DEBUG_CATEGORY_STATIC (pipewire_sink_debug);
 
 #define DEFAULT_PROP_MODE GST_PIPEWIRE_SINK_MODE_DEFAULT
 
+/* the damage regions that are sent with a buffer, more regions are sent
+ * as a completely damaged frame */
+#define DEFAULT_DAMAGE_REGIONS 16
+#define MAX_DAMAGE_REGIONS 64
+
 enum
 {
   PROP_0,
@@ -126,7 +130,6 @@ gst_pipewire_sink_finalize (GObject * object)
 
   if (pwsink->properties)
     gst_structure_free (pwsink->properties);
-  g_object_unref (pwsink->allocator);
   g_free (pwsink->path);
   g_free (pwsink->client_name);
   g_hash_table_unref (pwsink->buf_ids);
@@ -138,8 +141,19 @@ static gboolean
 gst_pipewire_sink_propose_allocation (GstBaseSink * bsink, GstQuery * query)
 {
   GstPipeWireSink *pwsink = GST_PIPEWIRE_SINK (bsink);
-
-  gst_query_add_allocation_pool (query, GST_BUFFER_POOL_CAST (pwsink->pool), 0, 0, 0);
+  GstCaps *caps;
+  GstVideoInfo info;
+  guint size = 0;
+
+  gst_query_parse_allocation (query, &caps, NULL);
+  if (caps && gst_video_info_from_caps (&info, caps))
+    size = info.size;
+
+  /* upstream can render straight into the memory of the stream with our pool,
+   * the copy in render is only done for buffers of other pools */
+  gst_query_add_allocation_pool (query, GST_BUFFER_POOL_CAST (pwsink->pool), size, 0, 0);
+  /* the damage of a frame is sent with region of interest metas */
+  gst_query_add_allocation_meta (query, GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE, NULL);
   return TRUE;
 }
 
@@ -241,7 +255,7 @@ pool_activated (GstPipeWirePool *pool, GstPipeWireSink *sink)
   guint size;
   guint min_buffers;
   guint max_buffers;
-  struct spa_param *port_params[3];
+  struct spa_param *port_params[4];
   struct spa_pod_builder b = { NULL };
   uint8_t buffer[1024];
   struct spa_pod_frame f[2];
@@ -271,6 +285,13 @@ pool_activated (GstPipeWirePool *pool, GstPipeWireSink *sink)
       PROP    (&f[1], t->param_alloc_meta_enable.size, SPA_POD_TYPE_INT, sizeof (struct spa_meta_header)));
   port_params[1] = SPA_POD_BUILDER_DEREF (&b, f[0].ref, struct spa_param);
 
+  spa_pod_builder_object (&b, &f[0], 0, t->param_alloc_meta_enable.MetaEnable,
+      PROP    (&f[1], t->param_alloc_meta_enable.type, SPA_POD_TYPE_ID, t->meta.VideoDamage),
+      PROP_MM (&f[1], t->param_alloc_meta_enable.size, SPA_POD_TYPE_INT, SPA_META_VIDEO_DAMAGE_SIZE (DEFAULT_DAMAGE_REGIONS),
+                                                                         SPA_META_VIDEO_DAMAGE_SIZE (1),
+                                                                         SPA_META_VIDEO_DAMAGE_SIZE (MAX_DAMAGE_REGIONS)));
+  port_params[2] = SPA_POD_BUILDER_DEREF (&b, f[0].ref, struct spa_param);
+
   spa_pod_builder_object (&b, &f[0], 0, t->param_alloc_meta_enable.MetaEnable,
       PROP    (&f[1], t->param_alloc_meta_enable.type, SPA_POD_TYPE_ID, t->meta.Ringbuffer),
       PROP    (&f[1], t->param_alloc_meta_enable.size, SPA_POD_TYPE_INT, sizeof (struct spa_meta_ringbuffer)),
@@ -280,17 +301,16 @@ pool_activated (GstPipeWirePool *pool, GstPipeWireSink *sink)
       PROP    (&f[1], t->param_alloc_meta_enable.ringbufferStride, SPA_POD_TYPE_INT, 0),
       PROP    (&f[1], t->param_alloc_meta_enable.ringbufferBlocks, SPA_POD_TYPE_INT, 1),
       PROP    (&f[1], t->param_alloc_meta_enable.ringbufferAlign,  SPA_POD_TYPE_INT, 16));
-  port_params[2] = SPA_POD_BUILDER_DEREF (&b, f[0].ref, struct spa_param);
+  port_params[3] = SPA_POD_BUILDER_DEREF (&b, f[0].ref, struct spa_param);
 
   pw_thread_loop_lock (sink->main_loop);
-  pw_stream_finish_format (sink->stream, SPA_RESULT_OK, port_params, 2);
+  pw_stream_finish_format (sink->stream, SPA_RESULT_OK, port_params, 3);
   pw_thread_loop_unlock (sink->main_loop);
 }
 
 static void
 gst_pipewire_sink_init (GstPipeWireSink * sink)
 {
-  sink->allocator = gst_fd_allocator_new ();
   sink->pool =  gst_pipewire_pool_new ();
   sink->client_name = pw_get_client_name();
   sink->mode = DEFAULT_PROP_MODE;
@@ -420,6 +440,8 @@ typedef struct {
   guint id;
   struct spa_buffer *buf;
   struct spa_meta_header *header;
+  struct spa_meta_video_damage *damage;
+  uint32_t damage_size;
   guint flags;
   goffset offset;
 } ProcessMemData;
@@ -457,6 +479,8 @@ on_add_buffer (void     *_data,
   data.id = id;
   data.buf = b;
   data.header = spa_buffer_find_meta (b, t->meta.Header);
+  data.damage = spa_buffer_find_meta (b, t->meta.VideoDamage);
+  data.damage_size = spa_buffer_find_meta_size (b, t->meta.VideoDamage);
 
   for (i = 0; i < b->n_datas; i++) {
     struct spa_data *d = &b->datas[i];
@@ -464,9 +488,10 @@ on_add_buffer (void     *_data,
 
     if (d->type == t->data.MemFd ||
         d->type == t->data.DmaBuf) {
-      gmem = gst_fd_allocator_alloc (pwsink->allocator, dup (d->fd),
-                d->mapoffset + d->maxsize, GST_FD_MEMORY_FLAG_NONE);
-      gst_memory_resize (gmem, d->chunk->offset + d->mapoffset, d->chunk->size);
+      gmem = gst_pipewire_pool_get_fd_memory (pwsink->pool, d->fd, d->mapoffset, d->maxsize,
+          d->type == t->data.DmaBuf);
+      if (gmem)
+        gst_memory_resize (gmem, d->chunk->offset, d->chunk->size);
       data.offset = d->mapoffset;
     }
     else if (d->type == t->data.MemPtr) {
@@ -528,6 +553,44 @@ on_new_buffer (void     *data,
   }
 }
 
+/* the damage of a frame is given with region of interest metas of the
+ * "damage" type, a frame without them is completely damaged */
+static void
+fill_damage (GstBuffer *buffer, ProcessMemData *data)
+{
+  struct spa_meta_video_damage *damage = data->damage;
+  GQuark damage_type = g_quark_from_static_string ("damage");
+  gpointer state = NULL;
+  GstMeta *meta;
+  gboolean found = FALSE;
+
+  damage->flags = 0;
+  damage->n_regions = 0;
+
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT)) {
+    while ((meta = gst_buffer_iterate_meta (buffer, &state))) {
+      GstVideoRegionOfInterestMeta *roi;
+      struct spa_meta_region region;
+
+      if (meta->info->api != GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE)
+        continue;
+
+      roi = (GstVideoRegionOfInterestMeta *) meta;
+      if (roi->roi_type != damage_type)
+        continue;
+
+      region.x = roi->x;
+      region.y = roi->y;
+      region.width = roi->w;
+      region.height = roi->h;
+      spa_meta_video_damage_add (damage, data->damage_size, &region);
+      found = TRUE;
+    }
+  }
+  if (!found)
+    spa_meta_video_damage_set_all (damage);
+}
+
 static void
 do_send_buffer (GstPipeWireSink *pwsink)
 {
@@ -550,6 +613,8 @@ do_send_buffer (GstPipeWireSink *pwsink)
     data->header->pts = GST_BUFFER_PTS (buffer);
     data->header->dts_offset = GST_BUFFER_DTS (buffer);
   }
+  if (data->damage)
+    fill_damage (buffer, data);
   for (i = 0; i < data->buf->n_datas; i++) {
     struct spa_data *d = &data->buf->datas[i];
     GstMemory *mem = gst_buffer_peek_memory (buffer, i);
@@ -583,10 +648,13 @@ on_state_changed (void *data, enum pw_stream_state old, enum pw_stream_state sta
 
   switch (state) {
     case PW_STREAM_STATE_UNCONNECTED:
-    case PW_STREAM_STATE_CONNECTING:
-    case PW_STREAM_STATE_CONFIGURE:
     case PW_STREAM_STATE_READY:
     case PW_STREAM_STATE_PAUSED:
+      /* the buffers are negotiated or cleared */
+      gst_pipewire_pool_trim (pwsink->pool);
+      break;
+    case PW_STREAM_STATE_CONNECTING:
+    case PW_STREAM_STATE_CONFIGURE:
     case PW_STREAM_STATE_STREAMING:
       break;
     case PW_STREAM_STATE_ERROR:
@@ -698,6 +766,8 @@ gst_pipewire_sink_render (GstBaseSink * bsink, GstBuffer * buffer)
     gst_buffer_extract (buffer, 0, info.data, info.size);
     gst_buffer_unmap (b, &info);
     gst_buffer_resize (b, 0, gst_buffer_get_size (buffer));
+    /* keep the timestamps and the damage metas */
+    gst_buffer_copy_into (b, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
     buffer = b;
   } else {
     gst_buffer_ref (buffer);
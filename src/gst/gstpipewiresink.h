@@ -88,7 +88,6 @@ struct _GstPipeWireSink {
   struct pw_stream *stream;
   struct spa_hook stream_listener;
 
-  GstAllocator *allocator;
   GstStructure *properties;
   GstPipeWireSinkMode mode;
 
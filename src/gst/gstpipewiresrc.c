@@ -42,7 +42,6 @@
 
 #include <gio/gunixfdmessage.h>
 #include <gst/net/gstnetclientclock.h>
-#include <gst/allocators/gstfdmemory.h>
 #include <gst/video/video.h>
 
 #include <spa/buffer.h>
@@ -56,6 +55,10 @@ GST_DEBUG_CATEGORY_STATIC (pipewire_src_debug);
 
 #define DEFAULT_ALWAYS_COPY     false
 
+/* the damage regions that are accepted with a buffer */
+#define DEFAULT_DAMAGE_REGIONS  16
+#define MAX_DAMAGE_REGIONS      64
+
 enum
 {
   PROP_0,
@@ -204,7 +207,7 @@ gst_pipewire_src_finalize (GObject * object)
 
   if (pwsrc->properties)
     gst_structure_free (pwsrc->properties);
-  g_object_unref (pwsrc->fd_allocator);
+  g_object_unref (pwsrc->pool);
   if (pwsrc->clock)
     gst_object_unref (pwsrc->clock);
   g_free (pwsrc->path);
@@ -304,7 +307,7 @@ gst_pipewire_src_init (GstPipeWireSrc * src)
 
   g_queue_init (&src->queue);
 
-  src->fd_allocator = gst_fd_allocator_new ();
+  src->pool = gst_pipewire_pool_new ();
   src->client_name = pw_get_client_name ();
   src->buf_ids = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) gst_buffer_unref);
 
@@ -321,6 +324,8 @@ typedef struct {
   guint id;
   struct spa_buffer *buf;
   struct spa_meta_header *header;
+  struct spa_meta_video_damage *damage;
+  uint32_t damage_size;
   guint flags;
   goffset offset;
 } ProcessMemData;
@@ -379,15 +384,18 @@ on_add_buffer (void *_data, guint id)
   data.id = id;
   data.buf = b;
   data.header = spa_buffer_find_meta (b, t->meta.Header);
+  data.damage = spa_buffer_find_meta (b, t->meta.VideoDamage);
+  data.damage_size = spa_buffer_find_meta_size (b, t->meta.VideoDamage);
 
   for (i = 0; i < b->n_datas; i++) {
     struct spa_data *d = &b->datas[i];
     GstMemory *gmem = NULL;
 
     if (d->type == t->data.MemFd || d->type == t->data.DmaBuf) {
-      gmem = gst_fd_allocator_alloc (pwsrc->fd_allocator, dup (d->fd),
-                d->mapoffset + d->maxsize, GST_FD_MEMORY_FLAG_NONE);
-      gst_memory_resize (gmem, d->chunk->offset + d->mapoffset, d->chunk->size);
+      gmem = gst_pipewire_pool_get_fd_memory (pwsrc->pool, d->fd, d->mapoffset, d->maxsize,
+          d->type == t->data.DmaBuf);
+      if (gmem)
+        gst_memory_resize (gmem, d->chunk->offset, d->chunk->size);
       data.offset = d->mapoffset;
     }
     else if (d->type == t->data.MemPtr) {
@@ -435,6 +443,38 @@ on_remove_buffer (void *data,
   }
 }
 
+static gboolean
+remove_damage (GstBuffer *buffer, GstMeta **meta, gpointer user_data)
+{
+  if ((*meta)->info->api == GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE &&
+      ((GstVideoRegionOfInterestMeta *) *meta)->roi_type == GPOINTER_TO_UINT (user_data))
+    *meta = NULL;
+  return TRUE;
+}
+
+/* the damage of the frame is given to downstream as region of interest metas
+ * of the "damage" type, a frame without them is completely damaged */
+static void
+add_damage (GstBuffer *buf, ProcessMemData *data)
+{
+  struct spa_meta_video_damage *damage = data->damage;
+  GQuark damage_type = g_quark_from_static_string ("damage");
+  uint32_t i, n_regions;
+
+  gst_buffer_foreach_meta (buf, remove_damage, GUINT_TO_POINTER (damage_type));
+
+  if (damage->flags & SPA_META_VIDEO_DAMAGE_FLAG_ALL)
+    return;
+
+  n_regions = SPA_MIN (damage->n_regions, spa_meta_video_damage_max_regions (data->damage_size));
+  for (i = 0; i < n_regions; i++) {
+    struct spa_meta_region *r = &damage->regions[i];
+
+    gst_buffer_add_video_region_of_interest_meta_id (buf, damage_type,
+        r->x, r->y, r->width, r->height);
+  }
+}
+
 static void
 on_new_buffer (void *_data,
                guint id)
@@ -465,6 +505,8 @@ on_new_buffer (void *_data,
     }
     GST_BUFFER_OFFSET (buf) = h->seq;
   }
+  if (data->damage)
+    add_damage (buf, data);
   for (i = 0; i < data->buf->n_datas; i++) {
     struct spa_data *d = &data->buf->datas[i];
     GstMemory *mem = gst_buffer_peek_memory (buf, i);
@@ -494,10 +536,13 @@ on_state_changed (void *data,
 
   switch (state) {
     case PW_STREAM_STATE_UNCONNECTED:
-    case PW_STREAM_STATE_CONNECTING:
-    case PW_STREAM_STATE_CONFIGURE:
     case PW_STREAM_STATE_READY:
     case PW_STREAM_STATE_PAUSED:
+      /* the buffers are negotiated or cleared */
+      gst_pipewire_pool_trim (pwsrc->pool);
+      break;
+    case PW_STREAM_STATE_CONNECTING:
+    case PW_STREAM_STATE_CONFIGURE:
     case PW_STREAM_STATE_STREAMING:
       break;
     case PW_STREAM_STATE_ERROR:
@@ -754,7 +799,7 @@ on_format_changed (void              *data,
   gst_caps_unref (caps);
 
   if (res) {
-    struct spa_param *params[2];
+    struct spa_param *params[3];
     struct spa_pod_builder b = { NULL };
     uint8_t buffer[512];
     struct spa_pod_frame f[2];
@@ -772,8 +817,15 @@ on_format_changed (void              *data,
         PROP    (&f[1], t->param_alloc_meta_enable.size, SPA_POD_TYPE_INT, sizeof (struct spa_meta_header)));
     params[1] = SPA_POD_BUILDER_DEREF (&b, f[0].ref, struct spa_param);
 
+    spa_pod_builder_object (&b, &f[0], 0, t->param_alloc_meta_enable.MetaEnable,
+        PROP    (&f[1], t->param_alloc_meta_enable.type, SPA_POD_TYPE_ID, t->meta.VideoDamage),
+        PROP_MM (&f[1], t->param_alloc_meta_enable.size, SPA_POD_TYPE_INT, SPA_META_VIDEO_DAMAGE_SIZE (DEFAULT_DAMAGE_REGIONS),
+                                                                           SPA_META_VIDEO_DAMAGE_SIZE (1),
+                                                                           SPA_META_VIDEO_DAMAGE_SIZE (MAX_DAMAGE_REGIONS)));
+    params[2] = SPA_POD_BUILDER_DEREF (&b, f[0].ref, struct spa_param);
+
     GST_DEBUG_OBJECT (pwsrc, "doing finish format");
-    pw_stream_finish_format (pwsrc->stream, SPA_RESULT_OK, params, 2);
+    pw_stream_finish_format (pwsrc->stream, SPA_RESULT_OK, params, 3);
   } else {
     GST_WARNING_OBJECT (pwsrc, "finish format with error");
     pw_stream_finish_format (pwsrc->stream, SPA_RESULT_INVALID_MEDIA_TYPE, NULL, 0);
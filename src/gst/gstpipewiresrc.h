@@ -24,6 +24,7 @@
 #include <gst/base/gstpushsrc.h>
 
 #include <pipewire/pipewire.h>
+#include <gst/gstpipewirepool.h>
 
 G_BEGIN_DECLS
 
@@ -75,9 +76,10 @@ struct _GstPipeWireSrc {
   struct pw_stream *stream;
   struct spa_hook stream_listener;
 
-  GstAllocator *fd_allocator;
   GstStructure *properties;
 
+  GstPipeWirePool *pool;
+
   GHashTable *buf_ids;
   GQueue queue;
   GstClock *clock;
@@ -54,6 +54,10 @@ static void *create_object(void *_data,
 	if (resource == NULL)
 		goto no_resource;
 
+	/* the layout of the transport area changes between versions */
+	if (version != PW_VERSION_CLIENT_NODE)
+		goto wrong_version;
+
 	node_resource = pw_resource_new(pw_resource_get_client(resource),
 					new_id, PW_PERM_RWX, type, version, 0);
 	if (node_resource == NULL)
@@ -69,6 +73,10 @@ static void *create_object(void *_data,
 	pw_log_error("client-node needs a resource");
 	pw_resource_error(resource, SPA_RESULT_INVALID_ARGUMENTS, "no resource");
 	goto done;
+      wrong_version:
+	pw_log_error("client-node version %u, need %u", version, PW_VERSION_CLIENT_NODE);
+	pw_resource_error(resource, SPA_RESULT_INCOMPATIBLE_VERSION, "wrong version");
+	goto done;
       no_mem:
 	pw_log_error("can't create node");
 	pw_resource_error(resource, SPA_RESULT_NO_MEMORY, "no memory");
@@ -27,6 +27,7 @@
 #include <sys/socket.h>
 #include <sys/mman.h>
 #include <sys/eventfd.h>
+#include <time.h>
 
 #include "spa/node.h"
 #include "spa/format-builder.h"
@@ -36,6 +37,7 @@
 #include "pipewire/interfaces.h"
 
 #include "pipewire/core.h"
+#include "pipewire/private.h"
 #include "modules/spa/spa-node.h"
 #include "client-node.h"
 #include "transport.h"
@@ -109,6 +111,11 @@ struct proxy {
 
 	uint8_t format_buffer[1024];
 	uint32_t seq;
+
+	struct spa_clock *clock;	/**< only used and changed in the data loop */
+	int32_t rate;			/**< the last position */
+	int64_t ticks;
+	int64_t monotonic;
 };
 
 struct impl {
@@ -124,6 +131,11 @@ struct impl {
 	struct spa_hook node_listener;
 	struct spa_hook resource_listener;
 
+	struct pw_link *clock_link;	/**< the link and node of the clock */
+	struct pw_node *clock_node;
+	struct spa_hook clock_link_listener;
+	struct spa_hook clock_node_listener;
+
 	int fds[2];
 	int other_fds[2];
 };
@@ -157,6 +169,114 @@ static inline void do_flush(struct proxy *this)
 
 }
 
+/* a node with a clock that is linked to the client node */
+static struct pw_node *find_clock_node(struct impl *impl, struct pw_link **link)
+{
+	struct pw_node *node = impl->this.node;
+	struct pw_port *p;
+	struct pw_link *l;
+
+	spa_list_for_each(p, &node->input_ports, link) {
+		spa_list_for_each(l, &p->links, input_link) {
+			if (l->output && l->output->node->clock) {
+				*link = l;
+				return l->output->node;
+			}
+		}
+	}
+	spa_list_for_each(p, &node->output_ports, link) {
+		spa_list_for_each(l, &p->links, output_link) {
+			if (l->input && l->input->node->clock) {
+				*link = l;
+				return l->input->node;
+			}
+		}
+	}
+	return NULL;
+}
+
+static int
+do_set_clock(struct spa_loop *loop,
+	     bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct proxy *this = user_data;
+
+	this->clock = *(struct spa_clock * const *) data;
+
+	return SPA_RESULT_OK;
+}
+
+static const struct pw_link_events clock_link_events;
+static const struct pw_node_events clock_node_events;
+
+/* use the clock of @node until @link or @node is destroyed */
+static void set_clock(struct impl *impl, struct pw_link *link, struct pw_node *node)
+{
+	struct spa_clock *clock = node ? node->clock : NULL;
+
+	if (impl->clock_node) {
+		spa_hook_remove(&impl->clock_link_listener);
+		spa_hook_remove(&impl->clock_node_listener);
+	}
+	impl->clock_link = link;
+	impl->clock_node = node;
+	if (node) {
+		pw_link_add_listener(link, &impl->clock_link_listener, &clock_link_events, impl);
+		pw_node_add_listener(node, &impl->clock_node_listener, &clock_node_events, impl);
+	}
+	spa_loop_invoke(impl->proxy.data_loop, do_set_clock, SPA_ID_INVALID,
+			sizeof(clock), &clock, true, &impl->proxy);
+}
+
+static void clock_destroy(void *data)
+{
+	set_clock(data, NULL, NULL);
+}
+
+static const struct pw_link_events clock_link_events = {
+	PW_VERSION_LINK_EVENTS,
+	.destroy = clock_destroy,
+};
+
+static const struct pw_node_events clock_node_events = {
+	PW_VERSION_NODE_EVENTS,
+	.destroy = clock_destroy,
+};
+
+/* write the position of the graph in the transport area so that the client
+ * can get the time without asking for a clock update. Without a clock, the
+ * last position is moved on with the monotonic clock */
+static void update_position(struct proxy *this)
+{
+	struct impl *impl = this->impl;
+	struct spa_clock *clock = this->clock;
+	int32_t rate;
+	int64_t ticks, monotonic;
+
+	if (clock == NULL ||
+	    spa_clock_get_time(clock, &rate, &ticks, &monotonic) < 0 || rate <= 0) {
+		struct timespec ts;
+		int64_t elapsed;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		monotonic = SPA_TIMESPEC_TO_TIME(&ts);
+		elapsed = monotonic - this->monotonic;
+		rate = this->rate;
+		/* split the seconds off so that long gaps don't overflow */
+		if (rate == SPA_NSEC_PER_SEC)
+			ticks = this->ticks + elapsed;
+		else
+			ticks = this->ticks + (elapsed / SPA_NSEC_PER_SEC) * rate +
+			    (elapsed % SPA_NSEC_PER_SEC) * rate / SPA_NSEC_PER_SEC;
+	}
+	this->rate = rate;
+	this->ticks = ticks;
+	this->monotonic = monotonic;
+
+	pw_client_node_position_write(&impl->transport->area->position,
+				      rate, ticks, monotonic);
+}
+
 static int spa_proxy_node_send_command(struct spa_node *node, const struct spa_command *command)
 {
 	struct proxy *this;
@@ -176,6 +296,13 @@ static int spa_proxy_node_send_command(struct spa_node *node, const struct spa_c
 	if (SPA_COMMAND_TYPE(command) == t->command_node.ClockUpdate) {
 		pw_client_node_resource_node_command(this->resource, this->seq++, command);
 	} else {
+		if (SPA_COMMAND_TYPE(command) == t->command_node.Start) {
+			struct pw_link *link = NULL;
+			struct pw_node *node = find_clock_node(this->impl, &link);
+
+			set_clock(this->impl, link, node);
+		}
+
 		/* send start */
 		pw_client_node_resource_node_command(this->resource, this->seq, command);
 		res = SPA_RESULT_RETURN_ASYNC(this->seq++);
@@ -269,6 +396,7 @@ do_update_port(struct proxy *this,
 	       const struct spa_port_info *info)
 {
 	struct proxy_port *port;
+	struct pw_port *p;
 	uint32_t i;
 
 	if (direction == SPA_DIRECTION_INPUT) {
@@ -286,6 +414,11 @@ do_update_port(struct proxy *this,
 		    realloc(port->formats, port->n_formats * sizeof(struct spa_format *));
 		for (i = 0; i < port->n_formats; i++)
 			port->formats[i] = spa_format_copy(possible_formats[i]);
+
+		/* negotiate with the new formats */
+		if (this->impl && this->impl->this.node &&
+		    (p = pw_node_find_port(this->impl->this.node, direction, port_id)))
+			pw_port_invalidate_formats(p);
 	}
 	if (change_mask & PW_CLIENT_NODE_PORT_UPDATE_FORMAT) {
 		spa_log_info(this->log, "proxy %p: update format %p", this, format);
@@ -753,6 +886,8 @@ static int spa_proxy_node_process_input(struct spa_node *node)
 	this = SPA_CONTAINER_OF(node, struct proxy, node);
 	impl = this->impl;
 
+	update_position(this);
+
 	for (i = 0; i < MAX_INPUTS; i++) {
 		struct spa_port_io *io = this->in_ports[i].io;
 
@@ -783,6 +918,8 @@ static int spa_proxy_node_process_output(struct spa_node *node)
 	this = SPA_CONTAINER_OF(node, struct proxy, node);
 	impl = this->impl;
 
+	update_position(this);
+
 	for (i = 0; i < MAX_OUTPUTS; i++) {
 		struct spa_port_io *io = this->out_ports[i].io, tmp;
 
@@ -976,6 +1113,7 @@ proxy_init(struct proxy *this,
 	   const struct spa_support *support,
 	   uint32_t n_support)
 {
+	struct timespec ts;
 	uint32_t i;
 
 	for (i = 0; i < n_support; i++) {
@@ -1003,6 +1141,11 @@ proxy_init(struct proxy *this,
 	this->data_source.mask = SPA_IO_IN | SPA_IO_ERR | SPA_IO_HUP;
 	this->data_source.rmask = 0;
 
+	/* without a clock, the ticks are in nanoseconds from now */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	this->rate = SPA_NSEC_PER_SEC;
+	this->monotonic = SPA_TIMESPEC_TO_TIME(&ts);
+
 	return SPA_RESULT_RETURN_ASYNC(this->seq++);
 }
 
@@ -1098,6 +1241,11 @@ static void node_free(void *data)
 	pw_log_debug("client-node %p: free", &impl->this);
 	proxy_clear(&impl->proxy);
 
+	if (impl->clock_node) {
+		spa_hook_remove(&impl->clock_link_listener);
+		spa_hook_remove(&impl->clock_node_listener);
+	}
+
 	if (impl->transport)
 		pw_client_node_transport_destroy(impl->transport);
 
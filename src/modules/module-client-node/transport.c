@@ -17,6 +17,7 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/mman.h>
@@ -96,6 +97,7 @@ static void transport_reset_area(struct pw_client_node_transport *trans)
 	}
 	spa_ringbuffer_init(trans->input_buffer, INPUT_BUFFER_SIZE);
 	spa_ringbuffer_init(trans->output_buffer, OUTPUT_BUFFER_SIZE);
+	memset(&a->position, 0, sizeof(a->position));
 }
 
 static void destroy(struct pw_client_node_transport *trans)
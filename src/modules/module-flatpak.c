@@ -458,10 +458,33 @@ do_create_link(void *data,
 			      new_id);
 }
 
+static void
+do_create_links(void *data,
+		uint32_t n_links,
+		const struct pw_core_link *links,
+		const struct spa_dict *props)
+{
+	struct resource *resource = data;
+	struct client_info *cinfo = resource->cinfo;
+
+	if (cinfo->is_sandboxed) {
+		pw_resource_error(resource->resource, SPA_RESULT_NO_PERMISSION, "not allowed");
+		return;
+	}
+	pw_resource_do_parent(resource->resource,
+			      &resource->override,
+			      struct pw_core_proxy_methods,
+			      create_links,
+			      n_links,
+			      links,
+			      props);
+}
+
 static const struct pw_core_proxy_methods core_override = {
 	PW_VERSION_CORE_PROXY_METHODS,
 	.create_object = do_create_object,
 	.create_link = do_create_link,
+	.create_links = do_create_links,
 };
 
 static void client_resource_impl(void *data, struct pw_resource *resource)
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/stat.h>
@@ -55,6 +56,8 @@
 #define LOCK_SUFFIX     ".lock"
 #define LOCK_SUFFIXLEN  5
 
+#define FREEWHEEL_TIMEOUT_USEC	(10 * SPA_USEC_PER_SEC)
+
 int segment_num = 0;
 
 typedef bool(*demarshal_func_t) (void *object, void *data, size_t size);
@@ -91,7 +94,15 @@ struct impl {
 
 	struct {
 		struct spa_list nodes;
+		jack_time_t cycle_end;
+		int stats_cycles;
 	} rt;
+
+	struct {
+		pthread_t thread;
+		bool running;
+		struct spa_source *cycle;
+	} freewheel;
 };
 
 struct client {
@@ -266,6 +277,7 @@ static const struct pw_jack_port_events port_listener = {
 };
 
 static int process_messages(struct client *client);
+static int set_freewheel(struct impl *impl, bool onoff);
 
 static int
 handle_register_port(struct client *client)
@@ -493,6 +505,23 @@ handle_set_timebase_callback(struct client *client)
 	return 0;
 }
 
+static int
+handle_set_freewheel(struct client *client)
+{
+	struct impl *impl = client->impl;
+	int result, onoff;
+
+	CheckSize(kSetFreeWheel_size);
+	CheckRead(&onoff, sizeof(int));
+
+	pw_log_debug("protocol-jack %p: kSetFreeWheel %d", client->impl, onoff);
+
+	result = set_freewheel(impl, onoff != 0);
+
+	CheckWrite(&result, sizeof(int));
+	return 0;
+}
+
 static int
 handle_client_check(struct client *client)
 {
@@ -906,7 +935,9 @@ process_messages(struct client *client)
 		res = handle_set_timebase_callback(client);
 		break;
 	case jack_request_SetBufferSize:
+		break;
 	case jack_request_SetFreeWheel:
+		res = handle_set_freewheel(client);
 		break;
 	case jack_request_ClientCheck:
 		res = handle_client_check(client);
@@ -1099,6 +1130,112 @@ static int do_graph_order_changed(struct spa_loop *loop,
 	return SPA_RESULT_OK;
 }
 
+struct client_stats {
+	int ref_num;
+	jack_time_t avg_usecs;
+	jack_time_t max_usecs;
+	uint32_t xruns;
+	float load;
+};
+
+static int do_update_stats(struct spa_loop *loop,
+			   bool async,
+			   uint32_t seq,
+			   size_t size,
+			   const void *data,
+			   void *user_data)
+{
+	struct impl *impl = user_data;
+	const struct client_stats *st = data;
+	struct jack_client *jc = impl->server.client_table[st->ref_num];
+	struct spa_dict_item items[3];
+	struct spa_dict dict = SPA_DICT_INIT(0, items);
+	char avg[32], max[32], val[32];
+
+	if (jc == NULL)
+		return SPA_RESULT_OK;
+
+	if (st->ref_num == impl->server.audio_ref_num) {
+		snprintf(val, sizeof(val), "%.2f", st->load);
+		items[dict.n_items].key = "jack.dsp.load";
+		items[dict.n_items++].value = val;
+	} else {
+		snprintf(avg, sizeof(avg), "%" PRIu64, st->avg_usecs);
+		items[dict.n_items].key = "jack.dsp.avg-usecs";
+		items[dict.n_items++].value = avg;
+		snprintf(max, sizeof(max), "%" PRIu64, st->max_usecs);
+		items[dict.n_items].key = "jack.dsp.max-usecs";
+		items[dict.n_items++].value = max;
+		snprintf(val, sizeof(val), "%u", st->xruns);
+		items[dict.n_items].key = "jack.xruns";
+		items[dict.n_items++].value = val;
+	}
+	pw_node_update_properties(jc->node->node, &dict);
+
+	return SPA_RESULT_OK;
+}
+
+/* collect the timing of the clients in the previous cycle, called from
+ * the data thread before the activation counters are reset */
+static void update_client_timing(struct impl *impl, struct jack_client_timing *timing)
+{
+	struct jack_server *server = &impl->server;
+	struct jack_engine_control *ctrl = server->engine_control;
+	struct client_stats st;
+	int i;
+
+	for (i = ctrl->driver_num; i < CLIENT_NUM; i++) {
+		struct jack_client *jc = server->client_table[i];
+		struct jack_client_timing *t = &timing[i];
+
+		if (jc == NULL || !jc->activated || !jc->realtime)
+			continue;
+
+		if (t->status == Finished) {
+			if (t->finished_at > t->awake_at && t->awake_at > 0) {
+				jack_time_t usecs = t->finished_at - t->awake_at;
+				jc->stats.sum_usecs += usecs;
+				if (usecs > jc->stats.max_usecs)
+					jc->stats.max_usecs = usecs;
+				jc->stats.n_cycles++;
+			}
+		} else if (t->status != NotTriggered) {
+			jc->stats.xruns++;
+			pw_log_trace("module-jack %p: client %d \"%s\" did not complete",
+				     impl, i, jc->node->control->name);
+		}
+	}
+
+	if (++impl->rt.stats_cycles < ctrl->rolling_interval)
+		return;
+
+	impl->rt.stats_cycles = 0;
+
+	for (i = ctrl->driver_num; i < CLIENT_NUM; i++) {
+		struct jack_client *jc = server->client_table[i];
+
+		if (jc == NULL || !jc->activated || !jc->realtime)
+			continue;
+
+		st.ref_num = i;
+		st.avg_usecs = jc->stats.n_cycles ? jc->stats.sum_usecs / jc->stats.n_cycles : 0;
+		st.max_usecs = jc->stats.max_usecs;
+		st.xruns = jc->stats.xruns;
+		pw_loop_invoke(pw_core_get_main_loop(impl->core),
+			       do_update_stats, 0, sizeof(st), &st, false, impl);
+
+		jc->stats.sum_usecs = 0;
+		jc->stats.max_usecs = 0;
+		jc->stats.n_cycles = 0;
+	}
+
+	spa_zero(st);
+	st.ref_num = server->audio_ref_num;
+	st.load = ctrl->CPU_load;
+	pw_loop_invoke(pw_core_get_main_loop(impl->core),
+		       do_update_stats, 0, sizeof(st), &st, false, impl);
+}
+
 static void jack_node_pull(void *data)
 {
 	struct jack_client *jc = data;
@@ -1134,6 +1271,7 @@ static void jack_node_push(void *data)
 	struct pw_jack_node *node;
 	struct spa_graph_node *n = &jc->node->node->rt.node, *pn;
 	struct spa_graph_port *p, *pp;
+	jack_time_t cycle_begin = jack_get_microseconds();
 
 	conn = jack_graph_manager_get_current(mgr);
 
@@ -1141,6 +1279,10 @@ static void jack_node_push(void *data)
 	if (activation != 0)
 		pw_log_warn("resume %d, some client did not complete", activation);
 
+	update_client_timing(impl, mgr->client_timing);
+	jack_engine_control_calc_cpu_load(server->engine_control, mgr->client_timing,
+					  cycle_begin, impl->rt.cycle_end);
+
 	jack_connection_manager_reset(conn, mgr->client_timing);
 
         jack_activation_count_signal(&conn->input_counter[server->freewheel_ref_num],
@@ -1179,7 +1321,7 @@ static void jack_node_push(void *data)
 			pn->state = spa_node_process_input(pn->implementation);
 		}
 	}
-
+	impl->rt.cycle_end = jack_get_microseconds();
 
 #if 0
 	jack_connection_manager_resume_ref_num(conn,
@@ -1203,19 +1345,117 @@ static const struct pw_jack_node_events jack_node_events = {
 	.push = jack_node_push,
 };
 
+static void do_freewheel_cycle(void *data, uint64_t count)
+{
+	struct impl *impl = data;
+	struct jack_server *server = &impl->server;
+	struct jack_client *jc = server->client_table[server->audio_ref_num];
+
+	if (!server->freewheel)
+		return;
+
+	jack_node_pull(jc);
+	jack_node_push(jc);
+}
+
+static void *freewheel_thread(void *data)
+{
+	struct impl *impl = data;
+	struct jack_server *server = &impl->server;
+	struct pw_loop *loop = server->audio_node->node->data_loop;
+	struct jack_synchro *synchro = &server->synchro_table[server->freewheel_ref_num];
+
+	pw_log_debug("module-jack %p: enter freewheel thread", impl);
+
+	/* run the graph back to back, the freewheel driver is signaled when
+	 * all clients completed the cycle */
+	while (impl->freewheel.running) {
+		pw_loop_signal_event(loop, impl->freewheel.cycle);
+
+		if (!jack_synchro_timed_wait(synchro, FREEWHEEL_TIMEOUT_USEC))
+			pw_log_warn("module-jack %p: freewheel cycle timed out", impl);
+	}
+	pw_log_debug("module-jack %p: leave freewheel thread", impl);
+
+	return NULL;
+}
+
+static int do_set_freewheel(struct spa_loop *loop, bool async, uint32_t seq, size_t size,
+			    const void *data, void *user_data)
+{
+	struct impl *impl = user_data;
+	impl->server.freewheel = *(bool *) data;
+	return SPA_RESULT_OK;
+}
+
+static int set_freewheel(struct impl *impl, bool onoff)
+{
+	struct jack_server *server = &impl->server;
+	struct jack_engine_control *ctrl = server->engine_control;
+	struct pw_loop *loop = server->audio_node->node->data_loop;
+	int err;
+
+	if (server->freewheel == onoff)
+		return 0;
+
+	pw_log_debug("module-jack %p: freewheel %d", impl, onoff);
+
+	if (onoff) {
+		ctrl->saved_real_time = ctrl->real_time;
+		ctrl->real_time = false;
+
+		/* detach the graph from the device, the device keeps running
+		 * with silence */
+		pw_loop_invoke(loop, do_set_freewheel, SPA_ID_INVALID, sizeof(bool), &onoff, true, impl);
+		jack_synchro_reset(&server->synchro_table[server->freewheel_ref_num]);
+
+		notify_clients(impl, jack_notify_StartFreewheelCallback, true, "", 0, 0);
+
+		impl->freewheel.running = true;
+		if ((err = pthread_create(&impl->freewheel.thread, NULL, freewheel_thread, impl)) != 0) {
+			pw_log_error("module-jack %p: can't create freewheel thread: %s",
+				     impl, strerror(err));
+			impl->freewheel.running = false;
+			set_freewheel(impl, false);
+			return -1;
+		}
+	} else {
+		if (impl->freewheel.running) {
+			impl->freewheel.running = false;
+			pthread_join(impl->freewheel.thread, NULL);
+		}
+		pw_loop_invoke(loop, do_set_freewheel, SPA_ID_INVALID, sizeof(bool), &onoff, true, impl);
+
+		ctrl->real_time = ctrl->saved_real_time;
+		ctrl->saved_real_time = false;
+
+		notify_clients(impl, jack_notify_StopFreewheelCallback, true, "", 0, 0);
+	}
+	return 0;
+}
+
 static int
 make_audio_client(struct impl *impl)
 {
 	struct jack_server *server = &impl->server;
-	int ref_num;
+	int ref_num, n_ports;
 	struct jack_client *jc;
 	struct pw_jack_node *node;
+	const char *str = NULL;
+
+	/* the number of system:playback ports, the channels of the device
+	 * are negotiated when the driver is linked to it */
+	if (impl->properties)
+		str = pw_properties_get(impl->properties, "jack.driver.ports");
+
+	n_ports = str ? atoi(str) : 2;
+	n_ports = SPA_CLAMP(n_ports, 1, PORT_NUM_FOR_CLIENT / 2);
 
 	node = pw_jack_driver_new(impl->core,
 				  pw_module_get_global(impl->module),
 				  server,
 				  "system",
-				  0, 2,
+				  0, n_ports,
 				  NULL,
 				  sizeof(struct jack_client));
 	if (node == NULL) {
@@ -1326,6 +1566,9 @@ static bool init_nodes(struct impl *impl)
 	make_audio_client(impl);
 	make_freewheel_client(impl);
 
+	impl->freewheel.cycle = pw_loop_add_event(impl->server.audio_node->node->data_loop,
+						  do_freewheel_cycle, impl);
+
 	pw_core_for_each_global(core, on_global, impl);
 
 	return true;
@@ -1459,6 +1702,11 @@ static void module_destroy(void *data)
 
 	spa_hook_remove(&impl->module_listener);
 
+	set_freewheel(impl, false);
+	if (impl->freewheel.cycle)
+		pw_loop_destroy_source(impl->server.audio_node->node->data_loop,
+				       impl->freewheel.cycle);
+
 	spa_list_for_each_safe(ld, t, &impl->link_list, link_link)
 		pw_link_destroy(ld->link);
 
@@ -28,11 +28,16 @@
 #include <sys/mman.h>
 #include <sys/eventfd.h>
 
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <spa/node.h>
 #include <spa/hook.h>
 #include <spa/format-builder.h>
 #include <spa/lib/format.h>
 #include <spa/audio/format-utils.h>
+#include <spa/param-alloc.h>
 
 #include "pipewire/pipewire.h"
 #include "pipewire/core.h"
@@ -43,6 +48,9 @@
 
 #define NAME "jack-node"
 
+/* the most channels the driver port negotiates with the device */
+#define MAX_CHANNELS 64
+
 /** \cond */
 
 struct type {
@@ -53,6 +61,7 @@ struct type {
         struct spa_type_format_audio format_audio;
         struct spa_type_audio_format audio_format;
         struct spa_type_media_subtype_audio media_subtype_audio;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
 };
 
 static inline void init_type(struct type *type, struct spa_type_map *map)
@@ -64,6 +73,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
         spa_type_format_audio_map(map, &type->format_audio);
         spa_type_audio_format_map(map, &type->audio_format);
         spa_type_media_subtype_audio_map(map, &type->media_subtype_audio);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
 }
 
 struct node_data {
@@ -75,6 +85,11 @@ struct node_data {
 	int n_capture_channels;
 	int n_playback_channels;
 
+	/* format negotiated on the driver ports */
+	bool have_driver_format;
+	struct spa_audio_info_raw driver_format;
+	uint32_t driver_sample_size;
+
 	struct spa_hook_list listener_list;
 
 	struct spa_node node_impl;
@@ -117,6 +132,7 @@ struct port_data {
 	struct spa_chunk chunk[1];
 
 	uint8_t buffer[1024];
+	uint8_t params_buffer[1024];
 };
 
 /** \endcond */
@@ -218,26 +234,77 @@ static int driver_process_input(struct spa_node *node)
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
 
-static void conv_f32_s16(int16_t *out, float *in, int n_samples, int stride)
+static void conv_f32_s16(int16_t *out, const float *in, int n_samples, int stride)
 {
-	int i;
-	for (i = 0; i < n_samples; i++) {
+	int i = 0;
+#if defined (__SSE2__)
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128 min = _mm_set1_ps(-1.0f);
+	const __m128 max = _mm_set1_ps(1.0f);
+
+	if (stride == 1) {
+		for (; i + 8 <= n_samples; i += 8) {
+			__m128 v0 = _mm_loadu_ps(&in[i]);
+			__m128 v1 = _mm_loadu_ps(&in[i + 4]);
+			v0 = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v0, min), max), scale);
+			v1 = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v1, min), max), scale);
+			_mm_storeu_si128((__m128i*)&out[i],
+					 _mm_packs_epi32(_mm_cvtps_epi32(v0), _mm_cvtps_epi32(v1)));
+		}
+	} else {
+		for (; i + 4 <= n_samples; i += 4) {
+			__m128 v = _mm_loadu_ps(&in[i]);
+			__m128i r;
+			v = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v, min), max), scale);
+			r = _mm_cvtps_epi32(v);
+			out[(i + 0) * stride] = _mm_cvtsi128_si32(r);
+			out[(i + 1) * stride] = _mm_cvtsi128_si32(_mm_srli_si128(r, 4));
+			out[(i + 2) * stride] = _mm_cvtsi128_si32(_mm_srli_si128(r, 8));
+			out[(i + 3) * stride] = _mm_cvtsi128_si32(_mm_srli_si128(r, 12));
+		}
+	}
+#endif
+	for (; i < n_samples; i++) {
 		if (in[i] < -1.0f)
-			*out = -32767;
+			out[i * stride] = -32767;
 		else if (in[i] >= 1.0f)
-			*out = 32767;
+			out[i * stride] = 32767;
 		else
-			*out = lrintf(in[i] * 32767.0f);
-		out += stride;
+			out[i * stride] = lrintf(in[i] * 32767.0f);
 	}
 }
 static void fill_s16(int16_t *out, int n_samples, int stride)
 {
 	int i;
-	for (i = 0; i < n_samples; i++) {
-		*out = 0;
-		out += stride;
+
+	if (stride == 1) {
+		memset(out, 0, n_samples * sizeof(int16_t));
+		return;
 	}
+	for (i = 0; i < n_samples; i++)
+		out[i * stride] = 0;
+}
+static void copy_f32(float *out, const float *in, int n_samples, int stride)
+{
+	int i;
+
+	if (stride == 1) {
+		memcpy(out, in, n_samples * sizeof(float));
+		return;
+	}
+	for (i = 0; i < n_samples; i++)
+		out[i * stride] = in[i];
+}
+static void fill_f32(float *out, int n_samples, int stride)
+{
+	int i;
+
+	if (stride == 1) {
+		memset(out, 0, n_samples * sizeof(float));
+		return;
+	}
+	for (i = 0; i < n_samples; i++)
+		out[i * stride] = 0.0f;
 }
 static void add_f32(float *out, float *in, int n_samples)
 {
@@ -246,6 +313,22 @@ static void add_f32(float *out, float *in, int n_samples)
 		out[i] += in[i];
 }
 
+static void driver_convert(struct node_data *nd, void *dst, int stride,
+			   const float *src, int n_samples)
+{
+	if (nd->driver_format.format == nd->type.audio_format.F32) {
+		if (src)
+			copy_f32(dst, src, n_samples, stride);
+		else
+			fill_f32(dst, n_samples, stride);
+	} else {
+		if (src)
+			conv_f32_s16(dst, src, n_samples, stride);
+		else
+			fill_s16(dst, n_samples, stride);
+	}
+}
+
 static int driver_process_output(struct spa_node *node)
 {
 	struct node_data *nd = SPA_CONTAINER_OF(node, struct node_data, node_impl);
@@ -256,7 +339,9 @@ static int driver_process_output(struct spa_node *node)
 	struct spa_port_io *out_io = opd->io;
 	struct jack_engine_control *ctrl = this->server->engine_control;
 	struct buffer *out;
-	int16_t *op;
+	struct spa_data *d;
+	int channel, channels = nd->driver_format.channels, n_samples = ctrl->buffer_size;
+	uint32_t bpf, sample_size = nd->driver_sample_size;
 
 	pw_log_trace(NAME "%p: process output", this);
 
@@ -275,28 +360,53 @@ static int driver_process_output(struct spa_node *node)
 	out_io->buffer_id = out->outbuf->id;
 	out_io->status = SPA_RESULT_HAVE_BUFFER;
 
-	op = out->ptr;
+	d = out->outbuf->datas;
+	bpf = channels * sample_size;
+
+	if (n_samples * bpf > d[0].maxsize) {
+		pw_log_warn(NAME " %p: buffer too small %u < %u", this,
+			    d[0].maxsize, n_samples * bpf);
+		n_samples = d[0].maxsize / bpf;
+	}
+	d[0].chunk->offset = 0;
+	d[0].chunk->size = n_samples * bpf;
+	d[0].chunk->stride = bpf;
+
+	/* in freewheel mode the graph is driven by the freewheel thread and
+	 * the device only gets silence */
+	if (this->server->freewheel) {
+		memset(d[0].data, 0, n_samples * bpf);
+		return SPA_RESULT_HAVE_BUFFER;
+	}
 
 	spa_hook_list_call(&nd->listener_list, struct pw_jack_node_events, pull);
 
+	channel = 0;
 	spa_list_for_each(p, &gn->ports[SPA_DIRECTION_INPUT], link) {
 		struct pw_port *port = p->scheduler_data;
 		struct port_data *ipd = pw_port_get_user_data(port);
 		struct spa_port_io *in_io = ipd->io;
-		struct buffer *in;
-		int stride = 2;
+		const float *src = NULL;
 
-		if (in_io->buffer_id < ipd->n_buffers && in_io->status == SPA_RESULT_HAVE_BUFFER) {
-			in = &ipd->buffers[in_io->buffer_id];
-			conv_f32_s16(op, in->ptr, ctrl->buffer_size, stride);
-		}
-		else {
-			fill_s16(op, ctrl->buffer_size, stride);
+		if (ipd->port.jack_port == NULL)
+			continue;
+
+		if (in_io->buffer_id < ipd->n_buffers && in_io->status == SPA_RESULT_HAVE_BUFFER)
+			src = ipd->buffers[in_io->buffer_id].ptr;
+
+		/* the ports beyond the negotiated channels are not played */
+		if (channel < channels) {
+			driver_convert(nd, SPA_MEMBER(d[0].data, channel * sample_size, void),
+				       channels, src, n_samples);
+			channel++;
 		}
-		op++;
+
 		in_io->status = SPA_RESULT_NEED_BUFFER;
 	}
-	out->outbuf->datas[0].chunk->size = ctrl->buffer_size * sizeof(int16_t) * 2;
+	/* and the channels without a port are silent */
+	for (; channel < channels; channel++)
+		driver_convert(nd, SPA_MEMBER(d[0].data, channel * sample_size, void),
+			       channels, NULL, n_samples);
 
 	spa_hook_list_call(&nd->listener_list, struct pw_jack_node_events, push);
 	gn->ready[SPA_DIRECTION_INPUT] = gn->required[SPA_DIRECTION_OUTPUT] = 0;
@@ -313,7 +423,6 @@ static int node_process_input(struct spa_node *node)
         struct jack_server *server = this->server;
         struct jack_graph_manager *mgr = server->graph_manager;
 	struct jack_connection_manager *conn;
-	jack_time_t current_date = 0;
 	int ref_num = this->control->ref_num;
 
 	pw_log_trace(NAME " %p: process input", nd);
@@ -321,7 +430,7 @@ static int node_process_input(struct spa_node *node)
                 return SPA_RESULT_HAVE_BUFFER;
 
 	mgr->client_timing[ref_num].status = Triggered;
-	mgr->client_timing[ref_num].signaled_at = current_date;
+	mgr->client_timing[ref_num].signaled_at = jack_get_microseconds();
 
 	conn = jack_graph_manager_get_current(mgr);
 
@@ -370,6 +479,14 @@ static int port_set_io(struct spa_node *node, enum spa_direction direction, uint
 
 #define PROP(f,key,type,...)                                                    \
         SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_MM(f,key,type,...)							\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_U_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
 
 static int port_enum_formats(struct spa_node *node, enum spa_direction direction, uint32_t port_id,
                              struct spa_format **format,
@@ -408,11 +525,19 @@ static int port_enum_formats(struct spa_node *node, enum spa_direction direction
 			return SPA_RESULT_ENUM_END;
 	}
 	else {
+		/* the driver port produces interleaved float or s16 samples, float
+		 * is preferred. The channels are negotiated with the device, the
+		 * playback ports are preferably played on a channel each */
                 spa_pod_builder_format(&b, &f[0], t->format,
                         t->media_type.audio, t->media_subtype.raw,
-                        PROP(&f[1], t->format_audio.format, SPA_POD_TYPE_ID, t->audio_format.S16),
+                        PROP_U_EN(&f[1], t->format_audio.format, SPA_POD_TYPE_ID, 3,
+							t->audio_format.F32,
+							t->audio_format.F32,
+							t->audio_format.S16),
                         PROP(&f[1], t->format_audio.rate, SPA_POD_TYPE_INT, ctrl->sample_rate),
-                        PROP(&f[1], t->format_audio.channels, SPA_POD_TYPE_INT, 2));
+                        PROP_U_MM(&f[1], t->format_audio.channels, SPA_POD_TYPE_INT,
+							SPA_CLAMP(nd->n_playback_channels, 1, MAX_CHANNELS),
+							1, MAX_CHANNELS));
 	}
 	fmt = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
 
@@ -428,14 +553,73 @@ static int port_enum_formats(struct spa_node *node, enum spa_direction direction
 static int port_set_format(struct spa_node *node, enum spa_direction direction, uint32_t port_id,
 			   uint32_t flags, const struct spa_format *format)
 {
+	struct node_data *nd = SPA_CONTAINER_OF(node, struct node_data, node_impl);
+	struct port_data *pd = nd->port_data[direction][port_id];
+	struct type *t = &nd->type;
+	struct spa_audio_info info;
+
+	if (pd->port.jack_port != NULL)
+		return SPA_RESULT_OK;
+
+	if (format == NULL) {
+		nd->have_driver_format = false;
+		return SPA_RESULT_OK;
+	}
+
+	info.media_type = SPA_FORMAT_MEDIA_TYPE(format);
+	info.media_subtype = SPA_FORMAT_MEDIA_SUBTYPE(format);
+
+	if (info.media_type != t->media_type.audio ||
+	    info.media_subtype != t->media_subtype.raw)
+		return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+	spa_zero(info.info.raw);
+	if (!spa_format_audio_raw_parse(format, &info.info.raw, &t->format_audio))
+		return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+	if (info.info.raw.format == t->audio_format.F32)
+		nd->driver_sample_size = sizeof(float);
+	else if (info.info.raw.format == t->audio_format.S16)
+		nd->driver_sample_size = sizeof(int16_t);
+	else
+		return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+	if (info.info.raw.layout != SPA_AUDIO_LAYOUT_INTERLEAVED ||
+	    info.info.raw.channels < 1 || info.info.raw.channels > MAX_CHANNELS)
+		return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+	nd->driver_format = info.info.raw;
+	nd->have_driver_format = true;
+
+	pw_log_debug(NAME " %p: driver format %s %d channels for %d ports", nd,
+		     info.info.raw.format == t->audio_format.F32 ? "F32" : "S16",
+		     info.info.raw.channels, nd->n_playback_channels);
+
 	return SPA_RESULT_OK;
 }
 
 static int port_get_format(struct spa_node *node, enum spa_direction direction, uint32_t port_id,
 			   const struct spa_format **format)
 {
+	struct node_data *nd = SPA_CONTAINER_OF(node, struct node_data, node_impl);
+	struct port_data *pd = nd->port_data[direction][port_id];
+	struct type *t = &nd->type;
+	struct spa_pod_builder b = { NULL, };
+        struct spa_pod_frame f[2];
 	int res;
 	struct spa_format *fmt;
+
+	if (pd->port.jack_port == NULL && nd->have_driver_format) {
+		spa_pod_builder_init(&b, pd->buffer, sizeof(pd->buffer));
+                spa_pod_builder_format(&b, &f[0], t->format,
+                        t->media_type.audio, t->media_subtype.raw,
+                        PROP(&f[1], t->format_audio.format, SPA_POD_TYPE_ID, nd->driver_format.format),
+                        PROP(&f[1], t->format_audio.rate, SPA_POD_TYPE_INT, nd->driver_format.rate),
+                        PROP(&f[1], t->format_audio.channels, SPA_POD_TYPE_INT, nd->driver_format.channels));
+		*format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+		return SPA_RESULT_OK;
+	}
+
 	res = port_enum_formats(node, direction, port_id, &fmt, NULL, 0);
 	*format = fmt;
 	return res;
@@ -461,7 +645,27 @@ static int port_get_info(struct spa_node *node, enum spa_direction direction, ui
 static int port_enum_params(struct spa_node *node, enum spa_direction direction, uint32_t port_id,
 			    uint32_t index, struct spa_param **param)
 {
-	return SPA_RESULT_ENUM_END;
+	struct node_data *nd = SPA_CONTAINER_OF(node, struct node_data, node_impl);
+	struct port_data *pd = nd->port_data[direction][port_id];
+	struct type *t = &nd->type;
+	struct spa_pod_builder b = { NULL, };
+        struct spa_pod_frame f[2];
+	struct jack_engine_control *ctrl = nd->node.server->engine_control;
+
+	/* only the driver port needs buffers large enough for all channels */
+	if (pd->port.jack_port != NULL || index > 0)
+		return SPA_RESULT_ENUM_END;
+
+	spa_pod_builder_init(&b, pd->params_buffer, sizeof(pd->params_buffer));
+	spa_pod_builder_object(&b, &f[0], 0, t->param_alloc_buffers.Buffers,
+		PROP(&f[1], t->param_alloc_buffers.size, SPA_POD_TYPE_INT,
+			ctrl->buffer_size * nd->driver_format.channels * sizeof(float)),
+		PROP(&f[1], t->param_alloc_buffers.stride, SPA_POD_TYPE_INT, 0),
+		PROP_MM(&f[1], t->param_alloc_buffers.buffers, SPA_POD_TYPE_INT, 2, 2, 32),
+		PROP(&f[1], t->param_alloc_buffers.align, SPA_POD_TYPE_INT, 16));
+	*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
 }
 
 static int port_set_param(struct spa_node *node, enum spa_direction direction, uint32_t port_id,
@@ -969,6 +1173,13 @@ pw_jack_driver_new(struct pw_core *core,
         spa_hook_list_init(&nd->listener_list);
 	init_type(&nd->type, pw_core_get_type(core)->map);
 	nd->node_impl = driver_impl;
+	nd->n_capture_channels = n_capture_channels;
+	nd->n_playback_channels = n_playback_channels;
+	nd->driver_format.format = nd->type.audio_format.S16;
+	nd->driver_format.layout = SPA_AUDIO_LAYOUT_INTERLEAVED;
+	nd->driver_format.rate = server->engine_control->sample_rate;
+	nd->driver_format.channels = SPA_CLAMP(n_playback_channels, 1, MAX_CHANNELS);
+	nd->driver_sample_size = sizeof(int16_t);
 
 	pw_node_add_listener(node, &nd->node_listener, &node_events, nd);
 	pw_node_set_implementation(node, &nd->node_impl);
@@ -28,6 +28,15 @@ struct jack_client {
 	struct spa_list client_link;
 	bool activated;
 	bool realtime;
+
+	/* processing time of the client in the current stats interval,
+	 * updated from the data thread */
+	struct {
+		jack_time_t sum_usecs;
+		jack_time_t max_usecs;
+		uint32_t n_cycles;
+		uint32_t xruns;
+	} stats;
 };
 
 struct jack_server {
@@ -46,6 +55,8 @@ struct jack_server {
 
 	struct pw_jack_node *audio_node;
 	int audio_used;
+
+	bool freewheel;
 };
 
 static inline int
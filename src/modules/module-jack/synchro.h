@@ -97,3 +97,30 @@ jack_synchro_wait(struct jack_synchro *synchro)
 	}
 	return res == 0;
 }
+
+static inline bool
+jack_synchro_timed_wait(struct jack_synchro *synchro, uint64_t usec)
+{
+	struct timespec ts;
+	int res;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	usec += ts.tv_nsec / SPA_NSEC_PER_USEC;
+	ts.tv_sec += usec / SPA_USEC_PER_SEC;
+	ts.tv_nsec = (usec % SPA_USEC_PER_SEC) * SPA_NSEC_PER_USEC;
+
+	while ((res = sem_timedwait(synchro->semaphore, &ts)) < 0) {
+		if (errno == EINTR)
+			continue;
+		if (errno != ETIMEDOUT)
+			pw_log_error("semaphore %s wait err = %s", synchro->name, strerror(errno));
+		break;
+	}
+	return res == 0;
+}
+
+static inline void
+jack_synchro_reset(struct jack_synchro *synchro)
+{
+	while (sem_trywait(synchro->semaphore) == 0);
+}
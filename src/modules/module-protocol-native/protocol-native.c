@@ -155,6 +155,47 @@ core_marshal_create_link(void *object,
 	pw_protocol_native_end_proxy(proxy, b);
 }
 
+static void
+core_marshal_create_links(void *object,
+			  uint32_t n_links,
+			  const struct pw_core_link *links,
+			  const struct spa_dict *props)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_builder *b;
+	struct spa_pod_frame f;
+	uint32_t i, n_items;
+
+	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_CREATE_LINKS);
+
+	n_items = props ? props->n_items : 0;
+
+	spa_pod_builder_add(b,
+			    SPA_POD_TYPE_STRUCT, &f,
+			    SPA_POD_TYPE_INT, n_links, 0);
+
+	for (i = 0; i < n_links; i++) {
+		spa_pod_builder_add(b,
+				    SPA_POD_TYPE_INT, links[i].output_node_id,
+				    SPA_POD_TYPE_INT, links[i].output_port_id,
+				    SPA_POD_TYPE_INT, links[i].input_node_id,
+				    SPA_POD_TYPE_INT, links[i].input_port_id,
+				    SPA_POD_TYPE_INT, links[i].new_id, 0);
+	}
+	spa_pod_builder_add(b,
+			    SPA_POD_TYPE_INT, n_items, 0);
+
+	for (i = 0; i < n_items; i++) {
+		spa_pod_builder_add(b,
+				    SPA_POD_TYPE_STRING, props->items[i].key,
+				    SPA_POD_TYPE_STRING, props->items[i].value, 0);
+	}
+	spa_pod_builder_add(b,
+			    -SPA_POD_TYPE_STRUCT, &f, 0);
+
+	pw_protocol_native_end_proxy(proxy, b);
+}
+
 static void
 core_marshal_update_types_client(void *object, uint32_t first_id, uint32_t n_types, const char **types)
 {
@@ -501,6 +542,51 @@ static bool core_demarshal_create_link(void *object, void *data, size_t size)
 	return true;
 }
 
+static bool core_demarshal_create_links(void *object, void *data, size_t size)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_iter it;
+	uint32_t i, n_links;
+	struct pw_core_link *links;
+	struct spa_dict props;
+
+	if (!spa_pod_iter_struct(&it, data, size) ||
+	    !spa_pod_iter_get(&it,
+			      SPA_POD_TYPE_INT, &n_links, 0))
+		return false;
+
+	/* every link takes 5 ints in the message */
+	if (n_links > size / (5 * sizeof(struct spa_pod_int)))
+		return false;
+
+	links = alloca(n_links * sizeof(struct pw_core_link));
+	for (i = 0; i < n_links; i++) {
+		if (!spa_pod_iter_get(&it,
+				      SPA_POD_TYPE_INT, &links[i].output_node_id,
+				      SPA_POD_TYPE_INT, &links[i].output_port_id,
+				      SPA_POD_TYPE_INT, &links[i].input_node_id,
+				      SPA_POD_TYPE_INT, &links[i].input_port_id,
+				      SPA_POD_TYPE_INT, &links[i].new_id, 0))
+			return false;
+	}
+	if (!spa_pod_iter_get(&it,
+			      SPA_POD_TYPE_INT, &props.n_items, 0))
+		return false;
+
+	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+	for (i = 0; i < props.n_items; i++) {
+		if (!spa_pod_iter_get(&it,
+				      SPA_POD_TYPE_STRING, &props.items[i].key,
+				      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
+			return false;
+	}
+
+	pw_resource_do(resource, struct pw_core_proxy_methods, create_links, n_links,
+								       links,
+								       &props);
+	return true;
+}
+
 static bool core_demarshal_update_types_server(void *object, void *data, size_t size)
 {
 	struct pw_resource *resource = object;
@@ -963,7 +1049,8 @@ static const struct pw_core_proxy_methods pw_protocol_native_core_method_marshal
 	&core_marshal_get_registry,
 	&core_marshal_client_update,
 	&core_marshal_create_object,
-	&core_marshal_create_link
+	&core_marshal_create_link,
+	&core_marshal_create_links
 };
 
 static const struct pw_protocol_native_demarshal pw_protocol_native_core_method_demarshal[PW_CORE_PROXY_METHOD_NUM] = {
@@ -972,7 +1059,8 @@ static const struct pw_protocol_native_demarshal pw_protocol_native_core_method_
 	{ &core_demarshal_get_registry, 0, },
 	{ &core_demarshal_client_update, 0, },
 	{ &core_demarshal_create_object, PW_PROTOCOL_NATIVE_REMAP, },
-	{ &core_demarshal_create_link, PW_PROTOCOL_NATIVE_REMAP, }
+	{ &core_demarshal_create_link, PW_PROTOCOL_NATIVE_REMAP, },
+	{ &core_demarshal_create_links, 0, }
 };
 
 static const struct pw_core_proxy_events pw_protocol_native_core_event_marshal = {
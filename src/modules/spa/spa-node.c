@@ -160,6 +160,10 @@ setup_props(struct pw_core *core, struct spa_node *spa_node, struct pw_propertie
 			pw_log_info("configure prop %s", key);
 
 			switch(prop->body.value.type) {
+			case SPA_POD_TYPE_BOOL:
+				SPA_POD_VALUE(struct spa_pod_bool, &prop->body.value) =
+					pw_properties_parse_bool(value);
+				break;
 			case SPA_POD_TYPE_ID:
 				SPA_POD_VALUE(struct spa_pod_id, &prop->body.value) =
 					spa_type_map_get_id(t->map, value);
@@ -129,6 +129,7 @@ struct pw_client *pw_client_new(struct pw_core *core,
 
 	pw_map_init(&this->objects, 0, 32);
 	pw_map_init(&this->types, 0, 32);
+	pw_array_init(&this->permissions, 64);
 
 	this->info.props = this->properties ? &this->properties->dict : NULL;
 
@@ -221,6 +222,7 @@ void pw_client_destroy(struct pw_client *client)
 
 	pw_map_clear(&client->objects);
 	pw_map_clear(&client->types);
+	pw_array_clear(&client->permissions);
 
 	if (client->properties)
 		pw_properties_free(client->properties);
@@ -16,6 +16,7 @@
  * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
  * Boston, MA 02110-1301, USA.
  */
+#include <stdlib.h>
 #include <unistd.h>
 #include <time.h>
 #include <stdio.h>
@@ -23,6 +24,7 @@
 #define spa_debug pw_log_trace
 
 #include <spa/lib/debug.h>
+#include <spa/lib/format.h>
 #include <spa/format-utils.h>
 
 #include <pipewire/pipewire.h>
@@ -32,6 +34,36 @@
 #include <pipewire/core.h>
 #include <pipewire/data-loop.h>
 
+#define PROFILER_N_RECORDS	4096
+
+static inline int process_node(struct pw_core *core, struct spa_graph_node *node, bool input)
+{
+	struct pw_node *n = node->scheduler_data;
+	struct pw_profiler_record rec;
+	int res;
+
+	if (core->profiler == NULL || n == NULL)
+		return input ?
+			spa_node_process_input(node->implementation) :
+			spa_node_process_output(node->implementation);
+
+	rec.start = pw_profiler_now();
+	res = input ?
+		spa_node_process_input(node->implementation) :
+		spa_node_process_output(node->implementation);
+	rec.end = pw_profiler_now();
+	rec.id = n->info.id;
+	rec.flags = input ? PW_PROFILER_RECORD_FLAG_INPUT : 0;
+	rec.status = res;
+	rec.padding = 0;
+	pw_profiler_area_write(pw_profiler_get_area(core->profiler), &rec);
+
+	return res;
+}
+
+#define spa_graph_node_process_input(d,n)	process_node(d,n,true)
+#define spa_graph_node_process_output(d,n)	process_node(d,n,false)
+
 #include <spa/graph-scheduler3.h>
 
 /** \cond */
@@ -224,6 +256,83 @@ core_create_object(void *object,
 	goto done;
 }
 
+static bool port_in(struct pw_port *port, struct pw_port **ports, uint32_t n_ports)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_ports; i++) {
+		if (ports[i] == port)
+			return true;
+	}
+	return false;
+}
+
+/* get the port to link, a free port that is in \a claimed is not used again
+ * because it is already picked for another link */
+static struct pw_port *
+get_link_port(struct pw_node *node, enum pw_direction direction, uint32_t port_id,
+	      struct pw_port **claimed, uint32_t n_claimed)
+{
+	struct pw_port *port, *p;
+	struct spa_list *ports;
+
+	if (port_id != SPA_ID_INVALID)
+		return pw_node_find_port(node, direction, port_id);
+
+	port = pw_node_get_free_port(node, direction);
+	if (port == NULL || !spa_list_is_empty(&port->links) ||
+	    !port_in(port, claimed, n_claimed))
+		return port;
+
+	ports = direction == PW_DIRECTION_INPUT ? &node->input_ports : &node->output_ports;
+	spa_list_for_each(p, ports, link) {
+		if (spa_list_is_empty(&p->links) && !port_in(p, claimed, n_claimed))
+			return p;
+	}
+	return pw_node_new_port(node, direction);
+}
+
+/* find the ports to link, returns an error message on failure. The first
+ * \a n_claimed ports of \a outports and \a inports are picked already and
+ * the new ports are placed after them. */
+static const char *
+find_link_ports(struct pw_core *core,
+		uint32_t output_node_id,
+		uint32_t output_port_id,
+		uint32_t input_node_id,
+		uint32_t input_port_id,
+		struct pw_port **outports,
+		struct pw_port **inports,
+		uint32_t n_claimed)
+{
+	struct pw_node *output_node, *input_node;
+	struct pw_global *global;
+
+	global = pw_core_find_global(core, output_node_id);
+	if (global == NULL || global->type != core->type.node)
+		return "unknown output node";
+
+	output_node = global->object;
+
+	global = pw_core_find_global(core, input_node_id);
+	if (global == NULL || global->type != core->type.node)
+		return "unknown input node";
+
+	input_node = global->object;
+
+	outports[n_claimed] = get_link_port(output_node, PW_DIRECTION_OUTPUT, output_port_id,
+					    outports, n_claimed);
+	if (outports[n_claimed] == NULL)
+		return "unknown output port";
+
+	inports[n_claimed] = get_link_port(input_node, PW_DIRECTION_INPUT, input_port_id,
+					   inports, n_claimed);
+	if (inports[n_claimed] == NULL)
+		return "unknown input port";
+
+	return NULL;
+}
+
 static void
 core_create_link(void *object,
 		 uint32_t output_node_id,
@@ -236,39 +345,17 @@ core_create_link(void *object,
 {
 	struct pw_resource *resource = object;
 	struct pw_client *client = resource->client;
-	struct pw_node *output_node, *input_node;
 	struct pw_port *outport, *inport;
 	struct pw_core *core = client->core;
-	struct pw_global *global;
 	struct pw_link *link;
+	const char *msg;
 	char *error;
 	int res;
 
-	global = pw_core_find_global(core, output_node_id);
-	if (global == NULL || global->type != core->type.node)
-		goto no_output;
-
-	output_node = global->object;
-
-	global = pw_core_find_global(core, input_node_id);
-	if (global == NULL || global->type != core->type.node)
-		goto no_input;
-
-	input_node = global->object;
-
-	if (output_port_id == SPA_ID_INVALID)
-		outport = pw_node_get_free_port(output_node, SPA_DIRECTION_OUTPUT);
-	else
-		outport = pw_node_find_port(output_node, SPA_DIRECTION_OUTPUT, output_port_id);
-	if (outport == NULL)
-		goto no_output_port;
-
-	if (input_port_id == SPA_ID_INVALID)
-		inport = pw_node_get_free_port(input_node, SPA_DIRECTION_INPUT);
-	else
-		inport = pw_node_find_port(input_node, SPA_DIRECTION_INPUT, input_port_id);
-	if (inport == NULL)
-		goto no_input_port;
+	msg = find_link_ports(core, output_node_id, output_port_id,
+			      input_node_id, input_port_id, &outport, &inport, 0);
+	if (msg != NULL)
+		goto no_ports;
 
 	link = pw_link_new(core, outport, inport, NULL, NULL, &error, 0);
 	if (link == NULL)
@@ -283,32 +370,98 @@ core_create_link(void *object,
       done:
 	return;
 
-      no_output:
+      no_ports:
 	pw_core_resource_error(client->core_resource,
-			       resource->id, SPA_RESULT_INVALID_ARGUMENTS, "unknown output node");
+			       resource->id, SPA_RESULT_INVALID_ARGUMENTS, "%s", msg);
 	goto done;
-      no_input:
+      no_link:
 	pw_core_resource_error(client->core_resource,
-			       resource->id, SPA_RESULT_INVALID_ARGUMENTS, "unknown input node");
+			       resource->id, SPA_RESULT_ERROR, "can't create link: %s", error);
+	free(error);
 	goto done;
-      no_output_port:
+      no_bind:
 	pw_core_resource_error(client->core_resource,
-			       resource->id, SPA_RESULT_INVALID_ARGUMENTS, "unknown output port");
+			       resource->id, res, "can't bind link: %d", res);
 	goto done;
-      no_input_port:
+
+}
+
+static void
+core_create_links(void *object,
+		  uint32_t n_links,
+		  const struct pw_core_link *links,
+		  const struct spa_dict *props)
+{
+	struct pw_resource *resource = object;
+	struct pw_client *client = resource->client;
+	struct pw_core *core = client->core;
+	struct pw_port **outports = NULL, **inports = NULL;
+	struct pw_link **result = NULL;
+	const char *msg;
+	char *error;
+	uint32_t i;
+	int res;
+
+	if (n_links == 0)
+		return;
+	if (n_links > PW_LINK_MAX_GROUP)
+		goto too_many;
+
+	outports = calloc(n_links, sizeof(struct pw_port *));
+	inports = calloc(n_links, sizeof(struct pw_port *));
+	result = calloc(n_links, sizeof(struct pw_link *));
+	if (outports == NULL || inports == NULL || result == NULL)
+		goto no_mem;
+
+	for (i = 0; i < n_links; i++) {
+		msg = find_link_ports(core, links[i].output_node_id, links[i].output_port_id,
+				      links[i].input_node_id, links[i].input_port_id,
+				      outports, inports, i);
+		if (msg != NULL)
+			goto no_ports;
+	}
+
+	res = pw_link_new_group(core, n_links, outports, inports, NULL,
+				props ? pw_properties_new_dict(props) : NULL,
+				&error, 0, result);
+	if (res < 0)
+		goto no_links;
+
+	for (i = 0; i < n_links; i++)
+		pw_link_register(result[i], client, pw_client_get_global(client));
+
+	for (i = 0; i < n_links; i++) {
+		res = pw_global_bind(pw_link_get_global(result[i]), client,
+				     PW_PERM_RWX, PW_VERSION_LINK, links[i].new_id);
+		if (res < 0)
+			pw_core_resource_error(client->core_resource,
+					       resource->id, res, "can't bind link %d: %d", i, res);
+	}
+
+      done:
+	free(outports);
+	free(inports);
+	free(result);
+	return;
+
+      no_mem:
 	pw_core_resource_error(client->core_resource,
-			       resource->id, SPA_RESULT_INVALID_ARGUMENTS, "unknown input port");
+			       resource->id, SPA_RESULT_NO_MEMORY, "no memory");
 	goto done;
-      no_link:
+      no_ports:
 	pw_core_resource_error(client->core_resource,
-			       resource->id, SPA_RESULT_ERROR, "can't create link: %s, error");
-	free(error);
+			       resource->id, SPA_RESULT_INVALID_ARGUMENTS, "link %d: %s", i, msg);
 	goto done;
-      no_bind:
+      no_links:
 	pw_core_resource_error(client->core_resource,
-			       resource->id, res, "can't bind link: %d", res);
+			       resource->id, res, "can't create links: %s", error);
+	free(error);
 	goto done;
-
+      too_many:
+	pw_core_resource_error(client->core_resource,
+			       resource->id, SPA_RESULT_INVALID_ARGUMENTS,
+			       "too many links %u > %u", n_links, PW_LINK_MAX_GROUP);
+	return;
 }
 
 static void core_update_types(void *object, uint32_t first_id, uint32_t n_types, const char **types)
@@ -332,7 +485,8 @@ static const struct pw_core_proxy_methods core_methods = {
 	.get_registry = core_get_registry,
 	.client_update = core_client_update,
 	.create_object = core_create_object,
-	.create_link = core_create_link
+	.create_link = core_create_link,
+	.create_links = core_create_links
 };
 
 static void core_unbind_func(void *data)
@@ -395,7 +549,8 @@ core_bind_func(struct pw_global *global,
 struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *properties)
 {
 	struct pw_core *this;
-	const char *name;
+	const char *name, *str;
+	uint32_t i;
 
 	this = calloc(1, sizeof(struct pw_core));
 	if (this == NULL)
@@ -419,7 +574,7 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	pw_map_init(&this->globals, 128, 32);
 
 	spa_graph_init(&this->rt.graph);
-	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, NULL);
+	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, this);
 
 	spa_debug_set_type_map(this->type.map);
 
@@ -441,6 +596,11 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	spa_list_init(&this->node_list);
 	spa_list_init(&this->factory_list);
 	spa_list_init(&this->link_list);
+	spa_list_init(&this->node_index_dirty);
+	for (i = 0; i < PW_CORE_NODE_INDEX_SIZE; i++) {
+		spa_list_init(&this->node_index[PW_DIRECTION_INPUT][i]);
+		spa_list_init(&this->node_index[PW_DIRECTION_OUTPUT][i]);
+	}
 	spa_hook_list_init(&this->listener_list);
 
 	if ((name = pw_properties_get(properties, PW_CORE_PROP_NAME)) == NULL) {
@@ -459,6 +619,14 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	this->info.props = &properties->dict;
 	this->info.name = name;
 
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_PROFILER)) == NULL)
+		str = getenv("PIPEWIRE_PROFILER");
+	if (str && pw_properties_parse_bool(str)) {
+		if ((this->profiler = pw_profiler_new(this, PROFILER_N_RECORDS)) != NULL)
+			pw_properties_set(properties, PW_CORE_PROP_PROFILER_PATH,
+					  pw_profiler_get_path(this->profiler));
+	}
+
 	this->global = pw_core_add_global(this,
 					  NULL,
 					  NULL,
@@ -486,6 +654,7 @@ void pw_core_destroy(struct pw_core *core)
 {
 	struct pw_global *global, *t;
 	struct pw_module *module, *tm;
+	uint32_t i;
 
 	pw_log_debug("core %p: destroy", core);
 	spa_hook_list_call(&core->listener_list, struct pw_core_events, destroy);
@@ -500,6 +669,12 @@ void pw_core_destroy(struct pw_core *core)
 
 	pw_data_loop_destroy(core->data_loop_impl);
 
+	if (core->profiler)
+		pw_profiler_destroy(core->profiler);
+
+	for (i = 0; i < PW_CORE_FORMAT_CACHE_SIZE; i++)
+		free(core->format_cache[i].format);
+
 	pw_properties_free(core->properties);
 
 	pw_map_clear(&core->globals);
@@ -532,6 +707,23 @@ void pw_core_set_permission_callback(struct pw_core *core,
 {
 	core->permission_func = callback;
 	core->permission_data = data;
+	pw_core_update_permissions(core);
+}
+
+/** Evaluate the permissions of all globals again
+ *
+ * \param core a core
+ *
+ * Call this when the policy of the permission callback changed.
+ *
+ * \memberof pw_core
+ */
+void pw_core_update_permissions(struct pw_core *core)
+{
+	struct pw_global *global;
+
+	spa_list_for_each(global, &core->global_list, link)
+		pw_global_update_permissions(global);
 }
 
 struct pw_type *pw_core_get_type(struct pw_core *core)
@@ -600,17 +792,206 @@ struct pw_global *pw_core_find_global(struct pw_core *core, uint32_t id)
 	return pw_map_lookup(&core->globals, id);
 }
 
+/** \cond */
+struct node_index_entry {
+	struct spa_list link;		/* link in core node index */
+	struct spa_list node_link;	/* link in node index entries */
+	struct pw_node *node;
+	uint32_t media_type;		/* SPA_ID_INVALID when the formats are unknown */
+};
+/** \endcond */
+
+static inline struct spa_list *
+node_index_bucket(struct pw_core *core, enum pw_direction direction, uint32_t media_type)
+{
+	return &core->node_index[direction][media_type & (PW_CORE_NODE_INDEX_SIZE - 1)];
+}
+
+static void clear_node_index(struct pw_node *node)
+{
+	struct node_index_entry *e, *t;
+
+	spa_list_for_each_safe(e, t, &node->index.entries, node_link) {
+		spa_list_remove(&e->link);
+		spa_list_remove(&e->node_link);
+		free(e);
+	}
+}
+
+static void
+add_node_index(struct pw_core *core, struct pw_node *node,
+	       enum pw_direction direction, uint32_t media_type)
+{
+	struct spa_list *bucket = node_index_bucket(core, direction, media_type);
+	struct node_index_entry *e;
+
+	spa_list_for_each(e, bucket, link) {
+		if (e->node == node && e->media_type == media_type)
+			return;
+	}
+	if ((e = calloc(1, sizeof(struct node_index_entry))) == NULL)
+		return;
+
+	e->node = node;
+	e->media_type = media_type;
+	spa_list_append(bucket, &e->link);
+	spa_list_append(&node->index.entries, &e->node_link);
+}
+
+/* index the node by the media types of the ports in each direction. When
+ * the node can make new ports or a port has no formats, the node is
+ * added with an unknown media type and will be checked for every lookup */
+static void update_node_index(struct pw_core *core, struct pw_node *node)
+{
+	const char *str;
+	enum pw_direction direction;
+	struct spa_list *ports;
+	struct pw_port *p;
+	uint32_t i, n_ports, max_ports;
+	bool unknown;
+
+	clear_node_index(node);
+
+	for (direction = PW_DIRECTION_INPUT; direction <= PW_DIRECTION_OUTPUT; direction++) {
+		if (direction == PW_DIRECTION_INPUT) {
+			ports = &node->input_ports;
+			n_ports = node->info.n_input_ports;
+			max_ports = node->info.max_input_ports;
+		} else {
+			ports = &node->output_ports;
+			n_ports = node->info.n_output_ports;
+			max_ports = node->info.max_output_ports;
+		}
+		if (max_ports == 0)
+			continue;
+
+		unknown = n_ports < max_ports;
+		spa_list_for_each(p, ports, link) {
+			if (pw_port_collect_formats(p) < 0 || p->formats.n_formats == 0) {
+				unknown = true;
+				continue;
+			}
+			for (i = 0; i < p->formats.n_formats; i++)
+				add_node_index(core, node, direction,
+					       SPA_FORMAT_MEDIA_TYPE(p->formats.formats[i]));
+		}
+		if (unknown)
+			add_node_index(core, node, direction, SPA_ID_INVALID);
+	}
+
+	if ((str = pw_properties_get(node->properties, PW_NODE_PROP_PRIORITY)))
+		node->index.priority = pw_properties_parse_int(str);
+	else
+		node->index.priority = 0;
+
+	pw_log_debug("core %p: indexed node %p priority %d", core, node, node->index.priority);
+}
+
+static void refresh_node_index(struct pw_core *core)
+{
+	struct pw_node *n;
+
+	while (!spa_list_is_empty(&core->node_index_dirty)) {
+		n = spa_list_first(&core->node_index_dirty, struct pw_node, index.dirty_link);
+		spa_list_remove(&n->index.dirty_link);
+		n->index.dirty = false;
+		update_node_index(core, n);
+	}
+}
+
+/** Mark the index entries of a node as outdated
+ * \param core a core
+ * \param node a registered node
+ *
+ * The entries are updated the next time the index is used.
+ *
+ * \memberof pw_core
+ */
+void pw_core_invalidate_node_index(struct pw_core *core, struct pw_node *node)
+{
+	if (node->global == NULL || node->index.dirty)
+		return;
+
+	if (spa_list_is_empty(&node->index.entries))
+		node->index.seq = ++core->node_index_seq;
+
+	spa_list_append(&core->node_index_dirty, &node->index.dirty_link);
+	node->index.dirty = true;
+}
+
+/** Remove a node from the index
+ * \param core a core
+ * \param node a node
+ *
+ * \memberof pw_core
+ */
+void pw_core_remove_node_index(struct pw_core *core, struct pw_node *node)
+{
+	if (node->index.dirty) {
+		spa_list_remove(&node->index.dirty_link);
+		node->index.dirty = false;
+	}
+	clear_node_index(node);
+}
+
+static void
+add_candidate(struct pw_core *core, struct pw_array *candidates, struct pw_node *exclude,
+	      struct node_index_entry *e, const char *media_class)
+{
+	struct pw_node *n = e->node;
+	const char *str;
+
+	if (n == exclude || n->index.stamp == core->node_index_stamp)
+		return;
+
+	if (media_class &&
+	    ((str = pw_properties_get(n->properties, "media.class")) == NULL ||
+	     strcmp(str, media_class) != 0))
+		return;
+
+	n->index.stamp = core->node_index_stamp;
+	pw_array_add_ptr(candidates, n);
+}
+
+static void
+add_candidates(struct pw_core *core, struct pw_array *candidates, struct pw_node *exclude,
+	       enum pw_direction direction, uint32_t media_type, const char *media_class)
+{
+	struct node_index_entry *e;
+
+	spa_list_for_each(e, node_index_bucket(core, direction, media_type), link) {
+		if (e->media_type == media_type)
+			add_candidate(core, candidates, exclude, e, media_class);
+	}
+}
+
+static int compare_candidates(const void *p1, const void *p2)
+{
+	const struct pw_node *n1 = *(const struct pw_node **) p1;
+	const struct pw_node *n2 = *(const struct pw_node **) p2;
+
+	if (n1->index.priority != n2->index.priority)
+		return n1->index.priority > n2->index.priority ? -1 : 1;
+
+	/* prefer the newest node */
+	return n1->index.seq > n2->index.seq ? -1 : 1;
+}
+
 /** Find a port to link with
  *
  * \param core a core
  * \param other_port a port to find a link with
  * \param id the id of a port or SPA_ID_INVALID
- * \param props extra properties
+ * \param props extra properties, media.class restricts the nodes to the
+ *	given class
  * \param n_format_filters number of filters
  * \param format_filters array of format filters
  * \param[out] error an error when something is wrong
  * \return a port that can be used to link to \a otherport or NULL on error
  *
+ * When \a id is SPA_ID_INVALID, the nodes with a compatible media type
+ * are tried in order of their priority.
+ *
  * \memberof pw_core
  */
 struct pw_port *pw_core_find_port(struct pw_core *core,
@@ -622,66 +1003,167 @@ struct pw_port *pw_core_find_port(struct pw_core *core,
 				  char **error)
 {
 	struct pw_port *best = NULL;
-	bool have_id;
-	struct pw_node *n;
+	enum pw_direction direction = pw_direction_reverse(other_port->direction);
+	struct pw_global *global;
+	struct pw_node *n, **np;
+	struct pw_array candidates;
+	const char *media_class = NULL;
+	uint32_t i;
 
-	have_id = id != SPA_ID_INVALID;
+	pw_log_debug("id \"%u\"", id);
 
-	pw_log_debug("id \"%u\", %d", id, have_id);
+	if (id != SPA_ID_INVALID) {
+		global = pw_core_find_global(core, id);
+		if (global != NULL && global->type == core->type.node) {
+			n = global->object;
+			if (n != other_port->node) {
+				pw_log_debug("id \"%u\" matches node %p", id, n);
+				best = pw_node_get_free_port(n, direction);
+			}
+		}
+		goto done;
+	}
 
-	spa_list_for_each(n, &core->node_list, link) {
-		if (n->global == NULL)
-			continue;
+	refresh_node_index(core);
 
-		if (other_port->node == n)
-			continue;
+	if (props)
+		media_class = pw_properties_get(props, "media.class");
 
-		pw_log_debug("node id \"%d\"", n->global->id);
+	pw_array_init(&candidates, 64);
+	++core->node_index_stamp;
 
-		if (have_id) {
-			if (n->global->id == id) {
-				pw_log_debug("id \"%u\" matches node %p", id, n);
+	if (pw_port_collect_formats(other_port) == SPA_RESULT_OK &&
+	    other_port->formats.n_formats > 0) {
+		for (i = 0; i < other_port->formats.n_formats; i++)
+			add_candidates(core, &candidates, other_port->node, direction,
+				       SPA_FORMAT_MEDIA_TYPE(other_port->formats.formats[i]),
+				       media_class);
+		add_candidates(core, &candidates, other_port->node, direction,
+			       SPA_ID_INVALID, media_class);
+	} else {
+		/* formats unknown, try all nodes */
+		struct node_index_entry *e;
 
-				best =
-				    pw_node_get_free_port(n,
-							  pw_direction_reverse(other_port->
-									       direction));
-				if (best)
-					break;
-			}
-		} else {
-			struct pw_port *p, *pin, *pout;
+		for (i = 0; i < PW_CORE_NODE_INDEX_SIZE; i++) {
+			spa_list_for_each(e, &core->node_index[direction][i], link)
+				add_candidate(core, &candidates, other_port->node, e, media_class);
+		}
+	}
 
-			p = pw_node_get_free_port(n, pw_direction_reverse(other_port->direction));
-			if (p == NULL)
-				continue;
+	qsort(candidates.data, pw_array_get_len(&candidates, struct pw_node *),
+	      sizeof(struct pw_node *), compare_candidates);
 
-			if (p->direction == PW_DIRECTION_OUTPUT) {
-				pin = other_port;
-				pout = p;
-			} else {
-				pin = p;
-				pout = other_port;
-			}
+	pw_array_for_each(np, &candidates) {
+		struct pw_port *p, *pin, *pout;
 
-			if (pw_core_find_format(core,
-						pout,
-						pin,
-						props,
-						n_format_filters, format_filters, error) == NULL) {
-				free(*error);
-				continue;
-			}
+		n = *np;
+		pw_log_debug("node id \"%d\" priority %d", n->global->id, n->index.priority);
+
+		p = pw_node_get_free_port(n, direction);
+		if (p == NULL)
+			continue;
 
-			best = p;
+		if (p->direction == PW_DIRECTION_OUTPUT) {
+			pin = other_port;
+			pout = p;
+		} else {
+			pin = p;
+			pout = other_port;
+		}
+
+		if (pw_core_find_format(core,
+					pout,
+					pin,
+					props,
+					n_format_filters, format_filters, error) == NULL) {
+			free(*error);
+			continue;
 		}
+
+		best = p;
+		break;
 	}
+	pw_array_clear(&candidates);
+
+      done:
 	if (best == NULL) {
 		asprintf(error, "No matching Node found");
 	}
 	return best;
 }
 
+/* intersect the collected formats of both ports. The formats are tried
+ * in the preference order of the input port and then the output port,
+ * the first match is fixated. */
+static int intersect_formats(struct pw_port *output, struct pw_port *input,
+			     struct spa_format **result)
+{
+	struct spa_pod_builder b = { NULL, };
+	uint8_t buffer[4096];
+	struct spa_format *in, *out;
+	uint32_t i, o;
+	int res = SPA_RESULT_INCOMPATIBLE_PROPS;
+
+	if (input->formats.n_formats == 0) {
+		/* input accepts anything, take the preferred output format */
+		if (output->formats.n_formats == 0)
+			return SPA_RESULT_NO_FORMAT;
+		*result = spa_format_copy(output->formats.formats[0]);
+		spa_format_fixate(*result);
+		return SPA_RESULT_OK;
+	}
+
+	for (i = 0; i < input->formats.n_formats; i++) {
+		in = input->formats.formats[i];
+
+		for (o = 0; o < output->formats.n_formats; o++) {
+			out = output->formats.formats[o];
+
+			if (SPA_FORMAT_MEDIA_TYPE(in) != SPA_FORMAT_MEDIA_TYPE(out) ||
+			    SPA_FORMAT_MEDIA_SUBTYPE(in) != SPA_FORMAT_MEDIA_SUBTYPE(out))
+				continue;
+
+			spa_pod_builder_init(&b, buffer, sizeof(buffer));
+			if ((res = spa_format_filter(out, in, &b)) < 0)
+				continue;
+			if (b.offset > b.size) {
+				res = SPA_RESULT_NO_MEMORY;
+				continue;
+			}
+			*result = spa_format_copy(SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format));
+			spa_format_fixate(*result);
+			return SPA_RESULT_OK;
+		}
+	}
+	return res;
+}
+
+/* find the common format of the collected port formats. The result is
+ * cached by the generations of both sets of formats. */
+static int negotiate_format(struct pw_core *core, struct pw_port *output, struct pw_port *input,
+			    struct spa_format **format)
+{
+	uint32_t og = output->formats.generation, ig = input->formats.generation;
+	uint32_t idx = (og * 31 + ig) & (PW_CORE_FORMAT_CACHE_SIZE - 1);
+	int res;
+
+	if (core->format_cache[idx].output == og && core->format_cache[idx].input == ig) {
+		pw_log_debug("core %p: cached format %u %u", core, og, ig);
+		*format = core->format_cache[idx].format;
+		return *format ? SPA_RESULT_OK : SPA_RESULT_NO_FORMAT;
+	}
+
+	if ((res = intersect_formats(output, input, format)) < 0)
+		*format = NULL;
+
+	free(core->format_cache[idx].format);
+	core->format_cache[idx].output = og;
+	core->format_cache[idx].input = ig;
+	core->format_cache[idx].format = *format;
+
+	return res;
+}
+
 /** Find a common format between two ports
  *
  * \param core a core object
@@ -708,8 +1190,7 @@ struct spa_format *pw_core_find_format(struct pw_core *core,
 {
 	uint32_t out_state, in_state;
 	int res;
-	struct spa_format *filter = NULL, *format;
-	uint32_t iidx = 0, oidx = 0;
+	struct spa_format *format;
 
 	out_state = output->state;
 	in_state = input->state;
@@ -737,35 +1218,22 @@ struct spa_format *pw_core_find_format(struct pw_core *core,
 			goto error;
 		}
 	} else if (in_state == PW_PORT_STATE_CONFIGURE && out_state == PW_PORT_STATE_CONFIGURE) {
-	      again:
 		/* both ports need a format */
-		pw_log_debug("core %p: do enum input %d", core, iidx);
-		if ((res = spa_node_port_enum_formats(input->node->node, input->direction, input->port_id,
-						      &filter, NULL, iidx)) < 0) {
-			if (res == SPA_RESULT_ENUM_END && iidx != 0) {
-				asprintf(error, "error input enum formats: %d", res);
-				goto error;
-			}
+		if ((res = pw_port_collect_formats(input)) < 0) {
+			asprintf(error, "error input enum formats: %d", res);
+			goto error;
 		}
-		pw_log_debug("enum output %d with filter: %p", oidx, filter);
-		if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
-			spa_debug_format(filter);
-
-		if ((res = spa_node_port_enum_formats(output->node->node, output->direction, output->port_id,
-						      &format, filter, oidx)) < 0) {
-			if (res == SPA_RESULT_ENUM_END) {
-				oidx = 0;
-				iidx++;
-				goto again;
-			}
+		if ((res = pw_port_collect_formats(output)) < 0) {
 			asprintf(error, "error output enum formats: %d", res);
 			goto error;
 		}
-		pw_log_debug("Got filtered:");
+		if ((res = negotiate_format(core, output, input, &format)) < 0) {
+			asprintf(error, "no common format: %d", res);
+			goto error;
+		}
+		pw_log_debug("core %p: negotiated format:", core);
 		if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
 			spa_debug_format(format);
-
-		spa_format_fixate(format);
 	} else {
 		asprintf(error, "error node state");
 		goto error;
@@ -111,6 +111,11 @@ struct pw_core_events {
 #define PW_CORE_PROP_VERSION	"pipewire.core.version"
 /** If the core should listen for connections, boolean default false */
 #define PW_CORE_PROP_DAEMON	"pipewire.daemon"
+/** If the graph should be profiled, boolean default false. Can also be
+ * enabled with the PIPEWIRE_PROFILER environment variable */
+#define PW_CORE_PROP_PROFILER	"pipewire.profiler"
+/** The path of the profiler shared memory, set by the core */
+#define PW_CORE_PROP_PROFILER_PATH	"pipewire.profiler.path"
 
 /** Make a new core object for a given main_loop. Ownership of the properties is taken */
 struct pw_core * pw_core_new(struct pw_loop *main_loop, struct pw_properties *props);
@@ -130,6 +135,10 @@ void pw_core_set_permission_callback(struct pw_core *core,
 				     pw_permission_func_t callback,
 				     void *data);
 
+/** Evaluate the permissions of all globals again when they are needed, call
+  * this when the policy of the permission callback changed */
+void pw_core_update_permissions(struct pw_core *core);
+
 /** Get the type object of a core */
 struct pw_type *pw_core_get_type(struct pw_core *core);
 
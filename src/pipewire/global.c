@@ -16,6 +16,7 @@
  * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
  * Boston, MA 02110-1301, USA.
  */
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <stdio.h>
@@ -31,16 +32,68 @@ struct global_impl {
 	struct pw_global this;
 };
 
+/* the permissions of a global for a client, valid when the serial is the
+ * serial of the global */
+struct permission_entry {
+	uint32_t serial;
+	uint32_t permissions;
+};
+
 /** \endcond */
 
+static uint32_t next_serial(struct pw_core *core)
+{
+	/* 0 is the serial of entries that were never filled */
+	if (++core->permission_serial == 0)
+		core->permission_serial = 1;
+	return core->permission_serial;
+}
+
+/** Get the permissions of a global for a client
+ *
+ * The permissions are evaluated with the permission callback of the core once
+ * and cached in the client until the global or the core permissions are updated.
+ *
+ * \memberof pw_global
+ */
 uint32_t pw_global_get_permissions(struct pw_global *global, struct pw_client *client)
 {
 	struct pw_core *core = client->core;
+	struct permission_entry *e;
+	uint32_t len;
 
 	if (core->permission_func == NULL)
 		return PW_PERM_RWX;
 
-	return core->permission_func(global, client, core->permission_data);
+	len = pw_array_get_len(&client->permissions, struct permission_entry);
+	if (global->id >= len) {
+		size_t size = (global->id + 1 - len) * sizeof(struct permission_entry);
+
+		if ((e = pw_array_add(&client->permissions, size)) == NULL)
+			return core->permission_func(global, client, core->permission_data);
+		memset(e, 0, size);
+	}
+
+	e = pw_array_get_unchecked(&client->permissions, global->id, struct permission_entry);
+	if (e->serial != global->serial) {
+		e->permissions = core->permission_func(global, client, core->permission_data);
+		e->serial = global->serial;
+	}
+	return e->permissions;
+}
+
+/** Evaluate the permissions of a global again
+ *
+ * \param global a global
+ *
+ * Call this when the owner or the parent of the global changed or when
+ * the policy changed for this global.
+ *
+ * \memberof pw_global
+ */
+void pw_global_update_permissions(struct pw_global *global)
+{
+	global->serial = next_serial(global->core);
 }
 
 /** Create and add a new global to the core
@@ -84,6 +137,9 @@ pw_core_add_global(struct pw_core *core,
 	this->object = object;
 
 	this->id = pw_map_insert_new(&core->globals, this);
+	/* the id can be of a destroyed global, a new serial makes sure that its
+	 * cached permissions are not used */
+	this->serial = next_serial(core);
 
 	if (owner)
 		parent = owner->global;
@@ -74,6 +74,9 @@ pw_core_add_global(struct pw_core *core,
 /** Get the permissions of the global for a given client */
 uint32_t pw_global_get_permissions(struct pw_global *global, struct pw_client *client);
 
+/** Evaluate the permissions of the global again when they are needed */
+void pw_global_update_permissions(struct pw_global *global);
+
 /** Get the core object of this global */
 struct pw_core *pw_global_get_core(struct pw_global *global);
 
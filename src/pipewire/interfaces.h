@@ -74,7 +74,17 @@ struct pw_link_proxy;
 #define PW_CORE_PROXY_METHOD_CLIENT_UPDATE	3
 #define PW_CORE_PROXY_METHOD_CREATE_OBJECT	4
 #define PW_CORE_PROXY_METHOD_CREATE_LINK	5
-#define PW_CORE_PROXY_METHOD_NUM		6
+#define PW_CORE_PROXY_METHOD_CREATE_LINKS	6
+#define PW_CORE_PROXY_METHOD_NUM		7
+
+/** A link between two node ports in a \ref pw_core_proxy_methods::create_links request */
+struct pw_core_link {
+	uint32_t output_node_id;	/**< the global id of the output node */
+	uint32_t output_port_id;	/**< the id of the output port or SPA_ID_INVALID */
+	uint32_t input_node_id;		/**< the global id of the input node */
+	uint32_t input_port_id;		/**< the id of the input port or SPA_ID_INVALID */
+	uint32_t new_id;		/**< the client proxy id */
+};
 
 /**
  * \struct pw_core_proxy_methods
@@ -160,6 +170,21 @@ struct pw_core_proxy_methods {
 			     const struct spa_format *filter,
 			     const struct spa_dict *props,
 			     uint32_t new_id);
+	/**
+	 * Create links between multiple pairs of node ports
+	 *
+	 * The links are negotiated together, their buffers are allocated
+	 * from one memory block and they are activated at once when all
+	 * nodes are ready. A 64 channel route can be made with one request.
+	 *
+	 * \param n_links the number of links
+	 * \param links the ports to link and the client proxy ids
+	 * \param props optional properties for all the links
+	 */
+	void (*create_links) (void *object,
+			      uint32_t n_links,
+			      const struct pw_core_link *links,
+			      const struct spa_dict *props);
 };
 
 static inline void
@@ -219,6 +244,36 @@ pw_core_proxy_create_link(struct pw_core_proxy *core,
 	return (struct pw_link_proxy*) p;
 }
 
+/** Create \a n_links links, the new_id field of \a links is filled in
+ * with the id of the matching link proxy in \a proxies */
+static inline int
+pw_core_proxy_create_links(struct pw_core_proxy *core,
+			   uint32_t type,
+			   uint32_t n_links,
+			   struct pw_core_link *links,
+			   const struct spa_dict *props,
+			   size_t user_data_size,
+			   struct pw_link_proxy **proxies)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_links; i++) {
+		struct pw_proxy *p = pw_proxy_new((struct pw_proxy*)core, type, user_data_size);
+		if (p == NULL)
+			goto no_mem;
+		links[i].new_id = pw_proxy_get_id(p);
+		proxies[i] = (struct pw_link_proxy*) p;
+	}
+	pw_proxy_do((struct pw_proxy*)core, struct pw_core_proxy_methods, create_links,
+			n_links, links, props);
+	return SPA_RESULT_OK;
+
+      no_mem:
+	while (i > 0)
+		pw_proxy_destroy((struct pw_proxy*)proxies[--i]);
+	return SPA_RESULT_NO_MEMORY;
+}
+
 
 #define PW_CORE_PROXY_EVENT_UPDATE_TYPES 0
 #define PW_CORE_PROXY_EVENT_DONE         1
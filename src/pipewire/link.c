@@ -34,13 +34,42 @@
 #include "work-queue.h"
 
 #define MAX_BUFFERS     16
+#define MAX_DATAS	8
+#define MAX_GRAPH_OPS	256
 
 /** \cond */
+/** a graph change for the data loop */
+struct graph_op {
+	struct pw_loop *loop;
+	struct spa_graph_port *port;
+	void *target;
+};
+
+/** links made with pw_link_new_group() */
+struct link_group {
+	int refcount;
+
+	struct pw_work_queue *work;	/**< shared by all links */
+	bool queued;			/**< a check of the links is queued */
+
+	bool sizing;			/**< collecting the size of the buffer memory */
+	size_t size;
+	struct pw_memblock mem;		/**< buffer memory of the links */
+	size_t offset;			/**< free space in mem */
+
+	uint32_t n_links;
+	struct pw_link **links;		/**< links, NULL when destroyed */
+	struct graph_op *ops;		/**< 2 * n_links ops for the data loop */
+};
+
 struct impl {
 	struct pw_link this;
 
 	bool active;
 
+	struct link_group *group;
+	bool shared_mem;		/**< buffer memory is owned by the group */
+
 	struct pw_work_queue *work;
 
 	struct spa_format *format_filter;
@@ -226,6 +255,27 @@ static struct spa_param *find_param(struct spa_param **params, int n_params, uin
 	return NULL;
 }
 
+/* the number of data blocks the port wants in a buffer. Filtering the params
+ * drops the properties only one of the ports knows about so ask the port */
+static uint32_t port_get_blocks(struct pw_port *port)
+{
+	struct spa_param *param;
+	uint32_t i, blocks = 1;
+
+	for (i = 0;; i++) {
+		if (spa_node_port_enum_params(port->node->node, port->direction, port->port_id,
+					      i, &param) < 0)
+			break;
+		if (spa_pod_is_object_type(&param->object.pod,
+					   port->node->core->type.param_alloc_buffers.Buffers)) {
+			spa_param_query(param, port->node->core->type.param_alloc_buffers.blocks,
+					SPA_POD_TYPE_INT, &blocks, 0);
+			break;
+		}
+	}
+	return SPA_CLAMP(blocks, 1, MAX_DATAS);
+}
+
 static struct spa_param *find_meta_enable(struct pw_core *core, struct spa_param **params,
 					  int n_params, uint32_t type)
 {
@@ -248,30 +298,25 @@ static struct spa_param *find_meta_enable(struct pw_core *core, struct spa_param
 	return NULL;
 }
 
-static struct spa_buffer **alloc_buffers(struct pw_link *this,
-					 uint32_t n_buffers,
-					 uint32_t n_params,
-					 struct spa_param **params,
-					 uint32_t n_datas,
-					 size_t *data_sizes,
-					 ssize_t *data_strides,
-					 struct pw_memblock *mem)
+/* collect the metadata in \a metas, which has room for n_params + 1 items, and
+ * return the size of the memory of one buffer */
+static size_t buffer_layout(struct pw_link *this,
+			    uint32_t n_params,
+			    struct spa_param **params,
+			    uint32_t n_datas,
+			    size_t *data_sizes,
+			    struct spa_meta *metas,
+			    uint32_t *n_metas_out,
+			    size_t *skel_size_out)
 {
-	struct spa_buffer **buffers, *bp;
-	uint32_t i;
+	uint32_t i, n_metas;
 	size_t skel_size, data_size, meta_size;
-	struct spa_chunk *cdp;
-	void *ddp;
-	uint32_t n_metas;
-	struct spa_meta *metas;
 
 	n_metas = data_size = meta_size = 0;
 
 	/* each buffer */
 	skel_size = sizeof(struct spa_buffer);
 
-	metas = alloca(sizeof(struct spa_meta) * (n_params + 1));
-
 	/* add shared metadata */
 	metas[n_metas].type = this->core->type.meta.Shared;
 	metas[n_metas].size = sizeof(struct spa_meta_shared);
@@ -310,13 +355,97 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 		skel_size += sizeof(struct spa_data);
 	}
 
+	*n_metas_out = n_metas;
+	*skel_size_out = skel_size;
+
+	return data_size;
+}
+
+static size_t buffers_size(struct pw_link *this,
+			   uint32_t n_buffers,
+			   uint32_t n_params,
+			   struct spa_param **params,
+			   uint32_t n_datas,
+			   size_t *data_sizes)
+{
+	struct spa_meta *metas = alloca(sizeof(struct spa_meta) * (n_params + 1));
+	uint32_t n_metas;
+	size_t skel_size;
+
+	return n_buffers * buffer_layout(this, n_params, params, n_datas, data_sizes,
+					 metas, &n_metas, &skel_size);
+}
+
+/* take \a size bytes from the memory of the group */
+static bool group_take_mem(struct link_group *group, size_t size,
+			   struct pw_memblock *mem, size_t *offset)
+{
+	if (group == NULL || group->mem.ptr == NULL ||
+	    group->offset + size > group->mem.size)
+		return false;
+
+	*mem = group->mem;
+	*offset = group->offset;
+	group->offset += SPA_ROUND_UP_N(size, 64);
+
+	return true;
+}
+
+/* free the buffers of the link, the memory is kept when it is owned by the group */
+static void free_buffers(struct pw_link *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+
+	if (this->buffer_owner != this)
+		return;
+
+	free(this->buffers);
+	if (!impl->shared_mem)
+		pw_memblock_free(&this->buffer_mem);
+	spa_zero(this->buffer_mem);
+	impl->shared_mem = false;
+	this->buffers = NULL;
+	this->n_buffers = 0;
+	this->buffer_owner = NULL;
+}
+
+static struct spa_buffer **alloc_buffers(struct pw_link *this,
+					 uint32_t n_buffers,
+					 uint32_t n_params,
+					 struct spa_param **params,
+					 uint32_t n_datas,
+					 size_t *data_sizes,
+					 ssize_t *data_strides,
+					 bool shared,
+					 struct pw_memblock *mem)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct spa_buffer **buffers, *bp;
+	uint32_t i;
+	size_t skel_size, data_size, base;
+	struct spa_chunk *cdp;
+	void *ddp;
+	uint32_t n_metas;
+	struct spa_meta *metas;
+
+	metas = alloca(sizeof(struct spa_meta) * (n_params + 1));
+
+	data_size = buffer_layout(this, n_params, params, n_datas, data_sizes,
+				  metas, &n_metas, &skel_size);
+
 	buffers = calloc(n_buffers, skel_size + sizeof(struct spa_buffer *));
 	/* pointer to buffer structures */
 	bp = SPA_MEMBER(buffers, n_buffers * sizeof(struct spa_buffer *), struct spa_buffer);
 
-	pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
-			  PW_MEMBLOCK_FLAG_MAP_READWRITE |
-			  PW_MEMBLOCK_FLAG_SEAL, n_buffers * data_size, mem);
+	if (shared && group_take_mem(impl->group, n_buffers * data_size, mem, &base)) {
+		pw_log_debug("link %p: using group memory at offset %zd", this, base);
+		impl->shared_mem = true;
+	} else {
+		pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
+				  PW_MEMBLOCK_FLAG_MAP_READWRITE |
+				  PW_MEMBLOCK_FLAG_SEAL, n_buffers * data_size, mem);
+		base = 0;
+	}
 
 	for (i = 0; i < n_buffers; i++) {
 		int j;
@@ -325,7 +454,7 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 
 		buffers[i] = b = SPA_MEMBER(bp, skel_size * i, struct spa_buffer);
 
-		p = SPA_MEMBER(mem->ptr, data_size * i, void);
+		p = SPA_MEMBER(mem->ptr, base + data_size * i, void);
 
 		b->id = i;
 		b->n_metas = n_metas;
@@ -342,11 +471,13 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 
 				msh->flags = 0;
 				msh->fd = mem->fd;
-				msh->offset = data_size * i;
+				msh->offset = base + data_size * i;
 				msh->size = data_size;
 			} else if (m->type == this->core->type.meta.Ringbuffer) {
 				struct spa_meta_ringbuffer *rb = p;
 				spa_ringbuffer_init(&rb->ringbuffer, data_sizes[0]);
+			} else if (m->type == this->core->type.meta.VideoDamage) {
+				spa_meta_video_damage_set_all(p);
 			}
 			p += m->size;
 		}
@@ -508,13 +639,19 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		spa_debug_port_info(iinfo);
 	}
 
+	if (impl->group && impl->group->sizing && this->buffers != NULL)
+		return SPA_RESULT_OK;
+
 	if (this->buffers == NULL) {
 		struct spa_param **params, *param;
 		uint8_t buffer[4096];
 		struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
 		int i, offset, n_params;
-		uint32_t max_buffers;
+		uint32_t max_buffers, n_datas;
 		size_t minsize = 1024, stride = 0;
+		size_t data_sizes[MAX_DATAS];
+		ssize_t data_strides[MAX_DATAS];
+		bool shared;
 
 		n_params = param_filter(this, input, output, &b);
 
@@ -539,7 +676,8 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 					    SPA_POD_TYPE_INT, &ms,
 					    this->core->type.param_alloc_meta_enable.
 					    ringbufferStride, SPA_POD_TYPE_INT, &s, 0) == 2) {
-				minsize = ms;
+				/* the indexes of a spa_ringbuffer wrap with a mask */
+				for (minsize = 1; minsize < ms; minsize <<= 1);
 				stride = s;
 			}
 		} else {
@@ -577,6 +715,26 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		    (out_flags & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS))
 			minsize = 0;
 
+		n_datas = SPA_MAX(port_get_blocks(input), port_get_blocks(output));
+		for (i = 0; i < n_datas; i++) {
+			data_sizes[i] = minsize;
+			data_strides[i] = stride;
+		}
+
+		/* the group only collects the memory of the links that own their buffers,
+		 * buffers allocated by a port are freed by the port */
+		shared = !((in_flags | out_flags) & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS);
+
+		if (impl->group && impl->group->sizing) {
+			if (shared && output->n_buffers == 0 &&
+			    !(input->n_buffers && input->mix == NULL)) {
+				impl->group->size += SPA_ROUND_UP_N(buffers_size(this, max_buffers,
+										 n_params, params,
+										 n_datas, data_sizes), 64);
+			}
+			return SPA_RESULT_OK;
+		}
+
 		if (output->n_buffers) {
 			out_flags = 0;
 			in_flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
@@ -594,20 +752,18 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 			pw_log_debug("link %p: reusing %d input buffers %p", this, this->n_buffers,
 				     this->buffers);
 		} else {
-			size_t data_sizes[1];
-			ssize_t data_strides[1];
-
-			data_sizes[0] = minsize;
-			data_strides[0] = stride;
-
+			/* buffers of an earlier allocation that no port uses anymore */
+			if (input->buffers != this->buffers)
+				free_buffers(this);
 			this->buffer_owner = this;
 			this->n_buffers = max_buffers;
 			this->buffers = alloc_buffers(this,
 						      this->n_buffers,
 						      n_params,
 						      params,
-						      1,
+						      n_datas,
 						      data_sizes, data_strides,
+						      shared,
 						      &this->buffer_mem);
 
 			pw_log_debug("link %p: allocating %d buffers %p %zd %zd", this,
@@ -732,34 +888,41 @@ do_activate_link(struct spa_loop *loop,
 	return SPA_RESULT_OK;
 }
 
-static int check_states(struct pw_link *this, void *user_data, int res)
+static int get_states(struct pw_link *this, uint32_t *in_state, uint32_t *out_state)
 {
-	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
-	uint32_t in_state, out_state;
-	struct pw_port *input, *output;
-
 	if (this->state == PW_LINK_STATE_ERROR)
 		return SPA_RESULT_ERROR;
 
-	input = this->input;
-	output = this->output;
-
-	if (input == NULL || output == NULL)
-		return SPA_RESULT_OK;
-
-	if (input->node->info.state == PW_NODE_STATE_ERROR ||
-	    output->node->info.state == PW_NODE_STATE_ERROR)
+	if (this->input->node->info.state == PW_NODE_STATE_ERROR ||
+	    this->output->node->info.state == PW_NODE_STATE_ERROR)
 		return SPA_RESULT_ERROR;
 
-	in_state = input->state;
-	out_state = output->state;
+	*in_state = this->input->state;
+	*out_state = this->output->state;
 
-	pw_log_debug("link %p: input state %d, output state %d", this, in_state, out_state);
+	pw_log_debug("link %p: input state %d, output state %d", this, *in_state, *out_state);
 
-	if (in_state == PW_PORT_STATE_ERROR || out_state == PW_PORT_STATE_ERROR) {
+	if (*in_state == PW_PORT_STATE_ERROR || *out_state == PW_PORT_STATE_ERROR) {
 		pw_link_update_state(this, PW_LINK_STATE_ERROR, NULL);
 		return SPA_RESULT_ERROR;
 	}
+	return SPA_RESULT_OK;
+}
+
+static int check_states(struct pw_link *this, void *user_data, int res)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	uint32_t in_state, out_state;
+	struct pw_port *input, *output;
+
+	input = this->input;
+	output = this->output;
+
+	if (input == NULL || output == NULL)
+		return this->state == PW_LINK_STATE_ERROR ? SPA_RESULT_ERROR : SPA_RESULT_OK;
+
+	if ((res = get_states(this, &in_state, &out_state)) < 0)
+		return res;
 
 	if (in_state == PW_PORT_STATE_STREAMING && out_state == PW_PORT_STATE_STREAMING) {
 		pw_loop_invoke(output->node->data_loop,
@@ -788,6 +951,168 @@ static int check_states(struct pw_link *this, void *user_data, int res)
 	return res;
 }
 
+static int
+do_add_ports(struct spa_loop *loop,
+	     bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	const struct graph_op *ops = data;
+	uint32_t i, n_ops = size / sizeof(struct graph_op);
+
+	for (i = 0; i < n_ops; i++)
+		spa_graph_port_add(ops[i].target, ops[i].port);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+do_link_ports(struct spa_loop *loop,
+	      bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	const struct graph_op *ops = data;
+	uint32_t i, n_ops = size / sizeof(struct graph_op);
+
+	for (i = 0; i < n_ops; i++)
+		spa_graph_port_link(ops[i].port, ops[i].target);
+
+	return SPA_RESULT_OK;
+}
+
+/* run \a func once for each data loop with all the ops for that loop */
+static void invoke_graph_ops(spa_invoke_func_t func, struct graph_op *ops, uint32_t n_ops)
+{
+	struct graph_op batch[MAX_GRAPH_OPS];
+	uint32_t i, j, n;
+
+	for (i = 0; i < n_ops; i++) {
+		struct pw_loop *loop = ops[i].loop;
+
+		if (loop == NULL)
+			continue;
+
+		for (j = i, n = 0; j < n_ops; j++) {
+			if (ops[j].loop != loop)
+				continue;
+
+			batch[n++] = ops[j];
+			ops[j].loop = NULL;
+
+			if (n == MAX_GRAPH_OPS) {
+				pw_loop_invoke(loop, func, SPA_ID_INVALID,
+					       n * sizeof(struct graph_op), batch, false, NULL);
+				n = 0;
+			}
+		}
+		if (n > 0)
+			pw_loop_invoke(loop, func, SPA_ID_INVALID,
+				       n * sizeof(struct graph_op), batch, false, NULL);
+	}
+}
+
+static void check_group(void *obj, void *data, int res, uint32_t id);
+
+static void group_schedule_check(struct link_group *group)
+{
+	if (group->queued)
+		return;
+
+	group->queued = true;
+	pw_work_queue_add(group->work, group, SPA_RESULT_WAIT_SYNC, check_group, group);
+}
+
+static inline bool group_link_active(struct pw_link *link)
+{
+	struct impl *impl;
+
+	if (link == NULL)
+		return false;
+
+	impl = SPA_CONTAINER_OF(link, struct impl, this);
+	return impl->active && link->input && link->output;
+}
+
+/* Like check_states but for all links of the group at once. The states are
+ * read again after each step so that links with synchronous nodes go from
+ * configure to streaming in one check. */
+static void check_group(void *obj, void *data, int res, uint32_t id)
+{
+	struct link_group *group = data;
+	struct graph_op *ops = group->ops;
+	uint32_t i, n_ops = 0, in_state, out_state;
+	bool pending = false;
+	struct pw_link *l;
+
+	group->queued = false;
+
+	pw_log_debug("link-group %p: check %d links", group, group->n_links);
+
+	for (i = 0; i < group->n_links; i++) {
+		l = group->links[i];
+		if (group_link_active(l) && get_states(l, &in_state, &out_state) == SPA_RESULT_OK)
+			do_negotiate(l, in_state, out_state);
+	}
+
+	/* collect the size of the buffers of all the links that can allocate
+	 * now and make one memory block for them */
+	if (group->mem.ptr == NULL) {
+		group->sizing = true;
+		group->size = 0;
+		for (i = 0; i < group->n_links; i++) {
+			l = group->links[i];
+			if (group_link_active(l) && get_states(l, &in_state, &out_state) == SPA_RESULT_OK)
+				do_allocation(l, in_state, out_state);
+		}
+		group->sizing = false;
+
+		if (group->size > 0) {
+			pw_log_debug("link-group %p: allocating %zd bytes", group, group->size);
+			if (pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
+					      PW_MEMBLOCK_FLAG_MAP_READWRITE |
+					      PW_MEMBLOCK_FLAG_SEAL, group->size, &group->mem) < 0)
+				spa_zero(group->mem);
+			group->offset = 0;
+		}
+	}
+
+	for (i = 0; i < group->n_links; i++) {
+		l = group->links[i];
+		if (group_link_active(l) && get_states(l, &in_state, &out_state) == SPA_RESULT_OK)
+			do_allocation(l, in_state, out_state);
+	}
+	for (i = 0; i < group->n_links; i++) {
+		l = group->links[i];
+		if (group_link_active(l) && get_states(l, &in_state, &out_state) == SPA_RESULT_OK)
+			do_start(l, in_state, out_state);
+	}
+
+	for (i = 0; i < group->n_links; i++) {
+		l = group->links[i];
+		if (!group_link_active(l) || get_states(l, &in_state, &out_state) < 0)
+			continue;
+
+		if (in_state != PW_PORT_STATE_STREAMING || out_state != PW_PORT_STATE_STREAMING) {
+			pending = true;
+			continue;
+		}
+		if (l->state == PW_LINK_STATE_RUNNING)
+			continue;
+
+		ops[n_ops].loop = l->output->node->data_loop;
+		ops[n_ops].port = &l->rt.out_port;
+		ops[n_ops].target = &l->rt.in_port;
+		n_ops++;
+	}
+
+	invoke_graph_ops(do_link_ports, ops, n_ops);
+
+	for (i = 0; i < n_ops; i++) {
+		l = SPA_CONTAINER_OF(ops[i].port, struct pw_link, rt.out_port);
+		pw_link_update_state(l, PW_LINK_STATE_RUNNING, NULL);
+	}
+
+	if (pending)
+		group_schedule_check(group);
+}
+
 static void
 input_node_async_complete(void *data, uint32_t seq, int res)
 {
@@ -913,8 +1238,11 @@ bool pw_link_activate(struct pw_link *this)
 	this->output->node->n_used_output_links++;
 	this->input->node->n_used_input_links++;
 
-	pw_work_queue_add(impl->work,
-			  this, SPA_RESULT_WAIT_SYNC, (pw_work_func_t) check_states, this);
+	if (impl->group)
+		group_schedule_check(impl->group);
+	else
+		pw_work_queue_add(impl->work,
+				  this, SPA_RESULT_WAIT_SYNC, (pw_work_func_t) check_states, this);
 
 	return true;
 }
@@ -1054,13 +1382,14 @@ static const struct pw_node_events output_node_events = {
 	.async_complete = output_node_async_complete,
 };
 
-struct pw_link *pw_link_new(struct pw_core *core,
-			    struct pw_port *output,
-			    struct pw_port *input,
-			    struct spa_format *format_filter,
-			    struct pw_properties *properties,
-			    char **error,
-			    size_t user_data_size)
+static struct pw_link *link_new(struct pw_core *core,
+				struct pw_port *output,
+				struct pw_port *input,
+				struct spa_format *format_filter,
+				struct pw_properties *properties,
+				char **error,
+				size_t user_data_size,
+				struct link_group *group)
 {
 	struct impl *impl;
 	struct pw_link *this;
@@ -1082,7 +1411,12 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	if (user_data_size > 0)
                 this->user_data = SPA_MEMBER(impl, sizeof(struct impl), void);
 
-	impl->work = pw_work_queue_new(core->main_loop);
+	if (group) {
+		impl->group = group;
+		impl->work = group->work;
+		group->refcount++;
+	} else
+		impl->work = pw_work_queue_new(core->main_loop);
 
 	this->core = core;
 	this->properties = properties;
@@ -1146,6 +1480,10 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	this->rt.in_port.scheduler_data = this;
 	this->rt.out_port.scheduler_data = this;
 
+	/* the group adds all its links to the graph at once */
+	if (group)
+		return this;
+
 	/* nodes can be in different data loops so we do this twice */
 	pw_loop_invoke(output_node->data_loop, do_add_link,
 		       SPA_ID_INVALID, sizeof(struct pw_port *), &output, false, this);
@@ -1168,6 +1506,127 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	return NULL;
 }
 
+struct pw_link *pw_link_new(struct pw_core *core,
+			    struct pw_port *output,
+			    struct pw_port *input,
+			    struct spa_format *format_filter,
+			    struct pw_properties *properties,
+			    char **error,
+			    size_t user_data_size)
+{
+	return link_new(core, output, input, format_filter, properties, error,
+			user_data_size, NULL);
+}
+
+int pw_link_new_group(struct pw_core *core,
+		      uint32_t n_links,
+		      struct pw_port **outputs,
+		      struct pw_port **inputs,
+		      struct spa_format *format_filter,
+		      struct pw_properties *properties,
+		      char **error,
+		      size_t user_data_size,
+		      struct pw_link **links)
+{
+	struct link_group *group;
+	struct graph_op *ops;
+	uint32_t i, n_ops, n_made;
+	int res = SPA_RESULT_OK;
+
+	if (n_links == 0 || n_links > PW_LINK_MAX_GROUP)
+		goto no_links;
+
+	group = calloc(1, sizeof(struct link_group));
+	if (group == NULL)
+		goto no_mem;
+
+	group->links = calloc(n_links, sizeof(struct pw_link *));
+	group->ops = ops = malloc(2 * n_links * sizeof(struct graph_op));
+	if (group->links == NULL || ops == NULL) {
+		free(group->links);
+		free(group);
+		free(ops);
+		goto no_mem;
+	}
+	group->work = pw_work_queue_new(core->main_loop);
+	group->n_links = n_links;
+
+	pw_log_debug("link-group %p: new %d links", group, n_links);
+
+	for (n_made = 0; n_made < n_links; n_made++) {
+		struct pw_properties *props = NULL;
+
+		if (properties && (props = pw_properties_copy(properties)) == NULL) {
+			asprintf(error, "no memory");
+			res = SPA_RESULT_NO_MEMORY;
+			break;
+		}
+		links[n_made] = link_new(core, outputs[n_made], inputs[n_made], format_filter,
+					 props, error, user_data_size, group);
+		if (links[n_made] == NULL) {
+			if (props)
+				pw_properties_free(props);
+			res = SPA_RESULT_ERROR;
+			break;
+		}
+		group->links[n_made] = links[n_made];
+	}
+
+	/* add all the links to the graph with one invoke for each data loop,
+	 * also when we failed so that the links can be destroyed normally */
+	for (i = 0, n_ops = 0; i < n_made; i++) {
+		struct pw_link *l = links[i];
+
+		ops[n_ops].loop = l->output->node->data_loop;
+		ops[n_ops].port = &l->rt.out_port;
+		ops[n_ops].target = &l->output->rt.mix_node;
+		n_ops++;
+		ops[n_ops].loop = l->input->node->data_loop;
+		ops[n_ops].port = &l->rt.in_port;
+		ops[n_ops].target = &l->input->rt.mix_node;
+		n_ops++;
+	}
+	invoke_graph_ops(do_add_ports, ops, n_ops);
+
+	if (res < 0) {
+		pw_log_debug("link-group %p: failed to make link %d: %s", group, n_made, *error);
+		for (i = 0; i < n_made; i++)
+			pw_link_destroy(links[i]);
+		goto exit;
+	}
+
+	for (i = 0; i < n_links; i++) {
+		spa_hook_list_call(&links[i]->output->listener_list,
+				   struct pw_port_events, link_added, links[i]);
+		spa_hook_list_call(&links[i]->input->listener_list,
+				   struct pw_port_events, link_added, links[i]);
+	}
+
+      exit:
+	/* the group is freed with the last link */
+	if (n_made == 0) {
+		pw_work_queue_destroy(group->work);
+		free(group->links);
+		free(group->ops);
+		free(group);
+	}
+	if (properties)
+		pw_properties_free(properties);
+	return res;
+
+      no_links:
+	asprintf(error, "invalid number of links %u", n_links);
+	res = SPA_RESULT_INVALID_ARGUMENTS;
+	goto free_props;
+      no_mem:
+	asprintf(error, "no memory");
+	res = SPA_RESULT_NO_MEMORY;
+      free_props:
+	if (properties)
+		pw_properties_free(properties);
+	return res;
+}
+
 void pw_link_register(struct pw_link *link,
 		      struct pw_client *owner,
 		      struct pw_global *parent)
@@ -1200,6 +1659,26 @@ void pw_link_register(struct pw_link *link,
 }
 
 
+static void group_remove_link(struct link_group *group, struct pw_link *link)
+{
+	uint32_t i;
+
+	for (i = 0; i < group->n_links; i++) {
+		if (group->links[i] == link)
+			group->links[i] = NULL;
+	}
+	if (--group->refcount > 0)
+		return;
+
+	pw_log_debug("link-group %p: free", group);
+	pw_work_queue_destroy(group->work);
+	if (group->mem.ptr)
+		pw_memblock_free(&group->mem);
+	free(group->links);
+	free(group->ops);
+	free(group);
+}
+
 void pw_link_destroy(struct pw_link *link)
 {
 	struct impl *impl = SPA_CONTAINER_OF(link, struct impl, this);
@@ -1230,7 +1709,10 @@ void pw_link_destroy(struct pw_link *link)
 
 	spa_hook_list_call(&link->listener_list, struct pw_link_events, free);
 
-	pw_work_queue_destroy(impl->work);
+	if (impl->group)
+		group_remove_link(impl->group, link);
+	else
+		pw_work_queue_destroy(impl->work);
 
 	if (link->properties)
 		pw_properties_free(link->properties);
@@ -1238,10 +1720,7 @@ void pw_link_destroy(struct pw_link *link)
 	if (link->info.format)
 		free(link->info.format);
 
-	if (link->buffer_owner == link) {
-		free(link->buffers);
-		pw_memblock_free(&link->buffer_mem);
-	}
+	free_buffers(link);
 	free(impl);
 }
 
@@ -75,6 +75,9 @@ struct pw_link_events {
   * set to "1" or "0" */
 #define PW_LINK_PROP_PASSIVE	"pipewire.link.passive"
 
+/** The maximum number of links in pw_link_new_group() */
+#define PW_LINK_MAX_GROUP	256
+
 /** Make a new link between two ports \memberof pw_link
  * \return a newly allocated link */
 struct pw_link *
@@ -86,6 +89,27 @@ pw_link_new(struct pw_core *core,		/**< the core object */
 	    char **error,			/**< error string when result is NULL */
 	    size_t user_data_size		/**< extra user data size */);
 
+/** Make links between \a n_links pairs of ports \memberof pw_link
+ *
+ * The links are checked together: they are negotiated before any of them
+ * allocates, the buffers of the links are allocated from one memory block
+ * and the links are activated with one invoke on the data loop.
+ *
+ * \return SPA_RESULT_OK and the links in \a links or an error when one of
+ *	the links could not be made, in which case no links are made.
+ *	At most \ref PW_LINK_MAX_GROUP links can be made at once. */
+int
+pw_link_new_group(struct pw_core *core,		/**< the core object */
+		  uint32_t n_links,			/**< number of links */
+		  struct pw_port **outputs,		/**< \a n_links output ports */
+		  struct pw_port **inputs,		/**< \a n_links input ports */
+		  struct spa_format *format_filter,	/**< an optional format filter */
+		  struct pw_properties *properties,	/**< extra properties, copied
+							  *  to each link */
+		  char **error,				/**< error string on error */
+		  size_t user_data_size,		/**< extra user data size */
+		  struct pw_link **links		/**< \a n_links result links */);
+
 /** Destroy a link \memberof pw_link */
 void pw_link_destroy(struct pw_link *link);
 
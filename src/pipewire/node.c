@@ -349,6 +349,7 @@ void pw_node_register(struct pw_node *this,
 					  node_bind_func, this);
 
 	this->info.id = this->global->id;
+	pw_core_invalidate_node_index(core, this);
 	spa_hook_list_call(&this->listener_list, struct pw_node_events, initialized);
 
 	pw_node_update_state(this, PW_NODE_STATE_SUSPENDED, NULL);
@@ -399,7 +400,10 @@ struct pw_node *pw_node_new(struct pw_core *core,
 	spa_list_init(&this->output_ports);
 	pw_map_init(&this->output_port_map, 64, 64);
 
+	spa_list_init(&this->index.entries);
+
 	spa_graph_node_init(&this->rt.node);
+	this->rt.node.scheduler_data = this;
 
 	return this;
 
@@ -443,6 +447,9 @@ void pw_node_update_properties(struct pw_node *node, const struct spa_dict *dict
 
 	node->info.props = &node->properties->dict;
 
+	/* priority and media class might have changed */
+	pw_core_invalidate_node_index(node->core, node);
+
 	node->info.change_mask = PW_NODE_CHANGE_MASK_PROPS;
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, info_changed, &node->info);
 
@@ -473,18 +480,47 @@ static void node_event(void *data, struct spa_event *event)
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, event, event);
 }
 
+static void profile_cycle(struct pw_node *node, uint64_t start, uint32_t flags)
+{
+	struct pw_profiler_record rec;
+
+	rec.id = node->info.id;
+	rec.flags = PW_PROFILER_RECORD_FLAG_CYCLE | flags;
+	rec.status = node->rt.node.state;
+	rec.padding = 0;
+	rec.start = start;
+	rec.end = pw_profiler_now();
+	pw_profiler_area_write(pw_profiler_get_area(node->core->profiler), &rec);
+}
+
 static void node_need_input(void *data)
 {
 	struct pw_node *node = data;
+	uint64_t start = 0;
+
+	if (node->core->profiler)
+		start = pw_profiler_now();
+
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, need_input);
 	spa_graph_need_input(node->rt.graph, &node->rt.node);
+
+	if (node->core->profiler)
+		profile_cycle(node, start, PW_PROFILER_RECORD_FLAG_INPUT);
 }
 
 static void node_have_output(void *data)
 {
 	struct pw_node *node = data;
+	uint64_t start = 0;
+
+	if (node->core->profiler)
+		start = pw_profiler_now();
+
 	spa_graph_have_output(node->rt.graph, &node->rt.node);
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, have_output);
+
+	if (node->core->profiler)
+		profile_cycle(node, start, 0);
 }
 
 static void node_reuse_buffer(void *data, uint32_t port_id, uint32_t buffer_id)
@@ -570,6 +606,7 @@ void pw_node_destroy(struct pw_node *node)
 	pw_loop_invoke(node->data_loop, do_node_remove, 1, 0, NULL, true, node);
 
 	if (node->global) {
+		pw_core_remove_node_index(node->core, node);
 		spa_list_remove(&node->link);
 		pw_global_destroy(node->global);
 		node->global = NULL;
@@ -660,18 +697,15 @@ struct pw_port *pw_node_get_free_port(struct pw_node *node, enum pw_direction di
 	uint32_t n_ports, max_ports;
 	struct spa_list *ports;
 	struct pw_port *port = NULL, *p, *mixport = NULL;
-	struct pw_map *portmap;
 
 	if (direction == PW_DIRECTION_INPUT) {
 		max_ports = node->info.max_input_ports;
 		n_ports = node->info.n_input_ports;
 		ports = &node->input_ports;
-		portmap = &node->input_port_map;
 	} else {
 		max_ports = node->info.max_output_ports;
 		n_ports = node->info.n_output_ports;
 		ports = &node->output_ports;
-		portmap = &node->output_port_map;
 	}
 
 	pw_log_debug("node %p: direction %d max %u, n %u", node, direction, max_ports, n_ports);
@@ -687,23 +721,46 @@ struct pw_port *pw_node_get_free_port(struct pw_node *node, enum pw_direction di
 	}
 
 	/* no port, can we create one ? */
-	if (n_ports < max_ports) {
-		uint32_t port_id = pw_map_insert_new(portmap, NULL);
-		int res;
+	if (n_ports < max_ports)
+		port = pw_node_new_port(node, direction);
+	else
+		port = mixport;
 
-		pw_log_debug("node %p: creating port direction %d %u", node, direction, port_id);
+	return port;
+}
 
-		if ((res = spa_node_add_port(node->node, direction, port_id)) < 0) {
-			pw_log_error("node %p: could not add port %d %d", node, port_id, res);
-			goto no_mem;
-		}
-		port = pw_port_new(direction, port_id, NULL, 0);
-		if (port == NULL)
-			goto no_mem;
-		pw_port_add(port, node);
+struct pw_port *pw_node_new_port(struct pw_node *node, enum pw_direction direction)
+{
+	struct pw_port *port;
+	struct pw_map *portmap;
+	uint32_t port_id, n_ports, max_ports;
+	int res;
+
+	if (direction == PW_DIRECTION_INPUT) {
+		max_ports = node->info.max_input_ports;
+		n_ports = node->info.n_input_ports;
+		portmap = &node->input_port_map;
 	} else {
-		port = mixport;
+		max_ports = node->info.max_output_ports;
+		n_ports = node->info.n_output_ports;
+		portmap = &node->output_port_map;
+	}
+	if (n_ports >= max_ports)
+		return NULL;
+
+	port_id = pw_map_insert_new(portmap, NULL);
+
+	pw_log_debug("node %p: creating port direction %d %u", node, direction, port_id);
+
+	if ((res = spa_node_add_port(node->node, direction, port_id)) < 0) {
+		pw_log_error("node %p: could not add port %d %d", node, port_id, res);
+		goto no_mem;
 	}
+	port = pw_port_new(direction, port_id, NULL, 0);
+	if (port == NULL)
+		goto no_mem;
+	pw_port_add(port, node);
+
 	return port;
 
       no_mem:
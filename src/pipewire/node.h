@@ -90,6 +90,9 @@ struct pw_node_events {
 #define PW_NODE_PROP_AUTOCONNECT	"pipewire.autoconnect"
 /** Try to connect the node to this node id */
 #define PW_NODE_PROP_TARGET_NODE	"pipewire.target.node"
+/** The priority of the node when looking for a node to connect to, integer,
+ * higher values are preferred, default 0 */
+#define PW_NODE_PROP_PRIORITY		"pipewire.priority"
 
 /** Create a new node \memberof pw_node */
 struct pw_node *
@@ -38,6 +38,7 @@ extern "C" {
 #include <pipewire/factory.h>
 #include <pipewire/node.h>
 #include <pipewire/port.h>
+#include <pipewire/profiler.h>
 #include <pipewire/properties.h>
 #include <pipewire/proxy.h>
 #include <pipewire/remote.h>
@@ -285,10 +285,104 @@ bool pw_port_add(struct pw_port *port, struct pw_node *node)
 	if (port->state <= PW_PORT_STATE_INIT)
 		port_update_state(port, PW_PORT_STATE_CONFIGURE);
 
+	pw_core_invalidate_node_index(node->core, node);
+
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, port_added, port);
 	return true;
 }
 
+static void clear_formats(struct pw_port *port)
+{
+	uint32_t i;
+
+	for (i = 0; i < port->formats.n_formats; i++)
+		free(port->formats.formats[i]);
+	free(port->formats.formats);
+	port->formats.formats = NULL;
+	port->formats.n_formats = 0;
+	port->formats.generation = 0;
+}
+
+/* the formats of a port can depend on the formats of the other ports
+ * of the node, collect them again for all ports */
+static void invalidate_formats(struct pw_node *node)
+{
+	struct pw_port *p;
+
+	spa_list_for_each(p, &node->input_ports, link)
+		clear_formats(p);
+	spa_list_for_each(p, &node->output_ports, link)
+		clear_formats(p);
+
+	pw_core_invalidate_node_index(node->core, node);
+}
+
+/** Mark the collected formats of a port as outdated
+ * \param port a port
+ *
+ * The formats of all ports of the node are collected again and get a new
+ * generation the next time they are needed, so that the negotiated formats
+ * cached for the old generation are not used anymore. Call this when the
+ * possible formats of a port change.
+ *
+ * \memberof pw_port
+ */
+void pw_port_invalidate_formats(struct pw_port *port)
+{
+	invalidate_formats(port->node);
+}
+
+/** Collect all formats of a port
+ * \param port a port
+ * \return 0 on success, < 0 on error
+ *
+ * Enumerate all formats of \a port without a filter and keep a copy of
+ * them. The formats get a new unique generation that can be used to
+ * identify them. The formats are kept until a format is set on one of
+ * the ports of the node.
+ *
+ * \memberof pw_port
+ */
+int pw_port_collect_formats(struct pw_port *port)
+{
+	struct pw_core *core = port->node->core;
+	struct spa_format *format, **formats;
+	uint32_t i;
+	int res;
+
+	if (port->formats.generation != 0)
+		return SPA_RESULT_OK;
+
+	for (i = 0;; i++) {
+		if ((res = spa_node_port_enum_formats(port->node->node,
+						      port->direction, port->port_id,
+						      &format, NULL, i)) < 0) {
+			if (res == SPA_RESULT_ENUM_END)
+				break;
+			pw_log_error("port %p: error enum formats: %d", port, res);
+			clear_formats(port);
+			return res;
+		}
+		formats = realloc(port->formats.formats, (i + 1) * sizeof(struct spa_format *));
+		if (formats == NULL) {
+			clear_formats(port);
+			return SPA_RESULT_NO_MEMORY;
+		}
+		port->formats.formats = formats;
+		port->formats.formats[i] = spa_format_copy(format);
+		port->formats.n_formats = i + 1;
+	}
+
+	if (++core->format_generation == 0)
+		++core->format_generation;
+	port->formats.generation = core->format_generation;
+
+	pw_log_debug("port %p: collected %d formats, generation %u", port,
+		     port->formats.n_formats, port->formats.generation);
+
+	return SPA_RESULT_OK;
+}
+
 static int do_remove_port(struct spa_loop *loop,
 			  bool async, uint32_t seq, size_t size, const void *data, void *user_data)
 {
@@ -327,6 +421,7 @@ void pw_port_destroy(struct pw_port *port)
 			node->info.n_output_ports--;
 		}
 		spa_list_remove(&port->link);
+		pw_core_invalidate_node_index(node->core, node);
 		spa_hook_list_call(&node->listener_list, struct pw_node_events, port_removed, port);
 	}
 
@@ -338,6 +433,8 @@ void pw_port_destroy(struct pw_port *port)
 		pw_memblock_free(&port->buffer_mem);
 	}
 
+	clear_formats(port);
+
 	if (port->properties)
 		pw_properties_free(port->properties);
 
@@ -361,6 +458,8 @@ int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_fo
 	res = spa_node_port_set_format(port->node->node, port->direction, port->port_id, flags, format);
 	pw_log_debug("port %p: set format %d", port, res);
 
+	invalidate_formats(port->node);
+
 	if (!SPA_RESULT_IS_ASYNC(res)) {
 		if (format == NULL) {
 			if (port->allocated) {
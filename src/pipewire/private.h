@@ -29,6 +29,7 @@ extern "C" {
 #include <sys/socket.h>
 
 #include "pipewire/mem.h"
+#include "pipewire/profiler.h"
 #include "pipewire/pipewire.h"
 #include "pipewire/introspect.h"
 
@@ -82,6 +83,8 @@ struct pw_client {
 
 	struct spa_list resource_list;	/**< The list of resources of this client */
 
+	struct pw_array permissions;	/**< cached permissions of the globals, by id */
+
 	bool busy;
 
 	struct spa_hook_list listener_list;
@@ -100,6 +103,8 @@ struct pw_global {
 	struct spa_list link;		/**< link in core list of globals */
 	uint32_t id;			/**< server id of the object */
 	struct pw_global *parent;	/**< parent global */
+	uint32_t serial;		/**< changes when the permissions of the global
+					  *  need to be evaluated again */
 
 	uint32_t type;			/**< type of interface */
 	uint32_t version;		/**< version of interface */
@@ -119,6 +124,7 @@ struct pw_core {
 
 	pw_permission_func_t permission_func;	/**< get permissions of an object */
 	void *permission_data;			/**< data passed to permission function */
+	uint32_t permission_serial;		/**< last serial of a global */
 
 	struct pw_map globals;			/**< map of globals */
 
@@ -142,6 +148,23 @@ struct pw_core {
 	struct spa_support support[4];	/**< support for spa plugins */
 	uint32_t n_support;		/**< number of support items */
 
+	struct pw_profiler *profiler;	/**< graph profiler, NULL when disabled */
+
+	uint32_t format_generation;	/**< last generation of collected port formats */
+#define PW_CORE_FORMAT_CACHE_SIZE	256
+	struct {
+		uint32_t output;		/**< format generation of the output port */
+		uint32_t input;			/**< format generation of the input port */
+		struct spa_format *format;	/**< common format, NULL when incompatible */
+	} format_cache[PW_CORE_FORMAT_CACHE_SIZE];	/**< negotiated formats */
+
+#define PW_CORE_NODE_INDEX_SIZE	16
+	struct spa_list node_index[2][PW_CORE_NODE_INDEX_SIZE];	/**< nodes by direction and
+								  *  media type */
+	struct spa_list node_index_dirty;	/**< nodes with outdated index entries */
+	uint32_t node_index_seq;		/**< sequence number of indexed nodes */
+	uint32_t node_index_stamp;		/**< stamp of the last lookup */
+
 	struct {
 		struct spa_graph graph;
 	} rt;
@@ -246,6 +269,15 @@ struct pw_node {
 
 	struct pw_loop *data_loop;		/**< the data loop for this node */
 
+	struct {
+		struct spa_list entries;	/**< entries in the core node index */
+		struct spa_list dirty_link;	/**< link in core dirty list */
+		bool dirty;			/**< entries need to be updated */
+		int32_t priority;		/**< priority when looking up nodes */
+		uint32_t seq;			/**< sequence number, newer nodes are higher */
+		uint32_t stamp;			/**< stamp of the last lookup */
+	} index;
+
 	struct {
 		struct spa_graph *graph;
 		struct spa_graph_node node;
@@ -278,6 +310,13 @@ struct pw_port {
 
 	struct spa_node *mix;		/**< optional port buffer mix/split */
 
+	struct {
+		uint32_t generation;		/**< unique generation of the formats,
+						  *  0 when not collected */
+		struct spa_format **formats;	/**< copy of all port formats */
+		uint32_t n_formats;		/**< number of formats */
+	} formats;				/**< formats used for negotiation */
+
 	struct {
 		struct spa_graph *graph;
 		struct spa_graph_port port;	/**< this graph port, linked to mix_port */
@@ -401,6 +440,18 @@ bool pw_port_add(struct pw_port *port, struct pw_node *node);
 /** Destroy a port \memberof pw_port */
 void pw_port_destroy(struct pw_port *port);
 
+/** Mark the index entries of a node as outdated \memberof pw_core */
+void pw_core_invalidate_node_index(struct pw_core *core, struct pw_node *node);
+
+/** Remove a node from the index \memberof pw_core */
+void pw_core_remove_node_index(struct pw_core *core, struct pw_node *node);
+
+/** Collect all formats of a port for negotiation \memberof pw_port */
+int pw_port_collect_formats(struct pw_port *port);
+
+/** Drop the collected formats of a port and its node \memberof pw_port */
+void pw_port_invalidate_formats(struct pw_port *port);
+
 /** Set a format on a port \memberof pw_port */
 int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_format *format);
 
@@ -418,6 +469,9 @@ int pw_node_set_state(struct pw_node *node, enum pw_node_state state);
 /** Update the state of the node, mostly used by node implementations */
 void pw_node_update_state(struct pw_node *node, enum pw_node_state state, char *error);
 
+/** Add a new port to \a node, NULL when the node can't have more ports */
+struct pw_port *pw_node_new_port(struct pw_node *node, enum pw_direction direction);
+
 /** Activate a link \memberof pw_link
   * Starts the negotiation of formats and buffers on \a link and then
   * starts data streaming */
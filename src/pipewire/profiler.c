@@ -0,0 +1,189 @@
+/* PipeWire
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pipewire/log.h"
+#include "pipewire/profiler.h"
+
+/** \cond */
+struct pw_profiler {
+	struct pw_core *core;
+	char path[PATH_MAX];
+	struct pw_profiler_area *area;
+	size_t size;
+};
+/** \endcond */
+
+/** Make a new profiler
+ * \param core the core
+ * \param n_records the number of records in the ring, rounded up to a power of 2
+ * \return a new profiler or NULL on error
+ *
+ * The shared memory is created in XDG_RUNTIME_DIR and named after the core.
+ *
+ * \memberof pw_profiler
+ */
+struct pw_profiler *pw_profiler_new(struct pw_core *core, uint32_t n_records)
+{
+	struct pw_profiler *this;
+	const char *runtime_dir;
+	uint32_t n = 1;
+	int fd;
+
+	if ((runtime_dir = getenv("XDG_RUNTIME_DIR")) == NULL) {
+		pw_log_error("profiler: XDG_RUNTIME_DIR not set in the environment");
+		return NULL;
+	}
+
+	this = calloc(1, sizeof(struct pw_profiler));
+	if (this == NULL)
+		return NULL;
+
+	this->core = core;
+
+	while (n < n_records)
+		n <<= 1;
+
+	if (snprintf(this->path, sizeof(this->path), "%s/%s.profiler",
+		     runtime_dir, pw_core_get_info(core)->name) >= (int) sizeof(this->path)) {
+		pw_log_error("profiler %p: path too long", this);
+		goto error;
+	}
+
+	fd = open(this->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		pw_log_error("profiler %p: can't create %s: %m", this, this->path);
+		goto error;
+	}
+
+	this->size = sizeof(struct pw_profiler_area) + n * sizeof(struct pw_profiler_record);
+	if (ftruncate(fd, this->size) < 0) {
+		pw_log_error("profiler %p: can't resize %s: %m", this, this->path);
+		goto error_close;
+	}
+
+	this->area = mmap(NULL, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (this->area == MAP_FAILED) {
+		pw_log_error("profiler %p: can't map %s: %m", this, this->path);
+		goto error_close;
+	}
+	close(fd);
+
+	this->area->n_records = n;
+	this->area->write_index = 0;
+	this->area->version = PW_VERSION_PROFILER;
+	__atomic_store_n(&this->area->magic, PW_PROFILER_MAGIC, __ATOMIC_RELEASE);
+
+	pw_log_info("profiler %p: %u records in %s", this, n, this->path);
+
+	return this;
+
+      error_close:
+	close(fd);
+	unlink(this->path);
+      error:
+	free(this);
+	return NULL;
+}
+
+/** Destroy a profiler
+ * \param profiler the profiler to destroy
+ *
+ * The data loop should not use the profiler anymore.
+ *
+ * \memberof pw_profiler
+ */
+void pw_profiler_destroy(struct pw_profiler *profiler)
+{
+	pw_log_debug("profiler %p: destroy", profiler);
+
+	munmap(profiler->area, profiler->size);
+	unlink(profiler->path);
+	free(profiler);
+}
+
+const char *pw_profiler_get_path(struct pw_profiler *profiler)
+{
+	return profiler->path;
+}
+
+struct pw_profiler_area *pw_profiler_get_area(struct pw_profiler *profiler)
+{
+	return profiler->area;
+}
+
+/** Map a profiler area
+ * \param path the path of the area, as found in the core properties
+ * \param[out] size the size of the mapping
+ * \return the area mapped read-only or NULL on error
+ *
+ * \memberof pw_profiler
+ */
+struct pw_profiler_area *pw_profiler_area_map(const char *path, size_t *size)
+{
+	struct pw_profiler_area *area;
+	struct stat st;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		pw_log_error("profiler: can't open %s: %m", path);
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(struct pw_profiler_area)) {
+		pw_log_error("profiler: invalid area %s", path);
+		goto error;
+	}
+
+	area = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (area == MAP_FAILED) {
+		pw_log_error("profiler: can't map %s: %m", path);
+		goto error;
+	}
+	close(fd);
+
+	if (__atomic_load_n(&area->magic, __ATOMIC_ACQUIRE) != PW_PROFILER_MAGIC ||
+	    area->version != PW_VERSION_PROFILER ||
+	    sizeof(struct pw_profiler_area) +
+	    area->n_records * sizeof(struct pw_profiler_record) > (size_t) st.st_size) {
+		pw_log_error("profiler: incompatible area %s", path);
+		munmap(area, st.st_size);
+		return NULL;
+	}
+
+	*size = st.st_size;
+	return area;
+
+      error:
+	close(fd);
+	return NULL;
+}
+
+void pw_profiler_area_unmap(struct pw_profiler_area *area, size_t size)
+{
+	munmap(area, size);
+}
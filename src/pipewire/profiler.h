@@ -0,0 +1,155 @@
+/* PipeWire
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PIPEWIRE_PROFILER_H__
+#define __PIPEWIRE_PROFILER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+#include <spa/defs.h>
+
+/** \class pw_profiler
+ *
+ * PipeWire graph profiler
+ *
+ * When enabled, the data loop writes a \ref pw_profiler_record for each
+ * node it processes and for each complete driver cycle into a ring in
+ * shared memory. The ring is a file in XDG_RUNTIME_DIR, its path is
+ * published in the \ref PW_CORE_PROP_PROFILER_PATH core property so that
+ * other processes can map it read-only and inspect the graph timing.
+ *
+ * There is only one writer, the data loop, and it never waits for
+ * readers. Readers keep their own read index and detect when the writer
+ * has overwritten the records they did not read yet.
+ */
+struct pw_profiler;
+
+#define PW_PROFILER_MAGIC	0x50575046	/* "PWPF" */
+#define PW_VERSION_PROFILER	0
+
+/** A timing record */
+struct pw_profiler_record {
+	uint32_t id;		/**< global id of the node */
+#define PW_PROFILER_RECORD_FLAG_CYCLE	(1 << 0)	/**< record spans a complete cycle
+							  *  started by the node */
+#define PW_PROFILER_RECORD_FLAG_INPUT	(1 << 1)	/**< process_input was called */
+	uint32_t flags;		/**< record flags */
+	int32_t status;		/**< result of the processing */
+	uint32_t padding;
+	uint64_t start;		/**< start time in nanoseconds, CLOCK_MONOTONIC */
+	uint64_t end;		/**< end time in nanoseconds, CLOCK_MONOTONIC */
+};
+
+/** The shared memory layout */
+struct pw_profiler_area {
+	uint32_t magic;		/**< PW_PROFILER_MAGIC */
+	uint32_t version;	/**< PW_VERSION_PROFILER */
+	uint32_t n_records;	/**< number of records, power of 2 */
+	uint32_t write_index;	/**< index of the next record to write */
+	uint64_t padding[6];
+	struct pw_profiler_record records[0];	/**< the records */
+};
+
+/** Get the current time in nanoseconds, used for the record timestamps */
+static inline uint64_t pw_profiler_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/** Append a record to the ring, only to be called from the data loop */
+static inline void
+pw_profiler_area_write(struct pw_profiler_area *area, const struct pw_profiler_record *rec)
+{
+	uint32_t index = area->write_index;
+
+	/* make sure readers see the updated index before the slot changes */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	area->records[index & (area->n_records - 1)] = *rec;
+	__atomic_store_n(&area->write_index, index + 1, __ATOMIC_RELEASE);
+}
+
+/** Read the record at \a index
+ * \param area a profiler area
+ * \param[in,out] index the read index, updated after reading
+ * \param[out] rec the record
+ * \return 1 when a record was read, 0 when there are no new records and
+ *	SPA_RESULT_ERROR when the writer overwrote unread records. \a index
+ *	is then moved to the oldest record that is still available.
+ */
+static inline int
+pw_profiler_area_read(struct pw_profiler_area *area, uint32_t *index, struct pw_profiler_record *rec)
+{
+	uint32_t windex = __atomic_load_n(&area->write_index, __ATOMIC_ACQUIRE);
+	int32_t avail = (int32_t) (windex - *index);
+
+	if (avail <= 0)
+		return 0;
+
+	if (avail < (int32_t) area->n_records) {
+		*rec = area->records[*index & (area->n_records - 1)];
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		windex = __atomic_load_n(&area->write_index, __ATOMIC_RELAXED);
+		if ((int32_t) (windex - *index) < (int32_t) area->n_records) {
+			(*index)++;
+			return 1;
+		}
+	}
+	/* leave one slot for the writer */
+	*index = windex - area->n_records + 1;
+	return SPA_RESULT_ERROR;
+}
+
+#include <pipewire/core.h>
+
+/** Make a new profiler for \a core with room for \a n_records records */
+struct pw_profiler *
+pw_profiler_new(struct pw_core *core, uint32_t n_records);
+
+/** Destroy a profiler and remove its shared memory */
+void pw_profiler_destroy(struct pw_profiler *profiler);
+
+/** Get the path of the shared memory of \a profiler */
+const char *pw_profiler_get_path(struct pw_profiler *profiler);
+
+/** Get the shared memory of \a profiler */
+struct pw_profiler_area *pw_profiler_get_area(struct pw_profiler *profiler);
+
+/** Map the profiler area at \a path read-only
+ * \param path the path of the profiler area
+ * \param[out] size the size of the mapped area
+ * \return the mapped area or NULL on error
+ */
+struct pw_profiler_area *pw_profiler_area_map(const char *path, size_t *size);
+
+/** Unmap an area mapped with \ref pw_profiler_area_map */
+void pw_profiler_area_unmap(struct pw_profiler_area *area, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PIPEWIRE_PROFILER_H__ */
@@ -21,9 +21,11 @@
 #include <sys/socket.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/eventfd.h>
 #include <errno.h>
 #include <time.h>
 
+#include "spa/ringbuffer.h"
 #include "spa/lib/debug.h"
 
 #include "pipewire/pipewire.h"
@@ -41,6 +43,7 @@
 #define MAX_FDS         32
 #define MAX_INPUTS      64
 #define MAX_OUTPUTS     64
+#define MAX_QUEUED      64	/* power of 2 */
 
 struct mem_id {
 	uint32_t id;
@@ -59,6 +62,12 @@ struct buffer_id {
 	struct spa_buffer *buf;
 };
 
+/* a single producer, single consumer queue of buffer ids */
+struct queue {
+	struct spa_ringbuffer ring;
+	uint32_t ids[MAX_QUEUED];
+};
+
 struct stream {
 	struct pw_stream this;
 
@@ -97,12 +106,76 @@ struct stream {
 	struct spa_list free;
 	bool in_need_buffer;
 
+	bool clock_update;		/**< request periodic clock updates */
+	bool use_queue;			/**< buffers are exchanged with the queues */
+	bool timestamp;			/**< stamp output buffers with the send time */
+	struct queue dequeue;		/**< buffers for the application, filled
+					  *  from the data loop */
+	struct queue queued;		/**< buffers from the application, emptied
+					  *  from the data loop */
+	int queue_fd;			/**< readable when a buffer can be dequeued */
+	int queued_fd;			/**< written when the application queues a buffer,
+					  *  lives as long as the stream */
+	struct spa_source *queue_source;	/**< watches queued_fd in the data loop */
+
+	struct spa_meta_ringbuffer *rb;	/**< the ringbuffer in PW_STREAM_MODE_RINGBUFFER */
+	void *rb_data;			/**< the memory of the ringbuffer */
+	uint64_t underrun;		/**< bytes pw_stream_read() could not read */
+	uint64_t overrun;		/**< bytes pw_stream_write() could not write */
+	uint32_t rb_id;			/**< the buffer with the ringbuffer */
+	bool rb_sent;			/**< the server has the ringbuffer */
+
 	int64_t last_ticks;
 	int32_t last_rate;
 	int64_t last_monotonic;
 };
 /** \endcond */
 
+static inline void queue_init(struct queue *q)
+{
+	spa_ringbuffer_init(&q->ring, MAX_QUEUED);
+}
+
+static inline bool queue_push(struct queue *q, uint32_t id)
+{
+	uint32_t index;
+
+	if (spa_ringbuffer_get_write_index(&q->ring, &index) >= MAX_QUEUED)
+		return false;
+
+	q->ids[index & q->ring.mask] = id;
+	spa_ringbuffer_write_update(&q->ring, index + 1);
+	return true;
+}
+
+static inline uint32_t queue_pop(struct queue *q)
+{
+	uint32_t index, id;
+
+	if (spa_ringbuffer_get_read_index(&q->ring, &index) < 1)
+		return SPA_ID_INVALID;
+
+	id = q->ids[index & q->ring.mask];
+	spa_ringbuffer_read_update(&q->ring, index + 1);
+	return id;
+}
+
+static void *map_mem(struct stream *impl, struct mem_id *mid)
+{
+	if (mid->ptr == NULL) {
+		mid->ptr =
+		    mmap(NULL, mid->size + mid->offset, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 mid->fd, 0);
+		if (mid->ptr == MAP_FAILED) {
+			mid->ptr = NULL;
+			pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
+				    strerror(errno));
+			return NULL;
+		}
+	}
+	return SPA_MEMBER(mid->ptr, mid->offset, void);
+}
+
 static void clear_memid(struct stream *impl, struct mem_id *mid)
 {
 	if (mid->ptr != NULL)
@@ -136,22 +209,49 @@ static void clear_mems(struct pw_stream *stream)
 	impl->mem_ids.size = 0;
 }
 
+/* forget the buffers in the data loop so that it does not use them
+ * while they are freed */
+static int
+do_clear_buffers(struct spa_loop *loop,
+		 bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct stream *impl = user_data;
+
+	impl->buffer_ids.size = 0;
+	impl->in_order = true;
+	spa_list_init(&impl->free);
+	queue_init(&impl->dequeue);
+	queue_init(&impl->queued);
+	impl->rb = NULL;
+	impl->rb_data = NULL;
+	impl->rb_sent = false;
+	impl->underrun = 0;
+	impl->overrun = 0;
+
+	return SPA_RESULT_OK;
+}
+
 static void clear_buffers(struct pw_stream *stream)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	struct buffer_id *bid;
+	struct buffer_id *bids = impl->buffer_ids.data;
+	uint32_t i, n_bids = pw_array_get_len(&impl->buffer_ids, struct buffer_id);
 
 	pw_log_debug("stream %p: clear buffers", stream);
 
-	pw_array_for_each(bid, &impl->buffer_ids) {
-		spa_hook_list_call(&stream->listener_list, struct pw_stream_events, remove_buffer, bid->id);
-		free(bid->buf);
-		bid->buf = NULL;
-		bid->used = false;
+	/* the application stops using the buffers when they are removed */
+	for (i = 0; i < n_bids; i++)
+		spa_hook_list_call(&stream->listener_list, struct pw_stream_events,
+				   remove_buffer, bids[i].id);
+
+	pw_loop_invoke(stream->remote->core->data_loop,
+		       do_clear_buffers, SPA_ID_INVALID, 0, NULL, true, impl);
+
+	for (i = 0; i < n_bids; i++) {
+		free(bids[i].buf);
+		bids[i].buf = NULL;
+		bids[i].used = false;
 	}
-	impl->buffer_ids.size = 0;
-	impl->in_order = true;
-	spa_list_init(&impl->free);
 }
 
 static bool stream_set_state(struct pw_stream *stream, enum pw_stream_state state, char *error)
@@ -222,6 +322,8 @@ struct pw_stream *pw_stream_new(struct pw_remote *remote,
 	this->name = strdup(name);
 	impl->type_client_node = spa_type_map_get_id(remote->core->type.map, PW_TYPE_INTERFACE__ClientNode);
 	impl->rtwritefd = -1;
+	impl->queue_fd = -1;
+	impl->queued_fd = -1;
 
 	spa_hook_list_init(&this->listener_list);
 
@@ -233,6 +335,8 @@ struct pw_stream *pw_stream_new(struct pw_remote *remote,
 	pw_array_ensure_size(&impl->buffer_ids, sizeof(struct buffer_id) * 64);
 	impl->pending_seq = SPA_ID_INVALID;
 	spa_list_init(&impl->free);
+	queue_init(&impl->dequeue);
+	queue_init(&impl->queued);
 
 	spa_list_insert(&remote->stream_list, &this->link);
 
@@ -279,9 +383,9 @@ do_remove_sources(struct spa_loop *loop,
 		pw_loop_destroy_source(stream->remote->core->data_loop, impl->rtsocket_source);
 		impl->rtsocket_source = NULL;
 	}
-	if (impl->timeout_source) {
-		pw_loop_destroy_source(stream->remote->core->data_loop, impl->timeout_source);
-		impl->timeout_source = NULL;
+	if (impl->queue_source) {
+		pw_loop_destroy_source(stream->remote->core->data_loop, impl->queue_source);
+		impl->queue_source = NULL;
 	}
 	if (impl->rtwritefd != -1) {
 		close(impl->rtwritefd);
@@ -296,6 +400,12 @@ static void unhandle_socket(struct pw_stream *stream)
 
         pw_loop_invoke(stream->remote->core->data_loop,
                        do_remove_sources, 1, 0, NULL, true, impl);
+
+	/* the timer is on the main loop */
+	if (impl->timeout_source) {
+		pw_loop_destroy_source(stream->remote->core->main_loop, impl->timeout_source);
+		impl->timeout_source = NULL;
+	}
 }
 
 static void
@@ -368,6 +478,11 @@ void pw_stream_destroy(struct pw_stream *stream)
 	clear_mems(stream);
 	pw_array_clear(&impl->mem_ids);
 
+	if (impl->queue_fd != -1)
+		close(impl->queue_fd);
+	if (impl->queued_fd != -1)
+		close(impl->queued_fd);
+
 	if (stream->properties)
 		pw_properties_free(stream->properties);
 
@@ -496,11 +611,141 @@ static struct buffer_id *find_buffer(struct pw_stream *stream, uint32_t id)
 	return NULL;
 }
 
+static inline void signal_queue(struct stream *impl)
+{
+	uint64_t cmd = 1;
+
+	if (write(impl->queue_fd, &cmd, sizeof(uint64_t)) != sizeof(uint64_t))
+		pw_log_warn("stream %p: write failed %m", impl);
+}
+
+/* wake up the data loop for the queued buffers, from any thread */
+static inline void signal_queued(struct stream *impl)
+{
+	uint64_t cmd = 1;
+
+	if (write(impl->queued_fd, &cmd, sizeof(uint64_t)) != sizeof(uint64_t))
+		pw_log_warn("stream %p: write failed %m", impl);
+}
+
+/* give a buffer to the application thread, from the data loop */
+static inline void dequeue_buffer(struct stream *impl, uint32_t id)
+{
+	pw_log_trace("stream %p: dequeue buffer %u", impl, id);
+	if (!queue_push(&impl->dequeue, id))
+		pw_log_warn("stream %p: can't dequeue buffer %u", impl, id);
+}
+
+static void send_reuse_buffer(struct pw_stream *stream, uint32_t id)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct pw_client_node_message_reuse_buffer rb = PW_CLIENT_NODE_MESSAGE_REUSE_BUFFER_INIT
+	    (impl->port_id, id);
+
+	pw_client_node_transport_add_message(impl->trans, (struct pw_client_node_message *) &rb);
+}
+
+static void stamp_buffer(struct pw_stream *stream, uint32_t id)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct buffer_id *bid;
+	struct spa_meta_header *h;
+	struct timespec ts;
+
+	if (!impl->timestamp || (bid = find_buffer(stream, id)) == NULL)
+		return;
+
+	if ((h = spa_buffer_find_meta(bid->buf, stream->remote->core->type.meta.Header))) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		h->pts = SPA_TIMESPEC_TO_TIME(&ts);
+	}
+}
+
+/* place the next queued buffer in the output when it is free */
+static bool output_queued_buffer(struct pw_stream *stream)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct spa_port_io *output = &impl->trans->outputs[0];
+	uint32_t id;
+
+	if (output->buffer_id != SPA_ID_INVALID)
+		return false;
+
+	do {
+		if ((id = queue_pop(&impl->queued)) == SPA_ID_INVALID)
+			return false;
+	} while (find_buffer(stream, id) == NULL);
+
+	pw_log_trace("stream %p: send queued buffer %u", stream, id);
+	stamp_buffer(stream, id);
+	output->buffer_id = id;
+	output->status = SPA_RESULT_HAVE_BUFFER;
+	return true;
+}
+
+static void on_queued(void *data, int fd, enum spa_io mask)
+{
+	struct pw_stream *stream = data;
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	uint64_t cmd = 1, count;
+	uint32_t id;
+	bool have_reuse = false;
+
+	if (read(fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+		pw_log_warn("stream %p: read failed %m", stream);
+
+	if (impl->trans == NULL)
+		return;
+
+	if (impl->direction == SPA_DIRECTION_INPUT) {
+		while ((id = queue_pop(&impl->queued)) != SPA_ID_INVALID) {
+			if (find_buffer(stream, id) == NULL)
+				continue;
+			send_reuse_buffer(stream, id);
+			have_reuse = true;
+		}
+		if (have_reuse)
+			write(impl->rtwritefd, &cmd, 8);
+	} else if (stream->state == PW_STREAM_STATE_STREAMING &&
+		   output_queued_buffer(stream)) {
+		send_have_output(stream);
+	}
+}
+
+/* place the ringbuffer on the output once, the server keeps it */
+static bool output_ringbuffer(struct pw_stream *stream)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct spa_port_io *output = &impl->trans->outputs[0];
+
+	if (impl->rb == NULL || impl->rb_sent || output->buffer_id != SPA_ID_INVALID)
+		return false;
+
+	pw_log_trace("stream %p: send ringbuffer %u", stream, impl->rb_id);
+	output->buffer_id = impl->rb_id;
+	output->status = SPA_RESULT_HAVE_BUFFER;
+	impl->rb_sent = true;
+	return true;
+}
+
 static inline void reuse_buffer(struct pw_stream *stream, uint32_t id)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
 	struct buffer_id *bid;
 
+	if (impl->rb && id == impl->rb_id) {
+		impl->rb_sent = false;
+		return;
+	}
+
+	if (impl->use_queue) {
+		if (find_buffer(stream, id)) {
+			dequeue_buffer(impl, id);
+			signal_queue(impl);
+		}
+		return;
+	}
+
 	if ((bid = find_buffer(stream, id)) && bid->used) {
 		pw_log_trace("stream %p: reuse buffer %u", stream, id);
 		bid->used = false;
@@ -515,6 +760,8 @@ static void handle_rtnode_message(struct pw_stream *stream, struct pw_client_nod
 
 	if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT) {
 		int i;
+		bool have_buffer = false, have_reuse = false;
+		uint64_t cmd = 1;
 
 		for (i = 0; i < impl->trans->area->n_input_ports; i++) {
 			struct spa_port_io *input = &impl->trans->inputs[i];
@@ -524,10 +771,25 @@ static void handle_rtnode_message(struct pw_stream *stream, struct pw_client_nod
 			if (input->buffer_id == SPA_ID_INVALID)
 				continue;
 
-			spa_hook_list_call(&stream->listener_list, struct pw_stream_events,
-					 new_buffer, input->buffer_id);
+			if (impl->mode == PW_STREAM_MODE_RINGBUFFER) {
+				/* the data is read with pw_stream_read(), give the
+				 * buffer back every cycle so that the server can
+				 * write more */
+				send_reuse_buffer(stream, input->buffer_id);
+				have_reuse = true;
+			} else if (impl->use_queue) {
+				dequeue_buffer(impl, input->buffer_id);
+				have_buffer = true;
+			} else {
+				spa_hook_list_call(&stream->listener_list, struct pw_stream_events,
+						 new_buffer, input->buffer_id);
+			}
 			input->buffer_id = SPA_ID_INVALID;
 		}
+		if (have_buffer)
+			signal_queue(impl);
+		if (have_reuse)
+			write(impl->rtwritefd, &cmd, 8);
 		send_need_input(stream);
 	} else if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT) {
 		int i;
@@ -542,9 +804,17 @@ static void handle_rtnode_message(struct pw_stream *stream, struct pw_client_nod
 			output->buffer_id = SPA_ID_INVALID;
 		}
 		pw_log_trace("stream %p: process output", stream);
-		impl->in_need_buffer = true;
-		spa_hook_list_call(&stream->listener_list, struct pw_stream_events, need_buffer);
-		impl->in_need_buffer = false;
+		if (impl->mode == PW_STREAM_MODE_RINGBUFFER) {
+			output_ringbuffer(stream);
+		} else if (impl->use_queue) {
+			/* nobody pulls from the client again, push the next buffer */
+			if (output_queued_buffer(stream))
+				send_have_output(stream);
+		} else {
+			impl->in_need_buffer = true;
+			spa_hook_list_call(&stream->listener_list, struct pw_stream_events, need_buffer);
+			impl->in_need_buffer = false;
+		}
 	} else if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_REUSE_BUFFER) {
 		struct pw_client_node_message_reuse_buffer *p =
 		    (struct pw_client_node_message_reuse_buffer *) message;
@@ -568,7 +838,9 @@ on_rtsocket_condition(void *data, int fd, enum spa_io mask)
 
 	if (mask & (SPA_IO_ERR | SPA_IO_HUP)) {
 		pw_log_warn("got error");
-		unhandle_socket(stream);
+		/* we are in the data loop, the main loop timer is removed
+		 * when the stream is disconnected */
+		do_remove_sources(NULL, false, 0, 0, NULL, impl);
 		return;
 	}
 
@@ -598,10 +870,21 @@ static void handle_socket(struct pw_stream *stream, int rtreadfd, int rtwritefd)
 					       SPA_IO_ERR | SPA_IO_HUP,
 					       true, on_rtsocket_condition, stream);
 
-	impl->timeout_source = pw_loop_add_timer(stream->remote->core->main_loop, on_timeout, stream);
-	interval.tv_sec = 0;
-	interval.tv_nsec = 100000000;
-	pw_loop_update_timer(stream->remote->core->main_loop, impl->timeout_source, NULL, &interval, false);
+	if (impl->use_queue)
+		impl->queue_source = pw_loop_add_io(stream->remote->core->data_loop,
+						    impl->queued_fd, SPA_IO_IN,
+						    false, on_queued, stream);
+
+	/* the position in the transport area is updated every cycle, only
+	 * ask for clock updates when they were requested */
+	if (impl->clock_update) {
+		impl->timeout_source = pw_loop_add_timer(stream->remote->core->main_loop,
+							 on_timeout, stream);
+		interval.tv_sec = 0;
+		interval.tv_nsec = 100000000;
+		pw_loop_update_timer(stream->remote->core->main_loop, impl->timeout_source,
+				     NULL, &interval, false);
+	}
 	return;
 }
 
@@ -634,13 +917,20 @@ handle_node_command(struct pw_stream *stream, uint32_t seq, const struct spa_com
 
 			if (impl->direction == SPA_DIRECTION_INPUT)
 				send_need_input(stream);
-			else {
+			else if (impl->mode == PW_STREAM_MODE_RINGBUFFER) {
+				if (output_ringbuffer(stream))
+					send_have_output(stream);
+			} else if (!impl->use_queue) {
 				impl->in_need_buffer = true;
 				spa_hook_list_call(&stream->listener_list, struct pw_stream_events,
 						    need_buffer);
 				impl->in_need_buffer = false;
 			}
 			stream_set_state(stream, PW_STREAM_STATE_STREAMING, NULL);
+
+			/* the buffers queued while paused can go out now */
+			if (impl->use_queue && impl->direction == SPA_DIRECTION_OUTPUT)
+				signal_queued(impl);
 		}
 	} else if (SPA_COMMAND_TYPE(command) == remote->core->type.command_node.ClockUpdate) {
 		struct spa_command_node_clock_update *cu = (__typeof__(cu)) command;
@@ -771,22 +1061,15 @@ client_node_use_buffers(void *data,
 			continue;
 		}
 
-		if (mid->ptr == NULL) {
-			mid->ptr =
-			    mmap(NULL, mid->size + mid->offset, PROT_READ | PROT_WRITE, MAP_SHARED,
-				 mid->fd, 0);
-			if (mid->ptr == MAP_FAILED) {
-				mid->ptr = NULL;
-				pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
-					    strerror(errno));
-				continue;
-			}
-		}
+		if (map_mem(impl, mid) == NULL)
+			continue;
+
 		len = pw_array_get_len(&impl->buffer_ids, struct buffer_id);
 		bid = pw_array_add(&impl->buffer_ids, sizeof(struct buffer_id));
 		if (impl->direction == SPA_DIRECTION_OUTPUT) {
 			bid->used = false;
-			spa_list_insert(impl->free.prev, &bid->link);
+			if (!impl->use_queue)
+				spa_list_insert(impl->free.prev, &bid->link);
 		} else {
 			bid->used = true;
 		}
@@ -840,6 +1123,9 @@ client_node_use_buffers(void *data,
 				d->type = stream->remote->core->type.data.MemFd;
 				d->data = NULL;
 				d->fd = bmid->fd;
+				/* the ringbuffer is read and written here */
+				if (impl->mode == PW_STREAM_MODE_RINGBUFFER)
+					d->data = map_mem(impl, bmid);
 				pw_log_debug(" data %d %u -> fd %d", j, bmid->id, bmid->fd);
 			} else if (d->type == stream->remote->core->type.data.MemPtr) {
 				d->data = SPA_MEMBER(bid->buf_ptr, SPA_PTR_TO_INT(d->data), void);
@@ -849,8 +1135,23 @@ client_node_use_buffers(void *data,
 				pw_log_warn("unknown buffer data type %d", d->type);
 			}
 		}
+		if (impl->mode == PW_STREAM_MODE_RINGBUFFER && impl->rb == NULL &&
+		    b->n_datas > 0 && b->datas[0].data != NULL) {
+			impl->rb = spa_buffer_find_meta(b, stream->remote->core->type.meta.Ringbuffer);
+			impl->rb_data = b->datas[0].data;
+			impl->rb_id = bid->id;
+			if (impl->rb)
+				pw_log_debug("stream %p: ringbuffer %u of %u bytes", stream,
+					     bid->id, impl->rb->ringbuffer.size);
+		}
+
 		spa_hook_list_call(&stream->listener_list, struct pw_stream_events, add_buffer, bid->id);
+
+		if (impl->use_queue && impl->direction == SPA_DIRECTION_OUTPUT)
+			dequeue_buffer(impl, bid->id);
 	}
+	if (impl->use_queue && impl->direction == SPA_DIRECTION_OUTPUT && n_buffers > 0)
+		signal_queue(impl);
 
 	add_async_complete(stream, seq, SPA_RESULT_OK);
 
@@ -945,6 +1246,18 @@ pw_stream_connect(struct pw_stream *stream,
 	    direction == PW_DIRECTION_INPUT ? SPA_DIRECTION_INPUT : SPA_DIRECTION_OUTPUT;
 	impl->port_id = 0;
 	impl->mode = mode;
+	impl->clock_update = (flags & PW_STREAM_FLAG_CLOCK_UPDATE) != 0;
+	impl->use_queue = (flags & PW_STREAM_FLAG_QUEUE) != 0;
+	impl->timestamp = (flags & PW_STREAM_FLAG_TIMESTAMP) != 0;
+
+	if (impl->use_queue && impl->queue_fd == -1) {
+		impl->queue_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		impl->queued_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (impl->queue_fd == -1 || impl->queued_fd == -1) {
+			pw_log_error("stream %p: can't create queue fd: %m", stream);
+			return false;
+		}
+	}
 
 	set_possible_formats(stream, n_possible_formats, possible_formats);
 
@@ -1024,15 +1337,35 @@ void pw_stream_disconnect(struct pw_stream *stream)
 bool pw_stream_get_time(struct pw_stream *stream, struct pw_time *time)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct pw_client_node_position pos;
 	int64_t elapsed;
 	struct timespec ts;
 
+	/* use the position of the last cycle, or the last clock update when
+	 * the graph did not run yet */
+	if (impl->trans == NULL ||
+	    !pw_client_node_position_read(&impl->trans->area->position, &pos)) {
+		pos.rate = impl->last_rate;
+		pos.ticks = impl->last_ticks;
+		pos.monotonic = impl->last_monotonic;
+	}
+
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	time->now = SPA_TIMESPEC_TO_TIME(&ts);
-	elapsed = (time->now - impl->last_monotonic) / 1000;
+	elapsed = (time->now - pos.monotonic) / 1000;
+
+	time->ticks = pos.ticks + (elapsed * pos.rate) / SPA_USEC_PER_SEC;
+	time->rate = pos.rate;
+
+	if (impl->rb) {
+		uint32_t index;
 
-	time->ticks = impl->last_ticks + (elapsed * impl->last_rate) / SPA_USEC_PER_SEC;
-	time->rate = impl->last_rate;
+		time->queued = spa_ringbuffer_get_read_index(&impl->rb->ringbuffer, &index);
+	} else {
+		time->queued = 0;
+	}
+	time->underrun = impl->underrun;
+	time->overrun = impl->overrun;
 
 	return true;
 }
@@ -1053,8 +1386,6 @@ uint32_t pw_stream_get_empty_buffer(struct pw_stream *stream)
 bool pw_stream_recycle_buffer(struct pw_stream *stream, uint32_t id)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	struct pw_client_node_message_reuse_buffer rb = PW_CLIENT_NODE_MESSAGE_REUSE_BUFFER_INIT
-	    (impl->port_id, id);
 	struct buffer_id *bid;
 	uint64_t cmd = 1;
 
@@ -1064,7 +1395,7 @@ bool pw_stream_recycle_buffer(struct pw_stream *stream, uint32_t id)
 	bid->used = false;
 	spa_list_insert(impl->free.prev, &bid->link);
 
-	pw_client_node_transport_add_message(impl->trans, (struct pw_client_node_message *) &rb);
+	send_reuse_buffer(stream, id);
 	write(impl->rtwritefd, &cmd, 8);
 
 	return true;
@@ -1094,6 +1425,7 @@ bool pw_stream_send_buffer(struct pw_stream *stream, uint32_t id)
 	if ((bid = find_buffer(stream, id)) && !bid->used) {
 		bid->used = true;
 		spa_list_remove(&bid->link);
+		stamp_buffer(stream, id);
 		impl->trans->outputs[0].buffer_id = id;
 		impl->trans->outputs[0].status = SPA_RESULT_HAVE_BUFFER;
 		pw_log_trace("stream %p: send buffer %d", stream, id);
@@ -1105,3 +1437,95 @@ bool pw_stream_send_buffer(struct pw_stream *stream, uint32_t id)
 
 	return true;
 }
+
+uint32_t pw_stream_dequeue_buffer(struct pw_stream *stream)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	uint32_t id;
+	uint64_t count;
+
+	if (!impl->use_queue)
+		return SPA_ID_INVALID;
+
+	if ((id = queue_pop(&impl->dequeue)) == SPA_ID_INVALID) {
+		/* clear the fd before looking again so that a buffer that is
+		 * added after this wakes up the next poll */
+		if (read(impl->queue_fd, &count, sizeof(uint64_t)) == sizeof(uint64_t))
+			id = queue_pop(&impl->dequeue);
+	}
+	return id;
+}
+
+bool pw_stream_queue_buffer(struct pw_stream *stream, uint32_t id)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+
+	/* the id is checked in the data loop, the buffers can change there */
+	if (!impl->use_queue || id == SPA_ID_INVALID)
+		return false;
+
+	if (!queue_push(&impl->queued, id)) {
+		pw_log_warn("stream %p: can't queue buffer %u", stream, id);
+		return false;
+	}
+	signal_queued(impl);
+
+	return true;
+}
+
+int pw_stream_get_queue_fd(struct pw_stream *stream)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+
+	return impl->use_queue ? impl->queue_fd : -1;
+}
+
+uint32_t pw_stream_write(struct pw_stream *stream, const void *data, uint32_t size)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct spa_ringbuffer *rb;
+	uint32_t index, avail;
+	int32_t filled;
+
+	if (impl->rb == NULL || impl->direction != SPA_DIRECTION_OUTPUT)
+		return 0;
+
+	rb = &impl->rb->ringbuffer;
+	filled = spa_ringbuffer_get_write_index(rb, &index);
+	avail = rb->size - SPA_CLAMP(filled, 0, (int32_t) rb->size);
+
+	if (avail < size) {
+		pw_log_trace("stream %p: ringbuffer overrun, %u of %u bytes", stream, avail, size);
+		impl->overrun += size - avail;
+		size = avail;
+	}
+	spa_ringbuffer_write_data(rb, impl->rb_data, index & rb->mask, (void *) data, size);
+	spa_ringbuffer_write_update(rb, index + size);
+
+	return size;
+}
+
+uint32_t pw_stream_read(struct pw_stream *stream, void *data, uint32_t size)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct spa_ringbuffer *rb;
+	uint32_t index;
+	int32_t avail;
+
+	if (impl->rb == NULL || impl->direction != SPA_DIRECTION_INPUT)
+		return 0;
+
+	rb = &impl->rb->ringbuffer;
+	avail = SPA_CLAMP(spa_ringbuffer_get_read_index(rb, &index), 0, (int32_t) rb->size);
+
+	if ((uint32_t) avail < size) {
+		pw_log_trace("stream %p: ringbuffer underrun, %d of %u bytes", stream, avail, size);
+		impl->underrun += size - avail;
+		size = avail;
+	}
+
+	spa_ringbuffer_read_data(rb, impl->rb_data, index & rb->mask, data, size);
+	spa_ringbuffer_read_update(rb, index + size);
+
+	return size;
+}
@@ -69,7 +69,12 @@ extern "C" {
  *	frames.
  * \li \ref PW_STREAM_MODE_RINGBUFFER: data is exhanged with a fixed
  *	size ringbuffer. This is ideal for variable sized audio packets
- *	or compressed media.
+ *	or compressed media. The stream must enable the Ringbuffer metadata
+ *	with a MetaEnable param. Data is written with \ref pw_stream_write()
+ *	or read with \ref pw_stream_read() at any time, the server consumes
+ *	or produces one period each cycle without waking up the client.
+ *	\ref pw_stream_get_time() reports the fill level and the underruns
+ *	and overruns of this stream.
  *
  * \subsection ssec_stream_target Stream target
  *
@@ -109,6 +114,12 @@ extern "C" {
  * With the add_buffer event, a stream will be notified of a new buffer
  * that can be used for data transport.
  *
+ * The metadata of the buffers is in the shared memory of the buffers and
+ * is exchanged with the data. Video streams can enable the VideoDamage
+ * metadata with a MetaEnable param so that producers can mark the regions
+ * that changed since the previous frame and consumers only have to
+ * process those.
+ *
  * Afer the buffers are negotiated, the stream will transition to the
  * \ref PW_STREAM_STATE_PAUSED state.
  *
@@ -147,6 +158,22 @@ extern "C" {
  * The new_buffer event is emited when PipeWire no longer uses the buffer
  * and it can be safely reused.
  *
+ * \subsection ssec_queue Exchange buffers from another thread
+ *
+ * The events are emited from the data loop of the remote. A stream that is
+ * connected with \ref PW_STREAM_FLAG_QUEUE does not emit the new_buffer and
+ * need_buffer events. Instead, one application thread gets buffers with
+ * \ref pw_stream_dequeue_buffer() and gives them back with \ref
+ * pw_stream_queue_buffer(). This does not block or take locks. The thread can
+ * wait for buffers by polling the fd of \ref pw_stream_get_queue_fd().
+ *
+ * The buffers change when they are renegotiated. The thread should stop
+ * dequeueing and queueing buffers when the remove_buffer event is emitted and
+ * can continue after the stream is \ref PW_STREAM_STATE_PAUSED again.
+ *
+ * Input streams dequeue filled buffers and queue them when they are consumed.
+ * Output streams dequeue empty buffers and queue them when they are filled.
+ *
  * \section sec_stream_disconnect Disconnect
  *
  * Use \ref pw_stream_disconnect() to disconnect a stream after use.
@@ -213,7 +240,14 @@ enum pw_stream_flags {
 	PW_STREAM_FLAG_AUTOCONNECT = (1 << 0),	/**< try to automatically connect
 						  *  this stream */
 	PW_STREAM_FLAG_CLOCK_UPDATE = (1 << 1),	/**< request periodic clock updates for
-						  *  this stream */
+						  *  this stream, not needed for
+						  *  pw_stream_get_time() */
+	PW_STREAM_FLAG_QUEUE = (1 << 2),	/**< exchange buffers with
+						  *  pw_stream_dequeue_buffer() and
+						  *  pw_stream_queue_buffer() */
+	PW_STREAM_FLAG_TIMESTAMP = (1 << 3),	/**< set the pts of the header metadata
+						  *  of output buffers to the monotonic
+						  *  time they are sent */
 };
 
 /** \enum pw_stream_mode The method for transfering data for a stream \memberof pw_stream */
@@ -227,6 +261,9 @@ struct pw_time {
 	int64_t now;		/**< the monotonic time */
 	int64_t ticks;		/**< the ticks at \a now */
 	int32_t rate;		/**< the rate of \a ticks */
+	int32_t queued;		/**< bytes in the ringbuffer */
+	uint64_t underrun;	/**< bytes \ref pw_stream_read() could not read */
+	uint64_t overrun;	/**< bytes \ref pw_stream_write() could not write */
 };
 
 /** Create a new unconneced \ref pw_stream \memberof pw_stream
@@ -293,7 +330,11 @@ pw_stream_finish_format(struct pw_stream *stream,	/**< a \ref pw_stream */
 			struct spa_param **params,	/**< an array of pointers to \ref spa_param */
 			uint32_t n_params		/**< number of elements in \a params */);
 
-/** Query the time on the stream \memberof pw_stream */
+/** Query the time on the stream \memberof pw_stream
+ *
+ * The time is interpolated from the position of the graph that the server
+ * writes in each cycle, this does not communicate with the server and can
+ * be called from any thread. */
 bool pw_stream_get_time(struct pw_stream *stream, struct pw_time *time);
 
 /** Get the id of an empty buffer that can be filled \memberof pw_stream
@@ -320,6 +361,44 @@ pw_stream_peek_buffer(struct pw_stream *stream, uint32_t id);
  * there is a new buffer available. */
 bool pw_stream_send_buffer(struct pw_stream *stream, uint32_t id);
 
+/** Write \a size bytes of \a data to the ringbuffer of \a stream \memberof pw_stream
+ * \return the number of bytes written, less than \a size when the ringbuffer
+ * is full. The bytes that did not fit are counted as overrun.
+ *
+ * For output streams connected with \ref PW_STREAM_MODE_RINGBUFFER. This can be
+ * called from any one thread at any time. */
+uint32_t pw_stream_write(struct pw_stream *stream, const void *data, uint32_t size);
+
+/** Read at most \a size bytes from the ringbuffer of \a stream into \a data \memberof pw_stream
+ * \return the number of bytes read, less than \a size when the ringbuffer
+ * does not have enough data. The missing bytes are counted as underrun.
+ *
+ * For input streams connected with \ref PW_STREAM_MODE_RINGBUFFER. This can be
+ * called from any one thread at any time. */
+uint32_t pw_stream_read(struct pw_stream *stream, void *data, uint32_t size);
+
+/** Get a buffer from \a stream \memberof pw_stream
+ * \return the id of a buffer or \ref SPA_ID_INVALID when no buffer is
+ * available.
+ *
+ * For streams connected with \ref PW_STREAM_FLAG_QUEUE. Input streams get a
+ * filled buffer, output streams an empty buffer. Call this until it returns
+ * \ref SPA_ID_INVALID after the queue fd became readable. Only one thread
+ * should dequeue and queue buffers. */
+uint32_t pw_stream_dequeue_buffer(struct pw_stream *stream);
+
+/** Give the buffer with \a id back to \a stream \memberof pw_stream
+ * \return true on success, false when the buffer can't be queued
+ *
+ * Input streams recycle the buffer, output streams send it. An unknown
+ * \a id is dropped by the data loop. */
+bool pw_stream_queue_buffer(struct pw_stream *stream, uint32_t id);
+
+/** Get the fd that is readable when a buffer can be dequeued \memberof pw_stream
+ * \return a file descriptor or -1 when the stream was not connected with
+ * \ref PW_STREAM_FLAG_QUEUE */
+int pw_stream_get_queue_fd(struct pw_stream *stream);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,8 @@
 #include "pipewire/log.h"
 #include "pipewire/work-queue.h"
 
+#define INITIAL_BUCKETS	16
+
 /** \cond */
 struct work_item {
 	uint32_t id;
@@ -31,7 +33,8 @@ struct work_item {
 	int res;
 	pw_work_func_t func;
 	void *data;
-	struct spa_list link;
+	struct spa_list link;		/**< link in the pending, sync, ready or free list */
+	struct spa_list hash_link;	/**< link in the hash bucket when pending */
 };
 
 struct pw_work_queue {
@@ -40,31 +43,121 @@ struct pw_work_queue {
 	struct spa_source *wakeup;
 	uint32_t counter;
 
-	struct spa_list work_list;
+	struct spa_list pending_list;	/**< items waiting for an async result, by id */
+	struct spa_list sync_list;	/**< items waiting for the older pending items, by id */
+	struct spa_list ready_list;	/**< items that can run, by id */
 	struct spa_list free_list;
 	int n_queued;
+
+	struct spa_list *buckets;	/**< pending items by obj and seq */
+	uint32_t n_buckets;
+	uint32_t n_pending;
 };
 /** \endcond */
 
+/* ids wrap around, compare them like serial numbers */
+static inline bool id_before(uint32_t a, uint32_t b)
+{
+	return (int32_t) (a - b) < 0;
+}
+
+static inline struct spa_list *
+get_bucket(struct pw_work_queue *this, void *obj, uint32_t seq)
+{
+	uint32_t hash = (uint32_t) ((uintptr_t) obj >> 4) * 2654435761u;
+
+	return &this->buckets[(hash ^ seq) & (this->n_buckets - 1)];
+}
+
+static bool init_buckets(struct pw_work_queue *this, uint32_t n_buckets)
+{
+	struct spa_list *buckets;
+	struct work_item *item;
+	uint32_t i;
+
+	buckets = malloc(n_buckets * sizeof(struct spa_list));
+	if (buckets == NULL)
+		return false;
+
+	for (i = 0; i < n_buckets; i++)
+		spa_list_init(&buckets[i]);
+
+	free(this->buckets);
+	this->buckets = buckets;
+	this->n_buckets = n_buckets;
+
+	spa_list_for_each(item, &this->pending_list, link)
+		spa_list_insert(get_bucket(this, item->obj, item->seq), &item->hash_link);
+
+	return true;
+}
+
+/* insert in a list that is sorted by id, new items usually go at the end */
+static void insert_ordered(struct spa_list *list, struct work_item *item)
+{
+	struct spa_list *pos = list->prev;
+	struct work_item *prev;
+
+	while (pos != list) {
+		prev = SPA_CONTAINER_OF(pos, struct work_item, link);
+		if (!id_before(item->id, prev->id))
+			break;
+		pos = pos->prev;
+	}
+
+	spa_list_insert(pos, &item->link);
+}
+
+/* an item that is not waiting for an async result anymore */
+static void queue_item(struct pw_work_queue *this, struct work_item *item)
+{
+	if (item->res == SPA_RESULT_WAIT_SYNC)
+		insert_ordered(&this->sync_list, item);
+	else
+		insert_ordered(&this->ready_list, item);
+}
+
+static void unqueue_pending(struct pw_work_queue *this, struct work_item *item)
+{
+	spa_list_remove(&item->hash_link);
+	spa_list_remove(&item->link);
+	item->seq = SPA_ID_INVALID;
+	this->n_pending--;
+}
+
+/* make the sync items ready that have no older pending items */
+static void release_sync(struct pw_work_queue *this)
+{
+	struct work_item *item, *pending = NULL;
+
+	if (!spa_list_is_empty(&this->pending_list))
+		pending = spa_list_first(&this->pending_list, struct work_item, link);
+
+	while (!spa_list_is_empty(&this->sync_list)) {
+		item = spa_list_first(&this->sync_list, struct work_item, link);
+
+		if (pending && id_before(pending->id, item->id)) {
+			pw_log_debug("work-queue %p: %d sync item %p waiting for item %p %d", this,
+				     this->n_queued, item->obj, pending->obj, pending->seq);
+			break;
+		}
+		spa_list_remove(&item->link);
+		insert_ordered(&this->ready_list, item);
+	}
+}
+
 static void process_work_queue(void *data, uint64_t count)
 {
 	struct pw_work_queue *this = data;
-	struct work_item *item, *tmp;
+	struct work_item *item;
 
-	spa_list_for_each_safe(item, tmp, &this->work_list, link) {
-		if (item->seq != SPA_ID_INVALID) {
-			pw_log_debug("work-queue %p: %d waiting for item %p %d", this,
-				     this->n_queued, item->obj, item->seq);
-			continue;
-		}
+	while (true) {
+		release_sync(this);
 
-		if (item->res == SPA_RESULT_WAIT_SYNC &&
-		    item != spa_list_first(&this->work_list, struct work_item, link)) {
-			pw_log_debug("work-queue %p: %d sync item %p not head", this,
-				     this->n_queued, item->obj);
-			continue;
-		}
+		if (spa_list_is_empty(&this->ready_list))
+			break;
 
+		item = spa_list_first(&this->ready_list, struct work_item, link);
 		spa_list_remove(&item->link);
 		this->n_queued--;
 
@@ -89,18 +182,39 @@ struct pw_work_queue *pw_work_queue_new(struct pw_loop *loop)
 	struct pw_work_queue *this;
 
 	this = calloc(1, sizeof(struct pw_work_queue));
+	if (this == NULL)
+		return NULL;
+
 	pw_log_debug("work-queue %p: new", this);
 
 	this->loop = loop;
 
-	this->wakeup = pw_loop_add_event(this->loop, process_work_queue, this);
-
-	spa_list_init(&this->work_list);
+	spa_list_init(&this->pending_list);
+	spa_list_init(&this->sync_list);
+	spa_list_init(&this->ready_list);
 	spa_list_init(&this->free_list);
 
+	if (!init_buckets(this, INITIAL_BUCKETS)) {
+		free(this);
+		return NULL;
+	}
+
+	this->wakeup = pw_loop_add_event(this->loop, process_work_queue, this);
+
 	return this;
 }
 
+static void cancel_list(struct pw_work_queue *queue, struct spa_list *list)
+{
+	struct work_item *item, *tmp;
+
+	spa_list_for_each_safe(item, tmp, list, link) {
+		pw_log_warn("work-queue %p: cancel work item %p %d %d", queue,
+			    item->obj, item->seq, item->res);
+		free(item);
+	}
+}
+
 /** Destroy a work queue
  * \param queue the work queue to destroy
  *
@@ -114,14 +228,14 @@ void pw_work_queue_destroy(struct pw_work_queue *queue)
 
 	pw_loop_destroy_source(queue->loop, queue->wakeup);
 
-	spa_list_for_each_safe(item, tmp, &queue->work_list, link) {
-		pw_log_warn("work-queue %p: cancel work item %p %d %d", queue,
-			    item->obj, item->seq, item->res);
-		free(item);
-	}
+	cancel_list(queue, &queue->pending_list);
+	cancel_list(queue, &queue->sync_list);
+	cancel_list(queue, &queue->ready_list);
+
 	spa_list_for_each_safe(item, tmp, &queue->free_list, link)
 		free(item);
 
+	free(queue->buckets);
 	free(queue);
 }
 
@@ -133,6 +247,10 @@ void pw_work_queue_destroy(struct pw_work_queue *queue)
  * \param func a work function
  * \param data passed to \a func
  *
+ * An async \a res makes the item wait for pw_work_queue_complete() with the
+ * sequence number of \a res, SPA_RESULT_WAIT_SYNC makes it wait until all the
+ * items that were added before it have run.
+ *
  * \memberof pw_work_queue
  */
 uint32_t
@@ -153,23 +271,29 @@ pw_work_queue_add(struct pw_work_queue *queue, void *obj, int res, pw_work_func_
 	item->obj = obj;
 	item->func = func;
 	item->data = data;
+	item->res = res;
 
 	if (SPA_RESULT_IS_ASYNC(res)) {
 		item->seq = SPA_RESULT_ASYNC_SEQ(res);
-		item->res = res;
 		pw_log_debug("work-queue %p: defer async %d for object %p", queue, item->seq, obj);
-	} else if (res == SPA_RESULT_WAIT_SYNC) {
-		pw_log_debug("work-queue %p: wait sync object %p", queue, obj);
-		item->seq = SPA_ID_INVALID;
-		item->res = res;
-		have_work = true;
+
+		if (queue->n_pending >= queue->n_buckets * 2)
+			init_buckets(queue, queue->n_buckets * 2);
+
+		spa_list_insert(queue->pending_list.prev, &item->link);
+		spa_list_insert(get_bucket(queue, obj, item->seq), &item->hash_link);
+		queue->n_pending++;
 	} else {
+		if (res == SPA_RESULT_WAIT_SYNC) {
+			pw_log_debug("work-queue %p: wait sync object %p", queue, obj);
+		} else {
+			pw_log_debug("work-queue %p: defer object %p", queue, obj);
+		}
+
 		item->seq = SPA_ID_INVALID;
-		item->res = res;
+		queue_item(queue, item);
 		have_work = true;
-		pw_log_debug("work-queue %p: defer object %p", queue, obj);
 	}
-	spa_list_insert(queue->work_list.prev, &item->link);
 	queue->n_queued++;
 
 	if (have_work)
@@ -178,6 +302,20 @@ pw_work_queue_add(struct pw_work_queue *queue, void *obj, int res, pw_work_func_
 	return item->id;
 }
 
+static bool cancel_matching(struct spa_list *list, void *obj, uint32_t id)
+{
+	struct work_item *item;
+	bool found = false;
+
+	spa_list_for_each(item, list, link) {
+		if ((id == SPA_ID_INVALID || item->id == id) && (obj == NULL || item->obj == obj)) {
+			item->func = NULL;
+			found = true;
+		}
+	}
+	return found;
+}
+
 /** Cancel a work item
  * \param queue the work queue
  * \param obj the owner object
@@ -188,17 +326,21 @@ pw_work_queue_add(struct pw_work_queue *queue, void *obj, int res, pw_work_func_
 void pw_work_queue_cancel(struct pw_work_queue *queue, void *obj, uint32_t id)
 {
 	bool have_work = false;
-	struct work_item *item;
+	struct work_item *item, *tmp;
 
-	spa_list_for_each(item, &queue->work_list, link) {
+	spa_list_for_each_safe(item, tmp, &queue->pending_list, link) {
 		if ((id == SPA_ID_INVALID || item->id == id) && (obj == NULL || item->obj == obj)) {
 			pw_log_debug("work-queue %p: cancel defer %d for object %p", queue,
 				     item->seq, item->obj);
-			item->seq = SPA_ID_INVALID;
+			unqueue_pending(queue, item);
 			item->func = NULL;
+			queue_item(queue, item);
 			have_work = true;
 		}
 	}
+	have_work |= cancel_matching(&queue->sync_list, obj, id);
+	have_work |= cancel_matching(&queue->ready_list, obj, id);
+
 	if (have_work)
 		pw_loop_signal_event(queue->loop, queue->wakeup);
 }
@@ -213,15 +355,16 @@ void pw_work_queue_cancel(struct pw_work_queue *queue, void *obj, uint32_t id)
  */
 bool pw_work_queue_complete(struct pw_work_queue *queue, void *obj, uint32_t seq, int res)
 {
-	struct work_item *item;
+	struct work_item *item, *tmp;
 	bool have_work = false;
 
-	spa_list_for_each(item, &queue->work_list, link) {
+	spa_list_for_each_safe(item, tmp, get_bucket(queue, obj, seq), hash_link) {
 		if (item->obj == obj && item->seq == seq) {
 			pw_log_debug("work-queue %p: found defered %d for object %p", queue, seq,
 				     obj);
-			item->seq = SPA_ID_INVALID;
+			unqueue_pending(queue, item);
 			item->res = res;
+			queue_item(queue, item);
 			have_work = true;
 		}
 	}
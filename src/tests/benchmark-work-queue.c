@@ -0,0 +1,198 @@
+/* PipeWire
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/work-queue.h>
+
+/* Queues the work of linking many async nodes like a link group does: the
+ * output and input node of each link return an async result and the link
+ * waits with a sync item for them. The nodes complete in random order and
+ * the loop runs after every few completions. */
+
+#define DEFAULT_LINKS	1000
+#define DEFAULT_ROUNDS	10
+#define BATCH		8
+
+struct node {
+	uint32_t seq;
+	bool done;
+};
+
+struct link {
+	struct node output;
+	struct node input;
+	bool checked;
+};
+
+struct data {
+	struct pw_loop *loop;
+	struct pw_work_queue *work;
+
+	struct link *links;
+	uint32_t n_links;
+
+	struct node **order;
+	uint32_t n_checked;
+	uint32_t n_errors;
+};
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static void complete_node(void *obj, void *data, int res, uint32_t id)
+{
+	struct node *node = obj;
+
+	node->done = true;
+}
+
+static void check_link(void *obj, void *data, int res, uint32_t id)
+{
+	struct data *d = data;
+	struct link *link = obj;
+
+	if (!link->output.done || !link->input.done || link->checked)
+		d->n_errors++;
+
+	link->checked = true;
+	d->n_checked++;
+}
+
+static void run_loop(struct data *d)
+{
+	while (pw_loop_iterate(d->loop, 0) > 0);
+}
+
+static void setup_links(struct data *d, uint32_t round)
+{
+	uint32_t i;
+
+	for (i = 0; i < d->n_links; i++) {
+		struct link *l = &d->links[i];
+
+		l->output.seq = round * 2;
+		l->output.done = false;
+		l->input.seq = round * 2 + 1;
+		l->input.done = false;
+		l->checked = false;
+
+		pw_work_queue_add(d->work, &l->output, SPA_RESULT_RETURN_ASYNC(l->output.seq),
+				  complete_node, d);
+		pw_work_queue_add(d->work, &l->input, SPA_RESULT_RETURN_ASYNC(l->input.seq),
+				  complete_node, d);
+		pw_work_queue_add(d->work, l, SPA_RESULT_WAIT_SYNC, check_link, d);
+	}
+}
+
+static void complete_links(struct data *d)
+{
+	uint32_t i, n_nodes = d->n_links * 2;
+
+	for (i = 0; i < n_nodes; i++) {
+		uint32_t j = i + rand() % (n_nodes - i);
+		struct node *t = d->order[i];
+
+		d->order[i] = d->order[j];
+		d->order[j] = t;
+	}
+
+	for (i = 0; i < n_nodes; i++) {
+		struct node *node = d->order[i];
+
+		if (!pw_work_queue_complete(d->work, node, node->seq, SPA_RESULT_OK))
+			d->n_errors++;
+
+		if ((i % BATCH) == BATCH - 1)
+			run_loop(d);
+	}
+	run_loop(d);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL, };
+	uint32_t i, n_rounds = DEFAULT_ROUNDS;
+	uint64_t t1, t2, t3, add_time = 0, complete_time = 0;
+
+	pw_init(&argc, &argv);
+
+	data.n_links = argc > 1 ? atoi(argv[1]) : DEFAULT_LINKS;
+	if (argc > 2)
+		n_rounds = atoi(argv[2]);
+	if (data.n_links == 0 || n_rounds == 0) {
+		printf("usage: %s [links] [rounds]\n", argv[0]);
+		return -1;
+	}
+
+	data.loop = pw_loop_new(NULL);
+	data.work = pw_work_queue_new(data.loop);
+	data.links = calloc(data.n_links, sizeof(struct link));
+	data.order = calloc(data.n_links * 2, sizeof(struct node *));
+	if (data.work == NULL || data.links == NULL || data.order == NULL) {
+		printf("can't allocate\n");
+		return -1;
+	}
+
+	for (i = 0; i < data.n_links; i++) {
+		data.order[i * 2] = &data.links[i].output;
+		data.order[i * 2 + 1] = &data.links[i].input;
+	}
+
+	pw_loop_enter(data.loop);
+
+	for (i = 0; i < n_rounds; i++) {
+		t1 = get_time();
+		setup_links(&data, i);
+		t2 = get_time();
+		complete_links(&data);
+		t3 = get_time();
+
+		add_time += t2 - t1;
+		complete_time += t3 - t2;
+	}
+
+	pw_loop_leave(data.loop);
+
+	printf("%u links, %u rounds: add %.1f ns, complete %.1f ns per link\n",
+	       data.n_links, n_rounds,
+	       (double) add_time / (data.n_links * n_rounds),
+	       (double) complete_time / (data.n_links * n_rounds));
+
+	if (data.n_checked != data.n_links * n_rounds)
+		data.n_errors++;
+	if (data.n_errors > 0)
+		printf("error: %u of %u links checked, %u errors\n",
+		       data.n_checked, data.n_links * n_rounds, data.n_errors);
+
+	pw_work_queue_destroy(data.work);
+	pw_loop_destroy(data.loop);
+	free(data.links);
+	free(data.order);
+
+	return data.n_errors > 0 ? -1 : 0;
+}
@@ -0,0 +1,424 @@
+/* PipeWire
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include <spa/type-map.h>
+#include <spa/format-utils.h>
+#include <spa/video/format-utils.h>
+#include <spa/format-builder.h>
+
+#include <pipewire/pipewire.h>
+
+/* Connects an output and an input stream with PW_STREAM_FLAG_QUEUE to the
+ * running daemon and lets an application thread of each round-trip the
+ * buffers with pw_stream_dequeue_buffer() and pw_stream_queue_buffer().
+ * Each thread holds all the buffers it can dequeue before it queues them
+ * again and checks that the stream never gives out a buffer twice. */
+
+#define DEFAULT_BUFFERS	2000
+#define TIMEOUT_SEC	10
+
+#define WIDTH	64
+#define HEIGHT	48
+#define BPP	3
+
+struct type {
+	uint32_t format;
+	struct spa_type_meta meta;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
+}
+
+#define MAX_BUFFERS	16
+
+struct data;
+
+struct side {
+	struct data *data;
+	const char *name;
+	enum pw_direction direction;
+
+	struct pw_stream *stream;
+	struct spa_hook stream_listener;
+
+	pthread_t thread;
+	bool started;
+
+	bool busy[MAX_BUFFERS];	/**< the buffers the thread holds */
+	uint32_t seq;		/**< next seq, written by the thread */
+	uint32_t n_buffers;	/**< buffers that made the round trip */
+	uint32_t n_errors;
+};
+
+struct data {
+	struct type type;
+
+	struct pw_loop *loop;
+	bool running;
+	struct spa_source *done;
+	struct spa_source *timer;
+
+	struct pw_core *core;
+	struct pw_type *t;
+	struct pw_remote *remote;
+	struct spa_hook remote_listener;
+
+	struct side src;
+	struct side sink;
+
+	uint32_t n_wanted;
+	bool quit;		/**< stop the threads */
+
+	uint8_t params_buffer[1024];
+};
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+
+static void process(struct side *s, uint32_t id)
+{
+	struct data *data = s->data;
+	struct spa_buffer *buf;
+	struct spa_meta_header *h;
+
+	if ((buf = pw_stream_peek_buffer(s->stream, id)) == NULL ||
+	    (h = spa_buffer_find_meta(buf, data->type.meta.Header)) == NULL) {
+		printf("%s: invalid buffer %u\n", s->name, id);
+		s->n_errors++;
+		return;
+	}
+
+	if (s->direction == PW_DIRECTION_OUTPUT) {
+		h->flags = 0;
+		h->seq = s->seq++;
+		h->pts = -1;
+		h->dts_offset = 0;
+		buf->datas[0].chunk->offset = 0;
+		buf->datas[0].chunk->size = buf->datas[0].maxsize;
+	} else if (buf->datas[0].chunk->size != buf->datas[0].maxsize) {
+		printf("%s: buffer %u has size %u\n", s->name, id,
+		       buf->datas[0].chunk->size);
+		s->n_errors++;
+	}
+	s->n_buffers++;
+}
+
+static void *thread_func(void *user_data)
+{
+	struct side *s = user_data;
+	struct data *data = s->data;
+	struct pollfd pfd;
+	uint32_t id, held[MAX_BUFFERS], n_held, i;
+
+	pfd.fd = pw_stream_get_queue_fd(s->stream);
+	pfd.events = POLLIN;
+
+	while (!__atomic_load_n(&data->quit, __ATOMIC_ACQUIRE)) {
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+
+		/* hold all buffers we can get, the stream must not give
+		 * out a buffer twice before it is queued again */
+		n_held = 0;
+		while ((id = pw_stream_dequeue_buffer(s->stream)) != SPA_ID_INVALID) {
+			if (id >= MAX_BUFFERS || s->busy[id]) {
+				printf("%s: dequeued buffer %u twice\n", s->name, id);
+				s->n_errors++;
+				continue;
+			}
+			s->busy[id] = true;
+			held[n_held++] = id;
+			process(s, id);
+		}
+		for (i = 0; i < n_held; i++) {
+			s->busy[held[i]] = false;
+			if (!pw_stream_queue_buffer(s->stream, held[i])) {
+				printf("%s: can't queue buffer %u\n", s->name, held[i]);
+				s->n_errors++;
+			}
+		}
+		if (s->direction == PW_DIRECTION_INPUT && s->n_buffers >= data->n_wanted)
+			pw_loop_signal_event(data->loop, data->done);
+	}
+	return NULL;
+}
+
+static void start_thread(struct side *s)
+{
+	if (s->started)
+		return;
+
+	if (pthread_create(&s->thread, NULL, thread_func, s) != 0) {
+		printf("%s: can't create thread\n", s->name);
+		s->n_errors++;
+		return;
+	}
+	s->started = true;
+}
+
+static void stop_thread(struct side *s)
+{
+	if (!s->started)
+		return;
+
+	pthread_join(s->thread, NULL);
+	s->started = false;
+}
+
+static const struct pw_stream_events stream_events;
+
+/* both streams have the same fixed format */
+static void connect_side(struct side *s, const char *port_path)
+{
+	struct data *data = s->data;
+	const struct spa_format *formats[1];
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod_frame f[2];
+
+	spa_pod_builder_format(&b, &f[0], data->type.format,
+		data->type.media_type.video,
+		data->type.media_subtype.raw,
+		PROP(&f[1], data->type.format_video.format, SPA_POD_TYPE_ID,
+			data->type.video_format.RGB),
+		PROP(&f[1], data->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+			WIDTH, HEIGHT),
+		PROP(&f[1], data->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+			25, 1));
+	formats[0] = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	s->stream = pw_stream_new(data->remote, s->name, NULL);
+	pw_stream_add_listener(s->stream, &s->stream_listener, &stream_events, s);
+
+	pw_stream_connect(s->stream, s->direction, PW_STREAM_MODE_BUFFER,
+			  port_path, PW_STREAM_FLAG_QUEUE, 1, formats);
+}
+
+static void on_stream_state_changed(void *_data, enum pw_stream_state old,
+				    enum pw_stream_state state, const char *error)
+{
+	struct side *s = _data;
+	struct data *data = s->data;
+
+	switch (state) {
+	case PW_STREAM_STATE_ERROR:
+		printf("%s: stream error: %s\n", s->name, error);
+		s->n_errors++;
+		data->running = false;
+		break;
+
+	case PW_STREAM_STATE_CONFIGURE:
+		/* link the sink to the node of the source */
+		if (s == &data->src && data->sink.stream == NULL) {
+			char node_id[16];
+
+			snprintf(node_id, sizeof(node_id), "%u", pw_stream_get_node_id(s->stream));
+			connect_side(&data->sink, node_id);
+		}
+		break;
+
+	case PW_STREAM_STATE_PAUSED:
+		start_thread(s);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void
+on_stream_format_changed(void *_data, struct spa_format *format)
+{
+	struct side *s = _data;
+	struct data *data = s->data;
+	struct pw_type *t = data->t;
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct spa_param *params[2];
+	int32_t stride = SPA_ROUND_UP_N(WIDTH * BPP, 4);
+
+	if (format == NULL) {
+		pw_stream_finish_format(s->stream, SPA_RESULT_OK, NULL, 0);
+		return;
+	}
+
+	spa_pod_builder_init(&b, data->params_buffer, sizeof(data->params_buffer));
+	spa_pod_builder_object(&b, &f[0], 0, t->param_alloc_buffers.Buffers,
+		PROP(&f[1], t->param_alloc_buffers.size, SPA_POD_TYPE_INT,
+			stride * HEIGHT),
+		PROP(&f[1], t->param_alloc_buffers.stride, SPA_POD_TYPE_INT,
+			stride),
+		PROP_U_MM(&f[1], t->param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+			8,
+			2, MAX_BUFFERS),
+		PROP(&f[1], t->param_alloc_buffers.align, SPA_POD_TYPE_INT,
+			16));
+	params[0] = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	spa_pod_builder_object(&b, &f[0], 0, t->param_alloc_meta_enable.MetaEnable,
+		PROP(&f[1], t->param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+			t->meta.Header),
+		PROP(&f[1], t->param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+			sizeof(struct spa_meta_header)));
+	params[1] = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	pw_stream_finish_format(s->stream, SPA_RESULT_OK, params, 2);
+}
+
+static const struct pw_stream_events stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = on_stream_state_changed,
+	.format_changed = on_stream_format_changed,
+};
+
+static void on_state_changed(void *_data, enum pw_remote_state old,
+			     enum pw_remote_state state, const char *error)
+{
+	struct data *data = _data;
+
+	switch (state) {
+	case PW_REMOTE_STATE_ERROR:
+		printf("remote error: %s\n", error);
+		data->src.n_errors++;
+		data->running = false;
+		break;
+
+	case PW_REMOTE_STATE_CONNECTED:
+		connect_side(&data->src, NULL);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const struct pw_remote_events remote_events = {
+	PW_VERSION_REMOTE_EVENTS,
+	.state_changed = on_state_changed,
+};
+
+static void on_done(void *_data, uint64_t count)
+{
+	struct data *data = _data;
+	data->running = false;
+}
+
+static void on_timeout(void *_data, uint64_t expirations)
+{
+	struct data *data = _data;
+
+	printf("timeout, %u of %u buffers received\n", data->sink.n_buffers, data->n_wanted);
+	data->sink.n_errors++;
+	data->running = false;
+}
+
+static void init_side(struct side *s, struct data *data, const char *name,
+		      enum pw_direction direction)
+{
+	s->data = data;
+	s->name = name;
+	s->direction = direction;
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { { 0, }, };
+	struct timespec timeout;
+	uint32_t n_errors;
+
+	pw_init(&argc, &argv);
+
+	data.n_wanted = argc > 1 ? atoi(argv[1]) : DEFAULT_BUFFERS;
+	if (data.n_wanted == 0) {
+		printf("usage: %s [buffers]\n", argv[0]);
+		return -1;
+	}
+
+	data.loop = pw_loop_new(NULL);
+	data.running = true;
+	data.core = pw_core_new(data.loop, NULL);
+	data.t = pw_core_get_type(data.core);
+	data.remote = pw_remote_new(data.core, NULL, 0);
+
+	init_type(&data.type, data.t->map);
+	init_side(&data.src, &data, "src", PW_DIRECTION_OUTPUT);
+	init_side(&data.sink, &data, "sink", PW_DIRECTION_INPUT);
+
+	data.done = pw_loop_add_event(data.loop, on_done, &data);
+	data.timer = pw_loop_add_timer(data.loop, on_timeout, &data);
+	timeout.tv_sec = TIMEOUT_SEC;
+	timeout.tv_nsec = 0;
+	pw_loop_update_timer(data.loop, data.timer, &timeout, NULL, false);
+
+	pw_remote_add_listener(data.remote, &data.remote_listener, &remote_events, &data);
+
+	if (pw_remote_connect(data.remote) < 0) {
+		printf("can't connect to the daemon\n");
+		return -1;
+	}
+
+	pw_loop_enter(data.loop);
+	while (data.running)
+		pw_loop_iterate(data.loop, -1);
+
+	__atomic_store_n(&data.quit, true, __ATOMIC_RELEASE);
+	stop_thread(&data.src);
+	stop_thread(&data.sink);
+
+	if (data.sink.stream)
+		pw_stream_destroy(data.sink.stream);
+	if (data.src.stream)
+		pw_stream_destroy(data.src.stream);
+	pw_loop_leave(data.loop);
+
+	printf("%u buffers sent, %u received\n", data.src.n_buffers, data.sink.n_buffers);
+
+	n_errors = data.src.n_errors + data.sink.n_errors;
+	if (data.sink.n_buffers < data.n_wanted)
+		n_errors++;
+	if (n_errors > 0)
+		printf("error: %u errors\n", n_errors);
+
+	pw_loop_destroy_source(data.loop, data.done);
+	pw_loop_destroy_source(data.loop, data.timer);
+	pw_remote_destroy(data.remote);
+	pw_core_destroy(data.core);
+	pw_loop_destroy(data.loop);
+
+	return n_errors > 0 ? -1 : 0;
+}
@@ -0,0 +1,411 @@
+/* PipeWire
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <spa/type-map.h>
+#include <spa/format-utils.h>
+#include <spa/audio/format-utils.h>
+#include <spa/format-builder.h>
+
+#include <pipewire/pipewire.h>
+
+/* Connects an output and an input stream with PW_STREAM_MODE_RINGBUFFER to
+ * the running daemon. While the graph runs, data written to the output with
+ * pw_stream_write() is read back from the input with pw_stream_read() in
+ * chunks of changing sizes. Then the ringbuffer is overrun and underrun and
+ * the counters of pw_stream_get_time() are checked. */
+
+#define DEFAULT_ROUNDS	200
+#define TIMEOUT_SEC	10
+#define INTERVAL_MSEC	5
+
+#define RB_SIZE		4096
+#define MAX_CHUNK	(RB_SIZE / 2)
+#define OVERRUN		100
+#define UNDERRUN	200
+
+struct type {
+	uint32_t format;
+	struct spa_type_meta meta;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+}
+
+struct data;
+
+struct side {
+	struct data *data;
+	const char *name;
+	enum pw_direction direction;
+
+	struct pw_stream *stream;
+	struct spa_hook stream_listener;
+	bool streaming;
+};
+
+struct data {
+	struct type type;
+
+	struct pw_loop *loop;
+	bool running;
+	struct spa_source *timer;
+	struct spa_source *timeout;
+
+	struct pw_core *core;
+	struct pw_type *t;
+	struct pw_remote *remote;
+	struct spa_hook remote_listener;
+
+	struct side src;
+	struct side sink;
+
+	uint32_t n_rounds;
+	uint32_t round;
+	uint8_t seq;		/**< next byte to write */
+	uint8_t expected;	/**< next byte to read */
+	uint64_t n_bytes;	/**< bytes that made the round trip */
+	uint32_t n_errors;
+
+	uint8_t params_buffer[1024];
+};
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+
+static uint32_t write_data(struct data *data, uint32_t size)
+{
+	uint8_t buf[RB_SIZE + OVERRUN];
+	uint32_t i, res;
+
+	for (i = 0; i < size; i++)
+		buf[i] = data->seq + i;
+
+	res = pw_stream_write(data->src.stream, buf, size);
+	data->seq += res;
+
+	return res;
+}
+
+static uint32_t read_data(struct data *data, uint32_t size)
+{
+	uint8_t buf[RB_SIZE + UNDERRUN];
+	uint32_t i, res;
+
+	res = pw_stream_read(data->sink.stream, buf, size);
+	for (i = 0; i < res; i++) {
+		if (buf[i] != data->expected) {
+			printf("byte %" PRIu64 " is %u, expected %u\n", data->n_bytes + i,
+			       buf[i], data->expected);
+			data->n_errors++;
+			data->expected = buf[i];
+		}
+		data->expected++;
+	}
+	data->n_bytes += res;
+
+	return res;
+}
+
+static void expect(struct data *data, const char *what, uint64_t val, uint64_t expected)
+{
+	if (val == expected)
+		return;
+
+	printf("%s is %" PRIu64 ", expected %" PRIu64 "\n", what, val, expected);
+	data->n_errors++;
+}
+
+/* one round while the graph runs, chunks of changing sizes make the data
+ * wrap at different places in the ringbuffer */
+static void do_round(struct data *data)
+{
+	uint32_t size = 1 + (data->round * 379) % MAX_CHUNK;
+	struct pw_time time;
+
+	expect(data, "write", write_data(data, size), size);
+
+	pw_stream_get_time(data->sink.stream, &time);
+	expect(data, "queued", time.queued, size);
+
+	expect(data, "read", read_data(data, size), size);
+}
+
+/* fill the ringbuffer past its size and drain it past its end */
+static void do_xrun(struct data *data)
+{
+	struct pw_time time;
+
+	expect(data, "write overrun", write_data(data, RB_SIZE + OVERRUN), RB_SIZE);
+	pw_stream_get_time(data->src.stream, &time);
+	expect(data, "overrun", time.overrun, OVERRUN);
+	expect(data, "queued full", time.queued, RB_SIZE);
+
+	expect(data, "read full", read_data(data, RB_SIZE), RB_SIZE);
+	expect(data, "read underrun", read_data(data, UNDERRUN), 0);
+	pw_stream_get_time(data->sink.stream, &time);
+	expect(data, "underrun", time.underrun, UNDERRUN);
+	expect(data, "queued empty", time.queued, 0);
+
+	/* the ringbuffer works after the xruns */
+	expect(data, "write after xrun", write_data(data, 16), 16);
+	expect(data, "read after xrun", read_data(data, 16), 16);
+}
+
+static void on_timer(void *_data, uint64_t expirations)
+{
+	struct data *data = _data;
+
+	if (!data->src.streaming || !data->sink.streaming)
+		return;
+
+	if (data->round == 0) {
+		/* the ringbuffer only goes one way */
+		expect(data, "read from output", pw_stream_read(data->src.stream, NULL, 16), 0);
+		expect(data, "write to input", pw_stream_write(data->sink.stream, NULL, 16), 0);
+	}
+
+	if (data->round < data->n_rounds) {
+		do_round(data);
+		data->round++;
+	} else {
+		do_xrun(data);
+		data->running = false;
+	}
+}
+
+static const struct pw_stream_events stream_events;
+
+/* both streams have the same fixed format */
+static void connect_side(struct side *s, const char *port_path)
+{
+	struct data *data = s->data;
+	const struct spa_format *formats[1];
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod_frame f[2];
+
+	spa_pod_builder_format(&b, &f[0], data->type.format,
+		data->type.media_type.audio,
+		data->type.media_subtype.raw,
+		PROP(&f[1], data->type.format_audio.format, SPA_POD_TYPE_ID,
+			data->type.audio_format.S16),
+		PROP(&f[1], data->type.format_audio.layout, SPA_POD_TYPE_INT,
+			SPA_AUDIO_LAYOUT_INTERLEAVED),
+		PROP(&f[1], data->type.format_audio.channels, SPA_POD_TYPE_INT, 2),
+		PROP(&f[1], data->type.format_audio.rate, SPA_POD_TYPE_INT, 44100));
+	formats[0] = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	s->stream = pw_stream_new(data->remote, s->name, NULL);
+	pw_stream_add_listener(s->stream, &s->stream_listener, &stream_events, s);
+
+	pw_stream_connect(s->stream, s->direction, PW_STREAM_MODE_RINGBUFFER,
+			  port_path, PW_STREAM_FLAG_NONE, 1, formats);
+}
+
+static void on_stream_state_changed(void *_data, enum pw_stream_state old,
+				    enum pw_stream_state state, const char *error)
+{
+	struct side *s = _data;
+	struct data *data = s->data;
+
+	s->streaming = state == PW_STREAM_STATE_STREAMING;
+
+	switch (state) {
+	case PW_STREAM_STATE_ERROR:
+		printf("%s: stream error: %s\n", s->name, error);
+		data->n_errors++;
+		data->running = false;
+		break;
+
+	case PW_STREAM_STATE_CONFIGURE:
+		/* link the sink to the node of the source */
+		if (s == &data->src && data->sink.stream == NULL) {
+			char node_id[16];
+
+			snprintf(node_id, sizeof(node_id), "%u", pw_stream_get_node_id(s->stream));
+			connect_side(&data->sink, node_id);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void
+on_stream_format_changed(void *_data, struct spa_format *format)
+{
+	struct side *s = _data;
+	struct data *data = s->data;
+	struct pw_type *t = data->t;
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct spa_param *params[1];
+
+	if (format == NULL) {
+		pw_stream_finish_format(s->stream, SPA_RESULT_OK, NULL, 0);
+		return;
+	}
+
+	spa_pod_builder_init(&b, data->params_buffer, sizeof(data->params_buffer));
+	spa_pod_builder_object(&b, &f[0], 0, t->param_alloc_meta_enable.MetaEnable,
+		PROP(&f[1], t->param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+			t->meta.Ringbuffer),
+		PROP(&f[1], t->param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+			sizeof(struct spa_meta_ringbuffer)),
+		PROP(&f[1], t->param_alloc_meta_enable.ringbufferSize, SPA_POD_TYPE_INT,
+			RB_SIZE),
+		PROP(&f[1], t->param_alloc_meta_enable.ringbufferStride, SPA_POD_TYPE_INT,
+			0),
+		PROP(&f[1], t->param_alloc_meta_enable.ringbufferBlocks, SPA_POD_TYPE_INT,
+			1),
+		PROP(&f[1], t->param_alloc_meta_enable.ringbufferAlign, SPA_POD_TYPE_INT,
+			16));
+	params[0] = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	pw_stream_finish_format(s->stream, SPA_RESULT_OK, params, 1);
+}
+
+static const struct pw_stream_events stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = on_stream_state_changed,
+	.format_changed = on_stream_format_changed,
+};
+
+static void on_state_changed(void *_data, enum pw_remote_state old,
+			     enum pw_remote_state state, const char *error)
+{
+	struct data *data = _data;
+
+	switch (state) {
+	case PW_REMOTE_STATE_ERROR:
+		printf("remote error: %s\n", error);
+		data->n_errors++;
+		data->running = false;
+		break;
+
+	case PW_REMOTE_STATE_CONNECTED:
+		connect_side(&data->src, NULL);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const struct pw_remote_events remote_events = {
+	PW_VERSION_REMOTE_EVENTS,
+	.state_changed = on_state_changed,
+};
+
+static void on_timeout(void *_data, uint64_t expirations)
+{
+	struct data *data = _data;
+
+	printf("timeout, %u of %u rounds done\n", data->round, data->n_rounds);
+	data->n_errors++;
+	data->running = false;
+}
+
+static void init_side(struct side *s, struct data *data, const char *name,
+		      enum pw_direction direction)
+{
+	s->data = data;
+	s->name = name;
+	s->direction = direction;
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { { 0, }, };
+	struct timespec value, interval;
+
+	pw_init(&argc, &argv);
+
+	data.n_rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+	if (data.n_rounds == 0) {
+		printf("usage: %s [rounds]\n", argv[0]);
+		return -1;
+	}
+
+	data.loop = pw_loop_new(NULL);
+	data.running = true;
+	data.core = pw_core_new(data.loop, NULL);
+	data.t = pw_core_get_type(data.core);
+	data.remote = pw_remote_new(data.core, NULL, 0);
+
+	init_type(&data.type, data.t->map);
+	init_side(&data.src, &data, "src", PW_DIRECTION_OUTPUT);
+	init_side(&data.sink, &data, "sink", PW_DIRECTION_INPUT);
+
+	data.timer = pw_loop_add_timer(data.loop, on_timer, &data);
+	value.tv_sec = interval.tv_sec = 0;
+	value.tv_nsec = interval.tv_nsec = INTERVAL_MSEC * SPA_NSEC_PER_MSEC;
+	pw_loop_update_timer(data.loop, data.timer, &value, &interval, false);
+
+	data.timeout = pw_loop_add_timer(data.loop, on_timeout, &data);
+	value.tv_sec = TIMEOUT_SEC;
+	value.tv_nsec = 0;
+	pw_loop_update_timer(data.loop, data.timeout, &value, NULL, false);
+
+	pw_remote_add_listener(data.remote, &data.remote_listener, &remote_events, &data);
+
+	if (pw_remote_connect(data.remote) < 0) {
+		printf("can't connect to the daemon\n");
+		return -1;
+	}
+
+	pw_loop_enter(data.loop);
+	while (data.running)
+		pw_loop_iterate(data.loop, -1);
+
+	if (data.sink.stream)
+		pw_stream_destroy(data.sink.stream);
+	if (data.src.stream)
+		pw_stream_destroy(data.src.stream);
+	pw_loop_leave(data.loop);
+
+	printf("%" PRIu64 " bytes in %u rounds\n", data.n_bytes, data.round);
+
+	if (data.n_errors > 0)
+		printf("error: %u errors\n", data.n_errors);
+
+	pw_loop_destroy_source(data.loop, data.timer);
+	pw_loop_destroy_source(data.loop, data.timeout);
+	pw_remote_destroy(data.remote);
+	pw_core_destroy(data.core);
+	pw_loop_destroy(data.loop);
+
+	return data.n_errors > 0 ? -1 : 0;
+}
@@ -156,6 +156,7 @@ static bool do_info(struct data *data, const char *cmd, char *args, char **error
 static bool do_create_node(struct data *data, const char *cmd, char *args, char **error);
 static bool do_destroy_node(struct data *data, const char *cmd, char *args, char **error);
 static bool do_create_link(struct data *data, const char *cmd, char *args, char **error);
+static bool do_create_links(struct data *data, const char *cmd, char *args, char **error);
 static bool do_destroy_link(struct data *data, const char *cmd, char *args, char **error);
 static bool do_export_node(struct data *data, const char *cmd, char *args, char **error);
 
@@ -172,6 +173,7 @@ static struct command command_list[] = {
 	{ "create-node", "Create a node from a factory. <factory-name> [<properties>]", do_create_node },
 	{ "destroy-node", "Destroy a node. <node-var>", do_destroy_node },
 	{ "create-link", "Create a link between nodes. <node-id> <port-id> <node-id> <port-id> [<properties>]", do_create_link },
+	{ "create-links", "Link the first ports of two nodes. <node-id> <node-id> <n-ports> [<properties>]", do_create_links },
 	{ "destroy-link", "Destroy a link. <link-var>", do_destroy_link },
 	{ "export-node", "Export a local node to the current remote. <node-id> [remote-var]", do_export_node },
 };
@@ -943,6 +945,70 @@ static bool do_create_link(struct data *data, const char *cmd, char *args, char
 	return true;
 }
 
+static bool do_create_links(struct data *data, const char *cmd, char *args, char **error)
+{
+	struct remote_data *rd = data->current;
+	char *a[4];
+	int n, i, n_links;
+	uint32_t id;
+	struct pw_type *t = data->t;
+	struct pw_core_link *links;
+	struct pw_link_proxy **proxies;
+	struct pw_properties *props = NULL;
+	struct proxy_data *pd;
+	bool res = false;
+
+	n = pw_split_ip(args, WHITESPACE, 4, a);
+	if (n < 3 || (n_links = atoi(a[2])) <= 0) {
+		asprintf(error, "%s <node-id> <node-id> <n-ports> [<properties>]", cmd);
+		return false;
+	}
+	links = calloc(n_links, sizeof(struct pw_core_link));
+	proxies = calloc(n_links, sizeof(struct pw_link_proxy *));
+	if (links == NULL || proxies == NULL) {
+		asprintf(error, "no memory");
+		goto done;
+	}
+	if (n == 4)
+		props = parse_props(a[3]);
+
+	for (i = 0; i < n_links; i++) {
+		links[i].output_node_id = atoi(a[0]);
+		links[i].output_port_id = i;
+		links[i].input_node_id = atoi(a[1]);
+		links[i].input_port_id = i;
+	}
+
+	if (pw_core_proxy_create_links(rd->core_proxy, t->link, n_links, links,
+				       props ? &props->dict : NULL,
+				       sizeof(struct proxy_data), proxies) < 0) {
+		asprintf(error, "can't create %d links", n_links);
+		goto done;
+	}
+	res = true;
+
+	for (i = 0; i < n_links; i++) {
+		struct pw_proxy *proxy = (struct pw_proxy *) proxies[i];
+
+		pd = pw_proxy_get_user_data(proxy);
+		pd->rd = rd;
+		pd->proxy = proxy;
+		pd->destroy = (pw_destroy_t) pw_link_info_free;
+		pw_proxy_add_proxy_listener(proxy, &pd->proxy_proxy_listener, &link_events, pd);
+		pw_proxy_add_listener(proxy, &pd->proxy_listener, &proxy_events, pd);
+
+		id = pw_map_insert_new(&data->vars, proxy);
+		fprintf(stdout, "%d = @proxy:%d\n", id, pw_proxy_get_id(proxy));
+	}
+
+      done:
+	if (props)
+		pw_properties_free(props);
+	free(links);
+	free(proxies);
+	return res;
+}
+
 static bool do_destroy_link(struct data *data, const char *cmd, char *args, char **error)
 {
         asprintf(error, "Command \"%s\" not yet implemented", cmd);
@@ -0,0 +1,824 @@
+/* PipeWire
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the latency of buffers from a source to a sink stream.
+ *
+ * For each path the tool creates a source, a chain of filters and an input
+ * stream. The source is a live spa node in the daemon or an output stream
+ * of the tool. Sources set the pts of the header metadata to the monotonic
+ * time the buffer was produced, filters copy the header metadata and the
+ * sink stream compares it with the arrival time.
+ *
+ * The spa nodes are made with the spa-node-factory, the daemon needs to
+ * load libpipewire-module-spa-node-factory for this. */
+
+#include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <spa/ringbuffer.h>
+#include <spa/format-builder.h>
+#include <spa/audio/format-utils.h>
+#include <spa/props.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/interfaces.h>
+#include <pipewire/type.h>
+
+#define MAX_PATHS	16
+#define MAX_FILTERS	8
+#define MAX_PROPS	16
+#define MAX_VALUES	4096	/* power of 2 */
+
+/* log-linear histogram of microseconds with 8 buckets per power of 2 */
+#define SUB_BUCKETS	8
+#define N_BUCKETS	(SUB_BUCKETS * 40)
+
+#define RATE		44100
+#define CHANNELS	2
+
+struct type {
+	uint32_t format;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+}
+
+struct histogram {
+	uint32_t buckets[N_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+};
+
+struct element {
+	struct path *path;
+	struct pw_proxy *proxy;
+	struct spa_hook proxy_listener;
+	uint32_t id;
+};
+
+struct path {
+	struct data *data;
+	uint32_t index;
+
+	/* the source, the filters and the sink, in link order */
+	struct element elements[MAX_FILTERS + 2];
+	uint32_t n_elements;
+	bool linked;
+
+	struct pw_stream *source;
+	struct spa_hook source_listener;
+	struct spa_source *source_timer;
+	uint32_t seq;
+
+	struct pw_stream *sink;
+	struct spa_hook sink_listener;
+
+	/* latencies measured in the data thread, read from the main thread */
+	struct spa_ringbuffer ring;
+	int64_t values[MAX_VALUES];
+	uint32_t lost;		/* atomic */
+	uint32_t invalid;	/* atomic */
+
+	struct histogram interval;
+	struct histogram total;
+};
+
+struct data {
+	struct type type;
+	struct pw_main_loop *loop;
+	struct pw_core *core;
+	struct pw_type *t;
+
+	struct pw_remote *remote;
+	struct spa_hook remote_listener;
+
+	struct pw_core_proxy *core_proxy;
+
+	struct spa_source *timer;
+	uint32_t elapsed;
+
+	const char *source;
+	const char *filters[MAX_FILTERS];
+	uint32_t n_filters;
+	const char *props[MAX_PROPS];
+	uint32_t n_props;
+	uint32_t n_paths;
+	uint32_t quantum;
+	uint32_t duration;
+
+	uint8_t params_buffer[1024];
+
+	struct path paths[MAX_PATHS];
+};
+
+static const struct node_factory {
+	const char *name;
+	const char *lib;
+	const char *factory;
+} node_factories[] = {
+	{ "audiotestsrc", "audiotestsrc/libspa-audiotestsrc", "audiotestsrc" },
+	{ "volume", "volume/libspa-volume", "volume" },
+};
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+
+static inline int64_t get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static uint32_t bucket_index(uint64_t us)
+{
+	int msb;
+
+	if (us < SUB_BUCKETS)
+		return us;
+
+	msb = 63 - __builtin_clzll(us);
+	return SPA_MIN((msb - 2) * SUB_BUCKETS + ((us >> (msb - 3)) & (SUB_BUCKETS - 1)),
+		       N_BUCKETS - 1);
+}
+
+static uint64_t bucket_value(uint32_t index)
+{
+	uint32_t shift;
+
+	if (index < SUB_BUCKETS)
+		return index;
+
+	shift = index / SUB_BUCKETS - 1;
+	return (uint64_t) (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+static void histogram_add(struct histogram *h, uint64_t us)
+{
+	h->buckets[bucket_index(us)]++;
+	if (h->count == 0 || us < h->min)
+		h->min = us;
+	if (us > h->max)
+		h->max = us;
+	h->count++;
+	h->sum += us;
+}
+
+static uint64_t histogram_percentile(struct histogram *h, double p)
+{
+	uint64_t sum = 0, target = h->count * p;
+	uint32_t i;
+
+	for (i = 0; i < N_BUCKETS; i++) {
+		sum += h->buckets[i];
+		if (sum > target)
+			return bucket_value(i);
+	}
+	return h->max;
+}
+
+static void print_histogram_line(struct path *p, struct histogram *h)
+{
+	uint32_t lost, invalid;
+
+	if (h->count == 0) {
+		printf("path %u: no buffers", p->index);
+	} else {
+		printf("path %u: %6" PRIu64 " buffers  min %6" PRIu64 "  avg %6" PRIu64
+		       "  p50 %6" PRIu64 "  p90 %6" PRIu64 "  p99 %6" PRIu64 "  max %6" PRIu64 " us",
+		       p->index, h->count, h->min, h->sum / h->count,
+		       histogram_percentile(h, 0.5), histogram_percentile(h, 0.9),
+		       histogram_percentile(h, 0.99), h->max);
+	}
+	lost = __atomic_load_n(&p->lost, __ATOMIC_RELAXED);
+	invalid = __atomic_load_n(&p->invalid, __ATOMIC_RELAXED);
+	if (lost > 0)
+		printf("  %u lost", lost);
+	if (invalid > 0)
+		printf("  %u without pts", invalid);
+	printf("\n");
+}
+
+/* print the histogram with one bar per power of 2 */
+static void print_histogram(struct histogram *h)
+{
+	uint32_t i, j, max = 0, counts[N_BUCKETS / SUB_BUCKETS] = { 0, };
+
+	for (i = 0; i < N_BUCKETS; i++)
+		counts[i / SUB_BUCKETS] += h->buckets[i];
+	for (i = 0; i < SPA_N_ELEMENTS(counts); i++)
+		max = SPA_MAX(max, counts[i]);
+
+	for (i = 0; i < SPA_N_ELEMENTS(counts); i++) {
+		if (counts[i] == 0)
+			continue;
+		printf("  %8" PRIu64 " us %8u |", bucket_value(i * SUB_BUCKETS), counts[i]);
+		for (j = 0; j < (uint64_t) counts[i] * 50 / max; j++)
+			printf("#");
+		printf("\n");
+	}
+}
+
+/* runs in the data thread */
+static void add_value(struct path *p, int64_t value)
+{
+	uint32_t index;
+
+	if (spa_ringbuffer_get_write_index(&p->ring, &index) >= MAX_VALUES) {
+		__atomic_fetch_add(&p->lost, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	p->values[index & p->ring.mask] = value;
+	spa_ringbuffer_write_update(&p->ring, index + 1);
+}
+
+static void collect_values(struct path *p)
+{
+	uint32_t index;
+	int32_t avail;
+
+	avail = spa_ringbuffer_get_read_index(&p->ring, &index);
+	while (avail-- > 0) {
+		int64_t value = p->values[index & p->ring.mask];
+		uint64_t us = value > 0 ? value / 1000 : 0;
+
+		histogram_add(&p->interval, us);
+		histogram_add(&p->total, us);
+		index++;
+	}
+	spa_ringbuffer_read_update(&p->ring, index);
+}
+
+static void print_summary(struct data *d)
+{
+	uint32_t i;
+
+	printf("\n");
+	for (i = 0; i < d->n_paths; i++) {
+		struct path *p = &d->paths[i];
+
+		collect_values(p);
+		print_histogram_line(p, &p->total);
+		print_histogram(&p->total);
+	}
+}
+
+static void on_timeout(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	uint32_t i;
+
+	for (i = 0; i < d->n_paths; i++) {
+		struct path *p = &d->paths[i];
+
+		collect_values(p);
+		print_histogram_line(p, &p->interval);
+		spa_zero(p->interval);
+	}
+	fflush(stdout);
+
+	if (d->duration > 0 && ++d->elapsed >= d->duration)
+		pw_main_loop_quit(d->loop);
+}
+
+static void link_path(struct path *p)
+{
+	struct data *d = p->data;
+	uint32_t i;
+
+	if (p->linked)
+		return;
+
+	for (i = 0; i < p->n_elements; i++) {
+		if (p->elements[i].id == SPA_ID_INVALID)
+			return;
+	}
+	p->linked = true;
+
+	for (i = 0; i + 1 < p->n_elements; i++) {
+		pw_log_debug("path %u: link %u -> %u", p->index,
+			     p->elements[i].id, p->elements[i + 1].id);
+		pw_core_proxy_create_link(d->core_proxy, d->t->link,
+					  p->elements[i].id, SPA_ID_INVALID,
+					  p->elements[i + 1].id, SPA_ID_INVALID,
+					  NULL, NULL, 0);
+	}
+}
+
+static void node_event_info(void *object, struct pw_node_info *info)
+{
+	struct element *e = object;
+
+	if (e->id == SPA_ID_INVALID) {
+		e->id = info->id;
+		link_path(e->path);
+	}
+}
+
+static const struct pw_node_proxy_events node_events = {
+	PW_VERSION_NODE_PROXY_EVENTS,
+	.info = node_event_info
+};
+
+static int create_node(struct path *p, struct element *e, const char *name, bool live)
+{
+	struct data *d = p->data;
+	struct pw_properties *props;
+	char lib[256], node_name[64];
+	const char *factory = NULL;
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(node_factories); i++) {
+		if (strcmp(node_factories[i].name, name) == 0) {
+			snprintf(lib, sizeof(lib), "%s", node_factories[i].lib);
+			factory = node_factories[i].factory;
+			break;
+		}
+	}
+	if (factory == NULL) {
+		/* <library>:<factory> */
+		const char *sep = strchr(name, ':');
+
+		if (sep == NULL) {
+			fprintf(stderr, "unknown node \"%s\", use <library>:<factory>\n", name);
+			return -1;
+		}
+		snprintf(lib, sizeof(lib), "%.*s", (int) (sep - name), name);
+		factory = sep + 1;
+	}
+	snprintf(node_name, sizeof(node_name), "latency-%u-%s", p->index, factory);
+
+	props = pw_properties_new("spa.library.name", lib,
+				  "spa.factory.name", factory,
+				  "name", node_name, NULL);
+	if (live)
+		pw_properties_set(props, SPA_TYPE_PROPS__live, "true");
+	for (i = 0; i < d->n_props; i++)
+		pw_properties_set(props, d->props[2 * i], d->props[2 * i + 1]);
+
+	e->path = p;
+	e->id = SPA_ID_INVALID;
+	e->proxy = pw_core_proxy_create_object(d->core_proxy, "spa-node-factory",
+					       d->t->node, PW_VERSION_NODE, &props->dict, 0);
+	pw_properties_free(props);
+	if (e->proxy == NULL)
+		return -1;
+
+	pw_proxy_add_proxy_listener(e->proxy, &e->proxy_listener, &node_events, e);
+	return 0;
+}
+
+static void finish_format(struct data *d, struct pw_stream *stream, struct spa_format *format)
+{
+	struct spa_audio_info_raw info;
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct spa_param *params[2];
+	uint32_t size;
+
+	if (format == NULL) {
+		pw_stream_finish_format(stream, SPA_RESULT_OK, NULL, 0);
+		return;
+	}
+	spa_format_audio_raw_parse(format, &info, &d->type.format_audio);
+	size = d->quantum * info.channels * sizeof(int16_t);
+
+	spa_pod_builder_init(&b, d->params_buffer, sizeof(d->params_buffer));
+	spa_pod_builder_object(&b, &f[0], 0, d->t->param_alloc_buffers.Buffers,
+		PROP(&f[1], d->t->param_alloc_buffers.size, SPA_POD_TYPE_INT,
+			size),
+		PROP(&f[1], d->t->param_alloc_buffers.stride, SPA_POD_TYPE_INT,
+			info.channels * sizeof(int16_t)),
+		PROP_U_MM(&f[1], d->t->param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+			8,
+			2, 32),
+		PROP(&f[1], d->t->param_alloc_buffers.align, SPA_POD_TYPE_INT,
+			16));
+	params[0] = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	spa_pod_builder_object(&b, &f[0], 0, d->t->param_alloc_meta_enable.MetaEnable,
+		PROP(&f[1], d->t->param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+			d->t->meta.Header),
+		PROP(&f[1], d->t->param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+			sizeof(struct spa_meta_header)));
+	params[1] = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	pw_stream_finish_format(stream, SPA_RESULT_OK, params, 2);
+}
+
+static void on_sink_state_changed(void *data, enum pw_stream_state old,
+				  enum pw_stream_state state, const char *error)
+{
+	struct path *p = data;
+	struct element *e = &p->elements[p->n_elements - 1];
+
+	if (state == PW_STREAM_STATE_ERROR)
+		fprintf(stderr, "path %u: sink error: %s\n", p->index, error);
+
+	if (state >= PW_STREAM_STATE_CONFIGURE && e->id == SPA_ID_INVALID) {
+		e->id = pw_stream_get_node_id(p->sink);
+		link_path(p);
+	}
+}
+
+static void on_sink_format_changed(void *data, struct spa_format *format)
+{
+	struct path *p = data;
+
+	finish_format(p->data, p->sink, format);
+}
+
+/* runs in the data thread */
+static void on_sink_new_buffer(void *data, uint32_t id)
+{
+	struct path *p = data;
+	struct spa_buffer *buf;
+	struct spa_meta_header *h;
+	int64_t now = get_time();
+
+	buf = pw_stream_peek_buffer(p->sink, id);
+
+	if (buf && (h = spa_buffer_find_meta(buf, p->data->type.meta.Header)) && h->pts > 0)
+		add_value(p, now - h->pts);
+	else
+		__atomic_fetch_add(&p->invalid, 1, __ATOMIC_RELAXED);
+
+	pw_stream_recycle_buffer(p->sink, id);
+}
+
+static const struct pw_stream_events sink_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = on_sink_state_changed,
+	.format_changed = on_sink_format_changed,
+	.new_buffer = on_sink_new_buffer,
+};
+
+static void on_source_timeout(void *data, uint64_t expirations)
+{
+	struct path *p = data;
+	struct spa_buffer *buf;
+	struct spa_meta_header *h;
+	uint32_t id;
+
+	if ((id = pw_stream_get_empty_buffer(p->source)) == SPA_ID_INVALID)
+		return;
+
+	buf = pw_stream_peek_buffer(p->source, id);
+	if (buf->datas[0].data == NULL)
+		return;
+
+	memset(buf->datas[0].data, 0, buf->datas[0].maxsize);
+	buf->datas[0].chunk->offset = 0;
+	buf->datas[0].chunk->size = buf->datas[0].maxsize;
+	buf->datas[0].chunk->stride = 0;
+
+	/* the pts is set when the buffer is sent */
+	if ((h = spa_buffer_find_meta(buf, p->data->type.meta.Header))) {
+		h->flags = 0;
+		h->seq = p->seq++;
+		h->dts_offset = 0;
+	}
+	pw_stream_send_buffer(p->source, id);
+}
+
+static void on_source_state_changed(void *data, enum pw_stream_state old,
+				    enum pw_stream_state state, const char *error)
+{
+	struct path *p = data;
+	struct data *d = p->data;
+	struct pw_loop *l = pw_main_loop_get_loop(d->loop);
+	struct element *e = &p->elements[0];
+
+	switch (state) {
+	case PW_STREAM_STATE_ERROR:
+		fprintf(stderr, "path %u: source error: %s\n", p->index, error);
+		break;
+	case PW_STREAM_STATE_PAUSED:
+		pw_loop_update_timer(l, p->source_timer, NULL, NULL, false);
+		break;
+	case PW_STREAM_STATE_STREAMING:
+	{
+		struct timespec timeout, interval;
+		uint64_t period = (uint64_t) d->quantum * SPA_NSEC_PER_SEC / RATE;
+
+		timeout.tv_sec = 0;
+		timeout.tv_nsec = 1;
+		interval.tv_sec = period / SPA_NSEC_PER_SEC;
+		interval.tv_nsec = period % SPA_NSEC_PER_SEC;
+		pw_loop_update_timer(l, p->source_timer, &timeout, &interval, false);
+		break;
+	}
+	default:
+		break;
+	}
+
+	if (state >= PW_STREAM_STATE_CONFIGURE && e->id == SPA_ID_INVALID) {
+		e->id = pw_stream_get_node_id(p->source);
+		link_path(p);
+	}
+}
+
+static void on_source_format_changed(void *data, struct spa_format *format)
+{
+	struct path *p = data;
+
+	finish_format(p->data, p->source, format);
+}
+
+static const struct pw_stream_events source_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = on_source_state_changed,
+	.format_changed = on_source_format_changed,
+};
+
+static const struct spa_format *build_format(struct data *d, struct spa_pod_builder *b,
+					     bool fixed)
+{
+	struct spa_pod_frame f[2];
+
+	if (fixed) {
+		spa_pod_builder_format(b, &f[0], d->type.format,
+			d->type.media_type.audio,
+			d->type.media_subtype.raw,
+			PROP(&f[1], d->type.format_audio.format, SPA_POD_TYPE_ID,
+				d->type.audio_format.S16),
+			PROP(&f[1], d->type.format_audio.rate, SPA_POD_TYPE_INT,
+				RATE),
+			PROP(&f[1], d->type.format_audio.channels, SPA_POD_TYPE_INT,
+				CHANNELS));
+	} else {
+		spa_pod_builder_format(b, &f[0], d->type.format,
+			d->type.media_type.audio,
+			d->type.media_subtype.raw,
+			PROP(&f[1], d->type.format_audio.format, SPA_POD_TYPE_ID,
+				d->type.audio_format.S16),
+			PROP_U_MM(&f[1], d->type.format_audio.rate, SPA_POD_TYPE_INT,
+				RATE,
+				1, INT32_MAX),
+			PROP_U_MM(&f[1], d->type.format_audio.channels, SPA_POD_TYPE_INT,
+				CHANNELS,
+				1, INT32_MAX));
+	}
+	return SPA_POD_BUILDER_DEREF(b, f[0].ref, struct spa_format);
+}
+
+static int create_path(struct data *d, struct path *p)
+{
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	const struct spa_format *formats[1];
+	char name[64];
+	uint32_t i;
+
+	p->data = d;
+	spa_ringbuffer_init(&p->ring, MAX_VALUES);
+	p->n_elements = d->n_filters + 2;
+	for (i = 0; i < p->n_elements; i++)
+		p->elements[i].id = SPA_ID_INVALID;
+
+	if (strcmp(d->source, "stream") == 0) {
+		snprintf(name, sizeof(name), "latency-%u-source", p->index);
+		p->source = pw_stream_new(d->remote, name, NULL);
+		pw_stream_add_listener(p->source, &p->source_listener, &source_events, p);
+		p->source_timer = pw_loop_add_timer(pw_main_loop_get_loop(d->loop),
+						    on_source_timeout, p);
+
+		formats[0] = build_format(d, &b, true);
+		pw_stream_connect(p->source, PW_DIRECTION_OUTPUT, PW_STREAM_MODE_BUFFER,
+				  NULL, PW_STREAM_FLAG_TIMESTAMP, 1, formats);
+	} else if (create_node(p, &p->elements[0], d->source, true) < 0)
+		return -1;
+
+	for (i = 0; i < d->n_filters; i++) {
+		if (create_node(p, &p->elements[i + 1], d->filters[i], false) < 0)
+			return -1;
+	}
+
+	snprintf(name, sizeof(name), "latency-%u-sink", p->index);
+	p->sink = pw_stream_new(d->remote, name, NULL);
+	pw_stream_add_listener(p->sink, &p->sink_listener, &sink_events, p);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	formats[0] = build_format(d, &b, false);
+	pw_stream_connect(p->sink, PW_DIRECTION_INPUT, PW_STREAM_MODE_BUFFER,
+			  NULL, PW_STREAM_FLAG_NONE, 1, formats);
+
+	return 0;
+}
+
+static void on_state_changed(void *_data, enum pw_remote_state old,
+			     enum pw_remote_state state, const char *error)
+{
+	struct data *d = _data;
+	struct timespec value, interval;
+	uint32_t i;
+
+	switch (state) {
+	case PW_REMOTE_STATE_ERROR:
+		fprintf(stderr, "remote error: %s\n", error);
+		pw_main_loop_quit(d->loop);
+		break;
+
+	case PW_REMOTE_STATE_CONNECTED:
+		d->core_proxy = pw_remote_get_core_proxy(d->remote);
+
+		for (i = 0; i < d->n_paths; i++) {
+			d->paths[i].index = i;
+			if (create_path(d, &d->paths[i]) < 0) {
+				pw_main_loop_quit(d->loop);
+				return;
+			}
+		}
+		value.tv_sec = 1;
+		value.tv_nsec = 0;
+		interval = value;
+		pw_loop_update_timer(pw_main_loop_get_loop(d->loop), d->timer,
+				     &value, &interval, false);
+		break;
+
+	case PW_REMOTE_STATE_UNCONNECTED:
+		pw_main_loop_quit(d->loop);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const struct pw_remote_events remote_events = {
+	PW_VERSION_REMOTE_EVENTS,
+	.state_changed = on_state_changed,
+};
+
+static void do_quit(void *data, int signal_number)
+{
+	struct data *d = data;
+	pw_main_loop_quit(d->loop);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -r <remote>      the remote to connect to\n"
+		"  -s <source>      audiotestsrc (default), stream or <library>:<factory>\n"
+		"  -f <filter>      add a filter to each path: volume or <library>:<factory>\n"
+		"  -P <key>=<value> set a prop on the spa nodes, the key is the name of\n"
+		"                   the prop without the \"" SPA_TYPE_PROPS_BASE "\" prefix\n"
+		"  -n <paths>       the number of parallel paths (default 1)\n"
+		"  -q <frames>      the buffer size in frames (default 1024)\n"
+		"  -d <seconds>     stop after this many seconds (default run until stopped)\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	struct pw_loop *l;
+	struct pw_properties *props = NULL;
+	const char *remote = NULL;
+	char prop_keys[MAX_PROPS / 2][128];
+	uint32_t i;
+	int c;
+
+	pw_init(&argc, &argv);
+
+	data.source = "audiotestsrc";
+	data.n_paths = 1;
+	data.quantum = 1024;
+
+	while ((c = getopt(argc, argv, "r:s:f:P:n:q:d:h")) != -1) {
+		switch (c) {
+		case 'r':
+			remote = optarg;
+			break;
+		case 's':
+			data.source = optarg;
+			break;
+		case 'f':
+			if (data.n_filters == MAX_FILTERS) {
+				fprintf(stderr, "too many filters\n");
+				return -1;
+			}
+			data.filters[data.n_filters++] = optarg;
+			break;
+		case 'P':
+		{
+			char *sep = strchr(optarg, '=');
+
+			if (sep == NULL || 2 * (data.n_props + 1) > MAX_PROPS) {
+				usage(argv[0]);
+				return -1;
+			}
+			*sep = '\0';
+			if (snprintf(prop_keys[data.n_props], sizeof(prop_keys[0]),
+				     SPA_TYPE_PROPS_BASE "%s", optarg) >= sizeof(prop_keys[0])) {
+				fprintf(stderr, "prop name too long: %s\n", optarg);
+				return -1;
+			}
+			data.props[2 * data.n_props] = prop_keys[data.n_props];
+			data.props[2 * data.n_props + 1] = sep + 1;
+			data.n_props++;
+			break;
+		}
+		case 'n':
+			data.n_paths = SPA_CLAMP(atoi(optarg), 1, MAX_PATHS);
+			break;
+		case 'q':
+			data.quantum = SPA_MAX(atoi(optarg), 1);
+			break;
+		case 'd':
+			data.duration = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+
+	data.loop = pw_main_loop_new(NULL);
+	if (data.loop == NULL)
+		return -1;
+
+	l = pw_main_loop_get_loop(data.loop);
+	pw_loop_add_signal(l, SIGINT, do_quit, &data);
+	pw_loop_add_signal(l, SIGTERM, do_quit, &data);
+	data.timer = pw_loop_add_timer(l, on_timeout, &data);
+
+	data.core = pw_core_new(l, NULL);
+	if (data.core == NULL)
+		return -1;
+
+	data.t = pw_core_get_type(data.core);
+	init_type(&data.type, data.t->map);
+
+	if (remote)
+		props = pw_properties_new(PW_REMOTE_PROP_REMOTE_NAME, remote, NULL);
+
+	data.remote = pw_remote_new(data.core, props, 0);
+	if (data.remote == NULL)
+		return -1;
+
+	pw_remote_add_listener(data.remote, &data.remote_listener, &remote_events, &data);
+	if (pw_remote_connect(data.remote) < 0)
+		return -1;
+
+	pw_main_loop_run(data.loop);
+
+	print_summary(&data);
+
+	for (i = 0; i < data.n_paths; i++) {
+		struct path *p = &data.paths[i];
+
+		if (p->sink)
+			pw_stream_destroy(p->sink);
+		if (p->source)
+			pw_stream_destroy(p->source);
+	}
+	pw_remote_destroy(data.remote);
+	pw_core_destroy(data.core);
+	pw_main_loop_destroy(data.loop);
+
+	return 0;
+}
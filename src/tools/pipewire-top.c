@@ -0,0 +1,358 @@
+/* PipeWire
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/interfaces.h>
+#include <pipewire/profiler.h>
+#include <pipewire/type.h>
+
+struct stats {
+	uint32_t count;
+	uint64_t sum;
+	uint64_t max;
+};
+
+struct node {
+	struct spa_list link;
+	uint32_t id;
+	char *name;
+
+	struct pw_proxy *proxy;
+	struct spa_hook proxy_listener;
+
+	struct stats process;		/**< process_input and process_output */
+	struct stats cycle;		/**< cycles started by this node */
+	struct stats period;		/**< time between cycle starts */
+	uint64_t last_cycle;
+	uint32_t errors;
+	uint32_t xruns;
+};
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_core *core;
+
+	struct pw_remote *remote;
+	struct spa_hook remote_listener;
+
+	struct pw_core_proxy *core_proxy;
+
+	struct pw_registry_proxy *registry_proxy;
+	struct spa_hook registry_listener;
+
+	struct spa_source *timer;
+
+	struct pw_profiler_area *area;
+	size_t size;
+	uint32_t index;
+	uint32_t lost;
+
+	struct spa_list nodes;
+};
+
+static struct node *find_node(struct data *d, uint32_t id, bool create)
+{
+	struct node *n;
+
+	spa_list_for_each(n, &d->nodes, link) {
+		if (n->id == id)
+			return n;
+	}
+	if (!create)
+		return NULL;
+
+	n = calloc(1, sizeof(struct node));
+	n->id = id;
+	spa_list_append(&d->nodes, &n->link);
+	return n;
+}
+
+static void free_node(struct node *n)
+{
+	if (n->proxy)
+		pw_proxy_destroy(n->proxy);
+	spa_list_remove(&n->link);
+	free(n->name);
+	free(n);
+}
+
+static inline void stats_add(struct stats *s, uint64_t val)
+{
+	s->count++;
+	s->sum += val;
+	if (val > s->max)
+		s->max = val;
+}
+
+static inline uint64_t stats_avg(struct stats *s)
+{
+	return s->count ? s->sum / s->count : 0;
+}
+
+static void handle_record(struct data *d, struct pw_profiler_record *rec)
+{
+	struct node *n = find_node(d, rec->id, true);
+	uint64_t elapsed = rec->end - rec->start;
+
+	if (rec->flags & PW_PROFILER_RECORD_FLAG_CYCLE) {
+		stats_add(&n->cycle, elapsed);
+		if (n->last_cycle != 0) {
+			uint64_t period = rec->start - n->last_cycle;
+
+			stats_add(&n->period, period);
+			/* the cycle did not complete before the next one was due */
+			if (elapsed > period)
+				n->xruns++;
+		}
+		n->last_cycle = rec->start;
+	} else {
+		stats_add(&n->process, elapsed);
+		if (rec->status < 0)
+			n->errors++;
+	}
+}
+
+static void print_stats(struct data *d)
+{
+	struct node *n;
+
+	printf("\033[H\033[2J");
+	printf("%5s %9s %9s %9s %9s %9s %6s %6s  %s\n",
+	       "ID", "AVG(us)", "MAX(us)", "CYCLE", "WCYCLE", "PERIOD", "XRUNS", "ERR", "NAME");
+
+	spa_list_for_each(n, &d->nodes, link) {
+		if (n->process.count == 0 && n->cycle.count == 0)
+			continue;
+
+		printf("%5u %9.1f %9.1f ", n->id,
+		       stats_avg(&n->process) / 1000.0, n->process.max / 1000.0);
+		if (n->cycle.count > 0)
+			printf("%9.1f %9.1f %9.1f ",
+			       stats_avg(&n->cycle) / 1000.0, n->cycle.max / 1000.0,
+			       stats_avg(&n->period) / 1000.0);
+		else
+			printf("%9s %9s %9s ", "-", "-", "-");
+		printf("%6u %6u  %s\n", n->xruns, n->errors, n->name ? n->name : "");
+
+		spa_zero(n->process);
+		spa_zero(n->cycle);
+		spa_zero(n->period);
+	}
+	if (d->lost > 0)
+		printf("\n%u times records were lost, reader too slow\n", d->lost);
+	fflush(stdout);
+}
+
+static void on_timeout(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	struct pw_profiler_record rec;
+	int res;
+
+	if (d->area == NULL)
+		return;
+
+	while ((res = pw_profiler_area_read(d->area, &d->index, &rec)) != 0) {
+		if (res < 0)
+			d->lost++;
+		else
+			handle_record(d, &rec);
+	}
+	print_stats(d);
+}
+
+static void on_info_changed(void *data, const struct pw_core_info *info)
+{
+	struct data *d = data;
+	const char *path;
+	struct timespec value, interval;
+
+	if (d->area != NULL)
+		return;
+
+	if (info->props == NULL ||
+	    (path = spa_dict_lookup(info->props, PW_CORE_PROP_PROFILER_PATH)) == NULL) {
+		fprintf(stderr, "profiler not enabled in \"%s\", start it with %s=true\n",
+			info->name, PW_CORE_PROP_PROFILER);
+		pw_main_loop_quit(d->loop);
+		return;
+	}
+
+	if ((d->area = pw_profiler_area_map(path, &d->size)) == NULL) {
+		fprintf(stderr, "can't map profiler area %s\n", path);
+		pw_main_loop_quit(d->loop);
+		return;
+	}
+	/* only show what happens from now on */
+	d->index = __atomic_load_n(&d->area->write_index, __ATOMIC_ACQUIRE);
+
+	value.tv_sec = 1;
+	value.tv_nsec = 0;
+	interval = value;
+	pw_loop_update_timer(pw_main_loop_get_loop(d->loop), d->timer, &value, &interval, false);
+}
+
+static void node_event_info(void *object, struct pw_node_info *info)
+{
+	struct node *n = object;
+
+	if (info->name == NULL)
+		return;
+
+	free(n->name);
+	n->name = strdup(info->name);
+}
+
+static const struct pw_node_proxy_events node_events = {
+	PW_VERSION_NODE_PROXY_EVENTS,
+	.info = node_event_info
+};
+
+static void registry_event_global(void *data, uint32_t id, uint32_t parent_id,
+				  uint32_t permissions, uint32_t type, uint32_t version)
+{
+	struct data *d = data;
+	struct pw_type *t = pw_core_get_type(d->core);
+	struct node *n;
+
+	if (type != t->node)
+		return;
+
+	n = find_node(d, id, true);
+	n->proxy = pw_registry_proxy_bind(d->registry_proxy, id, type, PW_VERSION_NODE, 0);
+	if (n->proxy == NULL) {
+		fprintf(stderr, "failed to create proxy");
+		return;
+	}
+	pw_proxy_add_proxy_listener(n->proxy, &n->proxy_listener, &node_events, n);
+}
+
+static void registry_event_global_remove(void *object, uint32_t id)
+{
+	struct data *d = object;
+	struct node *n;
+
+	if ((n = find_node(d, id, false)) != NULL)
+		free_node(n);
+}
+
+static const struct pw_registry_proxy_events registry_events = {
+	PW_VERSION_REGISTRY_PROXY_EVENTS,
+	.global = registry_event_global,
+	.global_remove = registry_event_global_remove,
+};
+
+static void on_state_changed(void *_data, enum pw_remote_state old,
+			     enum pw_remote_state state, const char *error)
+{
+	struct data *data = _data;
+	struct pw_type *t = pw_core_get_type(data->core);
+
+	switch (state) {
+	case PW_REMOTE_STATE_ERROR:
+		fprintf(stderr, "remote error: %s\n", error);
+		pw_main_loop_quit(data->loop);
+		break;
+
+	case PW_REMOTE_STATE_CONNECTED:
+		data->core_proxy = pw_remote_get_core_proxy(data->remote);
+		data->registry_proxy = pw_core_proxy_get_registry(data->core_proxy,
+								  t->registry,
+								  PW_VERSION_REGISTRY, 0);
+		pw_registry_proxy_add_listener(data->registry_proxy,
+					       &data->registry_listener,
+					       &registry_events, data);
+		break;
+
+	case PW_REMOTE_STATE_UNCONNECTED:
+		pw_main_loop_quit(data->loop);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const struct pw_remote_events remote_events = {
+	PW_VERSION_REMOTE_EVENTS,
+	.info_changed = on_info_changed,
+	.state_changed = on_state_changed,
+};
+
+static void do_quit(void *data, int signal_number)
+{
+	struct data *d = data;
+	pw_main_loop_quit(d->loop);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	struct pw_loop *l;
+	struct pw_properties *props = NULL;
+	struct node *n, *t;
+
+	pw_init(&argc, &argv);
+
+	spa_list_init(&data.nodes);
+
+	data.loop = pw_main_loop_new(NULL);
+	if (data.loop == NULL)
+		return -1;
+
+	l = pw_main_loop_get_loop(data.loop);
+	pw_loop_add_signal(l, SIGINT, do_quit, &data);
+	pw_loop_add_signal(l, SIGTERM, do_quit, &data);
+	data.timer = pw_loop_add_timer(l, on_timeout, &data);
+
+	/* never profile ourselves */
+	data.core = pw_core_new(l, pw_properties_new(PW_CORE_PROP_PROFILER, "false", NULL));
+	if (data.core == NULL)
+		return -1;
+
+	if (argc > 1)
+		props = pw_properties_new(PW_REMOTE_PROP_REMOTE_NAME, argv[1], NULL);
+
+	data.remote = pw_remote_new(data.core, props, 0);
+	if (data.remote == NULL)
+		return -1;
+
+	pw_remote_add_listener(data.remote, &data.remote_listener, &remote_events, &data);
+	if (pw_remote_connect(data.remote) < 0)
+		return -1;
+
+	pw_main_loop_run(data.loop);
+
+	spa_list_for_each_safe(n, t, &data.nodes, link)
+		free_node(n);
+
+	pw_remote_destroy(data.remote);
+	pw_core_destroy(data.core);
+	pw_main_loop_destroy(data.loop);
+
+	if (data.area)
+		pw_profiler_area_unmap(data.area, data.size);
+
+	return 0;
+}